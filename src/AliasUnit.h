@@ -22,6 +22,8 @@
  ***************************************************************************/
 
 
+#include "TRegex.h"
+
 #include "pre_guard.h"
 #include <QMultiMap>
 #include <QMutex>
@@ -78,6 +80,8 @@ public:
     int statsMinLineProcessingTime;
     int statsRegexAliases;
     QList<TAlias*> uninstallList;
+    // For the JIT compiled code of all of the aliases' regexes:
+    TRegexJitStack mJitStack;
 
 
 private:
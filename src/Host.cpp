@@ -59,6 +59,7 @@ Host::Host(int port, const QString& hostname, const QString& login, const QStrin
 , mAutoClearCommandLineAfterSend(false)
 , mBlockScriptCompile(true)
 , mEchoLuaErrors(false)
+, mIsTriggerGroupScanEnabled(false)
 , mBorderBottomHeight(0)
 , mBorderLeftWidth(0)
 , mBorderRightWidth(0)
@@ -82,6 +83,8 @@ Host::Host(int port, const QString& hostname, const QString& login, const QStrin
 , mPrintCommand(true)
 , mIsCurrentLogFileInHtmlFormat(false)
 , mIsNextLogFileInHtmlFormat(false)
+, mIsCurrentLogFileInBinaryFormat(false)
+, mIsNextLogFileInBinaryFormat(false)
 , mIsLoggingTimestamps(false)
 , mLogDir(QString())
 , mLogFileName(QString())
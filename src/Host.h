@@ -54,6 +54,7 @@ class TMap;
 class TRoom;
 class TConsole;
 class dlgNotepad;
+class dlgConnectionStatistics;
 class TMap;
 
 
@@ -188,6 +189,10 @@ public:
     bool mAutoClearCommandLineAfterSend;
     bool mBlockScriptCompile;
     bool mEchoLuaErrors;
+    // Whether the Perl regexes of the triggers in each folder are first all
+    // looked for at once (see TRegexSet) so that PCRE is only run for the
+    // ones that might match:
+    bool mIsTriggerGroupScanEnabled;
     int mBorderBottomHeight;
     int mBorderLeftWidth;
     int mBorderRightWidth;
@@ -212,6 +217,8 @@ public:
     dlgTriggerEditor* mpEditorDialog;
     QScopedPointer<TMap> mpMap;
     dlgNotepad* mpNotePad;
+    // Deletes itself when closed:
+    QPointer<dlgConnectionStatistics> mpConnectionStatistics;
 
     bool mPrintCommand;
 
@@ -227,6 +234,11 @@ public:
     // also mIsCurrentLogFileInHtmlFormat.
     bool mIsNextLogFileInHtmlFormat;
 
+    // As the two above, but for the compact binary format (see TSessionLog)
+    // which takes precedence over HTML:
+    bool mIsCurrentLogFileInBinaryFormat;
+    bool mIsNextLogFileInBinaryFormat;
+
     bool mIsLoggingTimestamps;
 
     // Where to put HTML/text logfile (default is the "Logs" under the profile's
@@ -313,6 +325,10 @@ public:
     QColor mBgColor_2;
     bool mMapStrongHighlight;
     QStringList mGMCP_merge_table_keys;
+    // GMCP keys for which only the last message in each batch of incoming data
+    // is put into the gmcp table (or, for a merge key, all of them are merged
+    // in) with the events for it raised just once, at the end of the batch:
+    QStringList mGMCP_coalesce_table_keys;
     QString mSpellDic;
     bool mLogStatus;
     bool mEnableSpellCheck;
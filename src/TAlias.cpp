@@ -88,7 +88,7 @@ bool TAlias::match(const QString& toMatch)
     bool matchCondition = false;
     //bool ret = false;
     //bool conditionMet = false;
-    QSharedPointer<pcre> re = mpRegex;
+    QSharedPointer<TRegex> re = mpRegex;
     if (re == nullptr) {
         return false; //regex compile error
     }
@@ -112,7 +112,7 @@ bool TAlias::match(const QString& toMatch)
 
     //cout <<" LINE="<<subject<<endl;
     if (mRegexCode.size() > 0) {
-        rc = pcre_exec(re.data(), nullptr, subject, subject_length, 0, 0, ovector, 100);
+        rc = re->exec(subject, subject_length, 0, 0, ovector, 100, &mpHost->getAliasUnit()->mJitStack);
     } else {
         goto MUD_ERROR;
     }
@@ -147,15 +147,15 @@ bool TAlias::match(const QString& toMatch)
             TDebug(QColor(Qt::darkMagenta), QColor(Qt::black)) << "<" << match.c_str() << ">\n" >> 0;
         }
     }
-    pcre_fullinfo(re.data(), nullptr, PCRE_INFO_NAMECOUNT, &namecount);
+    re->fullInfo(PCRE_INFO_NAMECOUNT, &namecount);
 
     if (namecount <= 0) {
         //cout << "no named substrings detected" << endl;
     } else {
         unsigned char* tabptr;
-        pcre_fullinfo(re.data(), nullptr, PCRE_INFO_NAMETABLE, &name_table);
+        re->fullInfo(PCRE_INFO_NAMETABLE, &name_table);
 
-        pcre_fullinfo(re.data(), nullptr, PCRE_INFO_NAMEENTRYSIZE, &name_entry_size);
+        re->fullInfo(PCRE_INFO_NAMEENTRYSIZE, &name_entry_size);
 
         tabptr = name_table;
         for (i = 0; i < namecount; i++) {
@@ -175,7 +175,7 @@ bool TAlias::match(const QString& toMatch)
             options = PCRE_NOTEMPTY | PCRE_ANCHORED;
         }
 
-        rc = pcre_exec(re.data(), nullptr, subject, subject_length, start_offset, options, ovector, 30);
+        rc = re->exec(subject, subject_length, start_offset, options, ovector, 30, &mpHost->getAliasUnit()->mJitStack);
         if (rc == PCRE_ERROR_NOMATCH) {
             if (options == 0) {
                 break;
@@ -226,11 +226,6 @@ MUD_ERROR:
     return matchCondition;
 }
 
-static void pcre_deleter(pcre* pointer)
-{
-    pcre_free(pointer);
-}
-
 void TAlias::setRegexCode(const QString& code)
 {
     mRegexCode = code;
@@ -239,12 +234,11 @@ void TAlias::setRegexCode(const QString& code)
 
 void TAlias::compileRegex()
 {
-    const char* error;
-    int erroffset;
+    QString error;
 
     // PCRE_UTF8 needed to run compile in UTF-8 mode
     // PCRE_UCP needed for \d, \w etc. to use Unicode properties:
-    QSharedPointer<pcre> re(pcre_compile(mRegexCode.toUtf8().constData(), PCRE_UTF8 | PCRE_UCP, &error, &erroffset, nullptr), pcre_deleter);
+    QSharedPointer<TRegex> re = TRegex::compile(mRegexCode, PCRE_UTF8 | PCRE_UCP, error);
 
     if (re == nullptr) {
         mOK_init = false;
@@ -252,7 +246,7 @@ void TAlias::compileRegex()
             TDebug(QColor(Qt::white), QColor(Qt::red)) << "REGEX ERROR: failed to compile, reason:\n" << error << "\n" >> 0;
             TDebug(QColor(Qt::red), QColor(Qt::gray)) << R"(in: ")" << mRegexCode << "\"\n" >> 0;
         }
-        setError(QStringLiteral("<b><font color='blue'>%1</font></b>").arg(tr(R"(Error: in "Pattern:", faulty regular expression, reason: "%1".)", error)));
+        setError(QStringLiteral("<b><font color='blue'>%1</font></b>").arg(tr(R"(Error: in "Pattern:", faulty regular expression, reason: "%1".)").arg(error)));
     } else {
         mOK_init = true;
     }
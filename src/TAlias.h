@@ -23,6 +23,7 @@
  ***************************************************************************/
 
 
+#include "TRegex.h"
 #include "Tree.h"
 
 #include "pre_guard.h"
@@ -31,8 +32,6 @@
 #include <QSharedPointer>
 #include "post_guard.h"
 
-#include <pcre.h>
-
 class Host;
 
 
@@ -67,7 +66,7 @@ public:
     QString mName;
     QString mCommand;
     QString mRegexCode;
-    QSharedPointer<pcre> mpRegex;
+    QSharedPointer<TRegex> mpRegex;
     QString mScript;
     QPointer<Host> mpHost;
     bool mNeedsToBeCompiled;
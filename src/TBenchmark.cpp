@@ -0,0 +1,196 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TBenchmark.h"
+
+
+#include "Host.h"
+#include "TRegex.h"
+#include "mudlet.h"
+
+#include "pre_guard.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QStringList>
+#include "post_guard.h"
+
+#include <iostream>
+
+#if defined(Q_OS_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+TBenchmark* TBenchmark::smpActive = nullptr;
+
+TBenchmark::TBenchmark(const QString& profileName, const QString& replayFileName, QObject* parent)
+: QObject(parent)
+, mProfileName(profileName)
+, mReplayFileName(replayFileName)
+, mCurrentStage(Other)
+, mCurrentStageStart(0)
+, mBytes(0)
+, mLines(0)
+, mRegexRuns(0)
+, mIsFinished(false)
+{
+    for (auto& time : mStageTimes) {
+        time = 0;
+    }
+    // Set from the start so that loading the profile knows not to connect it:
+    smpActive = this;
+}
+
+TBenchmark::~TBenchmark()
+{
+    if (smpActive == this) {
+        smpActive = nullptr;
+    }
+}
+
+void TBenchmark::slot_start()
+{
+    if (!QDir(mudlet::getMudletPath(mudlet::profileHomePath, mProfileName)).exists()) {
+        abort(QStringLiteral("there is no profile called \"%1\".").arg(mProfileName));
+        return;
+    }
+
+    mudlet::self()->doAutoLogin(mProfileName);
+    Host* pHost = mudlet::self()->getHostManager().getHost(mProfileName);
+    if (!pHost) {
+        abort(QStringLiteral("unable to load the profile \"%1\".").arg(mProfileName));
+        return;
+    }
+
+    // Only the replay itself is to be measured, not loading the profile:
+    for (auto& time : mStageTimes) {
+        time = 0;
+    }
+    mRegexRuns = 0;
+    mStageStack.clear();
+    mCurrentStage = Other;
+    mClock.start();
+    mCurrentStageStart = 0;
+
+    QString errorMessage;
+    if (!mudlet::self()->loadReplay(pHost, mReplayFileName, &errorMessage)) {
+        abort(errorMessage);
+        return;
+    }
+    mudlet::self()->setReplaySpeed(0);
+}
+
+void TBenchmark::enter(const Stage stage)
+{
+    const qint64 now = mClock.nsecsElapsed();
+    mStageTimes[mCurrentStage] += now - mCurrentStageStart;
+    mStageStack.push_back(mCurrentStage);
+    mCurrentStage = stage;
+    mCurrentStageStart = now;
+}
+
+void TBenchmark::leave()
+{
+    if (mStageStack.empty()) {
+        return;
+    }
+    const qint64 now = mClock.nsecsElapsed();
+    mStageTimes[mCurrentStage] += now - mCurrentStageStart;
+    mCurrentStage = mStageStack.back();
+    mStageStack.pop_back();
+    mCurrentStageStart = now;
+}
+
+void TBenchmark::finish()
+{
+    if (mIsFinished) {
+        return;
+    }
+    mIsFinished = true;
+
+    const qint64 now = mClock.nsecsElapsed();
+    mStageTimes[mCurrentStage] += now - mCurrentStageStart;
+    mCurrentStageStart = now;
+    const double seconds = qMax(now, Q_INT64_C(1)) / 1.0e9;
+
+    static const char* const stageNames[StageCount] = {"other", "telnet", "parsing", "triggers", "regex", "lua", "display"};
+
+    QStringList texts;
+    texts << QStringLiteral("Benchmark of profile \"%1\" with replay \"%2\":\n").arg(mProfileName, mReplayFileName);
+    texts << QStringLiteral("  %1 lines, %2 bytes in %3 seconds\n").arg(mLines).arg(mBytes).arg(seconds, 0, 'f', 3);
+    texts << QStringLiteral("  %1 lines/sec, %2 bytes/sec\n").arg(mLines / seconds, 0, 'f', 0).arg(mBytes / seconds, 0, 'f', 0);
+    const double regexSeconds = qMax(mStageTimes[Regex], Q_INT64_C(1)) / 1.0e9;
+    texts << QStringLiteral("  %1 regex runs, %2 regex runs/sec of regex time, JIT %3\n")
+             .arg(mRegexRuns)
+             .arg(mRegexRuns / regexSeconds, 0, 'f', 0)
+             .arg(TRegex::isJitEnabled() ? QStringLiteral("on") : QStringLiteral("off (--no-regex-jit)"));
+    texts << QStringLiteral("  stage         seconds   share\n");
+    for (int i = 0; i < StageCount; ++i) {
+        const double stageSeconds = mStageTimes[i] / 1.0e9;
+        texts << QStringLiteral("  %1 %2 %3%\n")
+                 .arg(QString::fromLatin1(stageNames[i]), -12)
+                 .arg(stageSeconds, 9, 'f', 3)
+                 .arg(100.0 * stageSeconds / seconds, 6, 'f', 1);
+    }
+    const qint64 peakMemory = peakMemoryUsage();
+    if (peakMemory >= 0) {
+        texts << QStringLiteral("  peak memory use: %1 MiB\n").arg(peakMemory / 1048576.0, 0, 'f', 1);
+    } else {
+        texts << QStringLiteral("  peak memory use: unknown\n");
+    }
+    std::cout << texts.join(QString()).toStdString() << std::flush;
+
+    smpActive = nullptr;
+    QCoreApplication::exit(0);
+}
+
+void TBenchmark::abort(const QString& reason)
+{
+    std::cerr << QStringLiteral("Benchmark failed: %1\n").arg(reason).toStdString() << std::flush;
+    mIsFinished = true;
+    smpActive = nullptr;
+    QCoreApplication::exit(1);
+}
+
+// In bytes, or -1 if it cannot be determined:
+qint64 TBenchmark::peakMemoryUsage()
+{
+#if defined(Q_OS_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+    return -1;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return -1;
+    }
+#if defined(Q_OS_MACOS)
+    // Reported in bytes on macOS...
+    return static_cast<qint64>(usage.ru_maxrss);
+#else
+    // ... but in KiB on Linux and the BSDs:
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
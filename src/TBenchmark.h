@@ -0,0 +1,139 @@
+#ifndef MUDLET_TBENCHMARK_H
+#define MUDLET_TBENCHMARK_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include "post_guard.h"
+
+#include <vector>
+
+
+// Drives the "--benchmark <profile> <replay file>" command line mode: the
+// profile is loaded (but not connected) and the replay is pushed through the
+// normal cTelnet -> TBuffer -> TriggerUnit -> Lua pipeline as fast as it can
+// go; when it is over a summary of the throughput, the time spent in each
+// stage and the peak memory use is written to standard output and the
+// application quits.
+// The stages are timed exclusively - time spent in a nested stage (e.g.
+// running the Lua of a trigger) is NOT also counted against the stage it was
+// entered from - so the stage times add up to the total.
+class TBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stage {
+        Other = 0,
+        Telnet,
+        Parsing,
+        Triggers,
+        Regex,
+        Lua,
+        Display,
+        StageCount
+    };
+
+    Q_DISABLE_COPY(TBenchmark)
+    TBenchmark(const QString& profileName, const QString& replayFileName, QObject* parent = nullptr);
+    ~TBenchmark();
+
+    // Only non-null whilst a benchmark is running, so the (inline) hooks
+    // below cost no more than a test of this otherwise:
+    static TBenchmark* active() { return smpActive; }
+    static void addBytes(const size_t count)
+    {
+        if (smpActive) {
+            smpActive->mBytes += count;
+        }
+    }
+    static void addLine()
+    {
+        if (smpActive) {
+            ++smpActive->mLines;
+        }
+    }
+    static void addRegexRun()
+    {
+        if (smpActive) {
+            ++smpActive->mRegexRuns;
+        }
+    }
+
+    void enter(const Stage stage);
+    void leave();
+    // Called when the replay is over:
+    void finish();
+
+public slots:
+    void slot_start();
+
+private:
+    void abort(const QString& reason);
+    static qint64 peakMemoryUsage();
+
+
+    static TBenchmark* smpActive;
+
+    QString mProfileName;
+    QString mReplayFileName;
+    QElapsedTimer mClock;
+    qint64 mStageTimes[StageCount];
+    // The stage currently being timed, when it (last) started and what to go
+    // back to afterwards:
+    Stage mCurrentStage;
+    qint64 mCurrentStageStart;
+    std::vector<Stage> mStageStack;
+    quint64 mBytes;
+    quint64 mLines;
+    quint64 mRegexRuns;
+    bool mIsFinished;
+};
+
+
+// Times the enclosing block as the given stage when a benchmark is running:
+class TBenchmarkScope
+{
+public:
+    Q_DISABLE_COPY(TBenchmarkScope)
+    explicit TBenchmarkScope(const TBenchmark::Stage stage)
+    : mpBenchmark(TBenchmark::active())
+    {
+        if (mpBenchmark) {
+            mpBenchmark->enter(stage);
+        }
+    }
+
+    ~TBenchmarkScope()
+    {
+        if (mpBenchmark) {
+            mpBenchmark->leave();
+        }
+    }
+
+private:
+    TBenchmark* mpBenchmark;
+};
+
+#endif // MUDLET_TBENCHMARK_H
@@ -23,14 +23,20 @@
 #include "TBuffer.h"
 
 #include "Host.h"
+#include "TByteScanner.h"
 #include "TConsole.h"
+#include "TScrollbackArchive.h"
+#include "TSessionLog.h"
 
 #include "pre_guard.h"
+#include <QDateTime>
 #include <QTextCodec>
 #include <QRegularExpression>
 #include "post_guard.h"
 
+#include <algorithm>
 #include <queue>
+#include <vector>
 
 #include <assert.h>
 
@@ -617,19 +623,14 @@ const QMap<QString, QPair<QString, QVector<QChar>>> TBuffer::csmEncodingTable =
 };
 // clang-format on
 
-TChar::TChar()
-{
-    fgR = 255;
-    fgG = 255;
-    fgB = 255;
-    bgR = 0;
-    bgG = 0;
-    bgB = 0;
-    flags = 0;
-    link = 0;
-}
-
-TChar::TChar(int fR, int fG, int fB, int bR, int bG, int bB, bool b, bool i, bool u, bool s, int _link) : fgR(fR), fgG(fG), fgB(fB), bgR(bR), bgG(bG), bgB(bB), link(_link)
+TChar::TChar(int fR, int fG, int fB, int bR, int bG, int bB, bool b, bool i, bool u, bool s, int _link)
+: fgR(static_cast<quint8>(qBound(0, fR, 255)))
+, fgG(static_cast<quint8>(qBound(0, fG, 255)))
+, fgB(static_cast<quint8>(qBound(0, fB, 255)))
+, bgR(static_cast<quint8>(qBound(0, bR, 255)))
+, bgG(static_cast<quint8>(qBound(0, bG, 255)))
+, bgB(static_cast<quint8>(qBound(0, bB, 255)))
+, link(static_cast<quint16>(_link))
 {
     flags = 0;
     if (i) {
@@ -696,19 +697,13 @@ bool TChar::operator==(const TChar& c)
     return true;
 }
 
-TChar::TChar(const TChar& copy)
-{
-    fgR = copy.fgR;
-    fgG = copy.fgG;
-    fgB = copy.fgB;
-    bgR = copy.bgR;
-    bgG = copy.bgG;
-    bgB = copy.bgB;
-    flags = copy.flags;
-    link = copy.link;
-    flags &= ~(TCHAR_INVERSE); //for some reason we always clear the inverse, is this a bug?
-}
 
+const qint64 TBuffer::csmNoTimeStamp;
+const qint64 TBuffer::csmContinuationTimeStamp;
+
+static_assert(TSessionLog::csmItalics == TCHAR_ITALICS && TSessionLog::csmBold == TCHAR_BOLD && TSessionLog::csmUnderline == TCHAR_UNDERLINE
+                      && TSessionLog::csmInverse == TCHAR_INVERSE && TSessionLog::csmStrikeOut == TCHAR_STRIKEOUT,
+              "the binary session log flags must match the TCHAR_ ones");
 
 TBuffer::TBuffer(Host* pH)
 : mLinkID(0)
@@ -728,9 +723,12 @@ TBuffer::TBuffer(Host* pH)
 , mSkip("")
 , mParsingVar(false)
 , mMXP_SEND_NO_REF_MODE(false)
+, mReceivedTime(0)
 , gotESC(false)
 , gotHeader(false)
 , codeRet(0)
+, mCsiParameter(0)
+, mIsCsiUnhandled(false)
 , mBlack(pH->mBlack)
 , mLightBlack(pH->mLightBlack)
 , mRed(pH->mRed)
@@ -750,6 +748,10 @@ TBuffer::TBuffer(Host* pH)
 , mFgColor(pH->mFgColor)
 , mBgColor(pH->mBgColor)
 , mpHost(pH)
+, mTrimmedLines(0)
+, mLineRenumberCount(0)
+, mVisibleLines(0)
+, mUnreflowedLines(0)
 , mCursorMoved(false)
 , mBold(false)
 , mItalics(false)
@@ -771,8 +773,6 @@ TBuffer::TBuffer(Host* pH)
 , maxy()
 , hadLF()
 , mCode()
-, lastLoggedFromLine(0)
-, lastloggedToLine(0)
 , mEncoding()
 , mMainIncomingCodec(nullptr)
 {
@@ -806,6 +806,46 @@ void TBuffer::setBufferSize(int s, int batch)
     mBatchDeleteSize = batch;
 }
 
+// Turning this off discards whatever has been archived so far:
+void TBuffer::setArchived(const bool state)
+{
+    if (state && !mpArchive) {
+        mpArchive.reset(new TScrollbackArchive);
+    } else if (!state) {
+        mpArchive.reset();
+    }
+}
+
+int TBuffer::archivedLineCount() const
+{
+    return mpArchive ? mpArchive->lineCount() : 0;
+}
+
+// Puts the most recently archived batch of lines back in front of those in
+// memory (so the buffer can go over mLinesLimit until it is next trimmed) and
+// returns how many there were; the caller must allow for every line number
+// going up by that amount:
+int TBuffer::restoreArchivedLines()
+{
+    if (!mpArchive) {
+        return 0;
+    }
+
+    const int count = mpArchive->takeLastBlock(buffer, lineBuffer, timeBuffer, promptBuffer);
+    if (count > 0) {
+        dirty.reserve(dirty.size() + count);
+        for (int i = 0; i < count; ++i) {
+            dirty.prepend(true);
+        }
+        // Archived lines are not put back together when the width changes:
+        wrapBuffer.insert(wrapBuffer.begin(), static_cast<size_t>(count), TLineWrap());
+        noteLinesInserted(0, count);
+        mCursorY += count;
+        mTrimmedLines -= count;
+    }
+    return count;
+}
+
 void TBuffer::updateColors()
 {
     Host* pH = mpHost;
@@ -873,6 +913,13 @@ void TBuffer::updateColors()
     mWhiteR = mWhite.red();
     mWhiteG = mWhite.green();
     mWhiteB = mWhite.blue();
+    // In the order of the ANSI color codes, the light ones following the
+    // normal ones:
+    const QColor* ansiColors[16] = {&mBlack, &mRed, &mGreen, &mYellow, &mBlue, &mMagenta, &mCyan, &mWhite,
+                                    &mLightBlack, &mLightRed, &mLightGreen, &mLightYellow, &mLightBlue, &mLightMagenta, &mLightCyan, &mLightWhite};
+    for (int i = 0; i < 16; ++i) {
+        mAnsiColors[i] = ansiColors[i]->rgb();
+    }
     mFgColor = pH->mFgColor;
     mBgColor = pH->mBgColor;
     mFgColorR = mFgColor.red();
@@ -1135,15 +1182,324 @@ void TBuffer::addLink(bool trigMode, const QString& text, QStringList& command,
       elements at the end can be omitted.
  */
 
-void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServer)
+// The grey ramp of the xterm 256 colour palette (codes 232 to 255) runs from
+// black to white in 24 steps, that is in units of 255/23 which is not an
+// integer, so it is looked up rather than calculated:
+static const int csmGreyScale[24] = {0, 11, 22, 33, 44, 55, 67, 78, 89, 100, 111, 122, 133, 144, 155, 166, 177, 188, 200, 211, 222, 233, 244, 255};
+
+// Sets the foreground to one of the eight basic ANSI colours (0 to 7) along
+// with the light version of it that is used when it is bold:
+inline void TBuffer::setFgAnsiColor(const int color)
 {
-    const QString cDigit = "0123456789";
+    const QRgb normal = mAnsiColors[color];
+    const QRgb light = mAnsiColors[color + 8];
+    fgColorR = qRed(normal);
+    fgColorG = qGreen(normal);
+    fgColorB = qBlue(normal);
+    fgColorLightR = qRed(light);
+    fgColorLightG = qGreen(light);
+    fgColorLightB = qBlue(light);
+    mIsDefaultColor = false;
+}
 
-    // As well as enabling the prepending of left-over bytes from last packet
-    // from the MUD server this may help in high frequency interactions to
-    // protect this process from the supplied string being modified
-    // asynchronously by the QNetwork code that runs in another thread:
-    std::string localBuffer;
+// Sets the background to one of the sixteen ANSI colours (8 to 15 being the
+// light versions of 0 to 7):
+inline void TBuffer::setBgAnsiColor(const int color)
+{
+    const QRgb rgb = mAnsiColors[color];
+    bgColorR = qRed(rgb);
+    bgColorG = qGreen(rgb);
+    bgColorB = qBlue(rgb);
+}
+
+// Converts one of the xterm 256 colour palette codes above the first sixteen
+// into the red, green and blue components of it, returns false if the code
+// is out of range:
+static bool xterm256Color(int code, int& red, int& green, int& blue)
+{
+    if (code >= 16 && code < 232) {
+        // 6x6x6 RGB color space
+        code -= 16;
+        // Did use 42 as a factor but that isn't right as it yields:
+        // 0:0; 1:42; 2:84; 3:126; 4:168; 5:210
+        // 6 x 42 DOES equal 252 BUT IT IS OUT OF RANGE... Instead we should
+        // use 51:
+        // 0:0; 1:51; 2:102; 3:153; 4:204: 5:255
+        red = (code / 36) * 51;
+        green = ((code / 6) % 6) * 51;
+        blue = (code % 6) * 51;
+        return true;
+    } else if (code >= 232 && code < 256) {
+        red = green = blue = csmGreyScale[code - 232];
+        return true;
+    }
+    return false;
+}
+
+void TBuffer::setFgXterm256Color(int code)
+{
+    if (code < 16) {
+        // The first sixteen behave like the normal ANSI colors, with the
+        // second eight being the bold ones:
+        if (code >= 8) {
+            code -= 8;
+            mBold = true;
+        } else {
+            mBold = false;
+        }
+        setFgAnsiColor(code);
+        return;
+    }
+
+    int red, green, blue;
+    if (!xterm256Color(code, red, green, blue)) {
+        red = green = blue = 192;
+        qWarning() << "TBuffer::translateToPlainText() 256 Color mode parsing Grey-scale code for foreground failed, unexpected value encountered (outside of 232-255):" << code << "mapping to light-grey!";
+    }
+    fgColorR = fgColorLightR = red;
+    fgColorG = fgColorLightG = green;
+    fgColorB = fgColorLightB = blue;
+}
+
+void TBuffer::setBgXterm256Color(const int code)
+{
+    if (code < 16) {
+        setBgAnsiColor(code);
+        mIsDefaultColor = false;
+        return;
+    }
+
+    int red, green, blue;
+    if (!xterm256Color(code, red, green, blue)) {
+        red = green = blue = 64;
+        qWarning() << "TBuffer::translateToPlainText() 256 Color mode parsing Grey-scale code for background failed, unexpected value encountered (outside of 232-255):" << code << "mapping to dark-grey!";
+    }
+    bgColorR = red;
+    bgColorG = green;
+    bgColorB = blue;
+}
+
+// Adds the number that has been accumulated to the parameters of the current
+// CSI sequence, any beyond the first csmMaxCsiParameters are dropped:
+inline void TBuffer::pushCsiParameter()
+{
+    if (codeRet < csmMaxCsiParameters) {
+        mCode[++codeRet] = mCsiParameter;
+    }
+    mCsiParameter = 0;
+}
+
+inline void TBuffer::resetCsiParameters()
+{
+    codeRet = 0;
+    mCsiParameter = 0;
+    mIsCsiUnhandled = false;
+}
+
+// Acts on the parameters, mCode[1] to mCode[codeRet], of an SGR ("ESC [ ... m")
+// sequence:
+void TBuffer::processSgrCodes()
+{
+    auto setMillionsColor = [this](const int (&components)[3]) {
+        if (mIsHighOrMillionsColorModeForeground) {
+            fgColorR = fgColorLightR = components[0];
+            fgColorG = fgColorLightG = components[1];
+            fgColorB = fgColorLightB = components[2];
+            mIsDefaultColor = false;
+        } else if (mIsHighOrMillionsColorModeBackground) {
+            bgColorR = components[0];
+            bgColorG = components[1];
+            bgColorB = components[2];
+            mIsDefaultColor = false;
+        }
+    };
+
+    for (int i = 1; i <= codeRet; ++i) {
+        const int tag = mCode[i];
+        if (mWaitingForHighColorCode) {
+            if (mIsHighOrMillionsColorModeForeground) {
+                setFgXterm256Color(tag);
+            } else if (mIsHighOrMillionsColorModeBackground) {
+                setBgXterm256Color(tag);
+            }
+            mWaitingForHighColorCode = false;
+            mIsHighOrMillionsColorMode = false;
+            mIsHighOrMillionsColorModeForeground = false;
+            mIsHighOrMillionsColorModeBackground = false;
+            continue;
+        }
+
+        if (mWaitingForMillionsColorCode) {
+            // Need to consume this and two more codes from mCode
+            // This is not a true ANSI spec decoder because it
+            // uses only ';' to separate the sub-options and
+            // only takes a maximum of three after the 38;2 or 48;2
+            // a full implementation would use ':' and handle a
+            // a variable number of up to six more numbers...
+            // the use of ':' would make it is possible to
+            // separate the sub-options as compared to a whole
+            // new SGR code...
+            // Any of the green and blue components that are missing are zero:
+            int components[3] = {qBound(0, tag, 255), 0, 0};
+            for (int j = 1; j < 3 && i < codeRet; ++j) {
+                components[j] = qBound(0, mCode[++i], 255);
+            }
+            setMillionsColor(components);
+            mWaitingForMillionsColorCode = false;
+            mIsHighOrMillionsColorMode = false;
+            mIsHighOrMillionsColorModeForeground = false;
+            mIsHighOrMillionsColorModeBackground = false;
+            continue;
+        }
+
+        if (tag == 38) {
+            mIsHighOrMillionsColorMode = true;
+            mIsHighOrMillionsColorModeForeground = true;
+            continue;
+        } else if (tag == 48) {
+            mIsHighOrMillionsColorMode = true;
+            mIsHighOrMillionsColorModeBackground = true;
+            continue;
+        }
+
+        if (mIsHighOrMillionsColorMode) {
+            switch (tag) {
+            case 5: // Indexed 256 color mode
+                mWaitingForHighColorCode = true;
+                continue;
+            case 2: // 24Bit RGB color mode
+                mWaitingForMillionsColorCode = true;
+                continue;
+            case 4: // 24Bit CYMB color mode
+            case 3: // 24Bit CYM color mode
+            case 1: // "Transparent" mode
+            case 0: // "Application defined" mode
+                qWarning() << "TBuffer::translateToPlainText(...) Warning unhandled ANSI SGR 38/48 type color code encountered, first parameter is:" << tag;
+                break;
+            default:
+                qWarning() << "TBuffer::translateToPlainText(...) Warning unknown ANSI SGR 38/48 type color code encountered, first parameter is:" << tag;
+                break;
+            }
+            // Give up on this 38/48 rather than taking the next code as
+            // another attempt at the type:
+            mIsHighOrMillionsColorMode = false;
+            mIsHighOrMillionsColorModeForeground = false;
+            mIsHighOrMillionsColorModeBackground = false;
+            continue;
+        }
+
+        // we are dealing with standard ANSI colors
+        if (tag >= 30 && tag <= 37) {
+            setFgAnsiColor(tag - 30);
+            continue;
+        } else if (tag >= 40 && tag <= 47) {
+            setBgAnsiColor(tag - 40);
+            continue;
+        }
+
+        switch (tag) {
+        case 0:
+            mWaitingForHighColorCode = false;
+            mWaitingForMillionsColorCode = false;
+            mIsHighOrMillionsColorMode = false;
+            mIsHighOrMillionsColorModeForeground = false;
+            mIsHighOrMillionsColorModeBackground = false;
+            mIsDefaultColor = true;
+            fgColorR = mFgColorR;
+            fgColorG = mFgColorG;
+            fgColorB = mFgColorB;
+            bgColorR = mBgColorR;
+            bgColorG = mBgColorG;
+            bgColorB = mBgColorB;
+            mBold = false;
+            mItalics = false;
+            mUnderline = false;
+            mStrikeOut = false;
+            break;
+        case 1:
+            mBold = true;
+            break;
+        case 2:
+            mBold = false;
+            break;
+        case 3:
+            mItalics = true;
+            break;
+        case 4:
+            mUnderline = true;
+            break;
+        case 5:
+            // TODO:
+            break; //slow-blinking
+        case 6:
+            // TODO:
+            break; //fast blinking
+        case 7:
+            // TODO:
+            break; //inverse
+        case 9:
+            mStrikeOut = true;
+            break; //strikethrough
+        case 10:
+            break; //default font
+        case 22:
+            mBold = false;
+            break;
+        case 23:
+            mItalics = false;
+            break;
+        case 24:
+            mUnderline = false;
+            break;
+        case 25:
+            break; // blink off
+        case 27:
+            // TODO:
+            break; //inverse off
+        case 29:
+            mStrikeOut = false;
+            break; //not crossed out (strikethrough) text
+        case 39: //default foreground color
+            fgColorR = mFgColorR;
+            fgColorG = mFgColorG;
+            fgColorB = mFgColorB;
+            break;
+        case 49: // default background color
+            bgColorR = mBgColorR;
+            bgColorG = mBgColorG;
+            bgColorB = mBgColorB;
+            break;
+        case 53: // overline on
+            // TODO:
+            break;
+        case 55: // overline off
+            // TODO:
+            break;
+        }
+    }
+
+    // Nothing that is still pending carries over into the next sequence: a
+    // 38;2 or 48;2 that ended before any of its components is black (as the
+    // missing ones are all zero) and a 38 or 48 without a type, or a 38;5 or
+    // 48;5 without an index, is dropped:
+    if (mWaitingForMillionsColorCode) {
+        const int black[3] = {0, 0, 0};
+        setMillionsColor(black);
+    }
+    mWaitingForHighColorCode = false;
+    mWaitingForMillionsColorCode = false;
+    mIsHighOrMillionsColorMode = false;
+    mIsHighOrMillionsColorModeForeground = false;
+    mIsHighOrMillionsColorModeBackground = false;
+}
+
+void TBuffer::translateToPlainText(const TStringView& incoming, const bool isFromServer)
+{
+    // Normally the incoming data is worked on in place, only when there are
+    // left-over bytes from the last packet from the MUD server to prepend is a
+    // copy made (into joinedBuffer):
+    std::string joinedBuffer;
+    TStringView localBuffer;
 
     Host* pHost = mpHost;
     if (!pHost) {
@@ -1151,6 +1507,10 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
         return; // We really have a problem
     }
 
+    // Every line completed by this lot of data gets the same time, preferably
+    // that of the socket read that brought it in:
+    const qint64 lineTime = (isFromServer && mReceivedTime > 0) ? mReceivedTime : QDateTime::currentMSecsSinceEpoch();
+
     // Check this each packet
     QString usedEncoding = mpHost->mTelnet.getEncoding();
     if (mEncoding != usedEncoding) {
@@ -1166,8 +1526,11 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
 #if defined(DEBUG_UTF8_PROCESSING) || defined(DEBUG_GB_PROCESSING)
         qDebug() << "TBuffer::translateToPlainText(...) Prepending residual UTF-8 bytes onto incoming data!";
 #endif
-        localBuffer = mIncompleteSequenceBytes + incoming;
+        joinedBuffer.reserve(mIncompleteSequenceBytes.size() + incoming.size());
+        joinedBuffer = mIncompleteSequenceBytes;
+        joinedBuffer.append(incoming.data(), incoming.size());
         mIncompleteSequenceBytes.clear();
+        localBuffer = TStringView(joinedBuffer);
     } else {
         localBuffer = incoming;
     }
@@ -1181,7 +1544,6 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
     // done as opposed to a a repeated switch(...) and branch to one of a series
     // of decoding methods each with another up to 128 value switch()
 
-    int numCodes = 0;
     mUntriggered = lineBuffer.size() - 1;
     size_t localBufferLength = localBuffer.length();
     size_t localBufferPosition = 0;
@@ -1194,7 +1556,36 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
         if (localBufferPosition >= localBufferLength) {
             return;
         }
-        char& ch = localBuffer[localBufferPosition];
+
+        // Fast path - take a whole run of plain printable ASCII text, that
+        // cannot be part of an ANSI, MXP or multi-byte sequence, in one go:
+        if (!gotESC && !gotHeader && !mMXP_SEND_NO_REF_MODE && !(mMXP && (mAssemblingToken || mIgnoreTag || openT))) {
+            size_t runLength = TByteScanner::findEndOfPlainText(localBuffer.data() + localBufferPosition, localBufferLength - localBufferPosition);
+            if (runLength) {
+                mMudLine.append(QLatin1String(localBuffer.data() + localBufferPosition, static_cast<int>(runLength)));
+                TChar c(!mIsDefaultColor && mBold ? fgColorLightR : fgColorR,
+                        !mIsDefaultColor && mBold ? fgColorLightG : fgColorG,
+                        !mIsDefaultColor && mBold ? fgColorLightB : fgColorB,
+                        bgColorR,
+                        bgColorG,
+                        bgColorB,
+                        mIsDefaultColor ? mBold : false,
+                        mItalics,
+                        mUnderline,
+                        mStrikeOut);
+
+                if (mMXP_LINK_MODE) {
+                    c.link = mLinkID;
+                    c.flags |= TCHAR_UNDERLINE;
+                }
+
+                mMudBuffer.insert(mMudBuffer.end(), runLength, c);
+                localBufferPosition += runLength;
+                continue;
+            }
+        }
+
+        char ch = localBuffer[localBufferPosition];
         if (ch == '\033') {
             gotESC = true;
             ++localBufferPosition;
@@ -1204,686 +1595,79 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
             if (ch == '[') {
                 gotHeader = true;
                 gotESC = false;
+                resetCsiParameters();
                 ++localBufferPosition;
                 continue;
             }
         }
 
         if (gotHeader) {
+            // A CSI sequence: parameter bytes (numbers separated by ';' or
+            // ':', with a leading "<", "=", ">" or "?" marking a private
+            // sequence) then optional intermediate bytes and finally a single
+            // byte that says what to do with them. The numbers are put into
+            // mCode as they are read, so this can stop at the end of the data
+            // and carry on when the next packet arrives:
             while (localBufferPosition < localBufferLength) {
-                QChar ch2 = localBuffer[localBufferPosition];
+                const unsigned char ch2 = static_cast<unsigned char>(localBuffer[localBufferPosition]);
+                if (ch2 >= '0' && ch2 <= '9') {
+                    // Capped to avoid overflow from an absurdly long number:
+                    mCsiParameter = qMin(mCsiParameter * 10 + (ch2 - '0'), 99999);
+                    ++localBufferPosition;
+                    continue;
+                } else if (ch2 == ';') {
+                    pushCsiParameter();
+                    ++localBufferPosition;
+                    continue;
+                } else if (ch2 == ':' || (ch2 >= '<' && ch2 <= '?')) {
+                    // ':' separated sub-parameters (the ITU T.416 form of the
+                    // 38/48 codes) are not handled, so such sequences are
+                    // dropped as a whole, as are private ones:
+                    mIsCsiUnhandled = true;
+                    ++localBufferPosition;
+                    continue;
+                } else if (ch2 >= 0x20 && ch2 <= 0x2F) {
+                    // Intermediate bytes, not used by anything we handle:
+                    ++localBufferPosition;
+                    continue;
+                }
 
-                if (ch2 == 'z' && !mpHost->mFORCE_MXP_NEGOTIATION_OFF) {
-                    gotHeader = false;
-                    gotESC = false;
+                gotHeader = false;
+                if (ch2 < 0x40 || ch2 > 0x7E) {
+                    // Not a valid final byte so the sequence is abandoned and
+                    // this is processed as normal:
+                    resetCsiParameters();
+                    goto DECODE;
+                }
+                ++localBufferPosition;
 
+                if (ch2 == 'z' && !mpHost->mFORCE_MXP_NEGOTIATION_OFF) {
                     // MXP line modes
-
+                    const int mode = mCsiParameter;
                     // locked mode
-                    if (code == "7" || code == "2") {
+                    if (mode == 7 || mode == 2) {
                         mMXP = false;
                     }
                     // secure mode
-                    if (code == "1" || code == "6" || code == "4") {
+                    if (mode == 1 || mode == 6 || mode == 4) {
                         mMXP = true;
                     }
                     // reset
-                    if (code == "3") {
+                    if (mode == 3) {
                         closeT = 0;
                         openT = 0;
                         mAssemblingToken = false;
                         currentToken.clear();
                         mParsingVar = false;
                     }
-                    codeRet = 0;
-                    code.clear();
-                    ++localBufferPosition;
-                    goto DECODE;
-                }
-                int digit = cDigit.indexOf(ch2);
-                if (digit > -1) {
-                    code.append(ch2);
-                    ++localBufferPosition;
-                    continue;
-                } else if (ch2 == ';') {
-                    codeRet++;
-                    mCode[codeRet] = code.toInt();
-                    code.clear();
-                    ++localBufferPosition;
-                    continue;
-                } else if (ch2 == 'm') {
-                    codeRet++;
-                    mCode[codeRet] = code.toInt();
-                    code.clear();
-                    gotHeader = false;
-                    ++localBufferPosition;
-
-                    numCodes += codeRet;
-                    for (int i = 1; i < codeRet + 1; i++) {
-                        // Parse the groups of numeric SGR codes
-                        int tag = mCode[i];
-                        if (mWaitingForHighColorCode) {
-                            if (mIsHighOrMillionsColorModeForeground) {
-                                if (tag < 16) {
-
-                                    if (tag >= 8) {
-                                        tag -= 8;
-                                        mBold = true;
-                                    } else {
-                                        mBold = false;
-                                    }
-                                    switch (tag) {
-                                    case 0:
-                                        fgColorR = mBlackR;
-                                        fgColorG = mBlackG;
-                                        fgColorB = mBlackB;
-                                        fgColorLightR = mLightBlackR;
-                                        fgColorLightG = mLightBlackG;
-                                        fgColorLightB = mLightBlackB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 1:
-                                        fgColorR = mRedR;
-                                        fgColorG = mRedG;
-                                        fgColorB = mRedB;
-                                        fgColorLightR = mLightRedR;
-                                        fgColorLightG = mLightRedG;
-                                        fgColorLightB = mLightRedB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 2:
-                                        fgColorR = mGreenR;
-                                        fgColorG = mGreenG;
-                                        fgColorB = mGreenB;
-                                        fgColorLightR = mLightGreenR;
-                                        fgColorLightG = mLightGreenG;
-                                        fgColorLightB = mLightGreenB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 3:
-                                        fgColorR = mYellowR;
-                                        fgColorG = mYellowG;
-                                        fgColorB = mYellowB;
-                                        fgColorLightR = mLightYellowR;
-                                        fgColorLightG = mLightYellowG;
-                                        fgColorLightB = mLightYellowB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 4:
-                                        fgColorR = mBlueR;
-                                        fgColorG = mBlueG;
-                                        fgColorB = mBlueB;
-                                        fgColorLightR = mLightBlueR;
-                                        fgColorLightG = mLightBlueG;
-                                        fgColorLightB = mLightBlueB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 5:
-                                        fgColorR = mMagentaR;
-                                        fgColorG = mMagentaG;
-                                        fgColorB = mMagentaB;
-                                        fgColorLightR = mLightMagentaR;
-                                        fgColorLightG = mLightMagentaG;
-                                        fgColorLightB = mLightMagentaB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 6:
-                                        fgColorR = mCyanR;
-                                        fgColorG = mCyanG;
-                                        fgColorB = mCyanB;
-                                        fgColorLightR = mLightCyanR;
-                                        fgColorLightG = mLightCyanG;
-                                        fgColorLightB = mLightCyanB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 7:
-                                        fgColorR = mWhiteR;
-                                        fgColorG = mWhiteG;
-                                        fgColorB = mWhiteB;
-                                        fgColorLightR = mLightWhiteR;
-                                        fgColorLightG = mLightWhiteG;
-                                        fgColorLightB = mLightWhiteB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    }
-
-                                } else if (tag < 232) {
-                                    tag -= 16; // because color 1-15 behave like normal ANSI colors
-                                    // 6x6x6 RGB color space
-                                    int r = tag / 36;
-                                    int g = (tag - (r * 36)) / 6;
-                                    int b = (tag - (r * 36)) - (g * 6);
-                                    // Did use 42 as a factor but that isn't
-                                    // right as it yields:
-                                    // 0:0; 1:42; 2:84; 3:126; 4:168; 5:210
-                                    // 6 x 42 DOES equal 252 BUT IT IS OUT OF
-                                    // RANGE... Instead we should use 51:
-                                    // 0:0; 1:51; 2:102; 3:153; 4:204: 5:255
-                                    fgColorR = r * 51;
-                                    fgColorLightR = r * 51;
-                                    fgColorG = g * 51;
-                                    fgColorLightG = g * 51;
-                                    fgColorB = b * 51;
-                                    fgColorLightB = b * 51;
-                                } else {
-                                    // black + 23 tone grayscale from dark to light gray
-                                    // Similar to RGB case the multiplier is a bit off
-                                    // we have been using 10 but 23 x 10 = 230
-                                    // whereas 23 should map to 255, this requires
-                                    // a non-integer multiplier, instead of multiplying
-                                    // and rounding we, for speed, can use a look-up table:
-                                    int value;
-                                    // clang-format off
-                                    switch (tag) {
-                                        case 232:   value =   0; break; //   0.000
-                                        case 233:   value =  11; break; //  11.087
-                                        case 234:   value =  22; break; //  22.174
-                                        case 235:   value =  33; break; //  33.261
-                                        case 236:   value =  44; break; //  44.348
-                                        case 237:   value =  55; break; //  55.435
-                                        case 238:   value =  67; break; //  66.522
-                                        case 239:   value =  78; break; //  77.609
-                                        case 240:   value =  89; break; //  88.696
-                                        case 241:   value = 100; break; //  99.783
-                                        case 242:   value = 111; break; // 110.870
-                                        case 243:   value = 122; break; // 121.957
-                                        case 244:   value = 133; break; // 133.043
-                                        case 245:   value = 144; break; // 144.130
-                                        case 246:   value = 155; break; // 155.217
-                                        case 247:   value = 166; break; // 166.304
-                                        case 248:   value = 177; break; // 177.391
-                                        case 249:   value = 188; break; // 188.478
-                                        case 250:   value = 200; break; // 199.565
-                                        case 251:   value = 211; break; // 210.652
-                                        case 252:   value = 222; break; // 221.739
-                                        case 253:   value = 233; break; // 232.826
-                                        case 254:   value = 244; break; // 243.913
-                                        case 255:   value = 255; break; // 255.000
-                                        default:
-                                            value = 192;
-                                            qWarning() << "TBuffer::translateToPlainText() 256 Color mode parsing Grey-scale code for foreground failed, unexpected value encountered (outside of 232-255):" << tag << "mapping to light-grey!";
-                                    }
-                                    // clang-format on
-                                    fgColorR = value;
-                                    fgColorLightR = value;
-                                    fgColorG = value;
-                                    fgColorLightG = value;
-                                    fgColorB = value;
-                                    fgColorLightB = value;
-                                }
-
-                                mWaitingForHighColorCode = false;
-                                mIsHighOrMillionsColorMode = false;
-                                mIsHighOrMillionsColorModeForeground = false;
-                                continue;
-                            } else if (mIsHighOrMillionsColorModeBackground) {
-                                if (tag < 16) {
-
-                                    bool _bold;
-                                    if (tag >= 8) {
-                                        tag -= 8;
-                                        _bold = true;
-                                    } else {
-                                        _bold = false;
-                                    }
-                                    int bgColorLightR = 0;
-                                    int bgColorLightG = 0;
-                                    int bgColorLightB = 0;
-                                    switch (tag) {
-                                    case 0:
-                                        bgColorR = mBlackR;
-                                        bgColorG = mBlackG;
-                                        bgColorB = mBlackB;
-                                        bgColorLightR = mLightBlackR;
-                                        bgColorLightG = mLightBlackG;
-                                        bgColorLightB = mLightBlackB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 1:
-                                        bgColorR = mRedR;
-                                        bgColorG = mRedG;
-                                        bgColorB = mRedB;
-                                        bgColorLightR = mLightRedR;
-                                        bgColorLightG = mLightRedG;
-                                        bgColorLightB = mLightRedB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 2:
-                                        bgColorR = mGreenR;
-                                        bgColorG = mGreenG;
-                                        bgColorB = mGreenB;
-                                        bgColorLightR = mLightGreenR;
-                                        bgColorLightG = mLightGreenG;
-                                        bgColorLightB = mLightGreenB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 3:
-                                        bgColorR = mYellowR;
-                                        bgColorG = mYellowG;
-                                        bgColorB = mYellowB;
-                                        bgColorLightR = mLightYellowR;
-                                        bgColorLightG = mLightYellowG;
-                                        bgColorLightB = mLightYellowB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 4:
-                                        bgColorR = mBlueR;
-                                        bgColorG = mBlueG;
-                                        bgColorB = mBlueB;
-                                        bgColorLightR = mLightBlueR;
-                                        bgColorLightG = mLightBlueG;
-                                        bgColorLightB = mLightBlueB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 5:
-                                        bgColorR = mMagentaR;
-                                        bgColorG = mMagentaG;
-                                        bgColorB = mMagentaB;
-                                        bgColorLightR = mLightMagentaR;
-                                        bgColorLightG = mLightMagentaG;
-                                        bgColorLightB = mLightMagentaB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 6:
-                                        bgColorR = mCyanR;
-                                        bgColorG = mCyanG;
-                                        bgColorB = mCyanB;
-                                        bgColorLightR = mLightCyanR;
-                                        bgColorLightG = mLightCyanG;
-                                        bgColorLightB = mLightCyanB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    case 7:
-                                        bgColorR = mWhiteR;
-                                        bgColorG = mWhiteG;
-                                        bgColorB = mWhiteB;
-                                        bgColorLightR = mLightWhiteR;
-                                        bgColorLightG = mLightWhiteG;
-                                        bgColorLightB = mLightWhiteB;
-                                        mIsDefaultColor = false;
-                                        break;
-                                    }
-                                    if (_bold) {
-                                        bgColorR = bgColorLightR;
-                                        bgColorG = bgColorLightG;
-                                        bgColorB = bgColorLightB;
-                                    }
-
-                                } else if (tag < 232) {
-                                    tag -= 16;
-                                    int r = tag / 36;
-                                    int g = (tag - (r * 36)) / 6;
-                                    int b = (tag - (r * 36)) - (g * 6);
-                                    bgColorR = r * 51;
-                                    bgColorG = g * 51;
-                                    bgColorB = b * 51;
-                                } else {
-                                    // black + 23 tone grayscale from dark to (NOT light gray, but) white
-                                    int value;
-                                    // clang-format off
-                                    switch (tag) {
-                                        case 232:   value =   0; break; //   0.000
-                                        case 233:   value =  11; break; //  11.087
-                                        case 234:   value =  22; break; //  22.174
-                                        case 235:   value =  33; break; //  33.261
-                                        case 236:   value =  44; break; //  44.348
-                                        case 237:   value =  55; break; //  55.435
-                                        case 238:   value =  67; break; //  66.522
-                                        case 239:   value =  78; break; //  77.609
-                                        case 240:   value =  89; break; //  88.696
-                                        case 241:   value = 100; break; //  99.783
-                                        case 242:   value = 111; break; // 110.870
-                                        case 243:   value = 122; break; // 121.957
-                                        case 244:   value = 133; break; // 133.043
-                                        case 245:   value = 144; break; // 144.130
-                                        case 246:   value = 155; break; // 155.217
-                                        case 247:   value = 166; break; // 166.304
-                                        case 248:   value = 177; break; // 177.391
-                                        case 249:   value = 188; break; // 188.478
-                                        case 250:   value = 200; break; // 199.565
-                                        case 251:   value = 211; break; // 210.652
-                                        case 252:   value = 222; break; // 221.739
-                                        case 253:   value = 233; break; // 232.826
-                                        case 254:   value = 244; break; // 243.913
-                                        case 255:   value = 255; break; // 255.000
-                                        default:
-                                            value = 64;
-                                            qWarning() << "TBuffer::translateToPlainText() 256 Color mode parsing Grey-scale code for background failed, unexpected value encountered (outside of 232-255):" << tag << "mapping to dark-grey!";
-                                    }
-                                    // clang-format on
-                                    bgColorR = value;
-                                    bgColorG = value;
-                                    bgColorB = value;
-                                }
-
-                                mWaitingForHighColorCode = false;
-                                mIsHighOrMillionsColorMode = false;
-                                mIsHighOrMillionsColorModeBackground = false;
-
-                            }
-
-                            continue;
-                        } else if (mWaitingForMillionsColorCode) {
-                            // Need to consume this and two more codes from mCode
-                            // This is not a true ANSI spec decoder because it
-                            // uses only ';' to separate the sub-options and
-                            // only takes a maximum of three after the 38;2 or 48;2
-                            // a full implementation would use ':' and handle a
-                            // a variable number of up to six more numbers...
-                            // the use of ':' would make it is possible to
-                            // separate the sub-options as compared to a whole
-                            // new SGR code...
-                            if (mIsHighOrMillionsColorModeForeground) {
-                                if (i + 2 <= codeRet) {
-                                    // Have enough for all three suboptions
-                                    fgColorR = qBound(0, mCode[i++], 255);
-                                    fgColorG = qBound(0, mCode[i++], 255);
-                                    fgColorB = qBound(0, mCode[i++], 255);
-                                    fgColorLightR = fgColorR;
-                                    fgColorLightG = fgColorG;
-                                    fgColorLightB = fgColorB;
-                                    mIsDefaultColor = false;
-                                } else if (i + 1 <= codeRet) {
-                                    // Have enough for two suboptions, but third, blue component is zero
-                                    fgColorR = qBound(0, mCode[i++], 255);
-                                    fgColorG = qBound(0, mCode[i++], 255);
-                                    fgColorB = 0;
-                                    fgColorLightR = fgColorR;
-                                    fgColorLightG = fgColorG;
-                                    fgColorLightB = fgColorB;
-                                    mIsDefaultColor = false;
-                                } else if (i <= codeRet) {
-                                    // Have enough for one suboption, but second and third, green and blue component are zero
-                                    fgColorR = qBound(0, mCode[i++], 255);
-                                    fgColorG = 0;
-                                    fgColorB = 0;
-                                    fgColorLightR = fgColorR;
-                                    fgColorLightG = fgColorG;
-                                    fgColorLightB = fgColorB;
-                                    mIsDefaultColor = false;
-                                } else  {
-                                    // No codes left so colour must be black, as all of red, green and blue components are zero
-                                    fgColorR = 0;
-                                    fgColorG = 0;
-                                    fgColorB = 0;
-                                    fgColorLightR = fgColorR;
-                                    fgColorLightG = fgColorG;
-                                    fgColorLightB = fgColorB;
-                                    mIsDefaultColor = false;
-                                }
-
-                                mWaitingForMillionsColorCode = false;
-                                mIsHighOrMillionsColorMode = false;
-                                mIsHighOrMillionsColorModeBackground = false;
-
-                            } else if (mIsHighOrMillionsColorModeBackground) {
-                                if (i + 2 <= codeRet) {
-                                    // Have enough for all three suboptions
-                                    bgColorR = qBound(0, mCode[i++], 255);
-                                    bgColorG = qBound(0, mCode[i++], 255);
-                                    bgColorB = qBound(0, mCode[i++], 255);
-                                    mIsDefaultColor = false;
-                                } else if (i + 1 <= codeRet) {
-                                    // Have enough for two suboptions, but third, blue component is zero
-                                    bgColorR = qBound(0, mCode[i++], 255);
-                                    bgColorG = qBound(0, mCode[i++], 255);
-                                    bgColorB = 0;
-                                    mIsDefaultColor = false;
-                                } else if (i <= codeRet) {
-                                    // Have enough for one suboption, but second and third, green and blue component are zero
-                                    bgColorR = qBound(0, mCode[i++], 255);
-                                    bgColorG = 0;
-                                    bgColorB = 0;
-                                    mIsDefaultColor = false;
-                                } else  {
-                                    // No codes left so colour must be black, as all of red , green and blue components are zero
-                                    bgColorR = 0;
-                                    bgColorG = 0;
-                                    bgColorB = 0;
-                                    mIsDefaultColor = false;
-                                }
-
-                                mWaitingForMillionsColorCode = false;
-                                mIsHighOrMillionsColorMode = false;
-                                mIsHighOrMillionsColorModeBackground = false;
-                            }
-
-                            continue;
-                        }
-
-                        if (tag == 38) {
-                            mIsHighOrMillionsColorMode = true;
-                            mIsHighOrMillionsColorModeForeground = true;
-                            continue;
-                        } else if (tag == 48) {
-                            mIsHighOrMillionsColorMode = true;
-                            mIsHighOrMillionsColorModeBackground = true;
-                            continue;
-                        }
-
-                        if (mIsHighOrMillionsColorMode) {
-                            switch (tag) {
-                            case 5: // Indexed 256 color mode
-                                mWaitingForHighColorCode = true;
-                                break;
-                            case 2: // 24Bit RGB color mode
-                                mWaitingForMillionsColorCode = true;
-                                break;
-                            case 4: // 24Bit CYMB color mode
-                            case 3: // 24Bit CYM color mode
-                            case 1: // "Transparent" mode
-                            case 0: // "Application defined" mode
-                                qWarning() << "TBuffer::translateToPlainText(...) Warning unhandled ANSI SGR 38/48 type color code encountered, first parameter is:" << tag;
-                                break;
-                            default:
-                                qWarning() << "TBuffer::translateToPlainText(...) Warning unknown ANSI SGR 38/48 type color code encountered, first parameter is:" << tag;
-                                break;
-                            }
-
-                            continue;
-                        }
-
-                        // we are dealing with standard ANSI colors
-                        switch (tag) {
-                        case 0:
-                            mWaitingForHighColorCode = false;
-                            mWaitingForMillionsColorCode = false;
-                            mIsHighOrMillionsColorMode = false;
-                            mIsHighOrMillionsColorModeForeground = false;
-                            mIsHighOrMillionsColorModeBackground = false;
-                            mIsDefaultColor = true;
-                            fgColorR = mFgColorR;
-                            fgColorG = mFgColorG;
-                            fgColorB = mFgColorB;
-                            bgColorR = mBgColorR;
-                            bgColorG = mBgColorG;
-                            bgColorB = mBgColorB;
-                            mBold = false;
-                            mItalics = false;
-                            mUnderline = false;
-                            mStrikeOut = false;
-                            break;
-                        case 1:
-                            mBold = true;
-                            break;
-                        case 2:
-                            mBold = false;
-                            break;
-                        case 3:
-                            mItalics = true;
-                            break;
-                        case 4:
-                            mUnderline = true;
-                            break;
-                        case 5:
-                            // TODO:
-                            break; //slow-blinking
-                        case 6:
-                            // TODO:
-                            break; //fast blinking
-                        case 7:
-                            // TODO:
-                            break; //inverse
-                        case 9:
-                            mStrikeOut = true;
-                            break; //strikethrough
-                        case 10:
-                            break; //default font
-                        case 22:
-                            mBold = false;
-                            break;
-                        case 23:
-                            mItalics = false;
-                            break;
-                        case 24:
-                            mUnderline = false;
-                            break;
-                        case 25:
-                            break; // blink off
-                        case 27:
-                            // TODO:
-                            break; //inverse off
-                        case 29:
-                            mStrikeOut = false;
-                            break; //not crossed out (strikethrough) text
-                        case 30:
-                            fgColorR = mBlackR;
-                            fgColorG = mBlackG;
-                            fgColorB = mBlackB;
-                            fgColorLightR = mLightBlackR;
-                            fgColorLightG = mLightBlackG;
-                            fgColorLightB = mLightBlackB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 31:
-                            fgColorR = mRedR;
-                            fgColorG = mRedG;
-                            fgColorB = mRedB;
-                            fgColorLightR = mLightRedR;
-                            fgColorLightG = mLightRedG;
-                            fgColorLightB = mLightRedB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 32:
-                            fgColorR = mGreenR;
-                            fgColorG = mGreenG;
-                            fgColorB = mGreenB;
-                            fgColorLightR = mLightGreenR;
-                            fgColorLightG = mLightGreenG;
-                            fgColorLightB = mLightGreenB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 33:
-                            fgColorR = mYellowR;
-                            fgColorG = mYellowG;
-                            fgColorB = mYellowB;
-                            fgColorLightR = mLightYellowR;
-                            fgColorLightG = mLightYellowG;
-                            fgColorLightB = mLightYellowB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 34:
-                            fgColorR = mBlueR;
-                            fgColorG = mBlueG;
-                            fgColorB = mBlueB;
-                            fgColorLightR = mLightBlueR;
-                            fgColorLightG = mLightBlueG;
-                            fgColorLightB = mLightBlueB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 35:
-                            fgColorR = mMagentaR;
-                            fgColorG = mMagentaG;
-                            fgColorB = mMagentaB;
-                            fgColorLightR = mLightMagentaR;
-                            fgColorLightG = mLightMagentaG;
-                            fgColorLightB = mLightMagentaB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 36:
-                            fgColorR = mCyanR;
-                            fgColorG = mCyanG;
-                            fgColorB = mCyanB;
-                            fgColorLightR = mLightCyanR;
-                            fgColorLightG = mLightCyanG;
-                            fgColorLightB = mLightCyanB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 37:
-                            fgColorR = mWhiteR;
-                            fgColorG = mWhiteG;
-                            fgColorB = mWhiteB;
-                            fgColorLightR = mLightWhiteR;
-                            fgColorLightG = mLightWhiteG;
-                            fgColorLightB = mLightWhiteB;
-                            mIsDefaultColor = false;
-                            break;
-                        case 39: //default foreground color
-                            fgColorR = mFgColorR;
-                            fgColorG = mFgColorG;
-                            fgColorB = mFgColorB;
-                            break;
-                        case 40:
-                            bgColorR = mBlackR;
-                            bgColorG = mBlackG;
-                            bgColorB = mBlackB;
-                            break;
-                        case 41:
-                            bgColorR = mRedR;
-                            bgColorG = mRedG;
-                            bgColorB = mRedB;
-                            break;
-                        case 42:
-                            bgColorR = mGreenR;
-                            bgColorG = mGreenG;
-                            bgColorB = mGreenB;
-                            break;
-                        case 43:
-                            bgColorR = mYellowR;
-                            bgColorG = mYellowG;
-                            bgColorB = mYellowB;
-                            break;
-                        case 44:
-                            bgColorR = mBlueR;
-                            bgColorG = mBlueG;
-                            bgColorB = mBlueB;
-                            break;
-                        case 45:
-                            bgColorR = mMagentaR;
-                            bgColorG = mMagentaG;
-                            bgColorB = mMagentaB;
-                            break;
-                        case 46:
-                            bgColorR = mCyanR;
-                            bgColorG = mCyanG;
-                            bgColorB = mCyanB;
-                            break;
-                        case 47:
-                            bgColorR = mWhiteR;
-                            bgColorG = mWhiteG;
-                            bgColorB = mWhiteB;
-                            break;
-                        case 49: // default background color
-                            bgColorR = mBgColorR;
-                            bgColorG = mBgColorG;
-                            bgColorB = mBgColorB;
-                            break;
-                        case 53: // overline on
-                            // TODO:
-                            break;
-                        case 55: // overline off
-                            // TODO:
-                            break;
-                        };
-                    }
-
-                    codeRet = 0;
-                    goto DECODE;
-                } else {
-                    ++localBufferPosition;
-                    gotHeader = false;
-                    goto DECODE;
+                } else if (ch2 == 'm' && !mIsCsiUnhandled) {
+                    pushCsiParameter();
+                    processSgrCodes();
                 }
+                // Anything else is a control sequence that we do not handle
+                // and is just dropped.
+                resetCsiParameters();
+                goto DECODE;
             }
             // sequenz ist im naechsten tcp paket keep decoder state
             return;
@@ -2202,19 +1986,19 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
 
             if (ch == '&' || mIgnoreTag) {
                 if ((localBufferPosition + 4 < localBufferLength) && (mSkip.size() == 0)) {
-                    if (localBuffer.substr(localBufferPosition, 4) == "&gt;") {
+                    if (localBuffer.matchesAt(localBufferPosition, "&gt;")) {
                         localBufferPosition += 3;
                         ch = '>';
                         mIgnoreTag = false;
-                    } else if (localBuffer.substr(localBufferPosition, 4) == "&lt;") {
+                    } else if (localBuffer.matchesAt(localBufferPosition, "&lt;")) {
                         localBufferPosition += 3;
                         ch = '<';
                         mIgnoreTag = false;
-                    } else if (localBuffer.substr(localBufferPosition, 5) == "&amp;") {
+                    } else if (localBuffer.matchesAt(localBufferPosition, "&amp;")) {
                         mIgnoreTag = false;
                         localBufferPosition += 4;
                         ch = '&';
-                    } else if (localBuffer.substr(localBufferPosition, 6) == "&quot;") {
+                    } else if (localBuffer.matchesAt(localBufferPosition, "&quot;")) {
                         localBufferPosition += 5;
                         mIgnoreTag = false;
                         mSkip.clear();
@@ -2284,8 +2068,9 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
                     lineBuffer << QString();
                 }
                 buffer.push_back(mMudBuffer);
+                wrapBuffer.emplace_back();
                 dirty << true;
-                timeBuffer << (QTime::currentTime()).toString("hh:mm:ss.zzz") + "   ";
+                timeBuffer.push_back(lineTime);
                 if (ch == '\xff') {
                     promptBuffer.append(true);
                 } else {
@@ -2302,8 +2087,9 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
                     lineBuffer.back().append(QString());
                 }
                 buffer.back() = mMudBuffer;
+                wrapBuffer.back() = TLineWrap();
                 dirty.back() = true;
-                timeBuffer.back() = QTime::currentTime().toString("hh:mm:ss.zzz") + "   ";
+                timeBuffer.back() = lineTime;
                 if (ch == '\xff') {
                     promptBuffer.back() = true;
                 } else {
@@ -2324,8 +2110,9 @@ void TBuffer::translateToPlainText(std::string& incoming, const bool isFromServe
             std::deque<TChar> newLine;
             buffer.push_back(newLine);
             lineBuffer.push_back(QString());
-            timeBuffer.push_back("   ");
+            timeBuffer.push_back(csmNoTimeStamp);
             promptBuffer << false;
+            wrapBuffer.emplace_back();
             dirty << true;
             if (static_cast<int>(buffer.size()) > mLinesLimit) {
                 shrinkBuffer();
@@ -2449,8 +2236,9 @@ void TBuffer::append(const QString& text,
         newLine.push_back(c);
         buffer.push_back(newLine);
         lineBuffer.push_back(QString());
-        timeBuffer << QTime::currentTime().toString(QStringLiteral("hh:mm:ss.zzz   "));
+        timeBuffer.push_back(QDateTime::currentMSecsSinceEpoch());
         promptBuffer << false;
+        wrapBuffer.emplace_back();
         dirty << true;
         last = 0;
     }
@@ -2469,8 +2257,9 @@ void TBuffer::append(const QString& text,
             std::deque<TChar> newLine;
             buffer.push_back(newLine);
             lineBuffer.push_back(QString());
-            timeBuffer << QStringLiteral("-------------");
+            timeBuffer.push_back(csmContinuationTimeStamp);
             promptBuffer << false;
+            wrapBuffer.emplace_back();
             dirty << true;
             mLastLine++;
             newLines++;
@@ -2504,8 +2293,11 @@ void TBuffer::append(const QString& text,
                     } else {
                         lineBuffer.append(QString());
                     }
-                    timeBuffer << QStringLiteral("-------------");
+                    timeBuffer.push_back(csmContinuationTimeStamp);
                     promptBuffer << false;
+                    // Broken after the character that allows it, so nothing
+                    // is dropped:
+                    wrapBuffer.emplace_back(mWrapAt, 0, 0);
                     dirty << true;
                     mLastLine++;
                     newLines++;
@@ -2524,7 +2316,7 @@ void TBuffer::append(const QString& text,
         }
         buffer.back().push_back(c);
         if (firstChar) {
-            timeBuffer.back() = QTime::currentTime().toString(QStringLiteral("hh:mm:ss.zzz   "));
+            timeBuffer.back() = QDateTime::currentMSecsSinceEpoch();
             firstChar = false;
         }
     }
@@ -2561,8 +2353,9 @@ void TBuffer::appendLine(const QString& text,
         newLine.push_back(c);
         buffer.push_back(newLine);
         lineBuffer.push_back(QString());
-        timeBuffer << (QTime::currentTime()).toString("hh:mm:ss.zzz") + "   ";
+        timeBuffer.push_back(QDateTime::currentMSecsSinceEpoch());
         promptBuffer << false;
+        wrapBuffer.emplace_back();
         dirty << true;
         last = 0;
     }
@@ -2583,7 +2376,7 @@ void TBuffer::appendLine(const QString& text,
         }
         buffer.back().push_back(c);
         if (firstChar) {
-            timeBuffer.back() = (QTime::currentTime()).toString("hh:mm:ss.zzz") + "   ";
+            timeBuffer.back() = QDateTime::currentMSecsSinceEpoch();
         }
     }
 }
@@ -2612,8 +2405,11 @@ QPoint TBuffer::insert(QPoint& where, const QString& text, int fgColorR, int fgC
             promptBuffer.insert(y, false);
             const QString nothing = "";
             lineBuffer.insert(y, nothing);
-            timeBuffer << "-->"; //this is intentional -> faster
+            timeBuffer.insert(timeBuffer.begin() + y, csmContinuationTimeStamp);
+            wrapBuffer.insert(wrapBuffer.begin() + y, TLineWrap());
             dirty.insert(y, true);
+            noteLinesInserted(y, 1);
+            ++mLineRenumberCount;
             mLastLine++;
             newLines++;
             x = 0;
@@ -2626,6 +2422,7 @@ QPoint TBuffer::insert(QPoint& where, const QString& text, int fgColorR, int fgC
         buffer[y].insert(it + x, c);
     }
     dirty[y] = true;
+    markEdited(y);
     P.setX(x);
     P.setY(y);
     return P;
@@ -2653,6 +2450,7 @@ bool TBuffer::insertInLine(QPoint& P, const QString& text, TChar& format)
             auto it = buffer[y].begin();
             buffer[y].insert(it + x + i, c);
         }
+        markEdited(y);
     } else {
         appendLine(text,
                    0,
@@ -2789,34 +2587,31 @@ void TBuffer::appendBuffer(const TBuffer& chunk)
     append(lf, 0, 1, 0, 0, 0, 0, 0, 0, false, false, false, false);
 }
 
-int TBuffer::calcWrapPos(int line, int begin, int end)
+int TBuffer::calcWrapPos(const QString& lineText, int begin, int end)
 {
     const QString lineBreaks = ",.- \n";
-    if (lineBuffer.size() < line) {
-        return 0;
-    }
-    int lineSize = static_cast<int>(lineBuffer[line].size()) - 1;
+    int lineSize = lineText.size() - 1;
     if (lineSize < end) {
         end = lineSize;
     }
     for (int i = end; i >= begin; i--) {
-        if (lineBreaks.indexOf(lineBuffer[line].at(i)) > -1) {
+        if (lineBreaks.indexOf(lineText.at(i)) > -1) {
             return i;
         }
     }
     return 0;
 }
 
-inline int TBuffer::skipSpacesAtBeginOfLine(int i, int i2)
+inline int TBuffer::skipSpacesAtBeginOfLine(const std::deque<TChar>& lineStyles, const QString& lineText, int i2)
 {
     int offset = 0;
-    int i_end = lineBuffer[i].size();
+    int i_end = lineText.size();
     QChar space = ' ';
     while (i2 < i_end) {
-        if (buffer[i][i2].flags & TCHAR_ECHO) {
+        if (lineStyles[i2].flags & TCHAR_ECHO) {
             break;
         }
-        if (lineBuffer[i][i2] == space) {
+        if (lineText[i2] == space) {
             offset++;
         } else {
             break;
@@ -2831,108 +2626,306 @@ inline int TBuffer::wrap(int startLine)
     if (static_cast<int>(buffer.size()) < startLine || startLine < 0) {
         return 0;
     }
-    std::queue<std::deque<TChar>> queue;
-    QStringList tempList;
-    QStringList timeList;
-    QList<bool> promptList;
-    int lineCount = 0;
+
+    // Nearly every line fits as it is, those need nothing but marking as
+    // dirty and logging, rather than being taken apart and put back again:
+    bool isWrapNeeded = false;
     for (int i = startLine; i < static_cast<int>(buffer.size()); i++) {
-        bool isPrompt = promptBuffer[i];
-        std::deque<TChar> newLine;
-        QString lineText = "";
-        QString time = timeBuffer[i];
-        int indent = 0;
-        if (static_cast<int>(buffer[i].size()) >= mWrapAt) {
-            for (int i3 = 0; i3 < mWrapIndent; i3++) {
-                TChar pSpace;
-                newLine.push_back(pSpace);
-                lineText.append(" ");
-            }
-            indent = mWrapIndent;
-        }
-        int lastSpace = 0;
-        int wrapPos = 0;
-        int length = buffer[i].size();
-        if (length == 0) {
-            tempList.append(QString());
-            std::deque<TChar> emptyLine;
-            queue.push(emptyLine);
-            timeList.append(time);
+        if (static_cast<int>(buffer[i].size()) >= mWrapAt || lineBuffer.at(i).contains(QChar::LineFeed)) {
+            isWrapNeeded = true;
+            break;
         }
-        for (int i2 = 0; i2 < static_cast<int>(buffer[i].size());) {
-            if (length - i2 > mWrapAt - indent) {
-                wrapPos = calcWrapPos(i, i2, i2 + mWrapAt - indent);
-                lastSpace = qMax(0, wrapPos);
-            } else {
-                lastSpace = 0;
-            }
-            int wrapPosition = (lastSpace) ? lastSpace : (mWrapAt - indent);
-            for (int i3 = 0; i3 < wrapPosition; i3++) {
-                if (lastSpace > 0) {
-                    if (i2 > lastSpace) {
-                        break;
-                    }
-                }
-                if (i2 >= static_cast<int>(buffer[i].size())) {
-                    break;
-                }
-                if (lineBuffer[i].at(i2) == '\n') {
-                    i2++;
-                    break;
-                }
-                newLine.push_back(buffer[i][i2]);
-                lineText.append(lineBuffer[i].at(i2));
-                i2++;
-            }
-            if (newLine.size() == 0) {
-                tempList.append(QString());
-                std::deque<TChar> emptyLine;
-                queue.push(emptyLine);
-                timeList.append(QString());
-                promptList.append(false);
-            } else {
-                queue.push(newLine);
-                tempList.append(lineText);
-                timeList.append(time);
-                promptList.append(isPrompt);
-            }
-            newLine.clear();
-            lineText = "";
-            indent = 0;
-            i2 += skipSpacesAtBeginOfLine(i, i2);
+    }
+    if (!isWrapNeeded) {
+        for (int i = startLine; i < static_cast<int>(buffer.size()); i++) {
+            dirty[i] = true;
         }
-        lineCount++;
+        log(startLine, static_cast<int>(buffer.size()));
+        return 0;
     }
+
+    // Take the lines off the end and put them back a piece at a time:
+    const int lineCount = static_cast<int>(buffer.size()) - startLine;
+    std::vector<std::deque<TChar>> styleList;
+    styleList.reserve(static_cast<size_t>(lineCount));
+    for (int i = startLine; i < static_cast<int>(buffer.size()); i++) {
+        styleList.push_back(std::move(buffer[i]));
+    }
+    const QStringList textList = lineBuffer.mid(startLine);
+    const std::vector<qint64> timeList(timeBuffer.begin() + startLine, timeBuffer.end());
+    const QList<bool> promptList = promptBuffer.mid(startLine);
+    eraseLines(startLine, lineCount);
+
     for (int i = 0; i < lineCount; i++) {
-        buffer.pop_back();
-        lineBuffer.pop_back();
-        timeBuffer.pop_back();
-        promptBuffer.pop_back();
-        dirty.pop_back();
+        appendWrapped(styleList[i], textList.at(i), timeList[i], promptList.at(i));
     }
+    const int wrappedLineCount = static_cast<int>(buffer.size()) - startLine;
+    newLines += wrappedLineCount - lineCount;
 
-    newLines -= lineCount;
-    newLines += queue.size();
-    int insertedLines = queue.size() - 1;
-    while (!queue.empty()) {
-        buffer.push_back(queue.front());
-        queue.pop();
+    log(startLine, startLine + wrappedLineCount);
+    return qMax(0, wrappedLineCount - 1);
+}
+
+// Appends a line to the end of the buffer in as many pieces as it takes to fit
+// in mWrapAt (breaking it at any line feeds in it too), noting in wrapBuffer
+// how each piece came about so that reflowLines(...) can undo it:
+void TBuffer::appendWrapped(std::deque<TChar>& lineStyles, const QString& lineText, const qint64 time, const bool isPrompt)
+{
+    const int length = static_cast<int>(lineStyles.size());
+    if (length == 0) {
+        buffer.emplace_back();
+        lineBuffer.append(QString());
+        timeBuffer.push_back(csmNoTimeStamp);
+        promptBuffer.append(false);
+        wrapBuffer.emplace_back(mWrapAt, 0, -1);
+        dirty.append(true);
+        return;
     }
-    for (int i = 0; i < tempList.size(); i++) {
-        if (tempList[i].size() < 1) {
+    if (length < mWrapAt && !lineText.contains(QChar::LineFeed)) {
+        buffer.push_back(std::move(lineStyles));
+        lineBuffer.append(lineText);
+        timeBuffer.push_back(time);
+        promptBuffer.append(isPrompt);
+        wrapBuffer.emplace_back(mWrapAt, 0, -1);
+        dirty.append(true);
+        return;
+    }
+
+    std::deque<TChar> newLine;
+    QString newText;
+    int indent = 0;
+    if (length >= mWrapAt) {
+        newLine.resize(mWrapIndent);
+        newText.fill(QChar::Space, mWrapIndent);
+        indent = mWrapIndent;
+    }
+    TLineWrap lineWrap(mWrapAt, indent, -1);
+    for (int i2 = 0; i2 < length;) {
+        int lastSpace = 0;
+        if (length - i2 > mWrapAt - indent) {
+            lastSpace = qMax(0, calcWrapPos(lineText, i2, i2 + mWrapAt - indent));
+        }
+        // Take up to (and including) the break found above, or a whole
+        // width if there is none, but stop short at a line feed:
+        int end = i2 + ((lastSpace) ? lastSpace : (mWrapAt - indent));
+        if (lastSpace > 0) {
+            end = qMin(end, lastSpace + 1);
+        }
+        end = qMin(end, length);
+        int next = end;
+        const int lineFeed = lineText.indexOf(QChar::LineFeed, i2);
+        const bool isAtLineFeed = (lineFeed >= 0 && lineFeed < end);
+        if (isAtLineFeed) {
+            end = lineFeed;
+            next = lineFeed + 1;
+        }
+        newLine.insert(newLine.end(), lineStyles.begin() + i2, lineStyles.begin() + end);
+        newText.append(lineText.midRef(i2, end - i2));
+        i2 = next;
+
+        if (newLine.empty()) {
+            buffer.emplace_back();
             lineBuffer.append(QString());
-            timeBuffer.append(QString());
-            promptBuffer.push_back(false);
+            timeBuffer.push_back(csmNoTimeStamp);
+            promptBuffer.append(false);
         } else {
-            lineBuffer.append(tempList[i]);
-            timeBuffer.append(timeList[i]);
-            promptBuffer.push_back(promptList[i]);
+            buffer.push_back(std::move(newLine));
+            lineBuffer.append(newText);
+            timeBuffer.push_back(time);
+            promptBuffer.append(isPrompt);
         }
-        dirty.push_back(true);
+        wrapBuffer.push_back(lineWrap);
+        dirty.append(true);
+        newLine.clear();
+        newText.clear();
+        indent = 0;
+        const int skipped = skipSpacesAtBeginOfLine(lineStyles, lineText, i2);
+        i2 += skipped;
+        lineWrap = TLineWrap(mWrapAt, 0, skipped, isAtLineFeed);
     }
+}
 
-    log(startLine, startLine + tempList.size());
-    return insertedLines > 0 ? insertedLines : 0;
+// Changing the width re-wraps the lines in memory (but not any that have been
+// archived) to suit it. Only those around what can be seen are done straight
+// away, whether or not it is scrolled back, so that this takes about the same
+// time however many lines there are; the rest are left for reflowSome(...) to
+// do a batch at a time. Returns true if any lines were renumbered:
+bool TBuffer::setWrapAt(const int i)
+{
+    if (i == mWrapAt) {
+        return false;
+    }
+
+    mWrapAt = i;
+    if (buffer.empty()) {
+        return false;
+    }
+    const int size = static_cast<int>(buffer.size());
+    mUnreflowedLines = size;
+    const int bottom = (mCursorY >= size - 1) ? size : mCursorY + 1;
+    const int from = logicalLineStart(qMax(0, bottom - mVisibleLines - csmScrolledBackMargin));
+    int to = qMin(size, bottom + csmScrolledBackMargin);
+    while (to < size && wrapBuffer[to].skipped >= 0) {
+        ++to;
+    }
+    const bool isRenumbered = reflowLines(from, to);
+    if (to == size) {
+        // All that is left is above what was just done:
+        mUnreflowedLines = from;
+    }
+    return isRenumbered;
+}
+
+bool TBuffer::reflowSome()
+{
+    if (mUnreflowedLines <= 0) {
+        return false;
+    }
+
+    // Lines may have been put in or taken out since, so finish on the end of
+    // a wrapped line:
+    const int size = static_cast<int>(buffer.size());
+    int to = qMin(mUnreflowedLines, size);
+    while (to < size && wrapBuffer[to].skipped >= 0) {
+        ++to;
+    }
+    const int from = logicalLineStart(qMax(0, to - csmReflowBatchLines));
+    mUnreflowedLines = from;
+    return reflowLines(from, to);
+}
+
+// The first piece of the wrapped line that this one is part of:
+int TBuffer::logicalLineStart(int line) const
+{
+    while (line > 0 && wrapBuffer[line].skipped >= 0) {
+        --line;
+    }
+    return line;
+}
+
+// Whether wrapping the line that starts here at mWrapAt would change it - one
+// piece that fits, without an indent or a line feed, never changes:
+bool TBuffer::isReflowNeeded(const int line) const
+{
+    const TLineWrap& lineWrap = wrapBuffer[line];
+    if (lineWrap.wrapAt == mWrapAt) {
+        return false;
+    }
+    const bool isOnePiece = (line + 1 >= static_cast<int>(wrapBuffer.size()) || wrapBuffer[line + 1].skipped < 0);
+    return !isOnePiece || lineWrap.indent > 0 || static_cast<int>(buffer[line].size()) >= mWrapAt || lineBuffer.at(line).contains(QChar::LineFeed);
+}
+
+// Keeps the lines still to be re-wrapped pointing at the same ones when lines
+// are put in the buffer anywhere but at the end:
+void TBuffer::noteLinesInserted(const int line, const int count)
+{
+    if (line < mUnreflowedLines) {
+        mUnreflowedLines += count;
+    }
+}
+
+// Puts each wrapped line from "from" up to "to" (both the start of one) back
+// together, taking out the indent and putting back the spaces that were
+// dropped at each break, and wraps it again at the current mWrapAt in the same
+// place; the line at the bottom of a scrolled back view stays there. Nothing
+// is logged, as the text has not changed. Returns true if anything changed:
+bool TBuffer::reflowLines(const int from, const int to)
+{
+    bool isNeeded = false;
+    for (int i = from; i < to && !isNeeded; ++i) {
+        isNeeded = wrapBuffer[i].skipped < 0 && isReflowNeeded(i);
+    }
+    if (!isNeeded) {
+        return false;
+    }
+
+    // The new pieces are made at the end of the buffer's own containers, with
+    // everything else set to one side whilst that is done:
+    std::deque<std::deque<TChar>> oldBuffer;
+    oldBuffer.swap(buffer);
+    QStringList oldLines;
+    oldLines.swap(lineBuffer);
+    std::deque<qint64> oldTimes;
+    oldTimes.swap(timeBuffer);
+    QList<bool> oldPrompts;
+    oldPrompts.swap(promptBuffer);
+    std::deque<TLineWrap> oldWraps;
+    oldWraps.swap(wrapBuffer);
+    QList<bool> oldDirty;
+    oldDirty.swap(dirty);
+
+    const int oldSize = static_cast<int>(oldBuffer.size());
+    const bool isAtEnd = (mCursorY >= oldSize - 1);
+    int newCursorY = mCursorY;
+    for (int i = from; i < to;) {
+        std::deque<TChar> lineStyles(std::move(oldBuffer[i]));
+        QString lineText = oldLines.at(i);
+        const int indent = qMin(static_cast<int>(oldWraps[i].indent), static_cast<int>(lineStyles.size()));
+        if (indent > 0) {
+            lineStyles.erase(lineStyles.begin(), lineStyles.begin() + indent);
+            lineText.remove(0, indent);
+        }
+
+        int j = i + 1;
+        for (; j < to && oldWraps[j].skipped >= 0; j++) {
+            // The dropped line feed and spaces look like the character
+            // before them:
+            if (oldWraps[j].isAfterLineFeed) {
+                lineStyles.push_back(lineStyles.empty() ? TChar() : lineStyles.back());
+                lineText.append(QChar::LineFeed);
+            }
+            const int skipped = oldWraps[j].skipped;
+            if (skipped > 0) {
+                const TChar space = lineStyles.empty() ? TChar() : lineStyles.back();
+                lineStyles.insert(lineStyles.end(), static_cast<size_t>(skipped), space);
+                lineText.append(QString(skipped, QChar::Space));
+            }
+            lineStyles.insert(lineStyles.end(), oldBuffer[j].begin(), oldBuffer[j].end());
+            std::deque<TChar>().swap(oldBuffer[j]);
+            lineText.append(oldLines.at(j));
+        }
+
+        appendWrapped(lineStyles, lineText, oldTimes[i], oldPrompts.at(i));
+        if (!isAtEnd && mCursorY >= i && mCursorY < j) {
+            newCursorY = from + static_cast<int>(buffer.size()) - 1;
+        }
+        i = j;
+    }
+
+    // Swap the new pieces for the old lines:
+    const int newCount = static_cast<int>(buffer.size());
+    const int delta = newCount - (to - from);
+    std::deque<std::deque<TChar>> newBuffer;
+    newBuffer.swap(buffer);
+    buffer.swap(oldBuffer);
+    buffer.erase(buffer.begin() + from, buffer.begin() + to);
+    buffer.insert(buffer.begin() + from, std::make_move_iterator(newBuffer.begin()), std::make_move_iterator(newBuffer.end()));
+    lineBuffer = oldLines.mid(0, from) + lineBuffer + oldLines.mid(to);
+    std::deque<qint64> newTimes;
+    newTimes.swap(timeBuffer);
+    timeBuffer.swap(oldTimes);
+    timeBuffer.erase(timeBuffer.begin() + from, timeBuffer.begin() + to);
+    timeBuffer.insert(timeBuffer.begin() + from, newTimes.begin(), newTimes.end());
+    promptBuffer = oldPrompts.mid(0, from) + promptBuffer + oldPrompts.mid(to);
+    std::deque<TLineWrap> newWraps;
+    newWraps.swap(wrapBuffer);
+    wrapBuffer.swap(oldWraps);
+    wrapBuffer.erase(wrapBuffer.begin() + from, wrapBuffer.begin() + to);
+    wrapBuffer.insert(wrapBuffer.begin() + from, newWraps.begin(), newWraps.end());
+    dirty = oldDirty.mid(0, from) + dirty + oldDirty.mid(to);
+
+    if (isAtEnd) {
+        mCursorY = static_cast<int>(buffer.size());
+    } else if (mCursorY >= to) {
+        mCursorY += delta;
+    } else {
+        mCursorY = newCursorY;
+    }
+    if (mUnreflowedLines > from) {
+        mUnreflowedLines = qMax(from, mUnreflowedLines + delta);
+    }
+    ++mLineRenumberCount;
+    return true;
 }
 
 void TBuffer::log(int fromLine, int toLine)
@@ -2953,10 +2946,18 @@ void TBuffer::log(int fromLine, int toLine)
     }
 
     // if we've been called to log the same line - which can happen when the user
-    // enters a command after in-game text - then skip recording the last line
-    if (fromLine != lastLoggedFromLine && toLine != lastloggedToLine) {
-        mpHost->mpConsole->mLogStream << lastTextToLog;
-        mpHost->mpConsole->mLogStream.flush();
+    // enters a command after in-game text - then only the last version of it
+    // is recorded:
+    TLogWriter& writer = mpHost->mpConsole->mLogWriter;
+    if (mpHost->mIsCurrentLogFileInBinaryFormat) {
+        // Only the text and its style runs are recorded, turning them into
+        // HTML or plain text is left until the log is converted:
+        QByteArray dataToLog;
+        for (int i = fromLine; i <= toLine; i++) {
+            TSessionLog::appendLine(dataToLog, timeBuffer[i], promptBuffer.at(i), lineBuffer.at(i), styleRuns(i));
+        }
+        mHeldLogLines.hold(writer, mTrimmedLines + fromLine, mTrimmedLines + toLine, QString(), dataToLog);
+        return;
     }
 
     QStringList linesToLog;
@@ -2965,22 +2966,40 @@ void TBuffer::log(int fromLine, int toLine)
             // This only handles a single line of logged text at a time:
             linesToLog << bufferToHtml(QPoint(0, i), QPoint(buffer.at(i).size(), i), mpHost->mIsLoggingTimestamps);
         } else {
-            linesToLog << ((mpHost->mIsLoggingTimestamps && !timeBuffer.at(i).isEmpty()) ? timeBuffer.at(i).left(13) : QString()) % lineBuffer.at(i) % QChar::LineFeed;
+            linesToLog << (mpHost->mIsLoggingTimestamps ? timeStamp(i).left(13) : QString()) % lineBuffer.at(i) % QChar::LineFeed;
         }
     }
 
     // record the last log call into a temporary buffer - we'll actually log
     // on the next iteration after duplication detection has run
-    lastTextToLog = std::move(linesToLog.join(QString()));
-    lastLoggedFromLine = fromLine;
-    lastloggedToLine = toLine;
+    mHeldLogLines.hold(writer, mTrimmedLines + fromLine, mTrimmedLines + toLine, linesToLog.join(QString()), QByteArray());
 }
 
-// logs the remaining output when logging gets stopped, without duplication checks
+// logs the remaining output when logging gets stopped (or the log is flushed),
+// which is only written again if it changes
 void TBuffer::logRemainingOutput()
 {
-    mpHost->mpConsole->mLogStream << lastTextToLog;
-    mpHost->mpConsole->mLogStream.flush();
+    mHeldLogLines.release(mpHost->mpConsole->mLogWriter);
+}
+
+// The runs of characters in a line that look the same, for the binary session
+// log:
+QVector<TSessionLogRun> TBuffer::styleRuns(const int line) const
+{
+    const quint16 styleFlags = TCHAR_ITALICS | TCHAR_BOLD | TCHAR_UNDERLINE | TCHAR_INVERSE | TCHAR_STRIKEOUT;
+    QVector<TSessionLogRun> runs;
+    for (const auto& c : buffer[line]) {
+        const quint16 flags = c.flags & styleFlags;
+        if (!runs.isEmpty()) {
+            TSessionLogRun& run = runs.last();
+            if (run.fgR == c.fgR && run.fgG == c.fgG && run.fgB == c.fgB && run.bgR == c.bgR && run.bgG == c.bgG && run.bgB == c.bgB && run.flags == flags) {
+                ++run.length;
+                continue;
+            }
+        }
+        runs.append({1, c.fgR, c.fgG, c.fgB, c.bgR, c.bgG, c.bgB, flags});
+    }
+    return runs;
 }
 
 // returns how many new lines have been inserted by the wrapping action
@@ -3018,7 +3037,7 @@ int TBuffer::wrapLine(int startLine, int screenWidth, int indentSize, TChar& for
 
         for (int i2 = 0; i2 < static_cast<int>(buffer[i].size());) {
             if (length - i2 > screenWidth - indent) {
-                wrapPos = calcWrapPos(i, i2, i2 + screenWidth - indent);
+                wrapPos = calcWrapPos(lineBuffer.at(i), i2, i2 + screenWidth - indent);
                 lastSpace = qMax(-1, wrapPos);
             } else {
                 lastSpace = -1;
@@ -3068,8 +3087,8 @@ int TBuffer::wrapLine(int startLine, int screenWidth, int indentSize, TChar& for
 
     buffer.erase(buffer.begin() + startLine);
     lineBuffer.removeAt(startLine);
-    QString time = timeBuffer.at(startLine);
-    timeBuffer.removeAt(startLine);
+    qint64 time = timeBuffer.at(startLine);
+    timeBuffer.erase(timeBuffer.begin() + startLine);
     bool isPrompt = promptBuffer.at(startLine);
     promptBuffer.removeAt(startLine);
     dirty.removeAt(startLine);
@@ -3082,13 +3101,29 @@ int TBuffer::wrapLine(int startLine, int screenWidth, int indentSize, TChar& for
         i++;
     }
 
+    // The first piece keeps the place in any longer line that this one had,
+    // the others start afresh:
+    if (tempList.isEmpty()) {
+        wrapBuffer.erase(wrapBuffer.begin() + startLine);
+        if (startLine < mUnreflowedLines) {
+            --mUnreflowedLines;
+        }
+    } else {
+        wrapBuffer.insert(wrapBuffer.begin() + startLine + 1, static_cast<size_t>(tempList.size() - 1), TLineWrap());
+        noteLinesInserted(startLine + 1, tempList.size() - 1);
+    }
     for (int i = 0; i < tempList.size(); i++) {
         lineBuffer.insert(startLine + i, tempList[i]);
-        timeBuffer.insert(startLine + i, time);
+        timeBuffer.insert(timeBuffer.begin() + startLine + i, time);
         promptBuffer.insert(startLine + i, isPrompt);
         dirty.insert(startLine + i, true);
     }
     log(startLine, startLine + tempList.size() - 1);
+    if (insertedLines > 0) {
+        ++mLineRenumberCount;
+    } else {
+        markEdited(startLine);
+    }
     return insertedLines > 0 ? insertedLines : 0;
 }
 
@@ -3123,6 +3158,24 @@ QString& TBuffer::line(int n)
 }
 
 
+// Returns the timestamp for a line as it is displayed, in the form
+// "hh:mm:ss.zzz   ", or an empty string if there is none:
+QString TBuffer::timeStamp(const int line) const
+{
+    if (line < 0 || line >= static_cast<int>(timeBuffer.size())) {
+        return QString();
+    }
+    const qint64 time = timeBuffer[line];
+    if (time == csmNoTimeStamp) {
+        return QString();
+    }
+    if (time == csmContinuationTimeStamp) {
+        return QStringLiteral("-------------");
+    }
+    return QDateTime::fromMSecsSinceEpoch(time).toString(QStringLiteral("hh:mm:ss.zzz   "));
+}
+
+
 int TBuffer::find(int line, const QString& what, int pos = 0)
 {
     if (lineBuffer[line].size() >= pos) {
@@ -3163,6 +3216,7 @@ void TBuffer::expandLine(int y, int count, TChar& pC)
         buffer[y].push_back(pC);
         lineBuffer[y].append(" ");
     }
+    markEdited(y);
 }
 
 bool TBuffer::replaceInLine(QPoint& P_begin, QPoint& P_end, const QString& with, TChar& format)
@@ -3207,6 +3261,7 @@ bool TBuffer::replaceInLine(QPoint& P_begin, QPoint& P_end, const QString& with,
         auto it1 = buffer[y].begin() + x;
         auto it2 = buffer[y].begin() + x_end;
         buffer[y].erase(it1, it2);
+        markEdited(y);
     }
 
     // insert replacement
@@ -3214,6 +3269,31 @@ bool TBuffer::replaceInLine(QPoint& P_begin, QPoint& P_end, const QString& with,
     return true;
 }
 
+// Notes a line whose text has been changed in place for the search index,
+// which would otherwise go on using the runs of characters it had before:
+void TBuffer::markEdited(const int line)
+{
+    const int sessionLine = mTrimmedLines + line;
+    if (!mEditedLines.isEmpty() && mEditedLines.last() == sessionLine) {
+        return;
+    }
+    if (mEditedLines.size() >= mLinesLimit) {
+        // Nobody has searched for a long time, it is as quick to index every
+        // line again as it is to look at this many one by one:
+        mEditedLines.clear();
+        ++mLineRenumberCount;
+        return;
+    }
+    mEditedLines.append(sessionLine);
+}
+
+QVector<int> TBuffer::takeEditedLines()
+{
+    QVector<int> lines;
+    lines.swap(mEditedLines);
+    return lines;
+}
+
 void TBuffer::clear()
 {
     while (buffer.size() > 0) {
@@ -3224,9 +3304,13 @@ void TBuffer::clear()
     std::deque<TChar> newLine;
     buffer.push_back(newLine);
     lineBuffer << QString();
-    timeBuffer << QString();
+    timeBuffer.push_back(csmNoTimeStamp);
     promptBuffer.push_back(false);
+    wrapBuffer.emplace_back();
     dirty.push_back(true);
+    if (mpArchive) {
+        mpArchive->clear();
+    }
 }
 
 bool TBuffer::deleteLine(int y)
@@ -3236,332 +3320,151 @@ bool TBuffer::deleteLine(int y)
 
 void TBuffer::shrinkBuffer()
 {
-    for (int i = 0; i < mBatchDeleteSize; i++) {
-        lineBuffer.pop_front();
-        promptBuffer.pop_front();
-        timeBuffer.pop_front();
-        dirty.pop_front();
-        buffer.pop_front();
-        mCursorY--;
+    // Keep at least the current (last) line:
+    int count = qMin(mBatchDeleteSize, static_cast<int>(buffer.size()) - 1);
+    if (mpArchive && mCursorY < static_cast<int>(buffer.size()) - 1 && static_cast<int>(buffer.size()) < mLinesLimit + csmMaxScrolledBackExcess) {
+        // Lines that have been brought back from the archive are likely to be
+        // on show in a view that has been scrolled back, so leave those (the
+        // mVisibleLines before mCursorY) and a few more above them until it
+        // is not:
+        count = qMin(count, mCursorY - mVisibleLines - csmScrolledBackMargin);
+    }
+    if (count <= 0) {
+        return;
+    }
+    // The archive must end with the line before the first one in memory, as
+    // its lines are numbered back from there, so if these cannot be stored
+    // the older ones are dropped too:
+    if (mpArchive && !mpArchive->store(buffer, lineBuffer, timeBuffer, promptBuffer, 0, count)) {
+        mpArchive->clear();
     }
+    eraseLines(0, count);
+    mCursorY = qMax(0, mCursorY - count);
+    mTrimmedLines += count;
 }
 
 bool TBuffer::deleteLines(int from, int to)
 {
     if ((from >= 0) && (from < static_cast<int>(buffer.size())) && (from <= to) && (to >= 0) && (to < static_cast<int>(buffer.size()))) {
-        int delta = to - from + 1;
-
-        for (int i = from; i < from + delta; i++) {
-            lineBuffer.removeAt(i);
-            timeBuffer.removeAt(i);
-            promptBuffer.removeAt(i);
-            dirty.removeAt(i);
-        }
-
-        buffer.erase(buffer.begin() + from, buffer.begin() + to + 1);
+        eraseLines(from, to - from + 1);
+        ++mLineRenumberCount;
         return true;
     } else {
         return false;
     }
 }
 
-
-bool TBuffer::applyFormat(QPoint& P_begin, QPoint& P_end, TChar& format)
+// Removes count lines starting at from from all of the per-line containers
+// together - each is a range erase which moves the remaining elements (of
+// which there are none when trimming from the front) just the once, rather
+// than a removal per line:
+void TBuffer::eraseLines(const int from, const int count)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
-
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
+    buffer.erase(buffer.begin() + from, buffer.begin() + from + count);
+    lineBuffer.erase(lineBuffer.begin() + from, lineBuffer.begin() + from + count);
+    timeBuffer.erase(timeBuffer.begin() + from, timeBuffer.begin() + from + count);
+    promptBuffer.erase(promptBuffer.begin() + from, promptBuffer.begin() + from + count);
+    wrapBuffer.erase(wrapBuffer.begin() + from, wrapBuffer.begin() + from + count);
+    dirty.erase(dirty.begin() + from, dirty.begin() + from + count);
+    // What is left of a wrapped line whose start has gone stands on its own:
+    if (from < static_cast<int>(wrapBuffer.size()) && wrapBuffer[from].skipped >= 0) {
+        wrapBuffer[from] = TLineWrap();
+    }
+    if (mUnreflowedLines > from) {
+        mUnreflowedLines = qMax(from, mUnreflowedLines - count);
+    }
+}
 
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
-            }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
 
-                buffer[y][x] = format;
-                x++;
-            }
-        }
-        return true;
-    } else {
-        return false;
-    }
+bool TBuffer::applyFormat(QPoint& P_begin, QPoint& P_end, TChar& format)
+{
+    return applyFormat(buffer, P_begin, P_end, format);
 }
 
 bool TBuffer::applyLink(QPoint& P_begin, QPoint& P_end, const QString& linkText, QStringList& linkFunction, QStringList& linkHint)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
+    Q_UNUSED(linkText)
+
     bool incLinkID = false;
     int linkID = 0;
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
-
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
-            }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
-                if (!incLinkID) {
-                    incLinkID = true;
-                    mLinkID++;
-                    linkID = mLinkID;
-                    if (mLinkID > 1000) {
-                        mLinkID = 1;
-                    }
-                    mLinkStore[mLinkID] = linkFunction;
-                    mHintStore[mLinkID] = linkHint;
-                }
-                buffer[y][x].link = linkID;
-                x++;
+    return applyToSpans(buffer, P_begin, P_end, [&](std::deque<TChar>::iterator first, std::deque<TChar>::iterator last) {
+        if (!incLinkID) {
+            incLinkID = true;
+            mLinkID++;
+            linkID = mLinkID;
+            if (mLinkID > 1000) {
+                mLinkID = 1;
             }
+            mLinkStore[mLinkID] = linkFunction;
+            mHintStore[mLinkID] = linkHint;
         }
-        return true;
-    } else {
-        return false;
-    }
+        for (auto it = first; it != last; ++it) {
+            it->link = linkID;
+        }
+    });
 }
 
-bool TBuffer::applyBold(QPoint& P_begin, QPoint& P_end, bool bold)
+bool TBuffer::applyFlag(QPoint& P_begin, QPoint& P_end, const quint16 flag, const bool state)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
-
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
-
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
+    return applyToSpans(buffer, P_begin, P_end, [=](std::deque<TChar>::iterator first, std::deque<TChar>::iterator last) {
+        if (state) {
+            for (auto it = first; it != last; ++it) {
+                it->flags |= flag;
             }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
-                if (bold) {
-                    buffer[y][x].flags |= TCHAR_BOLD;
-                } else {
-                    buffer[y][x].flags &= ~(TCHAR_BOLD);
-                }
-                x++;
+        } else {
+            for (auto it = first; it != last; ++it) {
+                it->flags &= ~flag;
             }
         }
-        return true;
-    } else {
-        return false;
-    }
+    });
 }
 
-bool TBuffer::applyItalics(QPoint& P_begin, QPoint& P_end, bool bold)
+bool TBuffer::applyBold(QPoint& P_begin, QPoint& P_end, bool bold)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
-
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
+    return applyFlag(P_begin, P_end, TCHAR_BOLD, bold);
+}
 
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
-            }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
-                if (bold) {
-                    buffer[y][x].flags |= TCHAR_ITALICS;
-                } else {
-                    buffer[y][x].flags &= ~(TCHAR_ITALICS);
-                }
-                x++;
-            }
-        }
-        return true;
-    } else {
-        return false;
-    }
+bool TBuffer::applyItalics(QPoint& P_begin, QPoint& P_end, bool bold)
+{
+    return applyFlag(P_begin, P_end, TCHAR_ITALICS, bold);
 }
 
 bool TBuffer::applyUnderline(QPoint& P_begin, QPoint& P_end, bool bold)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
-
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
-
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
-            }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
-
-                if (bold) {
-                    buffer[y][x].flags |= TCHAR_UNDERLINE;
-                } else {
-                    buffer[y][x].flags &= ~(TCHAR_UNDERLINE);
-                }
-                x++;
-            }
-        }
-        return true;
-    } else {
-        return false;
-    }
+    return applyFlag(P_begin, P_end, TCHAR_UNDERLINE, bold);
 }
 
 bool TBuffer::applyStrikeOut(QPoint& P_begin, QPoint& P_end, bool strikeout)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
-
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
-
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
-            }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
-
-                if (strikeout) {
-                    buffer[y][x].flags |= TCHAR_STRIKEOUT;
-                } else {
-                    buffer[y][x].flags &= ~(TCHAR_STRIKEOUT);
-                }
-                x++;
-            }
-        }
-        return true;
-    } else {
-        return false;
-    }
+    return applyFlag(P_begin, P_end, TCHAR_STRIKEOUT, strikeout);
 }
 
 bool TBuffer::applyFgColor(QPoint& P_begin, QPoint& P_end, int fgColorR, int fgColorG, int fgColorB)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
-
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
-
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
-            }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
-
-                buffer[y][x].fgR = fgColorR;
-                buffer[y][x].fgG = fgColorG;
-                buffer[y][x].fgB = fgColorB;
-                x++;
-            }
+    const quint8 r = static_cast<quint8>(qBound(0, fgColorR, 255));
+    const quint8 g = static_cast<quint8>(qBound(0, fgColorG, 255));
+    const quint8 b = static_cast<quint8>(qBound(0, fgColorB, 255));
+    return applyToSpans(buffer, P_begin, P_end, [=](std::deque<TChar>::iterator first, std::deque<TChar>::iterator last) {
+        for (auto it = first; it != last; ++it) {
+            it->fgR = r;
+            it->fgG = g;
+            it->fgB = b;
         }
-        return true;
-    } else {
-        return false;
-    }
+    });
 }
 
 bool TBuffer::applyBgColor(QPoint& P_begin, QPoint& P_end, int bgColorR, int bgColorG, int bgColorB)
 {
-    int x1 = P_begin.x();
-    int x2 = P_end.x();
-    int y1 = P_begin.y();
-    int y2 = P_end.y();
-    if ((x1 >= 0) && ((y2 < static_cast<int>(buffer.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(buffer[y1].size())))
-    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
-    // && ( x2 < static_cast<int>(buffer[y2].size()) ) )
-    {
-        for (int y = y1; y <= y2; y++) {
-            int x = 0;
-            if (y == y1) {
-                x = x1;
-            }
-            while (x < static_cast<int>(buffer[y].size())) {
-                if (y >= y2) {
-                    if (x >= x2) {
-                        return true;
-                    }
-                }
-
-                (buffer[y][x]).bgR = bgColorR;
-                (buffer[y][x]).bgG = bgColorG;
-                (buffer[y][x]).bgB = bgColorB;
-                x++;
-            }
+    const quint8 r = static_cast<quint8>(qBound(0, bgColorR, 255));
+    const quint8 g = static_cast<quint8>(qBound(0, bgColorG, 255));
+    const quint8 b = static_cast<quint8>(qBound(0, bgColorB, 255));
+    return applyToSpans(buffer, P_begin, P_end, [=](std::deque<TChar>::iterator first, std::deque<TChar>::iterator last) {
+        for (auto it = first; it != last; ++it) {
+            it->bgR = r;
+            it->bgG = g;
+            it->bgB = b;
         }
-        return true;
-    } else {
-        return false;
-    }
+    });
 }
 
 QStringList TBuffer::getEndLines(int n)
@@ -3608,12 +3511,13 @@ QString TBuffer::bufferToHtml(QPoint P1, QPoint P2, bool allowedTimestamps, int
     QString fontStyle;
     QString textDecoration;
     bool firstSpan = true;
-    if (allowedTimestamps && !timeBuffer[y].isEmpty()) {
+    const QString time = allowedTimestamps ? timeStamp(y) : QString();
+    if (!time.isEmpty()) {
         firstSpan = false;
         // formatting according to TTextEdit.cpp: if( i2 < timeOffset )
         s.append(R"(<span style="color: rgb(200,150,0); background: rgb(22,22,22); )");
         s.append(R"(font-weight: normal; font-style: normal; text-decoration: normal">)");
-        s.append(timeBuffer[y].leftRef(13));
+        s.append(time.leftRef(13));
     }
     if (spacePadding > 0) {
         // used for "copy HTML", first line of selection
@@ -3755,7 +3659,7 @@ const QString& TBuffer::getComputerEncoding(const QString& encoding) {
     return encoding;
 }
 
-bool TBuffer::processUtf8Sequence(const std::string& bufferData, const bool isFromServer, const size_t len, size_t& pos, bool& isNonBMPCharacter)
+bool TBuffer::processUtf8Sequence(const TStringView& bufferData, const bool isFromServer, const size_t len, size_t& pos, bool& isNonBMPCharacter)
 {
     // In Utf-8 mode we have to process the data more than one byte at a
     // time because there is not necessarily a one-byte to one TChar
@@ -3980,7 +3884,7 @@ bool TBuffer::processUtf8Sequence(const std::string& bufferData, const bool isFr
     return true;
 }
 
-bool TBuffer::processGBSequence(const std::string& bufferData, const bool isFromServer, const bool isGB18030, const size_t len, size_t& pos, bool& isNonBmpCharacter)
+bool TBuffer::processGBSequence(const TStringView& bufferData, const bool isFromServer, const bool isGB18030, const size_t len, size_t& pos, bool& isNonBmpCharacter)
 {
 // In GBK/GB18030 mode we have to process the data more than one byte at a
 // time because there is not necessarily a one-byte to one TChar
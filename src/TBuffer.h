@@ -24,13 +24,18 @@
  ***************************************************************************/
 
 
+#include "TLogWriter.h"
+#include "TStringView.h"
+
 #include "pre_guard.h"
 #include <QApplication>
+#include <QByteArray>
 #include <QChar>
 #include <QColor>
 #include <QMap>
 #include <QPoint>
 #include <QPointer>
+#include <QSharedPointer>
 #include <QString>
 #include <QStringBuilder>
 #include <QStringList>
@@ -38,6 +43,7 @@
 #include <QVector>
 #include "post_guard.h"
 
+#include <algorithm>
 #include <deque>
 #include <string>
 
@@ -64,27 +70,62 @@
 //#define TCHAR_BLINKMASK 768
 
 class Host;
+class TScrollbackArchive;
+struct TSessionLogRun;
 
 class QTextCodec;
 
+// One of these is kept for every character in the scrollback so it is packed
+// as tightly as the values allow - 10 bytes rather than the 32 that it takes
+// with int members: the colour components only go up to 255, the flags above
+// need fewer than 16 bits and link ids are recycled after 1000 (see
+// TBuffer::mLinkID):
 class TChar
 {
 public:
-    TChar();
+    TChar() : fgR(255), fgG(255), fgB(255), bgR(0), bgG(0), bgB(0), flags(0), link(0) {}
     TChar(int, int, int, int, int, int, bool, bool, bool, bool, int _link = 0);
     TChar(Host*);
-    TChar(const TChar& copy);
+    // Inline as it is done for every character that is copied or wrapped:
+    TChar(const TChar& copy)
+    : fgR(copy.fgR), fgG(copy.fgG), fgB(copy.fgB), bgR(copy.bgR), bgG(copy.bgG), bgB(copy.bgB)
+    , flags(static_cast<quint16>(copy.flags & ~(TCHAR_INVERSE))) //for some reason we always clear the inverse, is this a bug?
+    , link(copy.link)
+    {}
     bool operator==(const TChar& c);
 
 
-    int fgR;
-    int fgG;
-    int fgB;
-    int bgR;
-    int bgG;
-    int bgB;
-    unsigned flags;
-    int link;
+    quint8 fgR;
+    quint8 fgG;
+    quint8 fgB;
+    quint8 bgR;
+    quint8 bgG;
+    quint8 bgB;
+    quint16 flags;
+    quint16 link;
+};
+
+// How a line in the buffer came about when a longer one was wrapped, so that
+// the pieces can be put back together and wrapped again at another width:
+struct TLineWrap
+{
+    TLineWrap() : wrapAt(0), indent(0), skipped(-1), isAfterLineFeed(false) {}
+    TLineWrap(const int wrapWidth, const int indentSize, const int skippedSpaces, const bool isAfterLineFeed = false)
+    : wrapAt(wrapWidth), indent(static_cast<qint16>(indentSize)), skipped(static_cast<qint16>(skippedSpaces)), isAfterLineFeed(isAfterLineFeed)
+    {}
+
+    // The width that it was wrapped at, 0 if it was put in the buffer some
+    // other way:
+    int wrapAt;
+
+    // Spaces put in front of the first piece of a wrapped line:
+    qint16 indent;
+    // -1 for a line that starts afresh, otherwise this line carries on from
+    // the one before it and this many spaces were dropped at the break:
+    qint16 skipped;
+    // The break was at a line feed (which was dropped too) rather than
+    // because the line was too long:
+    bool isAfterLineFeed;
 };
 
 const QChar cLF = QChar('\n');
@@ -106,19 +147,39 @@ class TBuffer
     // values are a pair of human-friendly name + encoding data
     static const QMap<QString, QPair<QString, QVector<QChar>>> csmEncodingTable;
 
+    // More than enough for the longest SGR sequence that makes sense:
+    static const int csmMaxCsiParameters = 32;
+
+    // Lines above the top of a scrolled back view that are not archived, so
+    // that scrolling up a little further does not have to bring them back:
+    static const int csmScrolledBackMargin = 100;
+    // ... unless that would leave more than this many lines over mLinesLimit
+    // in memory, which lines keep arriving to do for as long as it stays
+    // scrolled back:
+    static const int csmMaxScrolledBackExcess = 20000;
+    // How many lines reflowSome() re-wraps at a time:
+    static const int csmReflowBatchLines = 2000;
+
 
 public:
+    // Markers that can be in timeBuffer instead of a time:
+    static const qint64 csmNoTimeStamp = 0;
+    // For a line that carries on from the one before it:
+    static const qint64 csmContinuationTimeStamp = -1;
+
     TBuffer(Host* pH);
     QPoint insert(QPoint&, const QString& text, int, int, int, int, int, int, bool bold, bool italics, bool underline, bool strikeout);
     bool insertInLine(QPoint& cursor, const QString& what, TChar& format);
     void expandLine(int y, int count, TChar&);
     int wrapLine(int startLine, int screenWidth, int indentSize, TChar& format);
     void log(int, int);
-    int skipSpacesAtBeginOfLine(int i, int i2);
+    int skipSpacesAtBeginOfLine(const std::deque<TChar>& lineStyles, const QString& lineText, int i2);
     void addLink(bool, const QString& text, QStringList& command, QStringList& hint, TChar format);
     QString bufferToHtml(QPoint P1, QPoint P2, bool allowedTimestamps, int spacePadding = 0);
     int size() { return static_cast<int>(buffer.size()); }
     QString& line(int n);
+    QString timeStamp(int line) const;
+    void setReceivedTime(const qint64 msecsSinceEpoch) { mReceivedTime = msecsSinceEpoch; }
     int find(int line, const QString& what, int pos);
     int wrap(int);
     QStringList split(int line, const QString& splitter);
@@ -127,6 +188,9 @@ public:
     bool deleteLine(int);
     bool deleteLines(int from, int to);
     bool applyFormat(QPoint&, QPoint&, TChar& format);
+    // The same for any lines, which is what the one above does to the buffer's
+    // own - so that it can also be timed without a Host:
+    static bool applyFormat(std::deque<std::deque<TChar>>& lines, const QPoint& P_begin, const QPoint& P_end, const TChar& format);
     bool applyUnderline(QPoint& P_begin, QPoint& P_end, bool bold);
     bool applyBold(QPoint& P_begin, QPoint& P_end, bool bold);
     bool applyLink(QPoint& P_begin, QPoint& P_end, const QString& linkText, QStringList&, QStringList&);
@@ -140,16 +204,39 @@ public:
     QStringList getEndLines(int);
     void clear();
     QPoint getEndPos();
-    void translateToPlainText(std::string& s, const bool isFromServer=false);
+    void translateToPlainText(const TStringView& s, const bool isFromServer=false);
     void append(const QString& chunk, int sub_start, int sub_end, int, int, int, int, int, int, bool bold, bool italics, bool underline, bool strikeout, int linkID = 0);
     void appendLine(const QString& chunk, int sub_start, int sub_end, int, int, int, int, int, int, bool bold, bool italics, bool underline, bool strikeout, int linkID = 0);
-    void setWrapAt(int i) { mWrapAt = i; }
+    bool setWrapAt(int i);
+    // Re-wraps the next batch of lines left by setWrapAt(...), working up
+    // from the bottom; returns true if that renumbered any lines:
+    bool reflowSome();
+    bool isReflowPending() const { return mUnreflowedLines > 0; }
     void setWrapIndent(int i) { mWrapIndent = i; }
     void updateColors();
     TBuffer copy(QPoint&, QPoint&);
     TBuffer cut(QPoint&, QPoint&);
     void paste(QPoint&, TBuffer);
     void setBufferSize(int s, int batch);
+    // When set the lines trimmed to keep to mLinesLimit are kept in a
+    // compressed file rather than being thrown away:
+    void setArchived(bool state);
+    bool isArchived() const { return !mpArchive.isNull(); }
+    // Set by the upper pane that shows this buffer whenever its size changes:
+    void setVisibleLineCount(const int lines) { mVisibleLines = lines; }
+    int archivedLineCount() const;
+    // For a search to read the archived lines away from the main thread:
+    QSharedPointer<TScrollbackArchive> archive() const { return mpArchive; }
+    int restoreArchivedLines();
+    // Adding this to the index of a line gives its number from the start of
+    // the session, which does not change when older lines are trimmed:
+    int trimmedLineCount() const { return mTrimmedLines; }
+    // Goes up whenever lines are inserted or deleted anywhere but at the ends,
+    // which changes the session numbers of the lines after them:
+    int lineRenumberCount() const { return mLineRenumberCount; }
+    // The session numbers of the lines whose text has been changed where they
+    // are (e.g. by replace() or insertText()) since this was last called:
+    QVector<int> takeEditedLines();
     static const QList<QString> getComputerEncodingNames() { return csmEncodingTable.keys(); }
     static const QList<QString> getFriendlyEncodingNames();
     static const QString& getComputerEncoding(const QString& encoding);
@@ -161,9 +248,13 @@ public:
 
     std::deque<TChar> bufferLine;
     std::deque<std::deque<TChar>> buffer;
-    QStringList timeBuffer;
+    // When each line was received, in milli-seconds since the epoch (or one
+    // of the csm...TimeStamp markers) - only turned into text by timeStamp(...)
+    // when it is shown, copied or logged:
+    std::deque<qint64> timeBuffer;
     QStringList lineBuffer;
     QList<bool> promptBuffer;
+    std::deque<TLineWrap> wrapBuffer;
     QList<bool> dirty;
     QMap<int, QStringList> mLinkStore;
     QMap<int, QStringList> mHintStore;
@@ -199,16 +290,40 @@ public:
 
 private:
     void shrinkBuffer();
-    int calcWrapPos(int line, int begin, int end);
+    void eraseLines(int from, int count);
+    void markEdited(int line);
+    void pushCsiParameter();
+    void resetCsiParameters();
+    void processSgrCodes();
+    void setFgAnsiColor(int color);
+    void setBgAnsiColor(int color);
+    void setFgXterm256Color(int code);
+    void setBgXterm256Color(int code);
+    int calcWrapPos(const QString& lineText, int begin, int end);
+    void appendWrapped(std::deque<TChar>& lineStyles, const QString& lineText, qint64 time, bool isPrompt);
+    bool reflowLines(int from, int to);
+    bool isReflowNeeded(int line) const;
+    int logicalLineStart(int line) const;
+    void noteLinesInserted(int line, int count);
+    QVector<TSessionLogRun> styleRuns(int line) const;
     void handleNewLine();
-    bool processUtf8Sequence(const std::string&, const bool, const size_t, size_t&, bool&);
-    bool processGBSequence(const std::string&, const bool, const bool, const size_t, size_t&, bool&);
+    bool processUtf8Sequence(const TStringView&, const bool, const size_t, size_t&, bool&);
+    bool processGBSequence(const TStringView&, const bool, const bool, const size_t, size_t&, bool&);
+    template <typename Apply>
+    static bool applyToSpans(std::deque<std::deque<TChar>>& lines, const QPoint&, const QPoint&, Apply);
+    bool applyFlag(QPoint&, QPoint&, quint16 flag, bool state);
 
 
+    // Time of the read that brought in the data that is being processed,
+    // zero if it is not known:
+    qint64 mReceivedTime;
     bool gotESC;
     bool gotHeader;
-    QString code;
+    // The number of parameters of the current CSI sequence in mCode and the
+    // one currently being read:
     int codeRet;
+    int mCsiParameter;
+    bool mIsCsiUnhandled;
     std::string tempLine;
     bool mWaitingForHighColorCode;
     bool mWaitingForMillionsColorCode;
@@ -283,6 +398,8 @@ private:
     int mWhiteR;
     int mWhiteG;
     int mWhiteB;
+    // The sixteen colors above by their ANSI color number:
+    QRgb mAnsiColors[16];
     QColor mFgColor;
     int fgColorR;
     int fgColorLightR;
@@ -296,6 +413,15 @@ private:
     QColor mBgColor;
 
     QPointer<Host> mpHost;
+    // Shared, rather than owned, only so that TBuffer can still be copied:
+    QSharedPointer<TScrollbackArchive> mpArchive;
+    int mTrimmedLines;
+    int mLineRenumberCount;
+    QVector<int> mEditedLines;
+    // How many lines the upper pane can show at once:
+    int mVisibleLines;
+    // The lines before this one may still be wrapped at an earlier width:
+    int mUnreflowedLines;
     int maxx;
     int maxy;
     bool hadLF;
@@ -318,19 +444,58 @@ private:
     int mBgColorB;
     QString mMudLine;
     std::deque<TChar> mMudBuffer;
-    int mCode[1024]; //FIXME: potential overflow bug
+    // Parameters of the current CSI sequence, from index 1:
+    int mCode[csmMaxCsiParameters + 1];
     // Used to hold the incomplete bytes (1-3) that could be left at the end of
     // a packet:
     std::string mIncompleteSequenceBytes;
 
     // keeps track of the previously logged buffer lines to ensure no log duplication
     // happens when you enter a command
-    int lastLoggedFromLine;
-    int lastloggedToLine;
-    QString lastTextToLog;
+    TLogHeldLines mHeldLogLines;
 
     QString mEncoding;
     QTextCodec* mMainIncomingCodec;
 };
 
+// Calls apply(first, last) once for the run of characters on each line between
+// the two points, rather than once per character, so that a format can be put
+// on a whole span at a time:
+template <typename Apply>
+bool TBuffer::applyToSpans(std::deque<std::deque<TChar>>& lines, const QPoint& P_begin, const QPoint& P_end, Apply apply)
+{
+    int x1 = P_begin.x();
+    int x2 = P_end.x();
+    int y1 = P_begin.y();
+    int y2 = P_end.y();
+
+    if ((x1 >= 0) && ((y2 < static_cast<int>(lines.size())) && (y2 >= 0)) && ((x2 > x1) || (y2 > y1)) && (x1 < static_cast<int>(lines[y1].size())))
+    // even if the end selection is out of bounds we still apply the format until the end of the line to simplify and ultimately speed up user scripting (no need to calc end of line)
+    // && ( x2 < static_cast<int>(lines[y2].size()) ) )
+
+    {
+        for (int y = y1; y <= y2; y++) {
+            std::deque<TChar>& line = lines[y];
+            int xStart = (y == y1) ? x1 : 0;
+            int xEnd = static_cast<int>(line.size());
+            if (y >= y2) {
+                xEnd = qMin(xEnd, x2);
+            }
+            if (xStart < xEnd) {
+                apply(line.begin() + xStart, line.begin() + xEnd);
+            }
+        }
+        return true;
+    } else {
+        return false;
+    }
+}
+
+inline bool TBuffer::applyFormat(std::deque<std::deque<TChar>>& lines, const QPoint& P_begin, const QPoint& P_end, const TChar& format)
+{
+    return applyToSpans(lines, P_begin, P_end, [&format](std::deque<TChar>::iterator first, std::deque<TChar>::iterator last) {
+        std::fill(first, last, format);
+    });
+}
+
 #endif // MUDLET_TBUFFER_H
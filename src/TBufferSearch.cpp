@@ -0,0 +1,225 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TBufferSearch.h"
+
+#include "TScrollbackArchive.h"
+
+#include "pre_guard.h"
+#include <QObject>
+#include <QRegularExpression>
+#include "post_guard.h"
+
+#include <algorithm>
+#include <iterator>
+
+TBufferSearchIndex::TBufferSearchIndex()
+: mFirstLine(0)
+, mEndLine(0)
+, mRenumberCount(0)
+{
+}
+
+void TBufferSearchIndex::clear()
+{
+    mPostings.clear();
+    mEditedLines.clear();
+    mFirstLine = 0;
+    mEndLine = 0;
+}
+
+// Drops the lines that have been trimmed from the buffer and adds those that
+// have arrived since the last time - except for the last one, which may still
+// be having text added to it and so is always looked at directly:
+void TBufferSearchIndex::update(const TBufferSearchRequest& request)
+{
+    const int endLine = request.firstLine + request.lines.size() - 1;
+    if (request.renumberCount != mRenumberCount || request.firstLine < mFirstLine || endLine < mEndLine) {
+        // Lines have been inserted or deleted (or brought back from the
+        // archive) so the numbers in the index are no longer right:
+        clear();
+        mRenumberCount = request.renumberCount;
+    }
+    if (mPostings.isEmpty() || request.firstLine >= mEndLine) {
+        // Nothing that is indexed is still in the buffer:
+        mPostings.clear();
+        mEditedLines.clear();
+        mFirstLine = request.firstLine;
+        mEndLine = request.firstLine;
+    } else if (request.firstLine > mFirstLine) {
+        prune(request.firstLine);
+    }
+    for (int line = qMax(mEndLine, request.firstLine); line < endLine; ++line) {
+        addLine(line, request.lines.at(line - request.firstLine));
+    }
+    mEndLine = qMax(mEndLine, endLine);
+}
+
+void TBufferSearchIndex::addLine(const int line, const QString& text)
+{
+    const QChar* pText = text.constData();
+    for (int i = 0, total = text.size() - 2; i < total; ++i) {
+        std::vector<int>& lines = mPostings[trigram(pText + i)];
+        // The lines are added in order so a repeated trigram in the same line
+        // will find that line at the end:
+        if (lines.empty() || lines.back() != line) {
+            lines.push_back(line);
+        }
+    }
+}
+
+void TBufferSearchIndex::prune(const int firstLine)
+{
+    for (auto it = mPostings.begin(); it != mPostings.end();) {
+        std::vector<int>& lines = it.value();
+        lines.erase(lines.begin(), std::lower_bound(lines.begin(), lines.end(), firstLine));
+        if (lines.empty()) {
+            it = mPostings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    mEditedLines.erase(mEditedLines.begin(), std::lower_bound(mEditedLines.begin(), mEditedLines.end(), firstLine));
+    mFirstLine = firstLine;
+}
+
+// Those that have not been indexed yet will be when they are, with the text
+// they have then:
+void TBufferSearchIndex::addEditedLines(const QVector<int>& lines)
+{
+    for (const int line : lines) {
+        if (line >= mFirstLine && line < mEndLine) {
+            mEditedLines.push_back(line);
+        }
+    }
+    std::sort(mEditedLines.begin(), mEditedLines.end());
+    mEditedLines.erase(std::unique(mEditedLines.begin(), mEditedLines.end()), mEditedLines.end());
+}
+
+// The indexed lines, in order, that have every trigram in the query:
+std::vector<int> TBufferSearchIndex::candidateLines(const QString& query) const
+{
+    std::vector<const std::vector<int>*> postings;
+    for (int i = 0, total = query.size() - 2; i < total; ++i) {
+        auto it = mPostings.constFind(trigram(query.constData() + i));
+        if (it == mPostings.cend()) {
+            return std::vector<int>();
+        }
+        postings.push_back(&it.value());
+    }
+    // Start with the rarest trigram and then keep only the lines that are
+    // also in each of the others:
+    std::sort(postings.begin(), postings.end(), [](const std::vector<int>* a, const std::vector<int>* b) { return a->size() < b->size(); });
+    std::vector<int> result(*postings.front());
+    for (size_t i = 1; i < postings.size() && !result.empty(); ++i) {
+        const std::vector<int>& other = *postings.at(i);
+        result.erase(std::remove_if(result.begin(), result.end(), [&other](const int line) { return !std::binary_search(other.cbegin(), other.cend(), line); }), result.end());
+    }
+    return result;
+}
+
+TBufferSearchResult TBufferSearchIndex::search(const TBufferSearchRequest& request)
+{
+    TBufferSearchResult result;
+    // Before anything else, so that the edits are not lost when this search
+    // does not use the index:
+    addEditedLines(request.editedLines);
+    if (request.query.isEmpty() || request.lines.isEmpty()) {
+        return result;
+    }
+
+    QRegularExpression regex;
+    if (request.isRegularExpression) {
+        regex.setPattern(request.query);
+        if (!regex.isValid()) {
+            result.errorMessage = QObject::tr("invalid regular expression: %1").arg(regex.errorString());
+            return result;
+        }
+        regex.optimize();
+    }
+
+    // The lines to look at, in order; every one of them when the index is
+    // no help:
+    std::vector<int> lines;
+    const int endLine = request.firstLine + request.lines.size();
+    if (!request.isRegularExpression && request.query.size() >= 3) {
+        update(request);
+        const std::vector<int> candidates = candidateLines(request.query);
+        lines.reserve(candidates.size() + mEditedLines.size());
+        std::set_union(candidates.cbegin(), candidates.cend(), mEditedLines.cbegin(), mEditedLines.cend(), std::back_inserter(lines));
+        for (int line = mEndLine; line < endLine; ++line) {
+            lines.push_back(line);
+        }
+    } else {
+        lines.reserve(static_cast<size_t>(request.lines.size()));
+        for (int line = request.firstLine; line < endLine; ++line) {
+            lines.push_back(line);
+        }
+    }
+
+    auto findMatchesIn = [&](const QString& text) {
+        if (request.isRegularExpression) {
+            QRegularExpressionMatchIterator it = regex.globalMatch(text);
+            while (it.hasNext()) {
+                QRegularExpressionMatch match = it.next();
+                if (match.capturedLength() > 0) {
+                    result.matches.append(qMakePair(match.capturedStart(), match.capturedLength()));
+                }
+            }
+        } else {
+            for (int begin = text.indexOf(request.query); begin > -1; begin = text.indexOf(request.query, begin + 1)) {
+                result.matches.append(qMakePair(begin, request.query.size()));
+            }
+        }
+        return !result.matches.isEmpty();
+    };
+    auto findMatches = [&](const int line) { return findMatchesIn(request.lines.at(line - request.firstLine)); };
+    // The archived lines come before those in memory:
+    const int archiveFirstLine = request.firstLine - (request.archive ? request.archivedLineCount : 0);
+    auto findArchivedMatches = [&](const int line) { return findMatchesIn(request.archive->lineText(line - archiveFirstLine)); };
+
+    if (request.isUpwards) {
+        auto it = std::lower_bound(lines.cbegin(), lines.cend(), request.fromLine);
+        while (it != lines.cbegin()) {
+            --it;
+            if (findMatches(*it)) {
+                result.line = *it;
+                break;
+            }
+        }
+        for (int line = qMin(request.fromLine, request.firstLine) - 1; result.line < 0 && line >= archiveFirstLine; --line) {
+            if (findArchivedMatches(line)) {
+                result.line = line;
+            }
+        }
+    } else {
+        for (int line = qMax(request.fromLine + 1, archiveFirstLine); result.line < 0 && line < request.firstLine; ++line) {
+            if (findArchivedMatches(line)) {
+                result.line = line;
+            }
+        }
+        for (auto it = std::upper_bound(lines.cbegin(), lines.cend(), request.fromLine); result.line < 0 && it != lines.cend(); ++it) {
+            if (findMatches(*it)) {
+                result.line = *it;
+            }
+        }
+    }
+    return result;
+}
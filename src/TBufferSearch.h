@@ -0,0 +1,117 @@
+#ifndef MUDLET_TBUFFERSEARCH_H
+#define MUDLET_TBUFFERSEARCH_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QHash>
+#include <QPair>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "post_guard.h"
+
+#include <vector>
+
+class TScrollbackArchive;
+
+// Line numbers here are all "session" ones, i.e. the index of the line in
+// TBuffer::lineBuffer plus TBuffer::trimmedLineCount(), so that they stay the
+// same as older lines are trimmed from the buffer.
+struct TBufferSearchRequest
+{
+    TBufferSearchRequest() : firstLine(0), renumberCount(0), archivedLineCount(0), isRegularExpression(false), isUpwards(true), fromLine(0) {}
+
+    // A (cheap, implicitly shared) copy of TBuffer::lineBuffer so that the
+    // search does not touch the buffer itself:
+    QStringList lines;
+    int firstLine;
+    // TBuffer::lineRenumberCount() when the copy was made:
+    int renumberCount;
+    // TBuffer::takeEditedLines() when the copy was made:
+    QVector<int> editedLines;
+    // Where the lines trimmed from before firstLine went, if anywhere (see
+    // TBuffer::archive()), and how many it held when the copy was made - they
+    // are numbered back from firstLine - 1 and are only read, a block at a
+    // time, if the search gets that far:
+    QSharedPointer<TScrollbackArchive> archive;
+    int archivedLineCount;
+    QString query;
+    bool isRegularExpression;
+    bool isUpwards;
+    // The search starts with the line before (or after) this one:
+    int fromLine;
+};
+
+struct TBufferSearchResult
+{
+    TBufferSearchResult() : line(-1) {}
+
+    // -1 if nothing was found:
+    int line;
+    // Start and length of each match in the line:
+    QVector<QPair<int, int>> matches;
+    QString errorMessage;
+};
+
+// A trigram index of the lines of a buffer: for each run of three characters
+// it holds, in order, the lines that contain it; so a search for some text
+// only has to look at the lines that contain every trigram of it rather than
+// at every line. It is brought up to date with the lines that have been added
+// (and trimmed) since the previous search at the start of each one - which is
+// done away from the main thread - so it costs nothing while text is arriving.
+// Lines whose text has been changed since they were indexed are looked at
+// directly, as the last line is, until the index is next built from scratch.
+//
+// Regular expressions, and text of fewer than three characters, cannot use the
+// index and are looked for in every line. Archived lines are never indexed, so
+// each search that reaches them reads them all from the archive again.
+class TBufferSearchIndex
+{
+public:
+    TBufferSearchIndex();
+
+    // Only one search may run at a time:
+    TBufferSearchResult search(const TBufferSearchRequest& request);
+    void clear();
+
+private:
+    Q_DISABLE_COPY(TBufferSearchIndex)
+
+    void update(const TBufferSearchRequest& request);
+    void addLine(int line, const QString& text);
+    void prune(int firstLine);
+    void addEditedLines(const QVector<int>& lines);
+    std::vector<int> candidateLines(const QString& query) const;
+    static quint64 trigram(const QChar* pText) { return (static_cast<quint64>(pText[0].unicode()) << 32) | (static_cast<quint64>(pText[1].unicode()) << 16) | pText[2].unicode(); }
+
+
+    QHash<quint64, std::vector<int>> mPostings;
+    // The lines [mFirstLine, mEndLine) are in the index:
+    int mFirstLine;
+    int mEndLine;
+    int mRenumberCount;
+    // In order, those indexed lines that have been changed since:
+    std::vector<int> mEditedLines;
+};
+
+#endif // MUDLET_TBUFFERSEARCH_H
@@ -0,0 +1,133 @@
+#ifndef MUDLET_TBYTESCANNER_H
+#define MUDLET_TBYTESCANNER_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <cstddef>
+
+// SSE2 is part of the x86-64 base instruction set so this is available on
+// every 64-bit PC build without any special compiler flags:
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MUDLET_BYTESCANNER_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Helpers to find the end of a run of "ordinary" bytes - most of what a MUD
+// server sends is plain printable text and these let the telnet and ANSI
+// parsers skip over (and bulk copy) such runs 16 bytes at a time instead of
+// putting every single byte through their state machines. Each returns the
+// offset of the first byte that DOES need individual attention, or length if
+// there is none.
+class TByteScanner
+{
+public:
+    // For the telnet layer: stop at IAC, <CR>, <NUL> and <BEL>:
+    static bool isTelnetSpecial(const char ch)
+    {
+        return ch == '\xff' || ch == '\r' || ch == '\0' || ch == '\a';
+    }
+
+    static size_t findTelnetSpecial(const char* data, const size_t length)
+    {
+        size_t i = 0;
+#if defined(MUDLET_BYTESCANNER_SSE2)
+        const __m128i iac = _mm_set1_epi8('\xff');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i nul = _mm_setzero_si128();
+        const __m128i bell = _mm_set1_epi8('\a');
+        for (; i + 16 <= length; i += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, iac), _mm_cmpeq_epi8(block, cr)),
+                                              _mm_or_si128(_mm_cmpeq_epi8(block, nul), _mm_cmpeq_epi8(block, bell)));
+            const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(hits));
+            if (mask) {
+                return i + lowestSetBit(mask);
+            }
+        }
+#endif
+        for (; i < length; ++i) {
+            if (isTelnetSpecial(data[i])) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    // For the ANSI/MXP layer: only printable ASCII (0x20 to 0x7E) other than the
+    // MXP '<', '>' and '&' and the quotes that MXP tag parameters use can be taken
+    // as they are; that means ESC, <LF>, <CR>, the prompt marker (0xFF) and
+    // anything that might be part of a multi-byte encoding all stop the run:
+    static bool isPlainText(const char ch)
+    {
+        return ch >= 0x20 && ch < 0x7F && ch != '<' && ch != '>' && ch != '&' && ch != '\'' && ch != '"';
+    }
+
+    static size_t findEndOfPlainText(const char* data, const size_t length)
+    {
+        size_t i = 0;
+#if defined(MUDLET_BYTESCANNER_SSE2)
+        // The comparisons are signed so bytes 0x80-0xFF are negative and fail the
+        // first test:
+        const __m128i belowSpace = _mm_set1_epi8(0x1F);
+        const __m128i del = _mm_set1_epi8(0x7F);
+        const __m128i lt = _mm_set1_epi8('<');
+        const __m128i gt = _mm_set1_epi8('>');
+        const __m128i amp = _mm_set1_epi8('&');
+        const __m128i apos = _mm_set1_epi8('\'');
+        const __m128i quot = _mm_set1_epi8('"');
+        for (; i + 16 <= length; i += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i printable = _mm_andnot_si128(_mm_cmpeq_epi8(block, del), _mm_cmpgt_epi8(block, belowSpace));
+            const __m128i markup = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, lt), _mm_cmpeq_epi8(block, gt)),
+                                                _mm_or_si128(_mm_cmpeq_epi8(block, amp), _mm_or_si128(_mm_cmpeq_epi8(block, apos), _mm_cmpeq_epi8(block, quot))));
+            const unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_andnot_si128(markup, printable))) ^ 0xFFFFu;
+            if (mask) {
+                return i + lowestSetBit(mask);
+            }
+        }
+#endif
+        for (; i < length; ++i) {
+            if (!isPlainText(data[i])) {
+                break;
+            }
+        }
+        return i;
+    }
+
+private:
+#if defined(MUDLET_BYTESCANNER_SSE2)
+    static unsigned int lowestSetBit(const unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned int>(index);
+#else
+        return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+    }
+#endif
+};
+
+#endif // MUDLET_TBYTESCANNER_H
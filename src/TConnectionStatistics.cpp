@@ -0,0 +1,162 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TConnectionStatistics.h"
+
+
+#include "pre_guard.h"
+#include <QtAlgorithms>
+#include "post_guard.h"
+
+TLatencyHistogram::TLatencyHistogram(const qint64 windowMilliSeconds)
+: mCurrentCount(0)
+, mPreviousCount(0)
+, mCurrentMaximum(0)
+, mPreviousMaximum(0)
+, mWindow(windowMilliSeconds)
+{
+    mCurrent.fill(0);
+    mPrevious.fill(0);
+    mWindowTimer.start();
+}
+
+int TLatencyHistogram::bucketFor(const quint64 value)
+{
+    if (value < 32) {
+        return static_cast<int>(value);
+    }
+    int power = 63 - static_cast<int>(qCountLeadingZeroBits(value));
+    if (power > csmMaxPower) {
+        return csmBucketCount - 1;
+    }
+    // The top five bits of the value, which will be from 16 to 31:
+    const int shift = power - 4;
+    return 32 + (power - 5) * 16 + static_cast<int>(value >> shift) - 16;
+}
+
+// The middle of the range of values that go into the bucket:
+qint64 TLatencyHistogram::valueOf(const int bucket)
+{
+    if (bucket < 32) {
+        return bucket;
+    }
+    const int shift = (bucket - 32) / 16 + 1;
+    const qint64 low = static_cast<qint64>((bucket - 32) % 16 + 16) << shift;
+    return low + ((Q_INT64_C(1) << shift) / 2);
+}
+
+void TLatencyHistogram::rotateIfDue()
+{
+    const qint64 elapsed = mWindowTimer.elapsed();
+    if (elapsed < mWindow) {
+        return;
+    }
+
+    if (elapsed < 2 * mWindow) {
+        mPrevious = mCurrent;
+        mPreviousCount = mCurrentCount;
+        mPreviousMaximum = mCurrentMaximum;
+    } else {
+        // Nothing has been recorded for more than a whole window:
+        mPrevious.fill(0);
+        mPreviousCount = 0;
+        mPreviousMaximum = 0;
+    }
+    mCurrent.fill(0);
+    mCurrentCount = 0;
+    mCurrentMaximum = 0;
+    mWindowTimer.restart();
+}
+
+void TLatencyHistogram::record(qint64 value)
+{
+    rotateIfDue();
+    if (value < 0) {
+        value = 0;
+    }
+    ++mCurrent[bucketFor(static_cast<quint64>(value))];
+    ++mCurrentCount;
+    if (value > mCurrentMaximum) {
+        mCurrentMaximum = value;
+    }
+}
+
+void TLatencyHistogram::reset()
+{
+    mCurrent.fill(0);
+    mPrevious.fill(0);
+    mCurrentCount = mPreviousCount = 0;
+    mCurrentMaximum = mPreviousMaximum = 0;
+    mWindowTimer.restart();
+}
+
+quint64 TLatencyHistogram::count()
+{
+    rotateIfDue();
+    return mCurrentCount + mPreviousCount;
+}
+
+qint64 TLatencyHistogram::maximum()
+{
+    rotateIfDue();
+    return qMax(mCurrentMaximum, mPreviousMaximum);
+}
+
+qint64 TLatencyHistogram::percentile(const double percentage)
+{
+    rotateIfDue();
+    const quint64 total = mCurrentCount + mPreviousCount;
+    if (!total) {
+        return 0;
+    }
+
+    // The rank of the wanted value, counting from one:
+    quint64 rank = static_cast<quint64>(qBound(0.0, percentage, 100.0) / 100.0 * total + 0.5);
+    rank = qBound(Q_UINT64_C(1), rank, total);
+    quint64 seen = 0;
+    for (int i = 0; i < csmBucketCount; ++i) {
+        seen += mCurrent[i] + mPrevious[i];
+        if (seen >= rank) {
+            // The bucket's middle may be above the largest value actually seen:
+            return qMin(valueOf(i), qMax(mCurrentMaximum, mPreviousMaximum));
+        }
+    }
+    return qMax(mCurrentMaximum, mPreviousMaximum);
+}
+
+void TConnectionStatistics::reset()
+{
+    for (auto& histogram : mHistograms) {
+        histogram.reset();
+    }
+}
+
+QString TConnectionStatistics::name(const Metric metric)
+{
+    switch (metric) {
+    case CommandLatency:    return QStringLiteral("commandLatency");
+    case BytesPerRead:      return QStringLiteral("bytesPerRead");
+    case InflateTime:       return QStringLiteral("inflateTime");
+    case ParseTime:         return QStringLiteral("parseTime");
+    case TriggerTime:       return QStringLiteral("triggerTime");
+    case PaintTime:         return QStringLiteral("paintTime");
+    default:                return QString();
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef MUDLET_TCONNECTIONSTATISTICS_H
+#define MUDLET_TCONNECTIONSTATISTICS_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+#include "pre_guard.h"
+#include <QElapsedTimer>
+#include <QString>
+#include "post_guard.h"
+
+#include <array>
+
+
+// A histogram of non-negative values (times in micro-seconds, or sizes in
+// bytes) in the style of an HDR histogram: the buckets are exact up to 32
+// and after that there are 16 to each power of two, so a percentile is never
+// more than about 3% out no matter how far the values range, and recording
+// one is just an increment. Only the recent past counts: values go into the
+// current window, which is moved to the previous one when it is full, so the
+// results cover between one and two window lengths.
+class TLatencyHistogram
+{
+public:
+    explicit TLatencyHistogram(const qint64 windowMilliSeconds = 60000);
+
+    void record(qint64 value);
+    void reset();
+    quint64 count();
+    // The value that the given percentage (0 - 100) of them are at or below:
+    qint64 percentile(const double percentage);
+    qint64 maximum();
+
+private:
+    void rotateIfDue();
+    static int bucketFor(const quint64 value);
+    static qint64 valueOf(const int bucket);
+
+
+    // 32 exact buckets and 16 for each power of two from 2^5 to 2^40:
+    static const int csmBucketCount = 32 + 36 * 16;
+    static const int csmMaxPower = 40;
+
+    std::array<quint32, csmBucketCount> mCurrent;
+    std::array<quint32, csmBucketCount> mPrevious;
+    quint64 mCurrentCount;
+    quint64 mPreviousCount;
+    qint64 mCurrentMaximum;
+    qint64 mPreviousMaximum;
+    qint64 mWindow;
+    QElapsedTimer mWindowTimer;
+};
+
+
+// The measurements that are kept for each connection, so that a slow server
+// or network can be told apart from a slow client; those taken in the network
+// thread are kept by the TTelnetReader and the rest by the cTelnet:
+class TConnectionStatistics
+{
+public:
+    enum Metric {
+        // From sending a command to the next data arriving (micro-seconds):
+        CommandLatency = 0,
+        // The amount of data read from the socket at a time (bytes):
+        BytesPerRead,
+        // Time spent decompressing MCCP data for each read (micro-seconds):
+        InflateTime,
+        // Time taken by TBuffer::translateToPlainText(...) for each batch of
+        // text, including the triggers it runs (micro-seconds):
+        ParseTime,
+        // Time taken running the triggers on each line (micro-seconds):
+        TriggerTime,
+        // From the text being handed to the console to it being painted
+        // (micro-seconds):
+        PaintTime,
+        MetricCount
+    };
+
+    void record(const Metric metric, const qint64 value) { mHistograms[metric].record(value); }
+    TLatencyHistogram& histogram(const Metric metric) { return mHistograms[metric]; }
+    const TLatencyHistogram& histogram(const Metric metric) const { return mHistograms[metric]; }
+    void reset();
+
+    // The name used for it in the Lua API:
+    static QString name(const Metric metric);
+    static bool isTime(const Metric metric) { return metric != BytesPerRead; }
+
+private:
+    std::array<TLatencyHistogram, MetricCount> mHistograms;
+};
+
+#endif // MUDLET_TCONNECTIONSTATISTICS_H
@@ -25,12 +25,14 @@
 
 
 #include "Host.h"
+#include "TBenchmark.h"
 #include "TCommandLine.h"
 #include "TDebug.h"
 #include "TEvent.h"
 #include "TLabel.h"
 #include "TMap.h"
 #include "TRoomDB.h"
+#include "TSessionLog.h"
 #include "TSplitter.h"
 #include "TTextEdit.h"
 #include "XMLexport.h"
@@ -45,6 +47,8 @@
 #include <QScrollBar>
 #include <QShortcut>
 #include <QTextCodec>
+#include <QTimer>
+#include <QtConcurrent>
 #include <QToolButton>
 #include <QVBoxLayout>
 #include "post_guard.h"
@@ -91,6 +95,7 @@ TConsole::TConsole(Host* pH, bool isDebugConsole, QWidget* parent)
 , mpMapper(nullptr)
 , mpScrollBar(new QScrollBar)
 , mpButtonMainLayer(nullptr)
+, mIsPaintPending(false)
 , mRecordReplay(false)
 , mSystemMessageBgColor(mBgColor)
 , mSystemMessageFgColor(QColor(Qt::red))
@@ -105,6 +110,9 @@ TConsole::TConsole(Host* pH, bool isDebugConsole, QWidget* parent)
 , mpBufferSearchDown(new QToolButton)
 , mCurrentSearchResult(0)
 , mSearchQuery("")
+, mpSearchIndex(new TBufferSearchIndex)
+, mpSearchWatcher(new QFutureWatcher<TBufferSearchResult>(this))
+, mpReflowTimer(new QTimer(this))
 {
     auto ps = new QShortcut(this);
     ps->setKey(Qt::CTRL + Qt::Key_W);
@@ -458,8 +466,11 @@ TConsole::TConsole(Host* pH, bool isDebugConsole, QWidget* parent)
     __pal.setColor(QPalette::Base, mpHost->mCommandLineBgColor); //QColor(255,255,225));
     __pal.setColor(QPalette::Window, mpHost->mCommandLineBgColor);
     mpBufferSearchBox->setPalette(__pal);
-    mpBufferSearchBox->setToolTip(tr("<html><head/><body><p>Search buffer.</p></body></html>"));
+    mpBufferSearchBox->setToolTip(tr("<html><head/><body><p>Search buffer.</p><p>Put the text between slashes, like <tt>/^You see \\d+/</tt>, to search with a regular expression.</p></body></html>"));
     connect(mpBufferSearchBox, SIGNAL(returnPressed()), this, SLOT(slot_searchBufferUp()));
+    connect(mpSearchWatcher, &QFutureWatcherBase::finished, this, &TConsole::slot_searchBufferFinished);
+    mpReflowTimer->setSingleShot(true);
+    connect(mpReflowTimer, &QTimer::timeout, this, &TConsole::slot_reflowSome);
 
 
     mpBufferSearchUp->setMinimumSize(QSize(30, 30));
@@ -856,8 +867,11 @@ void TConsole::toggleLogging(bool isMessageEnabled)
             dirLogFile.mkpath(directoryLogFile);
         }
 
-        mpHost->mIsCurrentLogFileInHtmlFormat = mpHost->mIsNextLogFileInHtmlFormat;
-        if (mpHost->mIsCurrentLogFileInHtmlFormat) {
+        mpHost->mIsCurrentLogFileInBinaryFormat = mpHost->mIsNextLogFileInBinaryFormat;
+        mpHost->mIsCurrentLogFileInHtmlFormat = mpHost->mIsNextLogFileInHtmlFormat && !mpHost->mIsCurrentLogFileInBinaryFormat;
+        if (mpHost->mIsCurrentLogFileInBinaryFormat) {
+            mLogFileName = QStringLiteral("%1/%2.mlog").arg(directoryLogFile, logFileName);
+        } else if (mpHost->mIsCurrentLogFileInHtmlFormat) {
             mLogFileName = QStringLiteral("%1/%2.html").arg(directoryLogFile, logFileName);
         } else {
             mLogFileName = QStringLiteral("%1/%2.txt").arg(directoryLogFile, logFileName);
@@ -894,7 +908,13 @@ void TConsole::toggleLogging(bool isMessageEnabled)
 
     if (mLogToLogFile) {
         // Logging is being turned on
-        if (mpHost->mIsCurrentLogFileInHtmlFormat) {
+        if (mpHost->mIsCurrentLogFileInBinaryFormat) {
+            // The start of the session is recorded by mLogWriter below, all a
+            // new file needs first is the header:
+            if (mLogFile.size() == 0) {
+                mLogFile.write(TSessionLog::fileHeader());
+            }
+        } else if (mpHost->mIsCurrentLogFileInHtmlFormat) {
             QString log;
             QTextStream logStream(&log);
             /*
@@ -993,6 +1013,18 @@ void TConsole::toggleLogging(bool isMessageEnabled)
                                                   "This is the format argument to QDateTime::toString(...) and needs to follow the rules for that function {literal text must be single quoted} as well as being suitable for the translation locale"));
 
         }
+        // From here on the file is only added to, by mLogWriter from its own
+        // thread:
+        mLogStream.flush();
+        mLogStream.setDevice(nullptr);
+        mLogFile.close();
+        if (!mLogWriter.open(mLogFileName, mpHost->mIsCurrentLogFileInBinaryFormat ? TLogWriter::CompressedRecords : TLogWriter::Text)) {
+            qWarning().nospace().noquote() << "TConsole::toggleLogging(...) ERROR - failed to reopen log file \"" << mLogFileName << "\" to add to it, reason: \"" << mLogWriter.errorString() << "\".";
+        } else if (mpHost->mIsCurrentLogFileInBinaryFormat) {
+            QByteArray sessionStart;
+            TSessionLog::appendSessionStart(sessionStart, logDateTime.toMSecsSinceEpoch(), profile_name, mpHost->mFgColor.rgb() & 0xffffff, mpHost->mBgColor.rgb() & 0xffffff);
+            mLogWriter.writeData(sessionStart);
+        }
         logButton->setToolTip(QStringLiteral("<html><head/><body>%1</body></html>")
                               .arg(tr("<p>Stop logging MUD output to log file.</p>")));
     } else {
@@ -1001,21 +1033,34 @@ void TConsole::toggleLogging(bool isMessageEnabled)
         QString endDateTimeLine = tr("Log session ending at %1.")
                 .arg(logDateTime.toString(tr("hh:mm:ss' on 'dddd', 'd' 'MMMM' 'yyyy",
                                              "This is the format argument to QDateTime::toString(...) and needs to follow the rules for that function {literal text must be single quoted} as well as being suitable for the translation locale")));
-        if (mpHost->mIsCurrentLogFileInHtmlFormat) {
-            mLogStream << QStringLiteral("<p>%1</p>\n").arg(endDateTimeLine);
-            mLogStream << "  </div></body>\n";
-            mLogStream << "</html>\n";
+        if (mpHost->mIsCurrentLogFileInBinaryFormat) {
+            QByteArray sessionEnd;
+            TSessionLog::appendSessionEnd(sessionEnd, logDateTime.toMSecsSinceEpoch());
+            mLogWriter.writeData(sessionEnd);
+        } else if (mpHost->mIsCurrentLogFileInHtmlFormat) {
+            mLogWriter.write(QStringLiteral("<p>%1</p>\n").arg(endDateTimeLine));
+            mLogWriter.write(QStringLiteral("  </div></body>\n"));
+            mLogWriter.write(QStringLiteral("</html>\n"));
         } else {
             // File is NOT an HTML one but pure text:
-            mLogStream << endDateTimeLine << "\n";
+            mLogWriter.write(QStringLiteral("%1\n").arg(endDateTimeLine));
         }
-        mLogFile.flush();
-        mLogFile.close();
+        mLogWriter.close();
         logButton->setToolTip(QStringLiteral("<html><head/><body>%1</body></html>")
                               .arg(tr("<p>Start logging MUD output to log file.</p>")));
     }
 }
 
+// Makes sure that everything logged so far has been written out, this is done
+// when the connection is lost:
+void TConsole::flushLog()
+{
+    if (mLogToLogFile) {
+        buffer.logRemainingOutput();
+        mLogWriter.flush();
+    }
+}
+
 // Converted into a wrapper around a separate toggleLogging() method so that
 // calls to turn logging on/off via the toolbar button - which go via this
 // wrapper - generate messages on the console.  Requests to control logging from
@@ -1045,15 +1090,18 @@ void TConsole::slot_toggleReplayRecording()
         if (!dirLogFile.exists(directoryLogFile)) {
             dirLogFile.mkpath(directoryLogFile);
         }
-        mReplayFile.setFileName(mLogFileName);
-        mReplayFile.open(QIODevice::WriteOnly);
-        mReplayStream.setDevice(&mReplayFile);
+        if (!mReplayWriter.open(mLogFileName)) {
+            mRecordReplay = false;
+            printSystemMessage(QStringLiteral("Replay recording could not be started, error message was: \"%1\".\n").arg(mReplayWriter.errorString()));
+            return;
+        }
         mpHost->mTelnet.recordReplay();
-        QString message = QString("Replay recording has started. File: ") + mReplayFile.fileName() + "\n";
+        QString message = QString("Replay recording has started. File: ") + mReplayWriter.fileName() + "\n";
         printSystemMessage(message);
     } else {
-        mReplayFile.close();
-        QString message = QString("Replay recording has been stopped. File: ") + mReplayFile.fileName() + "\n";
+        mpHost->mTelnet.stopReplayRecording();
+        mReplayWriter.close();
+        QString message = QString("Replay recording has been stopped. File: ") + mReplayWriter.fileName() + "\n";
         printSystemMessage(message);
     }
 }
@@ -1168,11 +1216,59 @@ void TConsole::changeColors()
 
     buffer.updateColors();
     if (!mIsDebugConsole && !mIsSubConsole) {
-        buffer.mWrapAt = mpHost->mWrapAt;
         buffer.mWrapIndent = mpHost->mWrapIndentCount;
+        if (buffer.setWrapAt(mpHost->mWrapAt)) {
+            updateAfterReflow();
+        }
+        if (buffer.isReflowPending()) {
+            mpReflowTimer->start();
+        }
+    }
+}
+
+void TConsole::setWrapAt(int pos)
+{
+    mWrapAt = pos;
+    if (buffer.setWrapAt(pos)) {
+        updateAfterReflow();
+    }
+    if (buffer.isReflowPending()) {
+        mpReflowTimer->start();
+    }
+}
+
+// Re-wraps the next batch of the lines that setWrapAt(...) left, going back
+// to the event loop in between so that the profile carries on meanwhile:
+void TConsole::slot_reflowSome()
+{
+    if (buffer.reflowSome()) {
+        updateAfterReflow();
+    }
+    if (buffer.isReflowPending()) {
+        mpReflowTimer->start();
     }
 }
 
+// The buffer has been wrapped again at a new width so the line numbers held
+// for a selection, a search result or the user cursor no longer point at the
+// same text - drop them and redraw both panes from scratch:
+void TConsole::updateAfterReflow()
+{
+    mUpperPane->unHighlight();
+    mLowerPane->unHighlight();
+    deselect();
+    mUpperPane->setSearchHighlight(-1, QVector<QPair<int, int>>());
+    mLowerPane->setSearchHighlight(-1, QVector<QPair<int, int>>());
+    mCurrentSearchResult = buffer.trimmedLineCount() + buffer.lineBuffer.size();
+    mUserCursor.setX(0);
+    mUserCursor.setY(buffer.getLastLineNumber());
+
+    mLowerPane->mCursorY = buffer.size();
+    mUpperPane->updateScreenView();
+    mUpperPane->forceUpdate();
+    mLowerPane->forceUpdate();
+}
+
 void TConsole::setConsoleBgColor(int r, int g, int b)
 {
     mBgColor = QColor(r, g, b);
@@ -1205,12 +1301,21 @@ void TConsole::setConsoleFgColor(int r, int g, int b)
 
 void TConsole::printOnDisplay(std::string& incomingSocketData, const bool isFromServer)
 {
-    mProcessingTime.restart();
+    mProcessingTime.start();
+    if (!mIsPaintPending && isVisible()) {
+        mIsPaintPending = true;
+        mPaintTimer.start();
+    }
     mTriggerEngineMode = true;
-    buffer.translateToPlainText(incomingSocketData, isFromServer);
+    {
+        TBenchmarkScope scope(TBenchmark::Parsing);
+        buffer.translateToPlainText(incomingSocketData, isFromServer);
+    }
     mTriggerEngineMode = false;
 
-    double processT = mProcessingTime.elapsed();
+    const qint64 processNanoSeconds = mProcessingTime.nsecsElapsed();
+    mpHost->mTelnet.recordStatistic(TConnectionStatistics::ParseTime, processNanoSeconds / 1000);
+    double processT = processNanoSeconds / 1000000.0;
     if (mpHost->mTelnet.mGA_Driver) {
         networkLatency->setText(QString("N:%1 S:%2").arg(mpHost->mTelnet.networkLatency, 0, 'f', 3).arg(processT / 1000, 0, 'f', 3));
     } else {
@@ -1225,6 +1330,10 @@ void TConsole::printOnDisplay(std::string& incomingSocketData, const bool isFrom
 
 void TConsole::runTriggers(int line)
 {
+    TBenchmarkScope scope(TBenchmark::Triggers);
+    TBenchmark::addLine();
+    QElapsedTimer triggerTimer;
+    triggerTimer.start();
     mDeletedLines = 0;
     mUserCursor.setY(line);
     mIsPromptLine = buffer.promptBuffer.at(line);
@@ -1240,6 +1349,7 @@ void TConsole::runTriggers(int line)
     }
     mpHost->incomingStreamProcessor(mCurrentLine, line);
     mIsPromptLine = false;
+    mpHost->mTelnet.recordStatistic(TConnectionStatistics::TriggerTime, triggerTimer.nsecsElapsed() / 1000);
 
     //FIXME: neu schreiben: wenn lines oberhalb der aktuellen zeile gelöscht wurden->redraw clean slice
     //       ansonsten einfach löschen
@@ -1251,6 +1361,14 @@ void TConsole::finalize()
     mLowerPane->showNewLines();
 }
 
+void TConsole::painted()
+{
+    if (mIsPaintPending) {
+        mIsPaintPending = false;
+        mpHost->mTelnet.recordStatistic(TConnectionStatistics::PaintTime, mPaintTimer.nsecsElapsed() / 1000);
+    }
+}
+
 /* ANSI color codes: sequence = "ESCAPE + [ code_1; ... ; code_n m"
    -----------------------------------------
    0 reset
@@ -1324,6 +1442,9 @@ void TConsole::showEvent(QShowEvent* event)
             mpHost->mTelnet.mAlertOnNewData = false;
         }
     }
+    // Text handed over whilst hidden is not timed, nor is any from before
+    // that it was not painted for:
+    mIsPaintPending = false;
     QWidget::showEvent(event); //FIXME-refac: might cause problems
 }
 
@@ -1338,6 +1459,8 @@ void TConsole::hideEvent(QHideEvent* event)
             }
         }
     }
+    // It will not be painted until it is shown again, however long that is:
+    mIsPaintPending = false;
     QWidget::hideEvent(event); //FIXME-refac: might cause problems
 }
 
@@ -2123,6 +2246,10 @@ void TConsole::setStrikeOut(bool b)
 
 void TConsole::setFgColor(int r, int g, int b)
 {
+    // TChar only has room for 0 to 255:
+    r = qBound(0, r, 255);
+    g = qBound(0, g, 255);
+    b = qBound(0, b, 255);
     mFormatCurrent.fgR = r;
     mFormatCurrent.fgG = g;
     mFormatCurrent.fgB = b;
@@ -2131,6 +2258,9 @@ void TConsole::setFgColor(int r, int g, int b)
 
 void TConsole::setBgColor(int r, int g, int b)
 {
+    r = qBound(0, r, 255);
+    g = qBound(0, g, 255);
+    b = qBound(0, b, 255);
     mFormatCurrent.bgR = r;
     mFormatCurrent.bgG = g;
     mFormatCurrent.bgB = b;
@@ -2652,6 +2782,12 @@ void TConsole::showStatistics()
     QString r1 = mpHost->getTriggerUnit()->assembleReport();
     msg = r1;
     print(msg, QColor(150, 120, 0), Qt::black);
+    // The full table, which can be sorted by any column, is in the trigger
+    // editor:
+    script = "setFgColor(190,150,0); setUnderline(true); echo([[\n\nTrigger Profile (most costly first):\n\n]]); setBold(false);setUnderline(false);setFgColor(150,120,0)";
+    mpHost->mLuaInterpreter.compileAndExecuteScript(script);
+    msg = mpHost->getTriggerUnit()->assembleProfileReport(20);
+    print(msg, QColor(150, 120, 0), Qt::black);
     script = "setFgColor(190,150,0); setUnderline(true);echo([[\n\nTimer Report:\n\n]]);setBold(false);setUnderline(false);setFgColor(150,120,0)";
     mpHost->mLuaInterpreter.compileAndExecuteScript(script);
     QString r2 = mpHost->getTimerUnit()->assembleReport();
@@ -2674,80 +2810,90 @@ void TConsole::showStatistics()
 
 void TConsole::slot_searchBufferUp()
 {
-    QString _txt = mpBufferSearchBox->text();
-    if (_txt != mSearchQuery) {
-        mSearchQuery = _txt;
-        mCurrentSearchResult = buffer.lineBuffer.size();
+    searchBuffer(true);
+}
+
+void TConsole::slot_searchBufferDown()
+{
+    searchBuffer(false);
+}
+
+// The search is done on another thread, against a copy of the lines (and the
+// archive, which it reads for itself), and the result is shown by
+// slot_searchBufferFinished() - matches are highlighted by the TTextEdits when
+// they draw the line rather than by changing its colours:
+void TConsole::searchBuffer(const bool isUpwards)
+{
+    if (mpSearchWatcher->isRunning() || buffer.lineBuffer.size() < 1) {
+        return;
+    }
+
+    const int endLine = buffer.trimmedLineCount() + buffer.lineBuffer.size();
+    QString query = mpBufferSearchBox->text();
+    if (query != mSearchQuery) {
+        mSearchQuery = query;
+        mCurrentSearchResult = endLine;
     } else {
         // make sure the line to search from does not exceed the buffer, which can grow and shrink dynamically
-        mCurrentSearchResult = std::min(mCurrentSearchResult, buffer.lineBuffer.size());
+        mCurrentSearchResult = std::min(mCurrentSearchResult, endLine);
     }
-    if (buffer.lineBuffer.size() < 1) {
+    if (query.isEmpty()) {
+        mUpperPane->setSearchHighlight(-1, QVector<QPair<int, int>>());
+        mLowerPane->setSearchHighlight(-1, QVector<QPair<int, int>>());
         return;
     }
-    bool _found = false;
-    for (int i = mCurrentSearchResult - 1; i >= 0; i--) {
-        int begin = -1;
-        do {
-            begin = buffer.lineBuffer[i].indexOf(mSearchQuery, begin + 1);
-            if (begin > -1) {
-                int length = mSearchQuery.size();
-                moveCursor(0, i);
-                selectSection(begin, length);
-                setBgColor(255, 255, 0);
-                setFgColor(0, 0, 0);
-                deselect();
-                reset();
-                _found = true;
-            }
-        } while (begin > -1);
-        if (_found) {
-            scrollUp(buffer.mCursorY - i - 3);
-            mUpperPane->forceUpdate();
-            mCurrentSearchResult = i;
-            return;
-        }
+    if (!isUpwards && mCurrentSearchResult >= endLine) {
+        return;
+    }
+
+    TBufferSearchRequest request;
+    request.lines = buffer.lineBuffer;
+    request.firstLine = buffer.trimmedLineCount();
+    request.renumberCount = buffer.lineRenumberCount();
+    request.editedLines = buffer.takeEditedLines();
+    request.archive = buffer.archive();
+    request.archivedLineCount = buffer.archivedLineCount();
+    if (query.size() > 2 && query.startsWith(QLatin1Char('/')) && query.endsWith(QLatin1Char('/'))) {
+        request.query = query.mid(1, query.size() - 2);
+        request.isRegularExpression = true;
+    } else {
+        request.query = query;
     }
-    print("No search results, sorry!\n");
+    request.isUpwards = isUpwards;
+    request.fromLine = mCurrentSearchResult;
+
+    QSharedPointer<TBufferSearchIndex> pIndex = mpSearchIndex;
+    mpSearchWatcher->setFuture(QtConcurrent::run([pIndex, request]() { return pIndex->search(request); }));
 }
 
-void TConsole::slot_searchBufferDown()
+void TConsole::slot_searchBufferFinished()
 {
-    QString _txt = mpBufferSearchBox->text();
-    if (_txt != mSearchQuery) {
-        mSearchQuery = _txt;
-        mCurrentSearchResult = buffer.lineBuffer.size();
-    }
-    if (buffer.lineBuffer.size() < 1) {
+    const TBufferSearchResult result = mpSearchWatcher->result();
+    if (!result.errorMessage.isEmpty()) {
+        print(tr("Search failed, %1\n").arg(result.errorMessage));
         return;
     }
-    if (mCurrentSearchResult >= buffer.lineBuffer.size()) {
-        return;
-    }
-    bool _found = false;
-    for (int i = mCurrentSearchResult + 1; i < buffer.lineBuffer.size(); i++) {
-        int begin = -1;
-        do {
-            begin = buffer.lineBuffer[i].indexOf(mSearchQuery, begin + 1);
-            if (begin > -1) {
-                int length = mSearchQuery.size();
-                moveCursor(0, i);
-                selectSection(begin, length);
-                setBgColor(255, 255, 0);
-                setFgColor(0, 0, 0);
-                deselect();
-                reset();
-                _found = true;
-            }
-        } while (begin > -1);
-        if (_found) {
-            scrollUp(buffer.mCursorY - i - 3);
-            mUpperPane->forceUpdate();
-            mCurrentSearchResult = i;
-            return;
+
+    // A line found in the archive has to be brought back, with those after
+    // it, before it can be scrolled to:
+    while (result.line >= 0 && result.line < buffer.trimmedLineCount()) {
+        if (mUpperPane->restoreArchivedLines() == 0) {
+            break;
         }
     }
-    print("No search results, sorry!\n");
+
+    // The buffer may have been trimmed while the search was running:
+    const int line = result.line - buffer.trimmedLineCount();
+    if (result.line < 0 || line < 0 || line >= buffer.lineBuffer.size()) {
+        print("No search results, sorry!\n");
+        return;
+    }
+
+    mUpperPane->setSearchHighlight(result.line, result.matches);
+    mLowerPane->setSearchHighlight(result.line, result.matches);
+    scrollUp(buffer.mCursorY - line - 3);
+    mUpperPane->forceUpdate();
+    mCurrentSearchResult = result.line;
 }
 
 QSize TConsole::getMainWindowSize() const
@@ -25,12 +25,19 @@
 
 
 #include "TBuffer.h"
+#include "TBufferSearch.h"
+#include "TLogWriter.h"
+#include "TReplayFile.h"
 
 #include "pre_guard.h"
 #include <QDataStream>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFutureWatcher>
 #include <QPointer>
+#include <QSharedPointer>
 #include <QTextStream>
+#include <QTimer>
 #include <QWidget>
 #include "post_guard.h"
 
@@ -92,11 +99,7 @@ public:
     int getColumnNumber();
     void createMapper(int, int, int, int);
 
-    void setWrapAt(int pos)
-    {
-        mWrapAt = pos;
-        buffer.setWrapAt(pos);
-    }
+    void setWrapAt(int pos);
 
     void setIndentCount(int count)
     {
@@ -148,6 +151,8 @@ public:
     void setUnderline(bool);
     void setStrikeOut(bool);
     void finalize();
+    // Called by the lower pane each time it has been painted:
+    void painted();
     void runTriggers(int);
     void showStatistics();
     void showEvent(QShowEvent* event) override;
@@ -167,6 +172,7 @@ public:
     QSize getMainWindowSize() const;
 
     void toggleLogging(bool);
+    void flushLog();
 
     QPointer<Host> mpHost;
 
@@ -203,7 +209,10 @@ public:
     std::map<std::string, TLabel*> mLabelMap;
     QFile mLogFile;
     QString mLogFileName;
+    // Only used to set up the log file when logging starts, after that it is
+    // added to by mLogWriter:
     QTextStream mLogStream;
+    TLogWriter mLogWriter;
     bool mLogToLogFile;
     int mMainFrameBottomHeight;
     int mMainFrameLeftWidth;
@@ -230,10 +239,13 @@ public:
     QScrollBar* mpScrollBar;
 
 
-    QTime mProcessingTime;
+    QElapsedTimer mProcessingTime;
+    // Started when text is handed over for display, if it is not already
+    // waiting to be painted, for the PaintTime statistic:
+    QElapsedTimer mPaintTimer;
+    bool mIsPaintPending;
     bool mRecordReplay;
-    QFile mReplayFile;
-    QDataStream mReplayStream;
+    TReplayWriter mReplayWriter;
     TChar mStandardFormat;
     QList<TConsole*> mSubConsoleList;
     std::map<std::string, TConsole*> mSubConsoleMap;
@@ -256,9 +268,16 @@ public:
     QLineEdit* mpBufferSearchBox;
     QToolButton* mpBufferSearchUp;
     QToolButton* mpBufferSearchDown;
+    // A session line number, see TBuffer::trimmedLineCount():
     int mCurrentSearchResult;
     QList<int> mSearchResults;
     QString mSearchQuery;
+    // Shared with the search that is running, if there is one, so that it
+    // can finish even if this console has gone:
+    QSharedPointer<TBufferSearchIndex> mpSearchIndex;
+    QFutureWatcher<TBufferSearchResult>* mpSearchWatcher;
+    // Drives TBuffer::reflowSome() until all the lines fit a new width:
+    QTimer* mpReflowTimer;
     bool mSaveLayoutRequested;
     QWidget* mpButtonMainLayer;
 
@@ -272,6 +291,8 @@ signals:
 public slots:
     void slot_searchBufferUp();
     void slot_searchBufferDown();
+    void slot_searchBufferFinished();
+    void slot_reflowSome();
     void slot_toggleReplayRecording();
     void slot_stop_all_triggers(bool);
     void slot_toggleLogging();
@@ -283,6 +304,8 @@ public slots:
 
 private:
     void refreshMiniConsole() const;
+    void searchBuffer(bool isUpwards);
+    void updateAfterReflow();
 
 };
 
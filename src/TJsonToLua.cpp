@@ -0,0 +1,435 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TJsonToLua.h"
+
+
+#include "pre_guard.h"
+#include <QByteArray>
+#include "post_guard.h"
+
+bool TJsonToLua::push(const char* data, const size_t length, QString& errorMessage)
+{
+    const int top = lua_gettop(mpL);
+    mpStart = data;
+    mpData = data;
+    mpEnd = data + length;
+    mDepth = 0;
+    mError.clear();
+
+    bool isOk = parseValue();
+    if (isOk) {
+        skipWhitespace();
+        if (mpData != mpEnd) {
+            isOk = fail("unexpected text after the end of the value");
+        }
+    }
+    if (!isOk) {
+        lua_settop(mpL, top);
+        errorMessage = mError;
+    }
+    return isOk;
+}
+
+void TJsonToLua::mergeTable(lua_State* L, int toIndex, int fromIndex)
+{
+    // Make relative indexes absolute as the stack changes below:
+    if (toIndex < 0 && toIndex > LUA_REGISTRYINDEX) {
+        toIndex = lua_gettop(L) + toIndex + 1;
+    }
+    if (fromIndex < 0 && fromIndex > LUA_REGISTRYINDEX) {
+        fromIndex = lua_gettop(L) + fromIndex + 1;
+    }
+    lua_pushnil(L);
+    while (lua_next(L, fromIndex)) {
+        // Stack is now: ... key value - keep a copy of the key for lua_next:
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, toIndex);
+    }
+}
+
+bool TJsonToLua::fail(const char* reason)
+{
+    if (mError.isEmpty()) {
+        mError = QStringLiteral("%1 at byte %2").arg(QLatin1String(reason)).arg(mpData - mpStart);
+    }
+    return false;
+}
+
+void TJsonToLua::skipWhitespace()
+{
+    while (mpData < mpEnd && (*mpData == ' ' || *mpData == '\t' || *mpData == '\n' || *mpData == '\r')) {
+        ++mpData;
+    }
+}
+
+bool TJsonToLua::parseValue()
+{
+    skipWhitespace();
+    if (mpData == mpEnd) {
+        return fail("unexpected end of the data");
+    }
+
+    switch (*mpData) {
+    case '{':
+        return parseObject();
+    case '[':
+        return parseArray();
+    case '"':
+        return parseString();
+    case 't':
+        if (!parseLiteral("true", 4)) {
+            return false;
+        }
+        lua_pushboolean(mpL, true);
+        return true;
+    case 'f':
+        if (!parseLiteral("false", 5)) {
+            return false;
+        }
+        lua_pushboolean(mpL, false);
+        return true;
+    case 'n':
+        if (!parseLiteral("null", 4)) {
+            return false;
+        }
+        // The sentinel that lua_yajl registers, so that scripts can still
+        // compare against yajl.null:
+        lua_getfield(mpL, LUA_REGISTRYINDEX, "yajl.null");
+        return true;
+    default:
+        if (*mpData == '-' || (*mpData >= '0' && *mpData <= '9')) {
+            return parseNumber();
+        }
+        return fail("unexpected character");
+    }
+}
+
+bool TJsonToLua::parseLiteral(const char* literal, const size_t length)
+{
+    if (static_cast<size_t>(mpEnd - mpData) < length || qstrncmp(mpData, literal, static_cast<uint>(length))) {
+        return fail("invalid literal");
+    }
+    mpData += length;
+    return true;
+}
+
+bool TJsonToLua::parseObject()
+{
+    if (++mDepth > csmMaxDepth) {
+        return fail("too deeply nested");
+    }
+    // The table, a key and a value - and the value may be a nested table:
+    if (!lua_checkstack(mpL, 4)) {
+        return fail("out of Lua stack space");
+    }
+    ++mpData; // The '{'
+    lua_newtable(mpL);
+
+    skipWhitespace();
+    if (mpData < mpEnd && *mpData == '}') {
+        ++mpData;
+        --mDepth;
+        return true;
+    }
+
+    while (true) {
+        skipWhitespace();
+        if (mpData == mpEnd || *mpData != '"') {
+            return fail("expected a string for the name of a field");
+        }
+        if (!parseString()) {
+            return false;
+        }
+        skipWhitespace();
+        if (mpData == mpEnd || *mpData != ':') {
+            return fail("expected a ':' after the name of a field");
+        }
+        ++mpData;
+        if (!parseValue()) {
+            return false;
+        }
+        lua_rawset(mpL, -3);
+
+        skipWhitespace();
+        if (mpData == mpEnd) {
+            return fail("unexpected end of the data in an object");
+        }
+        if (*mpData == ',') {
+            ++mpData;
+            continue;
+        }
+        if (*mpData == '}') {
+            ++mpData;
+            --mDepth;
+            return true;
+        }
+        return fail("expected a ',' or a '}' in an object");
+    }
+}
+
+bool TJsonToLua::parseArray()
+{
+    if (++mDepth > csmMaxDepth) {
+        return fail("too deeply nested");
+    }
+    if (!lua_checkstack(mpL, 3)) {
+        return fail("out of Lua stack space");
+    }
+    ++mpData; // The '['
+    lua_newtable(mpL);
+
+    skipWhitespace();
+    if (mpData < mpEnd && *mpData == ']') {
+        ++mpData;
+        --mDepth;
+        return true;
+    }
+
+    int index = 0;
+    while (true) {
+        if (!parseValue()) {
+            return false;
+        }
+        lua_rawseti(mpL, -2, ++index);
+
+        skipWhitespace();
+        if (mpData == mpEnd) {
+            return fail("unexpected end of the data in an array");
+        }
+        if (*mpData == ',') {
+            ++mpData;
+            continue;
+        }
+        if (*mpData == ']') {
+            ++mpData;
+            --mDepth;
+            return true;
+        }
+        return fail("expected a ',' or a ']' in an array");
+    }
+}
+
+bool TJsonToLua::parseString()
+{
+    ++mpData; // The opening '"'
+    const char* begin = mpData;
+
+    // Most strings have no escapes in them and can be pushed straight from
+    // the data without being copied first:
+    while (mpData < mpEnd && *mpData != '"' && *mpData != '\\') {
+        if (static_cast<unsigned char>(*mpData) < 0x20) {
+            return fail("control character in a string");
+        }
+        ++mpData;
+    }
+    if (mpData == mpEnd) {
+        return fail("unterminated string");
+    }
+    if (*mpData == '"') {
+        lua_pushlstring(mpL, begin, static_cast<size_t>(mpData - begin));
+        ++mpData;
+        return true;
+    }
+
+    mBuffer.assign(begin, static_cast<size_t>(mpData - begin));
+    while (mpData < mpEnd) {
+        const char c = *mpData;
+        if (c == '"') {
+            lua_pushlstring(mpL, mBuffer.data(), mBuffer.size());
+            ++mpData;
+            return true;
+        }
+        if (c == '\\') {
+            if (!appendEscape()) {
+                return false;
+            }
+            continue;
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            return fail("control character in a string");
+        }
+        mBuffer.push_back(c);
+        ++mpData;
+    }
+    return fail("unterminated string");
+}
+
+// Handles the escape sequence at mpData, adding what it stands for to mBuffer:
+bool TJsonToLua::appendEscape()
+{
+    ++mpData; // The '\\'
+    if (mpData == mpEnd) {
+        return fail("unterminated string");
+    }
+
+    const char c = *mpData++;
+    switch (c) {
+    case '"':   mBuffer.push_back('"'); return true;
+    case '\\':  mBuffer.push_back('\\'); return true;
+    case '/':   mBuffer.push_back('/'); return true;
+    case 'b':   mBuffer.push_back('\b'); return true;
+    case 'f':   mBuffer.push_back('\f'); return true;
+    case 'n':   mBuffer.push_back('\n'); return true;
+    case 'r':   mBuffer.push_back('\r'); return true;
+    case 't':   mBuffer.push_back('\t'); return true;
+    case 'u':   break;
+    default:
+        return fail("invalid escape sequence in a string");
+    }
+
+    auto readHex4 = [this](uint& value) -> bool {
+        if (mpEnd - mpData < 4) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const char h = *mpData++;
+            value <<= 4;
+            if (h >= '0' && h <= '9') {
+                value |= static_cast<uint>(h - '0');
+            } else if (h >= 'a' && h <= 'f') {
+                value |= static_cast<uint>(h - 'a' + 10);
+            } else if (h >= 'A' && h <= 'F') {
+                value |= static_cast<uint>(h - 'A' + 10);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    uint codePoint;
+    if (!readHex4(codePoint)) {
+        return fail("invalid \\u escape sequence in a string");
+    }
+    if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+        // A high surrogate, which should be followed by a low one:
+        uint low;
+        if (mpEnd - mpData >= 6 && mpData[0] == '\\' && mpData[1] == 'u') {
+            mpData += 2;
+            if (!readHex4(low)) {
+                return fail("invalid \\u escape sequence in a string");
+            }
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+            } else {
+                return fail("unpaired surrogate in a \\u escape sequence");
+            }
+        } else {
+            return fail("unpaired surrogate in a \\u escape sequence");
+        }
+    } else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+        return fail("unpaired surrogate in a \\u escape sequence");
+    }
+
+    if (codePoint < 0x80) {
+        mBuffer.push_back(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        mBuffer.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        mBuffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        mBuffer.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        mBuffer.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        mBuffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        mBuffer.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        mBuffer.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        mBuffer.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        mBuffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    return true;
+}
+
+bool TJsonToLua::parseNumber()
+{
+    const char* begin = mpData;
+    const bool isNegative = (*mpData == '-');
+    if (isNegative) {
+        ++mpData;
+    }
+
+    // Integers (by far the most common in GMCP) are accumulated as they are
+    // read; anything else is handed to a locale independent conversion:
+    qint64 integer = 0;
+    int digits = 0;
+    if (mpData < mpEnd && *mpData == '0') {
+        ++mpData;
+        if (mpData < mpEnd && *mpData >= '0' && *mpData <= '9') {
+            return fail("invalid number (leading zero)");
+        }
+        digits = 1;
+    } else {
+        while (mpData < mpEnd && *mpData >= '0' && *mpData <= '9') {
+            integer = integer * 10 + (*mpData - '0');
+            ++mpData;
+            // Past this many digits the value might not fit:
+            if (++digits > 18) {
+                break;
+            }
+        }
+    }
+    if (!digits) {
+        return fail("invalid number");
+    }
+
+    bool isInteger = true;
+    while (mpData < mpEnd && *mpData >= '0' && *mpData <= '9') {
+        isInteger = false;
+        ++mpData;
+    }
+    if (mpData < mpEnd && *mpData == '.') {
+        isInteger = false;
+        ++mpData;
+        if (mpData == mpEnd || *mpData < '0' || *mpData > '9') {
+            return fail("invalid number");
+        }
+        while (mpData < mpEnd && *mpData >= '0' && *mpData <= '9') {
+            ++mpData;
+        }
+    }
+    if (mpData < mpEnd && (*mpData == 'e' || *mpData == 'E')) {
+        isInteger = false;
+        ++mpData;
+        if (mpData < mpEnd && (*mpData == '+' || *mpData == '-')) {
+            ++mpData;
+        }
+        if (mpData == mpEnd || *mpData < '0' || *mpData > '9') {
+            return fail("invalid number");
+        }
+        while (mpData < mpEnd && *mpData >= '0' && *mpData <= '9') {
+            ++mpData;
+        }
+    }
+
+    if (isInteger) {
+        lua_pushnumber(mpL, static_cast<lua_Number>(isNegative ? -integer : integer));
+        return true;
+    }
+
+    bool isOk = false;
+    const double value = QByteArray::fromRawData(begin, static_cast<int>(mpData - begin)).toDouble(&isOk);
+    if (!isOk) {
+        return fail("invalid number");
+    }
+    lua_pushnumber(mpL, value);
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef MUDLET_TJSONTOLUA_H
+#define MUDLET_TJSONTOLUA_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+#include "pre_guard.h"
+#include <QString>
+#include "post_guard.h"
+
+extern "C" {
+#include <lua.h>
+}
+
+#include <string>
+
+
+// Turns JSON text (e.g. the payload of a GMCP or MSDP message) into a Lua value
+// built directly on the stack of the given lua_State, without going through
+// the Lua json_to_value (yajl.to_value) function. The result is the same as
+// that would give: objects and arrays become tables (arrays indexed from 1),
+// null becomes the yajl.null sentinel and numbers are Lua numbers.
+class TJsonToLua
+{
+public:
+    Q_DISABLE_COPY(TJsonToLua)
+    explicit TJsonToLua(lua_State* L) : mpL(L), mpStart(nullptr), mpData(nullptr), mpEnd(nullptr), mDepth(0) {}
+
+    // On success pushes exactly one value and returns true, otherwise leaves
+    // the stack as it was and returns false with a description in errorMessage:
+    bool push(const char* data, const size_t length, QString& errorMessage);
+
+    // Copies each field of the table at fromIndex into the table at toIndex,
+    // replacing any that are already there - a shallow merge:
+    static void mergeTable(lua_State* L, int toIndex, int fromIndex);
+
+private:
+    bool parseValue();
+    bool parseObject();
+    bool parseArray();
+    bool parseString();
+    bool parseNumber();
+    bool parseLiteral(const char* literal, const size_t length);
+    bool appendEscape();
+    void skipWhitespace();
+    bool fail(const char* reason);
+
+
+    // Nesting that is deeper than this is rejected rather than risking
+    // running out of C stack on malicious input:
+    static const int csmMaxDepth = 512;
+
+    lua_State* mpL;
+    const char* mpStart;
+    const char* mpData;
+    const char* mpEnd;
+    int mDepth;
+    QString mError;
+    // Reused between strings that contain escapes, to save reallocating it:
+    std::string mBuffer;
+};
+
+#endif // MUDLET_TJSONTOLUA_H
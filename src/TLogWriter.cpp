@@ -0,0 +1,200 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TLogWriter.h"
+
+#include "TSessionLog.h"
+
+
+#include "pre_guard.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QTextStream>
+#include "post_guard.h"
+
+const int TLogWriter::csmBatchSize;
+const unsigned long TLogWriter::csmFlushInterval;
+
+TLogWriter::TLogWriter()
+: mMode(Text)
+, mQueuedCount(0)
+, mWrittenCount(0)
+, mIsFlushRequested(false)
+, mIsStopping(false)
+{
+    setObjectName(QStringLiteral("log writer"));
+}
+
+TLogWriter::~TLogWriter()
+{
+    close();
+}
+
+bool TLogWriter::open(const QString& fileName, const Mode mode)
+{
+    close();
+    mMode = mode;
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::Append)) {
+        return false;
+    }
+
+    mIsStopping = false;
+    mIsFlushRequested = false;
+    mQueuedCount = 0;
+    mWrittenCount = 0;
+    start(QThread::LowPriority);
+    return true;
+}
+
+void TLogWriter::write(const QString& text)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+    Q_ASSERT(mMode == Text);
+
+    QMutexLocker locker(&mLock);
+    mPending.append(text);
+    ++mQueuedCount;
+    if (mPending.size() >= csmBatchSize) {
+        mWakeUp.wakeOne();
+    }
+}
+
+void TLogWriter::writeData(const QByteArray& records)
+{
+    if (records.isEmpty()) {
+        return;
+    }
+    Q_ASSERT(mMode == CompressedRecords);
+
+    QMutexLocker locker(&mLock);
+    mPendingData.append(records);
+    ++mQueuedCount;
+    if (mPendingData.size() >= csmBatchSize) {
+        mWakeUp.wakeOne();
+    }
+}
+
+void TLogWriter::flush()
+{
+    if (!isRunning()) {
+        return;
+    }
+
+    QMutexLocker locker(&mLock);
+    const quint64 target = mQueuedCount;
+    while (mWrittenCount < target) {
+        mIsFlushRequested = true;
+        mWakeUp.wakeOne();
+        mWritten.wait(&mLock);
+    }
+}
+
+void TLogWriter::close()
+{
+    if (isRunning()) {
+        {
+            QMutexLocker locker(&mLock);
+            mIsStopping = true;
+            mWakeUp.wakeOne();
+        }
+        wait();
+    }
+    if (mFile.isOpen()) {
+        mFile.close();
+    }
+}
+
+void TLogWriter::run()
+{
+    // Uses the same (locale dependent) codec as the QTextStream that the
+    // header of the file was written with:
+    QTextStream stream(&mFile);
+    QMutexLocker locker(&mLock);
+    forever {
+        if (mPending.size() < csmBatchSize && mPendingData.size() < csmBatchSize && !mIsFlushRequested && !mIsStopping) {
+            mWakeUp.wait(&mLock, csmFlushInterval);
+        }
+
+        QString batch;
+        batch.swap(mPending);
+        QByteArray dataBatch;
+        dataBatch.swap(mPendingData);
+        const quint64 queuedCount = mQueuedCount;
+        const bool isStopping = mIsStopping;
+        mIsFlushRequested = false;
+        locker.unlock();
+
+        if (!batch.isEmpty() || !dataBatch.isEmpty()) {
+            if (!batch.isEmpty()) {
+                stream << batch;
+                stream.flush();
+            }
+            if (!dataBatch.isEmpty()) {
+                // Compressing here keeps that off the main thread too:
+                mFile.write(TSessionLog::frame(dataBatch));
+            }
+            if (!mFile.flush()) {
+                qWarning().nospace().noquote() << "TLogWriter::run() WARNING - failed to write to log file \"" << mFile.fileName() << "\", reason: \"" << mFile.errorString() << "\".";
+            }
+        }
+
+        locker.relock();
+        mWrittenCount = queuedCount;
+        mWritten.wakeAll();
+        if (isStopping && mPending.isEmpty() && mPendingData.isEmpty()) {
+            break;
+        }
+    }
+}
+
+void TLogHeldLines::hold(TLogWriter& writer, const int fromLine, const int toLine, const QString& text, const QByteArray& data)
+{
+    // Either end being the same is taken to be a new version, the other end
+    // moves when the lines are wrapped:
+    const bool isNewVersion = (fromLine == mFromLine || toLine == mToLine);
+    if (!isNewVersion) {
+        release(writer);
+    } else if (mIsWritten && text == mText && data == mData) {
+        // What was written early has not changed since:
+        mFromLine = fromLine;
+        mToLine = toLine;
+        return;
+    }
+
+    mFromLine = fromLine;
+    mToLine = toLine;
+    mText = text;
+    mData = data;
+    mIsWritten = false;
+}
+
+void TLogHeldLines::release(TLogWriter& writer)
+{
+    if (mIsWritten) {
+        return;
+    }
+
+    writer.write(mText);
+    writer.writeData(mData);
+    mIsWritten = true;
+}
@@ -0,0 +1,127 @@
+#ifndef MUDLET_TLOGWRITER_H
+#define MUDLET_TLOGWRITER_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include "post_guard.h"
+
+// Appends the text given to write(...) to a log file from a thread of its own,
+// so that the main thread never waits for the disk: the text is only added to
+// a queue, which the thread writes out in one go - and then flushes to the
+// operating system - whenever csmBatchSize characters have built up or
+// csmFlushInterval milli-seconds have passed, whichever is first.
+//
+// For a binary session log the records given to writeData(...) are queued
+// instead and each batch of them is written as one compressed frame (see
+// TSessionLog).
+//
+// Flushing guarantees:
+// * flush() and close() block until everything written before the call has
+//   been handed to the operating system, which is done when logging is
+//   stopped, when the connection is lost and when the console is destroyed.
+// * If Mudlet crashes no more than the last csmFlushInterval milli-seconds of
+//   text (or csmBatchSize characters) can be lost, as anything older has
+//   already been passed to the operating system, which will still write it.
+class TLogWriter : public QThread
+{
+public:
+    Q_DISABLE_COPY(TLogWriter)
+    TLogWriter();
+    ~TLogWriter();
+
+    enum Mode {
+        Text,
+        CompressedRecords
+    };
+
+    // Opens the file to be added to and starts the thread:
+    bool open(const QString& fileName, Mode mode = Text);
+    void write(const QString& text);
+    // Only for the CompressedRecords mode, the data must hold whole records:
+    void writeData(const QByteArray& records);
+    void flush();
+    // Writes what is left, then stops the thread and closes the file:
+    void close();
+    bool isOpen() const { return isRunning(); }
+    QString errorString() const { return mFile.errorString(); }
+
+    static const int csmBatchSize = 65536;
+    static const unsigned long csmFlushInterval = 1000;
+
+protected:
+    void run() override;
+
+private:
+    QFile mFile;
+    Mode mMode;
+    QMutex mLock;
+    // Wakes the thread when there is a batch to write, a flush is wanted or it
+    // is to stop:
+    QWaitCondition mWakeUp;
+    // Wakes anything waiting in flush() each time a batch has been written:
+    QWaitCondition mWritten;
+    // Everything below is protected by mLock:
+    QString mPending;
+    QByteArray mPendingData;
+    // Counts of the write(...) and writeData(...) calls queued and of those written out, so that
+    // flush() knows what to wait for:
+    quint64 mQueuedCount;
+    quint64 mWrittenCount;
+    bool mIsFlushRequested;
+    bool mIsStopping;
+};
+
+// The lines most recently logged are held back until something else is, as the
+// same lines are logged again when more is added to them (a command echoed
+// after a prompt, say) and only the final version of them is wanted. They are
+// written early by release(), when the log must be complete - e.g. when the
+// connection is lost - and then not again unless they change.
+//
+// The line numbers are session ones (see TBufferSearchRequest), so that lines
+// being trimmed from the buffer in between cannot make different lines look
+// like the same ones.
+class TLogHeldLines
+{
+public:
+    TLogHeldLines() : mFromLine(-1), mToLine(-1), mIsWritten(true) {}
+
+    // Holds these lines back in place of the ones held before, which are
+    // written first unless these are a new version of them:
+    void hold(TLogWriter& writer, int fromLine, int toLine, const QString& text, const QByteArray& data);
+    // Writes what is being held back, if that has not been done already:
+    void release(TLogWriter& writer);
+
+private:
+    int mFromLine;
+    int mToLine;
+    QString mText;
+    QByteArray mData;
+    bool mIsWritten;
+};
+
+#endif // MUDLET_TLOGWRITER_H
@@ -36,9 +36,11 @@
 #include "TDebug.h"
 #include "TEvent.h"
 #include "TForkedProcess.h"
+#include "TJsonToLua.h"
 #include "TMap.h"
 #include "TRoom.h"
 #include "TRoomDB.h"
+#include "TSessionLog.h"
 #include "TTextEdit.h"
 #include "TTimer.h"
 #include "TTrigger.h"
@@ -946,7 +948,8 @@ int TLuaInterpreter::getLines(lua_State* L)
 }
 
 // Should have been called loadReplay(...) but this name is already in the
-// published Lua API
+// published Lua API; the optional second argument is the replay speed as a
+// multiple of the recorded rate, with 0 meaning as fast as possible
 int TLuaInterpreter::loadRawFile(lua_State* L)
 {
     QString replayFileName;
@@ -965,9 +968,19 @@ int TLuaInterpreter::loadRawFile(lua_State* L)
         }
     }
 
+    int speed = 1;
+    if (lua_gettop(L) > 1) {
+        if (!lua_isnumber(L, 2)) {
+            lua_pushfstring(L, "loadRawFile: bad argument #2 type (replay speed as number is optional, got %s!)", luaL_typename(L, 2));
+            return lua_error(L);
+        }
+        speed = qMax(0, static_cast<int>(lua_tointeger(L, 2)));
+    }
+
     Host& host = getHostFromLua(L);
     QString errMsg;
     if (mudlet::self()->loadReplay(&host, replayFileName, &errMsg)) {
+        mudlet::self()->setReplaySpeed(speed);
         lua_pushboolean(L, true);
         return 1;
     } else {
@@ -979,6 +992,26 @@ int TLuaInterpreter::loadRawFile(lua_State* L)
     }
 }
 
+// Moves the replay running in this profile to the given number of seconds from
+// its start, returns the length of the replay in seconds
+int TLuaInterpreter::seekReplay(lua_State* L)
+{
+    if (!lua_isnumber(L, 1)) {
+        lua_pushfstring(L, "seekReplay: bad argument #1 type (time in seconds from start of replay as number expected, got %s!)", luaL_typename(L, 1));
+        return lua_error(L);
+    }
+    const qint64 time = static_cast<qint64>(lua_tonumber(L, 1) * 1000.0);
+
+    Host& host = getHostFromLua(L);
+    if (!host.mTelnet.seekReplay(time)) {
+        lua_pushnil(L);
+        lua_pushstring(L, "no replay is in progress in this profile");
+        return 2;
+    }
+    lua_pushnumber(L, host.mTelnet.replayDuration() / 1000.0);
+    return 1;
+}
+
 int TLuaInterpreter::getCurrentLine(lua_State* L)
 {
     string luaSendText = "";
@@ -1700,6 +1733,36 @@ int TLuaInterpreter::setConsoleBufferSize(lua_State* L)
     return 0;
 }
 
+// When on, the lines trimmed to keep the console to the size given to
+// setConsoleBufferSize(...) are compressed into a temporary file instead of
+// being lost, and are brought back when the console is scrolled up to them:
+int TLuaInterpreter::setConsoleBufferArchived(lua_State* L)
+{
+    QString windowName = QStringLiteral("main");
+    int s = 0;
+    if (lua_gettop(L) > 1) {
+        if (!lua_isstring(L, ++s)) {
+            lua_pushfstring(L, "setConsoleBufferArchived: bad argument #%d type (window name as string is optional, got %s!)", s, luaL_typename(L, s));
+            return lua_error(L);
+        }
+        windowName = QString::fromUtf8(lua_tostring(L, s));
+    }
+    if (!lua_isboolean(L, ++s)) {
+        lua_pushfstring(L, "setConsoleBufferArchived: bad argument #%d type (state as boolean expected, got %s!)", s, luaL_typename(L, s));
+        return lua_error(L);
+    }
+    bool state = lua_toboolean(L, s);
+
+    Host& host = getHostFromLua(L);
+    if (!mudlet::self()->setConsoleBufferArchived(&host, windowName, state)) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "window \"%s\" not found", windowName.toUtf8().constData());
+        return 2;
+    }
+    lua_pushboolean(L, true);
+    return 1;
+}
+
 int TLuaInterpreter::enableScrollBar(lua_State* L)
 {
     int n = lua_gettop(L);
@@ -2347,6 +2410,60 @@ int TLuaInterpreter::killTrigger(lua_State* L)
     return 1;
 }
 
+// Returns an array of the profiles of the triggers that have been active for a
+// line since the profiles were last reset - or only of those with the given
+// name - the most costly first; the times are in milli-seconds:
+int TLuaInterpreter::getTriggerProfile(lua_State* L)
+{
+    QString name;
+    if (lua_gettop(L)) {
+        if (!lua_isstring(L, 1)) {
+            lua_pushfstring(L, "getTriggerProfile: bad argument #1 type (trigger name as string is optional, got %s!)", luaL_typename(L, 1));
+            lua_error(L);
+            return 1;
+        }
+        name = QString::fromUtf8(lua_tostring(L, 1));
+    }
+
+    Host& host = getHostFromLua(L);
+    auto pushNumber = [L](const char* key, const double value) {
+        lua_pushstring(L, key);
+        lua_pushnumber(L, value);
+        lua_rawset(L, -3);
+    };
+    lua_newtable(L);
+    int index = 0;
+    for (auto trigger : host.getTriggerUnit()->profiledTriggers()) {
+        if (!name.isNull() && trigger->getName() != name) {
+            continue;
+        }
+        const TTriggerProfile& profile = trigger->mProfile;
+        lua_pushnumber(L, ++index);
+        lua_newtable(L);
+        lua_pushstring(L, "name");
+        lua_pushstring(L, trigger->getName().toUtf8().constData());
+        lua_rawset(L, -3);
+        pushNumber("id", trigger->getID());
+        pushNumber("evaluations", profile.evaluations);
+        pushNumber("matches", profile.matches);
+        pushNumber("matchTime", profile.matchTime / 1000000.0);
+        pushNumber("maxMatchTime", profile.maxMatchTime / 1000000.0);
+        pushNumber("scriptRuns", profile.scriptRuns);
+        pushNumber("scriptTime", profile.scriptTime / 1000000.0);
+        pushNumber("maxScriptTime", profile.maxScriptTime / 1000000.0);
+        pushNumber("totalTime", profile.totalTime() / 1000000.0);
+        lua_rawset(L, -3);
+    }
+    return 1;
+}
+
+int TLuaInterpreter::resetTriggerProfile(lua_State* L)
+{
+    Host& host = getHostFromLua(L);
+    host.getTriggerUnit()->resetProfiles();
+    return 0;
+}
+
 int TLuaInterpreter::closeMudlet(lua_State* L)
 {
     mudlet::self()->forceClose();
@@ -3168,6 +3285,85 @@ int TLuaInterpreter::startLogging(lua_State* L)
     return 4;
 }
 
+// convertSessionLog(logFile, outputFile [, format [, showTimestamps [, foregroundColor, backgroundColor]]])
+// Renders a binary (".mlog") session log as HTML or plain text; format is "html"
+// or "text" and defaults to "html" unless outputFile ends in ".txt". The two
+// colors (as names, e.g. "#c0c0c0" or "white") replace the default ones that
+// the log was recorded with, to show it with a different theme.
+int TLuaInterpreter::convertSessionLog(lua_State* L)
+{
+    if (!lua_isstring(L, 1)) {
+        lua_pushfstring(L, "convertSessionLog: bad argument #1 type (log file name as string expected, got %s!)", luaL_typename(L, 1));
+        return lua_error(L);
+    }
+    QString logFileName = QString::fromUtf8(lua_tostring(L, 1));
+
+    if (!lua_isstring(L, 2)) {
+        lua_pushfstring(L, "convertSessionLog: bad argument #2 type (output file name as string expected, got %s!)", luaL_typename(L, 2));
+        return lua_error(L);
+    }
+    QString outputFileName = QString::fromUtf8(lua_tostring(L, 2));
+
+    TSessionLogRenderOptions options;
+    options.isHtml = !outputFileName.endsWith(QLatin1String(".txt"), Qt::CaseInsensitive);
+    int n = lua_gettop(L);
+    if (n > 2) {
+        if (!lua_isstring(L, 3)) {
+            lua_pushfstring(L, "convertSessionLog: bad argument #3 type (format as string is optional, got %s!)", luaL_typename(L, 3));
+            return lua_error(L);
+        }
+        QString format = QString::fromUtf8(lua_tostring(L, 3));
+        if (format == QLatin1String("html")) {
+            options.isHtml = true;
+        } else if (format == QLatin1String("text")) {
+            options.isHtml = false;
+        } else {
+            lua_pushnil(L);
+            lua_pushfstring(L, "format \"%s\" is not \"html\" or \"text\"", format.toUtf8().constData());
+            return 2;
+        }
+    }
+    if (n > 3) {
+        if (!lua_isboolean(L, 4)) {
+            lua_pushfstring(L, "convertSessionLog: bad argument #4 type (show timestamps as boolean is optional, got %s!)", luaL_typename(L, 4));
+            return lua_error(L);
+        }
+        options.isTimeStamped = lua_toboolean(L, 4);
+    }
+    if (n > 4) {
+        QColor colors[2];
+        for (int s = 5; s <= 6; ++s) {
+            if (!lua_isstring(L, s)) {
+                lua_pushfstring(L, "convertSessionLog: bad argument #%d type (%s color as string expected, got %s!)", s, s == 5 ? "foreground" : "background", luaL_typename(L, s));
+                return lua_error(L);
+            }
+            colors[s - 5] = QColor(QString::fromUtf8(lua_tostring(L, s)));
+            if (!colors[s - 5].isValid()) {
+                lua_pushnil(L);
+                lua_pushfstring(L, "\"%s\" is not a valid color", lua_tostring(L, s));
+                return 2;
+            }
+        }
+        options.isThemed = true;
+        options.foreground = colors[0].rgb() & 0xffffff;
+        options.background = colors[1].rgb() & 0xffffff;
+    }
+
+    Host& host = getHostFromLua(L);
+    if (host.mpConsole) {
+        options.fontFamily = host.mpConsole->fontInfo().family();
+    }
+
+    QString errorMessage;
+    if (!TSessionLogRenderer::render(logFileName, outputFileName, options, errorMessage)) {
+        lua_pushnil(L);
+        lua_pushstring(L, errorMessage.toUtf8().constData());
+        return 2;
+    }
+    lua_pushboolean(L, true);
+    return 1;
+}
+
 int TLuaInterpreter::setBackgroundImage(lua_State* L)
 {
     string luaSendText = "";
@@ -5506,6 +5702,47 @@ int TLuaInterpreter::getNetworkLatency(lua_State* L)
     return 1;
 }
 
+// Returns a table with an entry for each TConnectionStatistics::Metric, each
+// of which is a table of the count of values and the p50, p99 and max ones
+// measured in the last minute or two - in milli-seconds for the times and in
+// bytes for bytesPerRead:
+int TLuaInterpreter::getConnectionStatistics(lua_State* L)
+{
+    Host& host = getHostFromLua(L);
+    TConnectionStatistics statistics = host.mTelnet.statistics();
+
+    lua_newtable(L);
+    for (int i = 0; i < TConnectionStatistics::MetricCount; ++i) {
+        const auto metric = static_cast<TConnectionStatistics::Metric>(i);
+        TLatencyHistogram& histogram = statistics.histogram(metric);
+        const double scale = TConnectionStatistics::isTime(metric) ? 1000.0 : 1.0;
+
+        lua_pushstring(L, TConnectionStatistics::name(metric).toUtf8().constData());
+        lua_newtable(L);
+        lua_pushstring(L, "count");
+        lua_pushnumber(L, histogram.count());
+        lua_rawset(L, -3);
+        lua_pushstring(L, "p50");
+        lua_pushnumber(L, histogram.percentile(50.0) / scale);
+        lua_rawset(L, -3);
+        lua_pushstring(L, "p99");
+        lua_pushnumber(L, histogram.percentile(99.0) / scale);
+        lua_rawset(L, -3);
+        lua_pushstring(L, "max");
+        lua_pushnumber(L, histogram.maximum() / scale);
+        lua_rawset(L, -3);
+        lua_rawset(L, -3);
+    }
+    return 1;
+}
+
+int TLuaInterpreter::resetConnectionStatistics(lua_State* L)
+{
+    Host& host = getHostFromLua(L);
+    host.mTelnet.resetStatistics();
+    return 0;
+}
+
 int TLuaInterpreter::getMainConsoleWidth(lua_State* L)
 {
     Host& host = getHostFromLua(L);
@@ -6614,8 +6851,8 @@ int TLuaInterpreter::getTimestamp(lua_State* L)
     }
     Host& host = getHostFromLua(L);
     if (name == "") {
-        if (luaLine > 0 && luaLine < host.mpConsole->buffer.timeBuffer.size()) {
-            lua_pushstring(L, host.mpConsole->buffer.timeBuffer.at(luaLine).toLatin1().data());
+        if (luaLine > 0 && luaLine < static_cast<int>(host.mpConsole->buffer.timeBuffer.size())) {
+            lua_pushstring(L, host.mpConsole->buffer.timeStamp(luaLine).toLatin1().data());
         } else {
             lua_pushstring(L, "getTimestamp: invalid line number");
         }
@@ -6625,8 +6862,8 @@ int TLuaInterpreter::getTimestamp(lua_State* L)
     QMap<QString, TConsole*>& dockWindowConsoleMap = mudlet::self()->mHostConsoleMap[&host];
     if (dockWindowConsoleMap.contains(_name)) {
         TConsole* pC = dockWindowConsoleMap[_name];
-        if (luaLine > 0 && luaLine < pC->buffer.timeBuffer.size()) {
-            lua_pushstring(L, pC->buffer.timeBuffer.at(luaLine).toLatin1().data());
+        if (luaLine > 0 && luaLine < static_cast<int>(pC->buffer.timeBuffer.size())) {
+            lua_pushstring(L, pC->buffer.timeStamp(luaLine).toLatin1().data());
         } else {
             lua_pushstring(L, "getTimestamp: invalid line number");
         }
@@ -9957,6 +10194,50 @@ int TLuaInterpreter::setMergeTables(lua_State* L)
     return 0;
 }
 
+int TLuaInterpreter::setCoalesceTables(lua_State* L)
+{
+    Host& host = getHostFromLua(L);
+
+    QStringList modulesList;
+    int n = lua_gettop(L);
+    for (int i = 1; i <= n; i++) {
+        if (!lua_isstring(L, i)) {
+            lua_pushfstring(L, "setCoalesceTables: bad argument #%d (string expected, got %s)", i, luaL_typename(L, i));
+            lua_error(L);
+            return 1;
+        }
+        modulesList << QString(lua_tostring(L, i));
+    }
+
+    host.mGMCP_coalesce_table_keys = host.mGMCP_coalesce_table_keys + modulesList;
+    host.mGMCP_coalesce_table_keys.removeDuplicates();
+
+    return 0;
+}
+
+// With no arguments stops coalescing any GMCP keys, otherwise just the given ones:
+int TLuaInterpreter::resetCoalesceTables(lua_State* L)
+{
+    Host& host = getHostFromLua(L);
+
+    int n = lua_gettop(L);
+    if (!n) {
+        host.mGMCP_coalesce_table_keys.clear();
+        return 0;
+    }
+
+    for (int i = 1; i <= n; i++) {
+        if (!lua_isstring(L, i)) {
+            lua_pushfstring(L, "resetCoalesceTables: bad argument #%d (string expected, got %s)", i, luaL_typename(L, i));
+            lua_error(L);
+            return 1;
+        }
+        host.mGMCP_coalesce_table_keys.removeAll(QString(lua_tostring(L, i)));
+    }
+
+    return 0;
+}
+
 int TLuaInterpreter::pasteWindow(lua_State* L)
 {
     string luaName;
@@ -11190,7 +11471,7 @@ void TLuaInterpreter::setAtcpTable(const QString& var, const QString& arg)
 }
 
 
-void TLuaInterpreter::setGMCPTable(QString& key, const QString& string_data)
+void TLuaInterpreter::setGMCPTable(QString& key, const QString& string_data, const bool isEventRaised)
 {
     lua_State* L = pGlobalLua;
     lua_getglobal(L, "gmcp"); //defined in Lua init
@@ -11203,7 +11484,7 @@ void TLuaInterpreter::setGMCPTable(QString& key, const QString& string_data)
             return;
         }
     }
-    parseJSON(key, string_data, "gmcp");
+    parseJSON(key, string_data, "gmcp", isEventRaised);
 }
 void TLuaInterpreter::setMSDPTable(QString& key, const QString& string_data)
 {
@@ -11222,112 +11503,62 @@ void TLuaInterpreter::setMSDPTable(QString& key, const QString& string_data)
     parseJSON(key, string_data, "msdp");
 }
 
-void TLuaInterpreter::parseJSON(QString& key, const QString& string_data, const QString& protocol)
+void TLuaInterpreter::parseJSON(QString& key, const QString& string_data, const QString& protocol, const bool isEventRaised)
 {
     // key is in format of Blah.Blah or Blah.Blah.Bleh - we want to push & pre-create the tables as appropriate
     lua_State* L = pGlobalLua;
     QStringList tokenList = key.split(".");
-    if (!lua_checkstack(L, tokenList.size() + 5)) {
+    // Converted once here rather than every time each one is used below:
+    const QList<QByteArray> utf8TokenList = key.toUtf8().split('.');
+    if (!lua_checkstack(L, 5)) {
         return;
     }
     int i = 0;
-    for (; i < tokenList.size() - 1; i++) {
-        lua_getfield(L, -1, tokenList.at(i).toUtf8().constData());
+    for (; i < utf8TokenList.size() - 1; i++) {
+        const QByteArray& token = utf8TokenList.at(i);
+        lua_pushlstring(L, token.constData(), token.size());
+        lua_rawget(L, -2);
         if (!lua_istable(L, -1)) {
             lua_pop(L, 1);
-            lua_pushstring(L, tokenList.at(i).toUtf8().constData());
             lua_newtable(L);
-            lua_rawset(L, -3);
-            lua_getfield(L, -1, tokenList.at(i).toUtf8().constData());
+            lua_pushlstring(L, token.constData(), token.size());
+            lua_pushvalue(L, -2);
+            lua_rawset(L, -4);
         }
         lua_remove(L, -2);
     }
-    bool __needMerge = false;
-    lua_getfield(L, -1, tokenList.at(i).toUtf8().constData());
-    if (lua_istable(L, -1)) {
-        // only merge tables (instead of replacing them) if the key has been registered as a need to merge key by the user default is Char.Status only
-        if (mpHost->mGMCP_merge_table_keys.contains(key)) {
-            __needMerge = true;
-        }
-    }
-    lua_pop(L, 1);
-    if (!__needMerge) {
-        lua_pushstring(L, tokenList.at(i).toUtf8().constData());
-    } else {
-        lua_pushstring(L, "__needMerge");
-    }
-
-    lua_getglobal(L, "json_to_value");
 
-    if (!lua_isfunction(L, -1)) {
-        lua_settop(L, 0);
-        qDebug() << "CRITICAL ERROR: json_to_value not defined";
-        return;
-    }
-    auto dataInUtf8 = string_data.toUtf8();
-    lua_pushlstring(L, dataInUtf8.constData(), dataInUtf8.length());
-    int error = lua_pcall(L, 1, 1, 0);
-    if (error == 0) {
-        // Top of stack should now contain the lua representation of json.
-        lua_rawset(L, -3);
-        if (__needMerge) {
-            lua_settop(L, 0);
-            lua_getglobal(L, "__gmcp_merge_gmcp_sub_tables");
-            if (!lua_isfunction(L, -1)) {
-                lua_settop(L, 0);
-                qDebug() << "CRITICAL ERROR: __gmcp_merge_gmcp_sub_tables is not defined in lua_LuaGlobal.lua";
-                return;
-            }
-            lua_getglobal(L, "gmcp");
-            i = 0;
-            for (; i < tokenList.size() - 1; i++) {
-                lua_getfield(L, -1, tokenList.at(i).toUtf8().constData());
-                lua_remove(L, -2);
-            }
-            lua_pushstring(L, tokenList.at(i).toUtf8().constData());
-            lua_pcall(L, 2, 0, 0);
+    // The JSON is decoded natively, straight onto the stack, rather than by
+    // calling the Lua json_to_value function:
+    const QByteArray dataInUtf8 = string_data.toUtf8();
+    QString errorMessage;
+    TJsonToLua decoder(L);
+    if (decoder.push(dataInUtf8.constData(), static_cast<size_t>(dataInUtf8.size()), errorMessage)) {
+        const QByteArray& lastToken = utf8TokenList.at(i);
+        lua_pushlstring(L, lastToken.constData(), lastToken.size());
+        lua_rawget(L, -3);
+        // only merge tables (instead of replacing them) if the key has been registered as a need to merge key by the user default is Char.Status only
+        if (lua_istable(L, -1) && lua_istable(L, -2) && mpHost->mGMCP_merge_table_keys.contains(key)) {
+            TJsonToLua::mergeTable(L, -1, -2);
+        } else {
+            lua_pop(L, 1);
+            lua_pushlstring(L, lastToken.constData(), lastToken.size());
+            lua_insert(L, -2);
+            lua_rawset(L, -3);
         }
     } else {
-        {
-            string e;
-            if (lua_isstring(L, -1)) {
-                e = "Lua error:";
-                e += lua_tostring(L, -1);
-            }
-            QString _n = "JSON decoder error:";
-            QString _f = "json_to_value";
-            logError(e, _n, _f);
-        }
+        string e = "JSON decoder error: ";
+        e += errorMessage.toUtf8().constData();
+        QString _n = "JSON decoder error:";
+        QString _f = QStringLiteral("%1 message %2").arg(protocol, key);
+        logError(e, _n, _f);
     }
     lua_settop(L, 0);
 
-    // events: for key "foo.bar.top" we raise: gmcp.foo, gmcp.foo.bar and gmcp.foo.bar.top
-    // with the actual key given as parameter e.g. event=gmcp.foo, param="gmcp.foo.bar"
-
-    QString token = protocol;
-    if (protocol == "msdp") {
-        key.prepend("msdp.");
-    } else {
-        key.prepend("gmcp.");
+    if (isEventRaised) {
+        raiseProtocolEvents(protocol, key);
     }
 
-    for (int k = 0; k < tokenList.size(); k++) {
-        TEvent event;
-        token.append(".");
-        token.append(tokenList[k]);
-        event.mArgumentList.append(token);
-        event.mArgumentTypeList.append(ARGUMENT_TYPE_STRING);
-        event.mArgumentList.append(key);
-        event.mArgumentTypeList.append(ARGUMENT_TYPE_STRING);
-        Host& host = getHostFromLua(L);
-        if (mudlet::debugMode) {
-            QString msg = QString("\n%1 event <").arg(protocol);
-            msg.append(token);
-            msg.append(QString("> display(%1) to see the full content\n").arg(protocol));
-            host.mpConsole->printSystemMessage(msg);
-        }
-        host.raiseEvent(event);
-    }
     // auto-detect IRE composer
     if (tokenList.size() == 3 && tokenList.at(0) == "IRE" && tokenList.at(1) == "Composer" && tokenList.at(2) == "Edit") {
         QRegularExpression rx(QStringLiteral(R"lit(\{ "title": "(.*)", "text": "(.*)" \})lit"));
@@ -11351,6 +11582,33 @@ void TLuaInterpreter::parseJSON(QString& key, const QString& string_data, const
     lua_pop(L, lua_gettop(L));
 }
 
+// events: for key "foo.bar.top" we raise: gmcp.foo, gmcp.foo.bar and gmcp.foo.bar.top
+// with the actual key given as parameter e.g. event=gmcp.foo, param="gmcp.foo.bar"
+void TLuaInterpreter::raiseProtocolEvents(const QString& protocol, const QString& key)
+{
+    const QStringList tokenList = key.split(QLatin1Char('.'));
+    const QString fullKey = QStringLiteral("%1.%2").arg(protocol, key);
+    Host& host = getHostFromLua(pGlobalLua);
+
+    QString token = protocol;
+    for (int k = 0; k < tokenList.size(); k++) {
+        TEvent event;
+        token.append(".");
+        token.append(tokenList[k]);
+        event.mArgumentList.append(token);
+        event.mArgumentTypeList.append(ARGUMENT_TYPE_STRING);
+        event.mArgumentList.append(fullKey);
+        event.mArgumentTypeList.append(ARGUMENT_TYPE_STRING);
+        if (mudlet::debugMode) {
+            QString msg = QString("\n%1 event <").arg(protocol);
+            msg.append(token);
+            msg.append(QString("> display(%1) to see the full content\n").arg(protocol));
+            host.mpConsole->printSystemMessage(msg);
+        }
+        host.raiseEvent(event);
+    }
+}
+
 #define BUFFER_SIZE 20000
 void TLuaInterpreter::msdp2Lua(char* src, int srclen)
 {
@@ -12121,6 +12379,8 @@ void TLuaInterpreter::initLuaGlobals()
     lua_register(pGlobalLua, "enableTrigger", TLuaInterpreter::enableTrigger);
     lua_register(pGlobalLua, "disableTrigger", TLuaInterpreter::disableTrigger);
     lua_register(pGlobalLua, "killTrigger", TLuaInterpreter::killTrigger);
+    lua_register(pGlobalLua, "getTriggerProfile", TLuaInterpreter::getTriggerProfile);
+    lua_register(pGlobalLua, "resetTriggerProfile", TLuaInterpreter::resetTriggerProfile);
     lua_register(pGlobalLua, "getLineCount", TLuaInterpreter::getLineCount);
     lua_register(pGlobalLua, "getColumnNumber", TLuaInterpreter::getColumnNumber);
     lua_register(pGlobalLua, "send", TLuaInterpreter::sendRaw);
@@ -12139,6 +12399,8 @@ void TLuaInterpreter::initLuaGlobals()
     lua_register(pGlobalLua, "moveCursorEnd", TLuaInterpreter::moveCursorEnd);
     lua_register(pGlobalLua, "getLastLineNumber", TLuaInterpreter::getLastLineNumber);
     lua_register(pGlobalLua, "getNetworkLatency", TLuaInterpreter::getNetworkLatency);
+    lua_register(pGlobalLua, "getConnectionStatistics", TLuaInterpreter::getConnectionStatistics);
+    lua_register(pGlobalLua, "resetConnectionStatistics", TLuaInterpreter::resetConnectionStatistics);
     lua_register(pGlobalLua, "createMiniConsole", TLuaInterpreter::createMiniConsole);
     lua_register(pGlobalLua, "createLabel", TLuaInterpreter::createLabel);
     lua_register(pGlobalLua, "raiseWindow", TLuaInterpreter::raiseWindow);
@@ -12176,6 +12438,7 @@ void TLuaInterpreter::initLuaGlobals()
     lua_register(pGlobalLua, "showToolBar", TLuaInterpreter::showToolBar);
     lua_register(pGlobalLua, "hideToolBar", TLuaInterpreter::hideToolBar);
     lua_register(pGlobalLua, "loadRawFile", TLuaInterpreter::loadRawFile);
+    lua_register(pGlobalLua, "seekReplay", TLuaInterpreter::seekReplay);
     lua_register(pGlobalLua, "setBold", TLuaInterpreter::setBold);
     lua_register(pGlobalLua, "setItalics", TLuaInterpreter::setItalics);
     lua_register(pGlobalLua, "setUnderline", TLuaInterpreter::setUnderline);
@@ -12202,9 +12465,11 @@ void TLuaInterpreter::initLuaGlobals()
     lua_register(pGlobalLua, "setBorderRight", TLuaInterpreter::setBorderRight);
     lua_register(pGlobalLua, "setBorderColor", TLuaInterpreter::setBorderColor);
     lua_register(pGlobalLua, "setConsoleBufferSize", TLuaInterpreter::setConsoleBufferSize);
+    lua_register(pGlobalLua, "setConsoleBufferArchived", TLuaInterpreter::setConsoleBufferArchived);
     lua_register(pGlobalLua, "enableScrollBar", TLuaInterpreter::enableScrollBar);
     lua_register(pGlobalLua, "disableScrollBar", TLuaInterpreter::disableScrollBar);
     lua_register(pGlobalLua, "startLogging", TLuaInterpreter::startLogging);
+    lua_register(pGlobalLua, "convertSessionLog", TLuaInterpreter::convertSessionLog);
     lua_register(pGlobalLua, "calcFontSize", TLuaInterpreter::calcFontSize);
     lua_register(pGlobalLua, "permRegexTrigger", TLuaInterpreter::permRegexTrigger);
     lua_register(pGlobalLua, "permSubstringTrigger", TLuaInterpreter::permSubstringTrigger);
@@ -12354,6 +12619,8 @@ void TLuaInterpreter::initLuaGlobals()
     lua_register(pGlobalLua, "getExitWeights", TLuaInterpreter::getExitWeights);
     lua_register(pGlobalLua, "addSupportedTelnetOption", TLuaInterpreter::addSupportedTelnetOption);
     lua_register(pGlobalLua, "setMergeTables", TLuaInterpreter::setMergeTables);
+    lua_register(pGlobalLua, "setCoalesceTables", TLuaInterpreter::setCoalesceTables);
+    lua_register(pGlobalLua, "resetCoalesceTables", TLuaInterpreter::resetCoalesceTables);
     lua_register(pGlobalLua, "getModulePath", TLuaInterpreter::getModulePath);
     lua_register(pGlobalLua, "getAreaExits", TLuaInterpreter::getAreaExits);
     lua_register(pGlobalLua, "auditAreas", TLuaInterpreter::auditAreas);
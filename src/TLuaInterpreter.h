@@ -72,7 +72,8 @@ public:
     TLuaInterpreter(Host* mpHost, int id);
     ~TLuaInterpreter();
     void setMSDPTable(QString& key, const QString& string_data);
-    void parseJSON(QString& key, const QString& string_data, const QString& protocol);
+    void parseJSON(QString& key, const QString& string_data, const QString& protocol, const bool isEventRaised = true);
+    void raiseProtocolEvents(const QString& protocol, const QString& key);
     void msdp2Lua(char* src, int srclen);
     void initLuaGlobals();
     void initIndenterGlobals();
@@ -84,7 +85,7 @@ public:
     bool compile(const QString& code, QString& error, const QString& name);
     bool compileScript(const QString&);
     void setAtcpTable(const QString&, const QString&);
-    void setGMCPTable(QString&, const QString&);
+    void setGMCPTable(QString&, const QString&, const bool isEventRaised = true);
     void setChannel102Table(int& var, int& arg);
     bool compileAndExecuteScript(const QString&);
     QString formatLuaCode(const QString &);
@@ -128,6 +129,8 @@ public:
     static int auditAreas(lua_State*);
     static int getAreaExits(lua_State*);
     static int setMergeTables(lua_State* L);
+    static int setCoalesceTables(lua_State* L);
+    static int resetCoalesceTables(lua_State* L);
     static int addSupportedTelnetOption(lua_State*);
     static int setDoor(lua_State*);
     static int getDoors(lua_State*);
@@ -268,6 +271,8 @@ public:
     static int tempButton(lua_State* L);
     static int tempComplexRegexTrigger(lua_State* L);
     static int killTrigger(lua_State* L);
+    static int getTriggerProfile(lua_State* L);
+    static int resetTriggerProfile(lua_State* L);
     static int getLineCount(lua_State* L);
     static int getLineNumber(lua_State* L);
     static int getColumnNumber(lua_State* L);
@@ -295,6 +300,8 @@ public:
     static int moveCursorEnd(lua_State*);
     static int getLastLineNumber(lua_State*);
     static int getNetworkLatency(lua_State*);
+    static int getConnectionStatistics(lua_State*);
+    static int resetConnectionStatistics(lua_State*);
     static int appendBuffer(lua_State*);
     static int createBuffer(lua_State*);
     static int raiseWindow(lua_State*);
@@ -332,6 +339,7 @@ public:
     static int showToolBar(lua_State*);
     static int hideToolBar(lua_State*);
     static int loadRawFile(lua_State*);
+    static int seekReplay(lua_State*);
     static int setBold(lua_State*);
     static int setItalics(lua_State*);
     static int setUnderline(lua_State*);
@@ -355,9 +363,11 @@ public:
     static int setBorderRight(lua_State*);
     static int setBorderColor(lua_State*);
     static int setConsoleBufferSize(lua_State*);
+    static int setConsoleBufferArchived(lua_State*);
     static int enableScrollBar(lua_State*);
     static int disableScrollBar(lua_State*);
     static int startLogging(lua_State* L);
+    static int convertSessionLog(lua_State*);
     static int calcFontWidth(int size);
     static int calcFontHeight(int size);
     static int calcFontSize(lua_State*);
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TRegex.h"
+
+
+#include "TBenchmark.h"
+
+#include "pre_guard.h"
+#include <QMutexLocker>
+#include "post_guard.h"
+
+// The JIT stack grows as needed from the first size up to the second:
+static const int scmJitStackStartSize = 32 * 1024;
+static const int scmJitStackMaximumSize = 1024 * 1024;
+
+bool TRegex::smIsJitEnabled = true;
+QMutex TRegex::smCacheMutex;
+QHash<QPair<QString, int>, QWeakPointer<TRegex>> TRegex::smCache;
+int TRegex::smCachePruneSize = 256;
+
+TRegexJitStack::TRegexJitStack()
+: mpStack(nullptr)
+{
+#if defined(PCRE_STUDY_JIT_COMPILE)
+    mpStack = pcre_jit_stack_alloc(scmJitStackStartSize, scmJitStackMaximumSize);
+#endif
+}
+
+TRegexJitStack::~TRegexJitStack()
+{
+#if defined(PCRE_STUDY_JIT_COMPILE)
+    if (mpStack) {
+        pcre_jit_stack_free(static_cast<pcre_jit_stack*>(mpStack));
+    }
+#endif
+}
+
+TRegex::~TRegex()
+{
+    if (mpExtra) {
+#if defined(PCRE_STUDY_JIT_COMPILE)
+        pcre_free_study(mpExtra);
+#else
+        pcre_free(mpExtra);
+#endif
+    }
+    pcre_free(mpCode);
+}
+
+QSharedPointer<TRegex> TRegex::compile(const QString& pattern, const int options, QString& errorMessage)
+{
+    QMutexLocker locker(&smCacheMutex);
+    const QPair<QString, int> key(pattern, options);
+    QSharedPointer<TRegex> regex = smCache.value(key).toStrongRef();
+    if (regex) {
+        return regex;
+    }
+
+    const char* error = nullptr;
+    int errorOffset = 0;
+    pcre* pCode = pcre_compile(pattern.toUtf8().constData(), options, &error, &errorOffset, nullptr);
+    if (!pCode) {
+        errorMessage = QString::fromUtf8(error);
+        return QSharedPointer<TRegex>();
+    }
+
+    pcre_extra* pExtra = nullptr;
+    if (smIsJitEnabled) {
+#if defined(PCRE_STUDY_JIT_COMPILE)
+        pExtra = pcre_study(pCode, PCRE_STUDY_JIT_COMPILE, &error);
+#else
+        pExtra = pcre_study(pCode, 0, &error);
+#endif
+        // A failure to study is not an error, the regex still works without:
+    }
+    regex = QSharedPointer<TRegex>(new TRegex(pCode, pExtra));
+
+    if (smCache.size() >= smCachePruneSize) {
+        for (auto it = smCache.begin(); it != smCache.end();) {
+            if (it.value().isNull()) {
+                it = smCache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        smCachePruneSize = qMax(256, smCache.size() * 2);
+    }
+    smCache.insert(key, regex);
+    return regex;
+}
+
+int TRegex::exec(const char* subject, const int length, const int startOffset, const int options, int* ovector, const int ovectorSize, const TRegexJitStack* pJitStack) const
+{
+    TBenchmarkScope scope(TBenchmark::Regex);
+    TBenchmark::addRegexRun();
+#if defined(PCRE_STUDY_JIT_COMPILE)
+    if (mpExtra && pJitStack && pJitStack->mpStack) {
+        pcre_assign_jit_stack(mpExtra, nullptr, static_cast<pcre_jit_stack*>(pJitStack->mpStack));
+    }
+#else
+    Q_UNUSED(pJitStack);
+#endif
+    return pcre_exec(mpCode, mpExtra, subject, length, startOffset, options, ovector, ovectorSize);
+}
@@ -0,0 +1,100 @@
+#ifndef MUDLET_TREGEX_H
+#define MUDLET_TREGEX_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSharedPointer>
+#include <QString>
+#include <QWeakPointer>
+#include "post_guard.h"
+
+#include <pcre.h>
+
+
+// A stack for the JIT compiled code of the regexes to use whilst matching,
+// each TriggerUnit and AliasUnit has its own so that a deeply recursive
+// pattern does not run out of the small one that PCRE uses otherwise:
+class TRegexJitStack
+{
+public:
+    TRegexJitStack();
+    ~TRegexJitStack();
+
+private:
+    Q_DISABLE_COPY(TRegexJitStack)
+    friend class TRegex;
+
+
+    // Actually a pcre_jit_stack*, but that type is not in older PCREs:
+    void* mpStack;
+};
+
+
+// A compiled PCRE regex together with its study data, which includes the JIT
+// compiled code for it when the PCRE library supports that.
+//
+// They are shared: compiling a pattern (with the same options) that is
+// already held by any trigger or alias - of any profile - gives the same one
+// back rather than compiling it again; it is freed once nothing holds it. As
+// the study data holds the JIT stack to use, they must only be matched from
+// the main thread.
+class TRegex
+{
+public:
+    ~TRegex();
+
+    // Returns a null pointer, with PCRE's reason in errorMessage, if the
+    // pattern does not compile:
+    static QSharedPointer<TRegex> compile(const QString& pattern, int options, QString& errorMessage);
+
+    // The same as pcre_exec(...) but with the study data (and the given JIT
+    // stack, if any) - and timed as the Regex stage of a benchmark:
+    int exec(const char* subject, int length, int startOffset, int options, int* ovector, int ovectorSize, const TRegexJitStack* pJitStack = nullptr) const;
+    int fullInfo(int what, void* where) const { return pcre_fullinfo(mpCode, mpExtra, what, where); }
+
+    // Only affects regexes compiled afterwards; turning it off goes back to
+    // compiling them without any study data so that a benchmark can compare
+    // the two:
+    static void setJitEnabled(bool isEnabled) { smIsJitEnabled = isEnabled; }
+    static bool isJitEnabled() { return smIsJitEnabled; }
+
+private:
+    Q_DISABLE_COPY(TRegex)
+    TRegex(pcre* pCode, pcre_extra* pExtra) : mpCode(pCode), mpExtra(pExtra) {}
+
+
+    pcre* mpCode;
+    pcre_extra* mpExtra;
+
+    static bool smIsJitEnabled;
+    static QMutex smCacheMutex;
+    // Keyed by the pattern and the options:
+    static QHash<QPair<QString, int>, QWeakPointer<TRegex>> smCache;
+    // Entries whose regex has been freed are only cleared out when the cache
+    // grows past this:
+    static int smCachePruneSize;
+};
+
+#endif // MUDLET_TREGEX_H
@@ -0,0 +1,1267 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TRegexSet.h"
+
+
+#include "pre_guard.h"
+#include <QRegularExpression>
+#include <QStringList>
+#include "post_guard.h"
+
+#include <algorithm>
+#include <iterator>
+
+const int TRegexSet::csmMaxNodesPerPattern;
+const int TRegexSet::csmMaxRepeatCount;
+const int TRegexSet::csmMaxDfaStates;
+
+// How deeply groups can be nested before a regex is given up on:
+static const int scmMaxGroupDepth = 200;
+
+// Parses a regex into a tree and then makes the NFA nodes for it, anything
+// that it does not know how to handle makes it fail rather than guess:
+class TRegexSet::Parser
+{
+public:
+    Parser(TRegexSet& set, const QString& regex)
+    : mSet(set)
+    , mRegex(regex)
+    , mPos(0)
+    , mDepth(0)
+    , mIsCaseless(false)
+    , mIsMultiline(false)
+    , mHasFailed(false)
+    , mFirstNode(0)
+    {
+    }
+
+    // Returns the first node of the NFA for the regex - which leads to the
+    // given node when it matches - or -1 if it cannot be handled:
+    int compile(int matchNode);
+
+private:
+    struct Ast
+    {
+        enum Type {
+            Empty,
+            Char,
+            Class,
+            Any,
+            Begin,
+            End,
+            Concat,
+            Alternation,
+            Repeat
+        };
+
+        Type type;
+        bool isCaseless;
+        ushort c;
+        int classIndex;
+        // For a Repeat, a maximum of -1 is unlimited:
+        int min;
+        int max;
+        std::vector<int> children;
+    };
+
+    int newAst(Ast::Type type);
+    int newChar(ushort c);
+    int newRepeat(int child, int min, int max);
+    int anyString() { return newRepeat(newAst(Ast::Any), 0, -1); }
+    int fail()
+    {
+        mHasFailed = true;
+        return newAst(Ast::Empty);
+    }
+
+    ushort peek(const int offset = 0) const { return mPos + offset < mRegex.size() ? mRegex.at(mPos + offset).unicode() : 0; }
+    bool isAtEnd() const { return mPos >= mRegex.size(); }
+    static bool isDigit(const ushort c) { return c >= '0' && c <= '9'; }
+    static bool isLetterOrDigit(const ushort c) { return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+    int parseAlternation();
+    int parseSequence();
+    int parseAtom();
+    int parseGroup();
+    int parseEscape();
+    void parseQuote(std::vector<int>& items);
+    int parseClass();
+    int parseClassEscape(CharClass& charClass);
+    int parseCharacterCode(ushort letter);
+    bool parseQuantifier(int& min, int& max);
+    bool isQuantifierNext() const;
+    bool isRepeatNext() const;
+    bool skipPast(ushort end);
+    bool skipPropertyName();
+
+    int emit(int ast, int next);
+    int newNode(Node::Type type, int out, int out2 = -1);
+
+
+    TRegexSet& mSet;
+    const QString& mRegex;
+    int mPos;
+    int mDepth;
+    bool mIsCaseless;
+    bool mIsMultiline;
+    bool mHasFailed;
+    size_t mFirstNode;
+    std::vector<Ast> mAsts;
+};
+
+int TRegexSet::Parser::newAst(const Ast::Type type)
+{
+    Ast ast;
+    ast.type = type;
+    ast.isCaseless = mIsCaseless;
+    ast.c = 0;
+    ast.classIndex = -1;
+    ast.min = 0;
+    ast.max = 0;
+    mAsts.push_back(ast);
+    return static_cast<int>(mAsts.size()) - 1;
+}
+
+int TRegexSet::Parser::newChar(const ushort c)
+{
+    if (QChar::isSurrogate(c)) {
+        return fail();
+    }
+    const int ast = newAst(Ast::Char);
+    mAsts[static_cast<size_t>(ast)].c = c;
+    return ast;
+}
+
+int TRegexSet::Parser::newRepeat(const int child, const int min, const int max)
+{
+    const int ast = newAst(Ast::Repeat);
+    mAsts[static_cast<size_t>(ast)].children.push_back(child);
+    mAsts[static_cast<size_t>(ast)].min = min;
+    mAsts[static_cast<size_t>(ast)].max = max;
+    return ast;
+}
+
+int TRegexSet::Parser::compile(const int matchNode)
+{
+    mFirstNode = mSet.mNodes.size();
+    const int root = parseAlternation();
+    if (mHasFailed || !isAtEnd()) {
+        // The only thing that stops the top level early is a ')' too many:
+        return -1;
+    }
+    const int start = emit(root, matchNode);
+    return mHasFailed ? -1 : start;
+}
+
+int TRegexSet::Parser::parseAlternation()
+{
+    if (++mDepth > scmMaxGroupDepth) {
+        return fail();
+    }
+    std::vector<int> alternatives{parseSequence()};
+    while (!mHasFailed && peek() == '|') {
+        ++mPos;
+        alternatives.push_back(parseSequence());
+    }
+    --mDepth;
+    if (alternatives.size() == 1) {
+        return alternatives.front();
+    }
+    const int ast = newAst(Ast::Alternation);
+    mAsts[static_cast<size_t>(ast)].children = alternatives;
+    return ast;
+}
+
+int TRegexSet::Parser::parseSequence()
+{
+    std::vector<int> items;
+    while (!mHasFailed && !isAtEnd() && peek() != '|' && peek() != ')') {
+        if (peek() == '\\' && (peek(1) == 'Q' || peek(1) == 'E')) {
+            parseQuote(items);
+            continue;
+        }
+        int item = parseAtom();
+        int min;
+        int max;
+        if (!mHasFailed && parseQuantifier(min, max)) {
+            item = newRepeat(item, min, max);
+        }
+        items.push_back(item);
+    }
+    const int ast = newAst(Ast::Concat);
+    mAsts[static_cast<size_t>(ast)].children = items;
+    return ast;
+}
+
+int TRegexSet::Parser::parseAtom()
+{
+    const ushort c = peek();
+    switch (c) {
+    case '(':
+        return parseGroup();
+    case '[':
+        return parseClass();
+    case '\\':
+        return parseEscape();
+    case '.':
+        // Taken as matching a newline as well, as it does with (?s):
+        ++mPos;
+        return newAst(Ast::Any);
+    case '^':
+        ++mPos;
+        return newAst(mIsMultiline ? Ast::Empty : Ast::Begin);
+    case '$':
+        ++mPos;
+        return newAst(mIsMultiline ? Ast::Empty : Ast::End);
+    case '*':
+    case '+':
+    case '?':
+        // Nothing to repeat, PCRE will not compile it either:
+        return fail();
+    case '{':
+        if (isQuantifierNext()) {
+            return fail();
+        }
+        ++mPos;
+        return newChar(c);
+    default:
+        ++mPos;
+        return newChar(c);
+    }
+}
+
+int TRegexSet::Parser::parseGroup()
+{
+    // Skip the '(':
+    ++mPos;
+    bool isLookAround = false;
+    if (peek() == '*') {
+        // A verb, such as (*UTF8) or (*SKIP):
+        return fail();
+    }
+
+    if (peek() == '?') {
+        ++mPos;
+        const ushort c = peek();
+        if (c == ':' || c == '|' || c == '>') {
+            // Non-capturing, branch reset and atomic groups are all just
+            // groups as far as what they can match goes:
+            ++mPos;
+        } else if (c == '=' || c == '!') {
+            ++mPos;
+            isLookAround = true;
+        } else if (c == '<' && (peek(1) == '=' || peek(1) == '!')) {
+            mPos += 2;
+            isLookAround = true;
+        } else if (c == '<' || c == '\'') {
+            // A named group:
+            if (!skipPast(c == '<' ? '>' : '\'')) {
+                return fail();
+            }
+        } else if (c == 'P' && peek(1) == '<') {
+            if (!skipPast('>')) {
+                return fail();
+            }
+        } else if (c == 'P' && peek(1) == '=') {
+            // A back reference by name:
+            if (!skipPast(')')) {
+                return fail();
+            }
+            return anyString();
+        } else if (c == '#') {
+            // A comment, which is skipped so that a quantifier after it
+            // would apply to what came before, as after an option setting:
+            if (!skipPast(')') || isRepeatNext()) {
+                return fail();
+            }
+            return newAst(Ast::Empty);
+        } else {
+            // Option settings - anything else (recursion, conditions,
+            // callouts...) cannot be handled. Options that are turned on are
+            // left on to the end of the regex, even though PCRE turns them off
+            // at the end of the group, as that only makes this match more:
+            bool isTurningOff = false;
+            forever {
+                const ushort option = peek();
+                ++mPos;
+                if (option == ')') {
+                    return isRepeatNext() ? fail() : newAst(Ast::Empty);
+                }
+                if (option == ':') {
+                    break;
+                }
+                switch (option) {
+                case '-':
+                    isTurningOff = true;
+                    break;
+                case 'i':
+                    mIsCaseless = mIsCaseless || !isTurningOff;
+                    break;
+                case 'm':
+                    mIsMultiline = mIsMultiline || !isTurningOff;
+                    break;
+                case 'x':
+                    if (!isTurningOff) {
+                        // Extended mode changes what everything else means:
+                        return fail();
+                    }
+                    break;
+                case 's':
+                case 'U':
+                case 'J':
+                case 'X':
+                    // These make no difference to what can match here:
+                    break;
+                default:
+                    return fail();
+                }
+            }
+        }
+    }
+
+    const int content = parseAlternation();
+    if (mHasFailed || peek() != ')') {
+        return fail();
+    }
+    ++mPos;
+    // A look-around is taken as always passing:
+    return isLookAround ? newAst(Ast::Empty) : content;
+}
+
+int TRegexSet::Parser::parseEscape()
+{
+    // Skip the '\':
+    ++mPos;
+    if (isAtEnd()) {
+        return fail();
+    }
+    const ushort c = peek();
+    ++mPos;
+    switch (c) {
+    case 'd':
+    case 'D':
+    case 'w':
+    case 'W':
+    case 's':
+    case 'S': {
+        CharClass charClass;
+        mPos -= 2;
+        parseClassEscape(charClass);
+        const int ast = newAst(Ast::Class);
+        mAsts[static_cast<size_t>(ast)].classIndex = static_cast<int>(mSet.mClasses.size());
+        mSet.mClasses.push_back(charClass);
+        return ast;
+    }
+    case 'p':
+    case 'P':
+        if (!skipPropertyName()) {
+            return fail();
+        }
+    // Fall-through
+    case 'h':
+    case 'H':
+    case 'v':
+    case 'V':
+    case 'N':
+        // Some single character:
+        return newAst(Ast::Any);
+    case 'X':
+        return newRepeat(newAst(Ast::Any), 1, -1);
+    case 'R':
+        return newRepeat(newAst(Ast::Any), 1, 2);
+    case 'b':
+    case 'B':
+    case 'G':
+    case 'K':
+        return newAst(Ast::Empty);
+    case 'A':
+        return newAst(Ast::Begin);
+    case 'z':
+    case 'Z':
+        return newAst(Ast::End);
+    case 'g':
+        if (peek() == '<' || peek() == '\'') {
+            // A subroutine call:
+            return fail();
+        }
+        if (peek() == '{') {
+            if (!skipPast('}')) {
+                return fail();
+            }
+            return anyString();
+        }
+        if (peek() == '-' || peek() == '+') {
+            ++mPos;
+        }
+        if (!isDigit(peek())) {
+            return fail();
+        }
+        while (isDigit(peek())) {
+            ++mPos;
+        }
+        return anyString();
+    case 'k':
+        if (!(peek() == '<' ? skipPast('>') : peek() == '\'' ? skipPast('\'') : peek() == '{' ? skipPast('}') : false)) {
+            return fail();
+        }
+        return anyString();
+    default:
+        if (c >= '1' && c <= '9') {
+            // Outside of a class, a back reference - or, if there are not that many groups, an
+            // octal character code, either of which this covers:
+            while (isDigit(peek())) {
+                ++mPos;
+            }
+            return anyString();
+        }
+        const int code = parseCharacterCode(c);
+        if (code < 0) {
+            return fail();
+        }
+        return newChar(static_cast<ushort>(code));
+    }
+}
+
+// For a \Q...\E quote - or a lone \E, which is ignored - with the position at
+// the '\'. The quoted characters are added to the sequence one at a time, as
+// a quantifier after the quote only applies to the last of them. One after an
+// empty quote or a lone \E would apply to whatever came before it, which is
+// not worth keeping track of for something that odd:
+void TRegexSet::Parser::parseQuote(std::vector<int>& items)
+{
+    const bool isQuote = peek(1) == 'Q';
+    mPos += 2;
+    bool isEmpty = true;
+    if (isQuote) {
+        int end = mRegex.indexOf(QLatin1String("\\E"), mPos);
+        if (end < 0) {
+            end = mRegex.size();
+        }
+        for (; mPos < end; ++mPos) {
+            items.push_back(newChar(mRegex.at(mPos).unicode()));
+            isEmpty = false;
+        }
+        mPos = qMin(end + 2, mRegex.size());
+    }
+
+    int min;
+    int max;
+    if (isEmpty) {
+        if (isRepeatNext()) {
+            fail();
+        }
+    } else if (!mHasFailed && parseQuantifier(min, max)) {
+        items.back() = newRepeat(items.back(), min, max);
+    }
+}
+
+// For the character (not anything else) that the escape with this letter
+// stands for, with the position just after the letter; returns -1 if it is
+// not one or is not understood:
+int TRegexSet::Parser::parseCharacterCode(const ushort letter)
+{
+    auto digitValue = [](const ushort c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return 16;
+    };
+    // Reads up to limit (-1 for no limit) digits, or up to the end character
+    // if there is one - which has to be there then:
+    auto parseDigits = [&](const int base, int limit, const ushort end) {
+        int value = 0;
+        bool hasDigits = false;
+        while (limit-- && !isAtEnd() && peek() != end) {
+            const int digit = digitValue(peek());
+            if (digit >= base) {
+                if (end) {
+                    return -1;
+                }
+                break;
+            }
+            value = value * base + digit;
+            if (value > 0xFFFF) {
+                return -1;
+            }
+            hasDigits = true;
+            ++mPos;
+        }
+        if (end) {
+            if (peek() != end || !hasDigits) {
+                return -1;
+            }
+            ++mPos;
+        }
+        return value;
+    };
+
+    int code = -1;
+    switch (letter) {
+    case 'a':
+        return 0x07;
+    case 'e':
+        return 0x1B;
+    case 'f':
+        return 0x0C;
+    case 'n':
+        return 0x0A;
+    case 'r':
+        return 0x0D;
+    case 't':
+        return 0x09;
+    case 'c':
+        if (isAtEnd() || peek() > 127) {
+            return -1;
+        }
+        code = QChar(peek()).toUpper().unicode() ^ 0x40;
+        ++mPos;
+        return code;
+    case 'x':
+        if (peek() == '{') {
+            ++mPos;
+            code = parseDigits(16, -1, '}');
+        } else {
+            code = parseDigits(16, 2, 0);
+        }
+        break;
+    case 'o':
+        if (peek() != '{') {
+            return -1;
+        }
+        ++mPos;
+        code = parseDigits(8, -1, '}');
+        break;
+    case '0':
+        code = parseDigits(8, 2, 0);
+        break;
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+        // Only ever an octal code in a class, with the position at the digit:
+        code = parseDigits(8, 3, 0);
+        break;
+    default:
+        // Any other escaped letter or digit is either an error or something
+        // special; all other escaped characters are just themselves:
+        return isLetterOrDigit(letter) ? -1 : letter;
+    }
+    return (code < 0 || QChar::isSurrogate(static_cast<uint>(code))) ? -1 : code;
+}
+
+int TRegexSet::Parser::parseClass()
+{
+    // Skip the '[':
+    ++mPos;
+    CharClass charClass;
+    charClass.isCaseless = mIsCaseless;
+    if (peek() == '^') {
+        charClass.isNegated = true;
+        ++mPos;
+    }
+
+    for (bool isFirst = true;; isFirst = false) {
+        if (isAtEnd()) {
+            return fail();
+        }
+        ushort c = peek();
+        if (c == ']' && !isFirst) {
+            ++mPos;
+            break;
+        }
+        if (c == '[' && (peek(1) == ':' || peek(1) == '.' || peek(1) == '=')) {
+            if (peek(1) != ':') {
+                // Collating elements, which PCRE does not support either:
+                return fail();
+            }
+            const int end = mRegex.indexOf(QLatin1String(":]"), mPos + 2);
+            if (end < 0) {
+                return fail();
+            }
+            // A POSIX class, which with PCRE_UCP is a Unicode property:
+            charClass.isApproximate = true;
+            mPos = end + 2;
+            continue;
+        }
+
+        int low;
+        if (c == '\\') {
+            low = parseClassEscape(charClass);
+        } else if (QChar::isSurrogate(c)) {
+            return fail();
+        } else {
+            low = c;
+            ++mPos;
+        }
+        if (mHasFailed) {
+            return newAst(Ast::Empty);
+        }
+        if (low < 0) {
+            // Something like \d which has already been added to the class:
+            continue;
+        }
+
+        int high = low;
+        if (peek() == '-' && peek(1) != ']' && mPos + 1 < mRegex.size()) {
+            ++mPos;
+            if (peek() == '\\') {
+                high = parseClassEscape(charClass);
+                if (mHasFailed) {
+                    return newAst(Ast::Empty);
+                }
+                if (high < 0) {
+                    // Not a range after all, so the '-' is just a '-':
+                    charClass.ranges.append(qMakePair(static_cast<ushort>(low), static_cast<ushort>(low)));
+                    charClass.ranges.append(qMakePair(static_cast<ushort>('-'), static_cast<ushort>('-')));
+                    continue;
+                }
+            } else {
+                high = peek();
+                if (QChar::isSurrogate(static_cast<uint>(high))) {
+                    return fail();
+                }
+                ++mPos;
+            }
+            if (high < low) {
+                return fail();
+            }
+        }
+        charClass.ranges.append(qMakePair(static_cast<ushort>(low), static_cast<ushort>(high)));
+        if (charClass.isCaseless && high > 127) {
+            // Let alone the case folding of everything outside of ASCII:
+            charClass.isApproximate = true;
+        }
+    }
+
+    const int ast = newAst(Ast::Class);
+    mAsts[static_cast<size_t>(ast)].classIndex = static_cast<int>(mSet.mClasses.size());
+    mSet.mClasses.push_back(charClass);
+    return ast;
+}
+
+// Returns the character for an escape in a class (starting at the '\') or -1
+// if it was something else, which is then added to the class itself:
+int TRegexSet::Parser::parseClassEscape(CharClass& charClass)
+{
+    ++mPos;
+    if (isAtEnd()) {
+        fail();
+        return -1;
+    }
+    const ushort c = peek();
+    ++mPos;
+    switch (c) {
+    case 'd':
+        charClass.types |= CharClass::Digit;
+        return -1;
+    case 'D':
+        charClass.types |= CharClass::NotDigit;
+        return -1;
+    case 'w':
+        charClass.types |= CharClass::Word;
+        return -1;
+    case 'W':
+        charClass.types |= CharClass::NotWord;
+        return -1;
+    case 's':
+        charClass.types |= CharClass::Space;
+        return -1;
+    case 'S':
+        charClass.types |= CharClass::NotSpace;
+        return -1;
+    case 'p':
+    case 'P':
+        if (!skipPropertyName()) {
+            fail();
+            return -1;
+        }
+    // Fall-through
+    case 'h':
+    case 'H':
+    case 'v':
+    case 'V':
+        charClass.isApproximate = true;
+        return -1;
+    case 'b':
+        return 0x08;
+    default:
+        if (c >= '1' && c <= '7') {
+            --mPos;
+        }
+        const int code = parseCharacterCode(c);
+        if (code < 0) {
+            fail();
+        }
+        return code;
+    }
+}
+
+bool TRegexSet::Parser::isQuantifierNext() const
+{
+    static const QRegularExpression quantifier(QStringLiteral(R"(\{\d+(,\d*)?\})"));
+    return quantifier.match(mRegex, mPos, QRegularExpression::NormalMatch, QRegularExpression::AnchoredMatchOption).hasMatch();
+}
+
+bool TRegexSet::Parser::isRepeatNext() const
+{
+    const ushort c = peek();
+    return c == '*' || c == '+' || c == '?' || (c == '{' && isQuantifierNext());
+}
+
+bool TRegexSet::Parser::parseQuantifier(int& min, int& max)
+{
+    switch (peek()) {
+    case '*':
+        min = 0;
+        max = -1;
+        ++mPos;
+        break;
+    case '+':
+        min = 1;
+        max = -1;
+        ++mPos;
+        break;
+    case '?':
+        min = 0;
+        max = 1;
+        ++mPos;
+        break;
+    case '{': {
+        if (!isQuantifierNext()) {
+            // Just a '{':
+            return false;
+        }
+        const int end = mRegex.indexOf(QLatin1Char('}'), mPos);
+        const QStringList counts = mRegex.mid(mPos + 1, end - mPos - 1).split(QLatin1Char(','));
+        min = counts.at(0).toInt();
+        max = counts.size() == 1 ? min : counts.at(1).isEmpty() ? -1 : counts.at(1).toInt();
+        mPos = end + 1;
+        if (min > csmMaxRepeatCount || max > csmMaxRepeatCount) {
+            fail();
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    // Lazy and possessive quantifiers can match the same things:
+    if (peek() == '?' || peek() == '+') {
+        ++mPos;
+    }
+    return true;
+}
+
+// Moves to just after the next end character, if there is one:
+bool TRegexSet::Parser::skipPast(const ushort end)
+{
+    const int position = mRegex.indexOf(QChar(end), mPos + 1);
+    if (position < 0) {
+        return false;
+    }
+    mPos = position + 1;
+    return true;
+}
+
+// For \p and \P, which are followed by either one letter or a name in braces:
+bool TRegexSet::Parser::skipPropertyName()
+{
+    if (peek() == '{') {
+        return skipPast('}');
+    }
+    if (isAtEnd()) {
+        return false;
+    }
+    ++mPos;
+    return true;
+}
+
+int TRegexSet::Parser::newNode(const Node::Type type, const int out, const int out2)
+{
+    if (mSet.mNodes.size() - mFirstNode >= static_cast<size_t>(csmMaxNodesPerPattern)) {
+        mHasFailed = true;
+    }
+    Node node;
+    node.type = type;
+    node.out = out;
+    node.out2 = out2;
+    mSet.mNodes.push_back(node);
+    return static_cast<int>(mSet.mNodes.size()) - 1;
+}
+
+// Makes the nodes for the tree - last first, so that each only has to be told
+// where to go next - and returns the first of them:
+int TRegexSet::Parser::emit(const int index, const int next)
+{
+    if (mHasFailed) {
+        return next;
+    }
+    const Ast& ast = mAsts.at(static_cast<size_t>(index));
+    switch (ast.type) {
+    case Ast::Empty:
+        return next;
+    case Ast::Char: {
+        const int node = newNode(Node::Char, next);
+        mSet.mNodes[static_cast<size_t>(node)].c = ast.c;
+        mSet.mNodes[static_cast<size_t>(node)].isCaseless = ast.isCaseless;
+        return node;
+    }
+    case Ast::Class: {
+        const int node = newNode(Node::Class, next);
+        mSet.mNodes[static_cast<size_t>(node)].index = ast.classIndex;
+        return node;
+    }
+    case Ast::Any:
+        return newNode(Node::Any, next);
+    case Ast::Begin:
+        return newNode(Node::Begin, next);
+    case Ast::End:
+        return newNode(Node::End, next);
+    case Ast::Concat: {
+        int start = next;
+        for (auto it = ast.children.crbegin(); it != ast.children.crend(); ++it) {
+            start = emit(*it, start);
+        }
+        return start;
+    }
+    case Ast::Alternation: {
+        int start = emit(ast.children.back(), next);
+        for (int i = static_cast<int>(ast.children.size()) - 2; i >= 0; --i) {
+            start = newNode(Node::Split, emit(ast.children.at(static_cast<size_t>(i)), next), start);
+        }
+        return start;
+    }
+    case Ast::Repeat: {
+        const int child = ast.children.front();
+        int start = next;
+        if (ast.max < 0) {
+            const int loop = newNode(Node::Split, -1, next);
+            const int body = emit(child, loop);
+            mSet.mNodes[static_cast<size_t>(loop)].out = body;
+            start = loop;
+        } else {
+            // Each optional copy can be followed by the next one or skip the
+            // rest of them:
+            for (int i = ast.min; i < ast.max; ++i) {
+                start = newNode(Node::Split, emit(child, start), next);
+            }
+        }
+        for (int i = 0; i < ast.min; ++i) {
+            start = emit(child, start);
+        }
+        return start;
+    }
+    }
+    return next;
+}
+
+
+bool TRegexSet::CharClass::containsExactly(const ushort c) const
+{
+    for (const auto& range : ranges) {
+        if (c >= range.first && c <= range.second) {
+            return true;
+        }
+    }
+    if (!types || c > 127) {
+        return false;
+    }
+    const bool isDigit = c >= '0' && c <= '9';
+    const bool isWord = isDigit || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    const bool isSpace = (c >= 0x09 && c <= 0x0D) || c == ' ';
+    return ((types & Digit) && isDigit) || ((types & NotDigit) && !isDigit) || ((types & Word) && isWord) || ((types & NotWord) && !isWord) || ((types & Space) && isSpace)
+            || ((types & NotSpace) && !isSpace);
+}
+
+bool TRegexSet::CharClass::contains(const ushort c) const
+{
+    // Outside of ASCII the Unicode tables of PCRE and Qt might not quite
+    // agree, so anything that depends on them is taken as a match:
+    if (isApproximate || (c > 127 && (types || (isCaseless && isNegated)))) {
+        return true;
+    }
+    bool isFound = containsExactly(c);
+    if (!isFound && isCaseless) {
+        const QChar character(c);
+        isFound = containsExactly(character.toLower().unicode()) || containsExactly(character.toUpper().unicode()) || containsExactly(character.toCaseFolded().unicode());
+    }
+    return isFound != isNegated;
+}
+
+bool TRegexSet::Node::accepts(const ushort character) const
+{
+    if (character == c) {
+        return true;
+    }
+    if (!isCaseless) {
+        return false;
+    }
+    const QChar a(character);
+    const QChar b(c);
+    return a.toCaseFolded() == b.toCaseFolded() || a.toLower() == b.toLower() || a.toUpper() == b.toUpper();
+}
+
+
+TRegexSet::TRegexSet()
+: mIsDfaStale(true)
+, mInitialDfaState(-1)
+, mClosureGeneration(0)
+, mGeneration(0)
+, mFoundCount(0)
+{
+}
+
+int TRegexSet::addPattern(const QString& regex)
+{
+    const size_t nodeCount = mNodes.size();
+    const size_t classCount = mClasses.size();
+    const int id = patternCount();
+
+    Node match;
+    match.type = Node::Match;
+    match.index = id;
+    mNodes.push_back(match);
+
+    Parser parser(*this, regex);
+    const int start = parser.compile(static_cast<int>(nodeCount));
+    if (start < 0) {
+        mNodes.resize(nodeCount);
+        mClasses.resize(classCount);
+        return -1;
+    }
+
+    for (size_t i = nodeCount; i < mNodes.size(); ++i) {
+        mNodes[i].pattern = id;
+    }
+    mPatternStarts.push_back(start);
+    mFoundGeneration.push_back(0);
+    mIsDfaStale = true;
+    return id;
+}
+
+// Adds the nodes that can be got to from the seeds without reading anything,
+// that read something or that end a pattern, to the (sorted) states:
+void TRegexSet::closure(QVector<int>& seeds, const bool isAtStart, const bool isAtEnd, QVector<int>& states)
+{
+    if (++mClosureGeneration == 0) {
+        std::fill(mClosureMark.begin(), mClosureMark.end(), 0);
+        mClosureGeneration = 1;
+    }
+    mClosureMark.resize(mNodes.size(), 0);
+
+    while (!seeds.isEmpty()) {
+        const int index = seeds.takeLast();
+        if (mClosureMark.at(static_cast<size_t>(index)) == mClosureGeneration) {
+            continue;
+        }
+        mClosureMark[static_cast<size_t>(index)] = mClosureGeneration;
+        const Node& node = mNodes.at(static_cast<size_t>(index));
+        switch (node.type) {
+        case Node::Split:
+            seeds.append(node.out2);
+            seeds.append(node.out);
+            break;
+        case Node::Begin:
+            if (isAtStart) {
+                seeds.append(node.out);
+            }
+            break;
+        case Node::End:
+            if (isAtEnd) {
+                seeds.append(node.out);
+            } else {
+                // Kept, in case the line does end here:
+                states.append(index);
+            }
+            break;
+        default:
+            states.append(index);
+        }
+    }
+    std::sort(states.begin(), states.end());
+}
+
+// The nodes that the consuming ones of the states go on to after the
+// character:
+void TRegexSet::step(const QVector<int>& states, const ushort c, QVector<int>& next)
+{
+    QVector<int> seeds;
+    for (const int index : states) {
+        const Node& node = mNodes.at(static_cast<size_t>(index));
+        switch (node.type) {
+        case Node::Char:
+            if (node.accepts(c)) {
+                seeds.append(node.out);
+            }
+            break;
+        case Node::Class:
+            if (mClasses.at(static_cast<size_t>(node.index)).contains(c)) {
+                seeds.append(node.out);
+            }
+            break;
+        case Node::Any:
+            seeds.append(node.out);
+            break;
+        default:
+            break;
+        }
+    }
+    closure(seeds, false, false, next);
+}
+
+// Takes out the restart states, which every DFA state has without them having
+// to be listed, and what is left of the patterns that have just matched, as
+// they have already been reported and nothing more that they do can make any
+// difference - without the latter a pattern with a ".*" in it that matches
+// early on in the line would keep the DFA from ever getting back to a state
+// that it has been in before:
+void TRegexSet::simplify(QVector<int>& states) const
+{
+    QVector<int> matched;
+    for (const int index : states) {
+        if (mNodes.at(static_cast<size_t>(index)).type == Node::Match) {
+            matched.append(mNodes.at(static_cast<size_t>(index)).pattern);
+        }
+    }
+
+    QVector<int> simplified;
+    simplified.reserve(states.size());
+    auto restart = mRestartStates.cbegin();
+    for (const int index : states) {
+        while (restart != mRestartStates.cend() && *restart < index) {
+            ++restart;
+        }
+        if (restart != mRestartStates.cend() && *restart == index) {
+            continue;
+        }
+        const Node& node = mNodes.at(static_cast<size_t>(index));
+        if (node.type != Node::Match && !matched.isEmpty() && matched.contains(node.pattern)) {
+            continue;
+        }
+        simplified.append(index);
+    }
+    states.swap(simplified);
+}
+
+void TRegexSet::rebuild()
+{
+    resetDfa();
+
+    QVector<int> seeds = QVector<int>::fromStdVector(mPatternStarts);
+    mRestartStates.clear();
+    closure(seeds, false, false, mRestartStates);
+    mRestartMatches.clear();
+    mRestartEnds.clear();
+    for (const int index : mRestartStates) {
+        const Node& node = mNodes.at(static_cast<size_t>(index));
+        if (node.type == Node::Match) {
+            mRestartMatches.append(node.index);
+        } else if (node.type == Node::End) {
+            mRestartEnds.append(index);
+        }
+    }
+
+    seeds = QVector<int>::fromStdVector(mPatternStarts);
+    mInitialStates.clear();
+    closure(seeds, true, false, mInitialStates);
+    simplify(mInitialStates);
+    mIsDfaStale = false;
+}
+
+void TRegexSet::resetDfa()
+{
+    mDfaStates.clear();
+    mDfaStateIndex.clear();
+    mRestartNext.clear();
+    mInitialDfaState = -1;
+}
+
+int TRegexSet::addDfaState(const QVector<int>& nfaStates)
+{
+    auto it = mDfaStateIndex.constFind(nfaStates);
+    if (it != mDfaStateIndex.cend()) {
+        return it.value();
+    }
+
+    DfaState state;
+    state.nfaStates = nfaStates;
+    for (const int index : nfaStates) {
+        const Node& node = mNodes.at(static_cast<size_t>(index));
+        if (node.type == Node::Match) {
+            state.matches.append(node.index);
+        }
+    }
+    mDfaStates.push_back(std::move(state));
+    const int id = static_cast<int>(mDfaStates.size()) - 1;
+    mDfaStateIndex.insert(nfaStates, id);
+    return id;
+}
+
+int TRegexSet::nextDfaState(const int state, const ushort c)
+{
+    QVector<int> nfaStates;
+    step(mDfaStates.at(static_cast<size_t>(state)).nfaStates, c, nfaStates);
+
+    // Where the restart states go is the same for every state:
+    auto it = mRestartNext.constFind(c);
+    if (it == mRestartNext.cend()) {
+        QVector<int> restartNext;
+        step(mRestartStates, c, restartNext);
+        it = mRestartNext.insert(c, restartNext);
+    }
+    const QVector<int>& restartNext = it.value();
+    QVector<int> merged;
+    merged.reserve(nfaStates.size() + restartNext.size());
+    std::set_union(nfaStates.cbegin(), nfaStates.cend(), restartNext.cbegin(), restartNext.cend(), std::back_inserter(merged));
+    simplify(merged);
+
+    if (static_cast<int>(mDfaStates.size()) >= csmMaxDfaStates) {
+        // Start afresh rather than let the cache grow without limit, the
+        // state that this came from is lost so it cannot be told where to go:
+        resetDfa();
+        return addDfaState(merged);
+    }
+
+    const int next = addDfaState(merged);
+    DfaState& from = mDfaStates[static_cast<size_t>(state)];
+    if (c < 128) {
+        from.asciiNext[c] = next;
+    } else {
+        from.otherNext.insert(c, next);
+    }
+    return next;
+}
+
+void TRegexSet::report(const int state, const bool isAtEnd)
+{
+    DfaState& dfaState = mDfaStates[static_cast<size_t>(state)];
+    if (isAtEnd) {
+        if (dfaState.endReportedGeneration == mGeneration) {
+            return;
+        }
+        dfaState.endReportedGeneration = mGeneration;
+        if (!dfaState.hasEndMatches) {
+            QVector<int> seeds = mRestartEnds;
+            for (const int index : dfaState.nfaStates) {
+                if (mNodes.at(static_cast<size_t>(index)).type == Node::End) {
+                    seeds.append(index);
+                }
+            }
+            QVector<int> nfaStates;
+            closure(seeds, false, true, nfaStates);
+            for (const int index : nfaStates) {
+                if (mNodes.at(static_cast<size_t>(index)).type == Node::Match) {
+                    dfaState.endMatches.append(mNodes.at(static_cast<size_t>(index)).index);
+                }
+            }
+            dfaState.hasEndMatches = true;
+        }
+    } else {
+        if (dfaState.reportedGeneration == mGeneration) {
+            return;
+        }
+        dfaState.reportedGeneration = mGeneration;
+    }
+    found(isAtEnd ? dfaState.endMatches : dfaState.matches);
+}
+
+void TRegexSet::found(const QVector<int>& ids)
+{
+    for (const int id : ids) {
+        if (mFoundGeneration.at(static_cast<size_t>(id)) != mGeneration) {
+            mFoundGeneration[static_cast<size_t>(id)] = mGeneration;
+            ++mFoundCount;
+        }
+    }
+}
+
+bool TRegexSet::scan(const QString& text)
+{
+    for (const QChar c : text) {
+        if (c.isSurrogate()) {
+            return false;
+        }
+    }
+
+    if (mIsDfaStale) {
+        rebuild();
+    }
+
+    if (++mGeneration == 0) {
+        // So that nothing from 2^32 scans ago looks as if it was found now:
+        std::fill(mFoundGeneration.begin(), mFoundGeneration.end(), 0);
+        for (auto& state : mDfaStates) {
+            state.reportedGeneration = 0;
+            state.endReportedGeneration = 0;
+        }
+        mGeneration = 1;
+    }
+    mFoundCount = 0;
+
+    const int total = text.size();
+    if (!total) {
+        // The end is also the start, which the DFA states do not allow for:
+        QVector<int> seeds = QVector<int>::fromStdVector(mPatternStarts);
+        QVector<int> nfaStates;
+        closure(seeds, true, true, nfaStates);
+        QVector<int> ids;
+        for (const int index : nfaStates) {
+            if (mNodes.at(static_cast<size_t>(index)).type == Node::Match) {
+                ids.append(mNodes.at(static_cast<size_t>(index)).index);
+            }
+        }
+        found(ids);
+        return true;
+    }
+
+    // The patterns that match nothing at all match everywhere:
+    found(mRestartMatches);
+    if (mInitialDfaState < 0) {
+        mInitialDfaState = addDfaState(mInitialStates);
+    }
+    int state = mInitialDfaState;
+    report(state, false);
+    const int patterns = patternCount();
+    for (int i = 0; i < total && mFoundCount < patterns; ++i) {
+        const ushort c = text.at(i).unicode();
+        if (c == '\n' && i == total - 1) {
+            // A '$' also matches before a newline at the very end:
+            report(state, true);
+        }
+        const DfaState& dfaState = mDfaStates.at(static_cast<size_t>(state));
+        int next = c < 128 ? dfaState.asciiNext.at(c) : dfaState.otherNext.value(c, -1);
+        if (next < 0) {
+            next = nextDfaState(state, c);
+        }
+        state = next;
+        report(state, false);
+    }
+    report(state, true);
+    return true;
+}
@@ -0,0 +1,176 @@
+#ifndef MUDLET_TREGEXSET_H
+#define MUDLET_TREGEXSET_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include "post_guard.h"
+
+#include <vector>
+
+
+// Works out which of a set of (PCRE) regexes can match a line in a single
+// pass over it, by combining all of them into one automaton - a Thompson NFA
+// that is turned into a DFA a state at a time as the lines need it - rather
+// than running each of them on the line in turn.
+//
+// It only decides whether each regex matches somewhere, not where or what
+// the groups capture, so that is still left to PCRE for the regexes that it
+// reports. It is also allowed to err on the side of a match: look-arounds,
+// back references, word boundaries and the like are taken as matching
+// anything that they might, so a regex that is reported may still turn out
+// not to match but one that is not reported never does. Regexes that use
+// something that cannot be handled that way (recursion, conditions, callouts,
+// extended mode, ...) are not added at all, so the caller has to run those
+// itself.
+class TRegexSet
+{
+public:
+    TRegexSet();
+
+    // Returns the id of the regex - the number of ones added before it - or
+    // -1 if it cannot be handled, in which case the set is left as it was:
+    int addPattern(const QString& regex);
+    int patternCount() const { return static_cast<int>(mPatternStarts.size()); }
+
+    // Returns false, in which case mayMatch(...) is not to be used, if the
+    // text cannot be handled (it has characters outside of the BMP):
+    bool scan(const QString& text);
+    bool mayMatch(const int id) const { return mFoundGeneration.at(static_cast<size_t>(id)) == mGeneration; }
+
+    static const int csmMaxNodesPerPattern = 4000;
+    static const int csmMaxRepeatCount = 100;
+    static const int csmMaxDfaStates = 4000;
+
+private:
+    Q_DISABLE_COPY(TRegexSet)
+
+    class Parser;
+
+    struct CharClass
+    {
+        // For the \d, \w, \s (and negated) escapes in the class:
+        enum Type : quint8 {
+            Digit = 0x01,
+            NotDigit = 0x02,
+            Word = 0x04,
+            NotWord = 0x08,
+            Space = 0x10,
+            NotSpace = 0x20
+        };
+
+        CharClass() : isNegated(false), isCaseless(false), isApproximate(false), types(0) {}
+        bool contains(ushort c) const;
+        bool containsExactly(ushort c) const;
+
+        bool isNegated;
+        bool isCaseless;
+        // Set when it has something, such as a Unicode property, that is not
+        // worked out - so it has to be taken as matching any character:
+        bool isApproximate;
+        quint8 types;
+        QVector<QPair<ushort, ushort>> ranges;
+    };
+
+    struct Node
+    {
+        enum Type : quint8 {
+            Char,
+            Class,
+            Any,
+            Split,
+            Begin,
+            End,
+            Match
+        };
+
+        Node() : type(Any), isCaseless(false), c(0), index(-1), out(-1), out2(-1), pattern(-1) {}
+        bool accepts(ushort character) const;
+
+        Type type;
+        bool isCaseless;
+        ushort c;
+        // The CharClass of a Class or the pattern id of a Match:
+        int index;
+        int out;
+        // The other way out of a Split:
+        int out2;
+        // The id of the pattern that it is part of:
+        int pattern;
+    };
+
+    struct DfaState
+    {
+        DfaState() : hasEndMatches(false), reportedGeneration(0), endReportedGeneration(0), asciiNext(128, -1) {}
+
+        // The sorted NFA nodes that it stands for, besides the restart ones:
+        QVector<int> nfaStates;
+        // The ids of the patterns that have matched on getting here, and of
+        // those that have if the line ends here:
+        QVector<int> matches;
+        QVector<int> endMatches;
+        bool hasEndMatches;
+        quint32 reportedGeneration;
+        quint32 endReportedGeneration;
+        std::vector<int> asciiNext;
+        QHash<ushort, int> otherNext;
+    };
+
+    void rebuild();
+    void resetDfa();
+    int addDfaState(const QVector<int>& nfaStates);
+    int nextDfaState(int state, ushort c);
+    void closure(QVector<int>& seeds, bool isAtStart, bool isAtEnd, QVector<int>& states);
+    void step(const QVector<int>& states, ushort c, QVector<int>& next);
+    void simplify(QVector<int>& states) const;
+    void report(int state, bool isAtEnd);
+    void found(const QVector<int>& ids);
+
+
+    std::vector<Node> mNodes;
+    std::vector<CharClass> mClasses;
+    std::vector<int> mPatternStarts;
+
+    // The NFA states to start with at the beginning of a line and the ones
+    // that are added at every character after that, with the patterns that
+    // match with nothing at all and the '$'s that can be got to straight away:
+    QVector<int> mInitialStates;
+    QVector<int> mRestartStates;
+    QVector<int> mRestartMatches;
+    QVector<int> mRestartEnds;
+    QHash<ushort, QVector<int>> mRestartNext;
+    bool mIsDfaStale;
+    int mInitialDfaState;
+    std::vector<DfaState> mDfaStates;
+    QHash<QVector<int>, int> mDfaStateIndex;
+    std::vector<quint32> mClosureMark;
+    quint32 mClosureGeneration;
+
+    quint32 mGeneration;
+    std::vector<quint32> mFoundGeneration;
+    int mFoundCount;
+};
+
+#endif // MUDLET_TREGEXSET_H
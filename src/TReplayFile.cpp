@@ -0,0 +1,258 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TReplayFile.h"
+
+
+#include "pre_guard.h"
+#include <QObject>
+#include <QtEndian>
+#include "post_guard.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char csmFileMagic[] = "MUDLETRP";
+static const char csmIndexMagic[] = "MUDLETIX";
+static const int csmMagicLength = 8;
+static const quint32 csmFormatVersion = 1;
+// magic + version + reserved:
+static const quint64 csmHeaderSize = csmMagicLength + 4 + 4;
+// time + length:
+static const quint64 csmChunkHeaderSize = 8 + 4;
+// time + offset:
+static const quint64 csmIndexEntrySize = 8 + 8;
+// index offset + count + magic:
+static const quint64 csmTrailerSize = 8 + 4 + csmMagicLength;
+
+TReplayWriter::TReplayWriter()
+{
+    mStream.setByteOrder(QDataStream::LittleEndian);
+}
+
+TReplayWriter::~TReplayWriter()
+{
+    close();
+}
+
+bool TReplayWriter::open(const QString& fileName)
+{
+    close();
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    mStream.setDevice(&mFile);
+    mStream.writeRawData(csmFileMagic, csmMagicLength);
+    mStream << csmFormatVersion << quint32(0);
+    return true;
+}
+
+void TReplayWriter::writeChunk(const qint64 time, const char* data, const int length)
+{
+    if (!mFile.isOpen() || length <= 0) {
+        return;
+    }
+
+    IndexEntry entry;
+    entry.time = time;
+    entry.offset = static_cast<quint64>(mFile.pos());
+    mIndex.push_back(entry);
+    mStream << time << static_cast<quint32>(length);
+    mStream.writeRawData(data, length);
+}
+
+void TReplayWriter::close()
+{
+    if (!mFile.isOpen()) {
+        mIndex.clear();
+        return;
+    }
+
+    const quint64 indexOffset = static_cast<quint64>(mFile.pos());
+    for (const auto& entry : mIndex) {
+        mStream << entry.time << entry.offset;
+    }
+    mStream << indexOffset << static_cast<quint32>(mIndex.size());
+    mStream.writeRawData(csmIndexMagic, csmMagicLength);
+
+    mStream.setDevice(nullptr);
+    mFile.close();
+    mIndex.clear();
+}
+
+
+TReplayReader::TReplayReader()
+: mpData(nullptr)
+, mSize(0)
+, mIsLegacyFormat(false)
+{
+}
+
+TReplayReader::~TReplayReader()
+{
+    close();
+}
+
+bool TReplayReader::open(const QString& fileName, QString& errorMessage)
+{
+    close();
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        errorMessage = QObject::tr("cannot open file, error message was: \"%1\".").arg(mFile.errorString());
+        return false;
+    }
+
+    mSize = static_cast<quint64>(mFile.size());
+    if (mSize) {
+        mpData = mFile.map(0, mFile.size());
+        if (!mpData) {
+            errorMessage = QObject::tr("cannot map file into memory, error message was: \"%1\".").arg(mFile.errorString());
+            close();
+            return false;
+        }
+    }
+
+    bool isValid;
+    if (mSize >= csmHeaderSize && !std::memcmp(mpData, csmFileMagic, csmMagicLength)) {
+        if (qFromLittleEndian<quint32>(mpData + csmMagicLength) > csmFormatVersion) {
+            errorMessage = QObject::tr("it was recorded by a newer version of Mudlet.");
+            close();
+            return false;
+        }
+        isValid = readIndex() || scanChunks();
+    } else {
+        mIsLegacyFormat = true;
+        isValid = scanLegacyChunks();
+    }
+
+    if (!isValid) {
+        errorMessage = QObject::tr("it does not seem to be a replay file.");
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TReplayReader::close()
+{
+    if (mpData) {
+        mFile.unmap(const_cast<uchar*>(mpData));
+        mpData = nullptr;
+    }
+    if (mFile.isOpen()) {
+        mFile.close();
+    }
+    mSize = 0;
+    mIndex.clear();
+    mIsLegacyFormat = false;
+}
+
+TStringView TReplayReader::chunk(const int chunk) const
+{
+    const Entry& entry = mIndex.at(static_cast<size_t>(chunk));
+    return TStringView(reinterpret_cast<const char*>(mpData + entry.offset), entry.length);
+}
+
+int TReplayReader::findChunk(const qint64 time) const
+{
+    auto it = std::lower_bound(mIndex.cbegin(), mIndex.cend(), time, [](const Entry& entry, const qint64 value) { return entry.time < value; });
+    return static_cast<int>(it - mIndex.cbegin());
+}
+
+// Uses the index written at the end of a completed recording, returns false if
+// that is missing or does not make sense:
+bool TReplayReader::readIndex()
+{
+    if (mSize < csmHeaderSize + csmTrailerSize || std::memcmp(mpData + mSize - csmMagicLength, csmIndexMagic, csmMagicLength)) {
+        return false;
+    }
+
+    const uchar* pTrailer = mpData + mSize - csmTrailerSize;
+    const quint64 indexOffset = qFromLittleEndian<quint64>(pTrailer);
+    const quint32 count = qFromLittleEndian<quint32>(pTrailer + 8);
+    if (indexOffset < csmHeaderSize || indexOffset + count * csmIndexEntrySize != mSize - csmTrailerSize) {
+        return false;
+    }
+
+    mIndex.reserve(count);
+    const uchar* pEntry = mpData + indexOffset;
+    for (quint32 i = 0; i < count; ++i, pEntry += csmIndexEntrySize) {
+        Entry entry;
+        entry.time = qFromLittleEndian<qint64>(pEntry);
+        const quint64 chunkOffset = qFromLittleEndian<quint64>(pEntry + 8);
+        if (chunkOffset < csmHeaderSize || chunkOffset + csmChunkHeaderSize > indexOffset) {
+            mIndex.clear();
+            return false;
+        }
+        entry.length = qFromLittleEndian<quint32>(mpData + chunkOffset + 8);
+        entry.offset = chunkOffset + csmChunkHeaderSize;
+        if (entry.offset + entry.length > indexOffset) {
+            mIndex.clear();
+            return false;
+        }
+        mIndex.push_back(entry);
+    }
+    return true;
+}
+
+// For a recording that was never closed properly - walk through the chunks
+// and keep as many complete ones as there are:
+bool TReplayReader::scanChunks()
+{
+    quint64 offset = csmHeaderSize;
+    while (offset + csmChunkHeaderSize <= mSize) {
+        Entry entry;
+        entry.time = qFromLittleEndian<qint64>(mpData + offset);
+        entry.length = qFromLittleEndian<quint32>(mpData + offset + 8);
+        entry.offset = offset + csmChunkHeaderSize;
+        if (entry.offset + entry.length > mSize) {
+            break;
+        }
+        mIndex.push_back(entry);
+        offset = entry.offset + entry.length;
+    }
+    return true;
+}
+
+// The old format stored the time since the previous chunk rather than since
+// the start, so the times have to be summed to get something seekable:
+bool TReplayReader::scanLegacyChunks()
+{
+    quint64 offset = 0;
+    qint64 time = 0;
+    while (offset + 8 <= mSize) {
+        const qint32 delay = qFromBigEndian<qint32>(mpData + offset);
+        const qint32 length = qFromBigEndian<qint32>(mpData + offset + 4);
+        if (delay < 0 || length < 0 || offset + 8 + static_cast<quint64>(length) > mSize) {
+            break;
+        }
+        time += delay;
+        Entry entry;
+        entry.time = time;
+        entry.length = static_cast<quint32>(length);
+        entry.offset = offset + 8;
+        mIndex.push_back(entry);
+        offset = entry.offset + entry.length;
+    }
+    // Something that is not even a single record long cannot be right:
+    return !mIndex.empty();
+}
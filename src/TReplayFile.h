@@ -0,0 +1,127 @@
+#ifndef MUDLET_TREPLAYFILE_H
+#define MUDLET_TREPLAYFILE_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TStringView.h"
+
+#include "pre_guard.h"
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include "post_guard.h"
+
+#include <vector>
+
+/*
+ * Replay file format (version 1), all numbers are little-endian:
+ *
+ *   header:  "MUDLETRP" quint32 version quint32 reserved(0)
+ *   chunks:  qint64 milliSecondsSinceStart quint32 length <length bytes>
+ *            ... repeated for each piece of data received ...
+ *   index:   qint64 milliSecondsSinceStart quint64 fileOffsetOfChunk
+ *            ... one per chunk ...
+ *   trailer: quint64 fileOffsetOfIndex quint32 chunkCount "MUDLETIX"
+ *
+ * The index and trailer are written when the recording is stopped; if they
+ * are missing (e.g. after a crash) the chunks are scanned instead. The data
+ * is that AFTER any MCCP decompression, but still with all the telnet
+ * protocol bytes in it.
+ *
+ * The original format (still readable) was just a QDataStream of
+ * (qint32 milliSecondsSincePreviousChunk, qint32 length, <length bytes>)
+ * records, with no header at all.
+ */
+
+class TReplayWriter
+{
+public:
+    TReplayWriter();
+    ~TReplayWriter();
+
+    bool open(const QString& fileName);
+    void writeChunk(const qint64 time, const char* data, const int length);
+    // Writes the index and trailer, then closes the file:
+    void close();
+    bool isOpen() const { return mFile.isOpen(); }
+    QString fileName() const { return mFile.fileName(); }
+    QString errorString() const { return mFile.errorString(); }
+
+private:
+    Q_DISABLE_COPY(TReplayWriter)
+
+    struct IndexEntry
+    {
+        qint64 time;
+        quint64 offset;
+    };
+
+    QFile mFile;
+    QDataStream mStream;
+    std::vector<IndexEntry> mIndex;
+};
+
+
+// Reads either format through a memory mapping of the whole file, so that the
+// chunks can be handed out without copying and any of them can be reached
+// directly - which is what makes seeking cheap:
+class TReplayReader
+{
+public:
+    TReplayReader();
+    ~TReplayReader();
+
+    bool open(const QString& fileName, QString& errorMessage);
+    void close();
+
+    int chunkCount() const { return static_cast<int>(mIndex.size()); }
+    // Milli-seconds from the start of the recording:
+    qint64 timeOf(const int chunk) const { return mIndex.at(static_cast<size_t>(chunk)).time; }
+    TStringView chunk(const int chunk) const;
+    // The first chunk at or after the given time, or chunkCount() if there is
+    // none:
+    int findChunk(const qint64 time) const;
+    qint64 duration() const { return mIndex.empty() ? 0 : mIndex.back().time; }
+    bool isLegacyFormat() const { return mIsLegacyFormat; }
+
+private:
+    Q_DISABLE_COPY(TReplayReader)
+
+    struct Entry
+    {
+        qint64 time;
+        quint64 offset;
+        quint32 length;
+    };
+
+    bool readIndex();
+    bool scanChunks();
+    bool scanLegacyChunks();
+
+
+    QFile mFile;
+    const uchar* mpData;
+    quint64 mSize;
+    std::vector<Entry> mIndex;
+    bool mIsLegacyFormat;
+};
+
+#endif // MUDLET_TREPLAYFILE_H
@@ -0,0 +1,220 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TScrollbackArchive.h"
+
+#include "TBuffer.h"
+
+#include "pre_guard.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include "post_guard.h"
+
+#include <algorithm>
+#include <iterator>
+
+TScrollbackArchive::TScrollbackArchive()
+: mFile(QDir::tempPath() + QStringLiteral("/mudlet-scrollback-XXXXXX"))
+, mLineCount(0)
+, mCachedBlock(-1)
+{
+}
+
+TScrollbackArchive::~TScrollbackArchive()
+{
+    // The QTemporaryFile removes the file itself:
+    mFile.close();
+}
+
+// The file is only created when the first lines are stored, so a buffer that
+// never gets that long costs nothing:
+bool TScrollbackArchive::open()
+{
+    if (mFile.isOpen()) {
+        return true;
+    }
+
+    if (!mFile.open()) {
+        qWarning().nospace().noquote() << "TScrollbackArchive::open() WARNING - unable to create the scrollback archive file, reason: \"" << mFile.errorString() << "\", older lines will be lost.";
+        return false;
+    }
+
+    return true;
+}
+
+bool TScrollbackArchive::store(const std::deque<std::deque<TChar>>& lines, const QStringList& text, const std::deque<qint64>& times, const QList<bool>& prompts, const int from, const int count)
+{
+    QMutexLocker locker(&mMutex);
+    if (count <= 0 || !open()) {
+        return false;
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    for (int i = from, total = from + count; i < total; ++i) {
+        const std::deque<TChar>& line = lines[static_cast<size_t>(i)];
+        stream << times[static_cast<size_t>(i)] << prompts.at(i) << text.at(i) << static_cast<quint32>(line.size());
+        for (const TChar& c : line) {
+            stream << c.fgR << c.fgG << c.fgB << c.bgR << c.bgG << c.bgB << c.flags << c.link;
+        }
+    }
+
+    const QByteArray compressed = qCompress(data);
+    Block block;
+    block.offset = static_cast<quint64>(mFile.size());
+    block.size = static_cast<quint32>(compressed.size());
+    block.firstLine = mLineCount;
+    block.lineCount = count;
+    if (!mFile.seek(static_cast<qint64>(block.offset)) || mFile.write(compressed) != compressed.size()) {
+        qWarning().nospace().noquote() << "TScrollbackArchive::store(...) WARNING - unable to write to the scrollback archive file, reason: \"" << mFile.errorString() << "\", " << count << " older lines will be lost.";
+        mFile.resize(static_cast<qint64>(block.offset));
+        return false;
+    }
+
+    mIndex.push_back(block);
+    mLineCount += count;
+    return true;
+}
+
+int TScrollbackArchive::takeLastBlock(std::deque<std::deque<TChar>>& lines, QStringList& text, std::deque<qint64>& times, QList<bool>& prompts)
+{
+    QMutexLocker locker(&mMutex);
+    if (mIndex.empty()) {
+        return 0;
+    }
+
+    const size_t last = mIndex.size() - 1;
+    std::deque<std::deque<TChar>> blockLines;
+    QStringList blockText;
+    std::deque<qint64> blockTimes;
+    QList<bool> blockPrompts;
+    if (!readBlock(last, &blockLines, blockText, &blockTimes, &blockPrompts)) {
+        return 0;
+    }
+
+    const Block block = mIndex.back();
+    mIndex.pop_back();
+    mLineCount -= block.lineCount;
+    if (mCachedBlock == static_cast<int>(last)) {
+        mCachedBlock = -1;
+        mCachedText.clear();
+    }
+    // So that the space is reused for the next block to be stored:
+    mFile.resize(static_cast<qint64>(block.offset));
+
+    lines.insert(lines.begin(), std::make_move_iterator(blockLines.begin()), std::make_move_iterator(blockLines.end()));
+    times.insert(times.begin(), blockTimes.begin(), blockTimes.end());
+    blockText.append(text);
+    text.swap(blockText);
+    blockPrompts.append(prompts);
+    prompts.swap(blockPrompts);
+    return block.lineCount;
+}
+
+QString TScrollbackArchive::lineText(const int line)
+{
+    QMutexLocker locker(&mMutex);
+    if (line < 0 || line >= mLineCount) {
+        return QString();
+    }
+
+    const int block = findBlock(line);
+    if (block != mCachedBlock) {
+        mCachedText.clear();
+        mCachedBlock = -1;
+        if (!readBlock(static_cast<size_t>(block), nullptr, mCachedText, nullptr, nullptr)) {
+            return QString();
+        }
+        mCachedBlock = block;
+    }
+
+    return mCachedText.value(line - mIndex.at(static_cast<size_t>(block)).firstLine);
+}
+
+void TScrollbackArchive::clear()
+{
+    QMutexLocker locker(&mMutex);
+    mIndex.clear();
+    mLineCount = 0;
+    mCachedBlock = -1;
+    mCachedText.clear();
+    if (mFile.isOpen()) {
+        mFile.resize(0);
+    }
+}
+
+// The block holding the given archived line, which must be in range:
+int TScrollbackArchive::findBlock(const int line) const
+{
+    auto it = std::upper_bound(mIndex.cbegin(), mIndex.cend(), line, [](const int l, const Block& block) { return l < block.firstLine; });
+    return static_cast<int>(std::distance(mIndex.cbegin(), it)) - 1;
+}
+
+// Only the text is wanted when the other pointers are null:
+bool TScrollbackArchive::readBlock(const size_t block, std::deque<std::deque<TChar>>* pLines, QStringList& text, std::deque<qint64>* pTimes, QList<bool>* pPrompts)
+{
+    const Block& entry = mIndex.at(block);
+    if (!mFile.flush()) {
+        return false;
+    }
+
+    uchar* pMapped = mFile.map(static_cast<qint64>(entry.offset), static_cast<qint64>(entry.size));
+    if (!pMapped) {
+        qWarning().nospace().noquote() << "TScrollbackArchive::readBlock(" << block << ") WARNING - unable to map the scrollback archive file, reason: \"" << mFile.errorString() << "\".";
+        return false;
+    }
+    const QByteArray data = qUncompress(pMapped, static_cast<int>(entry.size));
+    mFile.unmap(pMapped);
+    if (data.isEmpty()) {
+        return false;
+    }
+
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    text.reserve(entry.lineCount);
+    for (int i = 0; i < entry.lineCount; ++i) {
+        qint64 time;
+        bool isPrompt;
+        QString lineText;
+        quint32 charCount;
+        stream >> time >> isPrompt >> lineText >> charCount;
+        if (pLines) {
+            std::deque<TChar> line(charCount);
+            for (TChar& c : line) {
+                stream >> c.fgR >> c.fgG >> c.fgB >> c.bgR >> c.bgG >> c.bgB >> c.flags >> c.link;
+            }
+            pLines->push_back(std::move(line));
+        } else {
+            // Each TChar is six quint8s and two quint16s:
+            stream.skipRawData(static_cast<int>(charCount) * 10);
+        }
+        if (pTimes) {
+            pTimes->push_back(time);
+        }
+        if (pPrompts) {
+            pPrompts->append(isPrompt);
+        }
+        text.append(lineText);
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
@@ -0,0 +1,106 @@
+#ifndef MUDLET_TSCROLLBACKARCHIVE_H
+#define MUDLET_TSCROLLBACKARCHIVE_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryFile>
+#include "post_guard.h"
+
+#include <deque>
+#include <vector>
+
+class TChar;
+
+/*
+ * Holds the lines that a TBuffer has trimmed from the front of its scrollback
+ * so that they are not lost: each batch of lines that is trimmed is written as
+ * one qCompress(...)ed block to the end of a temporary file (removed when the
+ * archive is) and only a small index entry for it is kept in memory. Blocks are
+ * read back through a memory mapping of just that block.
+ *
+ * A block, before compression, is a little-endian QDataStream of, for each
+ * line:
+ *   qint64 time, bool isPrompt, QString text, quint32 charCount,
+ *   then charCount * (quint8 fgR fgG fgB bgR bgG bgB, quint16 flags link)
+ *
+ * Archived lines are numbered from zero for the oldest one.
+ *
+ * Every public method may be called from any thread, so that a buffer search
+ * can read the archive (through lineText(...)) whilst the buffer goes on
+ * storing and taking back blocks.
+ */
+class TScrollbackArchive
+{
+public:
+    TScrollbackArchive();
+    ~TScrollbackArchive();
+
+    bool store(const std::deque<std::deque<TChar>>& lines, const QStringList& text, const std::deque<qint64>& times, const QList<bool>& prompts, const int from, const int count);
+    // Removes the most recently stored block and puts its lines onto the
+    // FRONT of the given containers, returns the number of lines or zero if
+    // the archive is empty (or the block could not be read):
+    int takeLastBlock(std::deque<std::deque<TChar>>& lines, QStringList& text, std::deque<qint64>& times, QList<bool>& prompts);
+    int lineCount() const
+    {
+        QMutexLocker locker(&mMutex);
+        return mLineCount;
+    }
+    QString lineText(const int line);
+    void clear();
+    QString errorString() const
+    {
+        QMutexLocker locker(&mMutex);
+        return mFile.errorString();
+    }
+
+private:
+    Q_DISABLE_COPY(TScrollbackArchive)
+
+    struct Block
+    {
+        quint64 offset;
+        quint32 size;
+        int firstLine;
+        int lineCount;
+    };
+
+    bool open();
+    int findBlock(const int line) const;
+    bool readBlock(const size_t block, std::deque<std::deque<TChar>>* pLines, QStringList& text, std::deque<qint64>* pTimes, QList<bool>* pPrompts);
+
+
+    mutable QMutex mMutex;
+    QTemporaryFile mFile;
+    std::vector<Block> mIndex;
+    int mLineCount;
+    // The text of the last block that lineText(...) needed, so that reading
+    // through the archive a line at a time only decompresses each block once:
+    int mCachedBlock;
+    QStringList mCachedText;
+};
+
+#endif // MUDLET_TSCROLLBACKARCHIVE_H
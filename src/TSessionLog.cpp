@@ -0,0 +1,474 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TSessionLog.h"
+
+
+#include "pre_guard.h"
+#include <QDateTime>
+#include <QStringList>
+#include <QTextStream>
+#include <QtEndian>
+#include "post_guard.h"
+
+const quint16 TSessionLog::csmItalics;
+const quint16 TSessionLog::csmBold;
+const quint16 TSessionLog::csmUnderline;
+const quint16 TSessionLog::csmInverse;
+const quint16 TSessionLog::csmStrikeOut;
+
+static const char scmMagic[] = "MUDLETLG";
+static const int scmMagicSize = 8;
+static const quint32 scmVersion = 1;
+static const quint8 scmRawFrame = 0;
+static const quint8 scmCompressedFrame = 1;
+// Anything bigger than this cannot have been written by Mudlet and means that
+// the file is damaged:
+static const quint32 scmMaximumFrameSize = 64 * 1024 * 1024;
+static const int scmFrameHeaderSize = 5;
+// What qCompress(...) puts at the start of its output: the uncompressed size
+// (big-endian) and then the two byte header of the zlib stream:
+static const int scmCompressedPrefixSize = 6;
+// How much of a damaged file is looked through at a time for the next frame:
+static const int scmSearchBlockSize = 65536;
+
+QByteArray TSessionLog::fileHeader()
+{
+    QByteArray header(scmMagic, scmMagicSize);
+    QDataStream stream(&header, QIODevice::Append);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << scmVersion << quint32(0);
+    return header;
+}
+
+void TSessionLog::appendSessionStart(QByteArray& records, const qint64 time, const QString& profileName, const quint32 foreground, const quint32 background)
+{
+    QDataStream stream(&records, QIODevice::Append);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << quint8(TSessionLogRecord::SessionStart) << time << profileName.toUtf8() << foreground << background;
+}
+
+void TSessionLog::appendLine(QByteArray& records, const qint64 time, const bool isPrompt, const QString& text, const QVector<TSessionLogRun>& runs)
+{
+    QDataStream stream(&records, QIODevice::Append);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << quint8(TSessionLogRecord::Line) << time << quint8(isPrompt) << text.toUtf8() << quint32(runs.size());
+    for (const auto& run : runs) {
+        stream << quint32(run.length) << run.fgR << run.fgG << run.fgB << run.bgR << run.bgG << run.bgB << run.flags;
+    }
+}
+
+void TSessionLog::appendSessionEnd(QByteArray& records, const qint64 time)
+{
+    QDataStream stream(&records, QIODevice::Append);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << quint8(TSessionLogRecord::SessionEnd) << time;
+}
+
+QByteArray TSessionLog::frame(const QByteArray& records)
+{
+    const QByteArray payload = qCompress(records);
+    QByteArray result;
+    result.reserve(payload.size() + scmFrameHeaderSize);
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << quint32(payload.size()) << scmCompressedFrame;
+    result.append(payload);
+    return result;
+}
+
+
+TSessionLogReader::TSessionLogReader()
+{
+    mFileStream.setByteOrder(QDataStream::LittleEndian);
+    mFrameStream.setDevice(&mFrameBuffer);
+    mFrameStream.setByteOrder(QDataStream::LittleEndian);
+}
+
+bool TSessionLogReader::open(const QString& fileName, QString& errorMessage)
+{
+    mFile.setFileName(fileName);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        errorMessage = mFile.errorString();
+        return false;
+    }
+
+    mFileStream.setDevice(&mFile);
+    const QByteArray magic = mFile.read(scmMagicSize);
+    quint32 version = 0;
+    quint32 reserved = 0;
+    mFileStream >> version >> reserved;
+    if (magic != QByteArray(scmMagic, scmMagicSize) || mFileStream.status() != QDataStream::Ok) {
+        errorMessage = QStringLiteral("not a Mudlet binary session log");
+        return false;
+    }
+    if (version > scmVersion) {
+        errorMessage = QStringLiteral("session log format version %1 is newer than this version of Mudlet can read").arg(version);
+        return false;
+    }
+    return true;
+}
+
+bool TSessionLogReader::readFrame()
+{
+    if (mFile.atEnd()) {
+        return false;
+    }
+
+    const qint64 start = mFile.pos();
+    if (loadFrame()) {
+        return true;
+    }
+    // Whatever is wrong with it, the frame's length cannot be trusted, so the
+    // next one is looked for from just after where it started:
+    return findFrame(start + 1);
+}
+
+// Reads the frame at the current position of the file:
+bool TSessionLogReader::loadFrame()
+{
+    const qint64 start = mFile.pos();
+    quint32 size = 0;
+    quint8 encoding = 0;
+    mFileStream.resetStatus();
+    mFileStream >> size >> encoding;
+    if (mFileStream.status() != QDataStream::Ok || size > scmMaximumFrameSize || (encoding != scmRawFrame && encoding != scmCompressedFrame)) {
+        mErrorString = QStringLiteral("damaged frame header at offset %1").arg(start);
+        return false;
+    }
+    QByteArray payload = mFile.read(size);
+    if (payload.size() != static_cast<int>(size)) {
+        // A frame that was only partly written when Mudlet stopped:
+        mErrorString = QStringLiteral("truncated frame at offset %1").arg(start);
+        return false;
+    }
+    if (encoding == scmCompressedFrame) {
+        // qUncompress(...) would otherwise make room for whatever size a
+        // damaged frame claims:
+        if (payload.size() < scmCompressedPrefixSize || qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(payload.constData())) > scmMaximumFrameSize) {
+            mErrorString = QStringLiteral("damaged frame at offset %1").arg(start);
+            return false;
+        }
+        payload = qUncompress(payload);
+        if (payload.isEmpty()) {
+            // Also what a partly written frame that more was added after
+            // looks like:
+            mErrorString = QStringLiteral("frame could not be uncompressed at offset %1").arg(start);
+            return false;
+        }
+    }
+
+    mFrameBuffer.close();
+    mFrame = payload;
+    mFrameBuffer.setBuffer(&mFrame);
+    mFrameBuffer.open(QIODevice::ReadOnly);
+    mFrameStream.resetStatus();
+    return true;
+}
+
+// Reads the first frame at or after the given offset that can be. Only
+// compressed ones that fit in what is left of the file and start as
+// qCompress(...) output does are tried, and the checksum at the end of the
+// zlib stream makes it most unlikely that anything else then passes for one.
+// Returns false if there is none:
+bool TSessionLogReader::findFrame(const qint64 from)
+{
+    // The damage that was found is what is to be reported, not the places
+    // that were tried after it:
+    const QString errorString = mErrorString;
+    const int probeSize = scmFrameHeaderSize + scmCompressedPrefixSize;
+    const qint64 fileSize = mFile.size();
+    qint64 blockStart = from;
+    while (blockStart + probeSize <= fileSize) {
+        if (!mFile.seek(blockStart)) {
+            return false;
+        }
+        // Overlapping the next block, so that no probe is cut short:
+        const QByteArray block = mFile.read(scmSearchBlockSize + probeSize - 1);
+        const auto* data = reinterpret_cast<const uchar*>(block.constData());
+        for (int i = 0; i + probeSize <= block.size(); ++i) {
+            const uchar* probe = data + i;
+            const quint32 size = qFromLittleEndian<quint32>(probe);
+            const uchar* zlibHeader = probe + scmFrameHeaderSize + 4;
+            if (probe[4] != scmCompressedFrame || size < static_cast<quint32>(scmCompressedPrefixSize) || size > scmMaximumFrameSize
+                || blockStart + i + scmFrameHeaderSize + size > fileSize || (zlibHeader[0] & 0x0f) != 8 || ((zlibHeader[0] << 8) | zlibHeader[1]) % 31) {
+                continue;
+            }
+            if (!mFile.seek(blockStart + i)) {
+                return false;
+            }
+            const bool isFound = loadFrame();
+            mErrorString = errorString;
+            if (isFound) {
+                return true;
+            }
+        }
+        blockStart += scmSearchBlockSize;
+    }
+    mFile.seek(fileSize);
+    return false;
+}
+
+bool TSessionLogReader::readRecord(TSessionLogRecord& record)
+{
+    forever {
+        while (!mFrameBuffer.isOpen() || mFrameStream.atEnd()) {
+            if (!readFrame()) {
+                return false;
+            }
+        }
+        if (parseRecord(record)) {
+            return true;
+        }
+        // Nothing after a damaged record in the same frame can be trusted:
+        mFrameBuffer.close();
+    }
+}
+
+bool TSessionLogReader::parseRecord(TSessionLogRecord& record)
+{
+    quint8 type = 0;
+    QByteArray text;
+    mFrameStream >> type >> record.time;
+    record.runs.clear();
+    switch (type) {
+    case TSessionLogRecord::SessionStart:
+        record.type = TSessionLogRecord::SessionStart;
+        record.isPrompt = false;
+        mFrameStream >> text >> record.foreground >> record.background;
+        record.text = QString::fromUtf8(text);
+        break;
+    case TSessionLogRecord::Line: {
+        record.type = TSessionLogRecord::Line;
+        quint8 isPrompt = 0;
+        quint32 runCount = 0;
+        mFrameStream >> isPrompt >> text >> runCount;
+        record.isPrompt = isPrompt;
+        record.text = QString::fromUtf8(text);
+        if (runCount > static_cast<quint32>(record.text.size())) {
+            mErrorString = QStringLiteral("damaged line record");
+            return false;
+        }
+        record.runs.resize(static_cast<int>(runCount));
+        for (auto& run : record.runs) {
+            quint32 length = 0;
+            mFrameStream >> length >> run.fgR >> run.fgG >> run.fgB >> run.bgR >> run.bgG >> run.bgB >> run.flags;
+            run.length = static_cast<int>(length);
+        }
+        break;
+    }
+    case TSessionLogRecord::SessionEnd:
+        record.type = TSessionLogRecord::SessionEnd;
+        record.isPrompt = false;
+        record.text.clear();
+        break;
+    default:
+        mErrorString = QStringLiteral("unknown record type %1").arg(type);
+        return false;
+    }
+
+    if (mFrameStream.status() != QDataStream::Ok) {
+        mErrorString = QStringLiteral("damaged record");
+        return false;
+    }
+    return true;
+}
+
+
+static QString timeStamp(const qint64 time)
+{
+    // As TBuffer::timeStamp(...) does, less the trailing spaces:
+    if (time == 0) {
+        return QString();
+    }
+    if (time == -1) {
+        return QStringLiteral("-------------");
+    }
+    return QDateTime::fromMSecsSinceEpoch(time).toString(QStringLiteral("hh:mm:ss.zzz "));
+}
+
+static QString rgb(const quint8 red, const quint8 green, const quint8 blue)
+{
+    return QStringLiteral("rgb(%1,%2,%3)").arg(red).arg(green).arg(blue);
+}
+
+// The HTML for a line, made in the same way as by TBuffer::bufferToHtml(...):
+static QString lineToHtml(const TSessionLogRecord& record, const bool isTimeStamped)
+{
+    QString s;
+    const QString time = isTimeStamped ? timeStamp(record.time) : QString();
+    if (!time.isEmpty()) {
+        s.append(R"(<span style="color: rgb(200,150,0); background: rgb(22,22,22); )");
+        s.append(R"(font-weight: normal; font-style: normal; text-decoration: normal">)");
+        s.append(time);
+        s.append(QStringLiteral("</span>"));
+    }
+
+    int position = 0;
+    for (const auto& run : record.runs) {
+        if (position >= record.text.size()) {
+            break;
+        }
+        QStringList decorations;
+        if (run.flags & TSessionLog::csmUnderline) {
+            decorations << QStringLiteral("underline");
+        }
+        if (run.flags & TSessionLog::csmStrikeOut) {
+            decorations << QStringLiteral("line-through");
+        }
+        s.append(QStringLiteral(R"(<span style="color: %1; background: %2; font-weight: %3; font-style: %4; text-decoration: %5">)")
+                 .arg(rgb(run.fgR, run.fgG, run.fgB),
+                      rgb(run.bgR, run.bgG, run.bgB),
+                      (run.flags & TSessionLog::csmBold) ? QStringLiteral("bold") : QStringLiteral("normal"),
+                      (run.flags & TSessionLog::csmItalics) ? QStringLiteral("italic") : QStringLiteral("normal"),
+                      decorations.isEmpty() ? QStringLiteral("normal") : decorations.join(QLatin1Char(' '))));
+        s.append(record.text.mid(position, run.length).toHtmlEscaped());
+        s.append(QStringLiteral("</span>"));
+        position += run.length;
+    }
+    s.append(QStringLiteral("<br>\n"));
+    return s;
+}
+
+// Swaps the colours a session was recorded with for the ones wanted:
+static void applyTheme(TSessionLogRecord& record, const quint32 foreground, const quint32 background, const TSessionLogRenderOptions& options)
+{
+    for (auto& run : record.runs) {
+        if (((run.fgR << 16) | (run.fgG << 8) | run.fgB) == foreground) {
+            run.fgR = (options.foreground >> 16) & 0xff;
+            run.fgG = (options.foreground >> 8) & 0xff;
+            run.fgB = options.foreground & 0xff;
+        }
+        if (((run.bgR << 16) | (run.bgG << 8) | run.bgB) == background) {
+            run.bgR = (options.background >> 16) & 0xff;
+            run.bgG = (options.background >> 8) & 0xff;
+            run.bgB = options.background & 0xff;
+        }
+    }
+}
+
+bool TSessionLogRenderer::render(const QString& logFileName, const QString& outputFileName, const TSessionLogRenderOptions& options, QString& errorMessage)
+{
+    TSessionLogReader reader;
+    if (!reader.open(logFileName, errorMessage)) {
+        errorMessage = tr("cannot read \"%1\": %2").arg(logFileName, errorMessage);
+        return false;
+    }
+
+    QFile outputFile(outputFileName);
+    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorMessage = tr("cannot write \"%1\": %2").arg(outputFileName, outputFile.errorString());
+        return false;
+    }
+    QTextStream out(&outputFile);
+    out.setCodec("UTF-8");
+
+    const QString startFormat = tr("'Log session starting at 'hh:mm:ss' on 'dddd', 'd' 'MMMM' 'yyyy",
+                                   "This is the format argument to QDateTime::toString(...) and needs to follow the rules for that function {literal text must be single quoted} as well as being suitable for the translation locale");
+    const QString endFormat = tr("hh:mm:ss' on 'dddd', 'd' 'MMMM' 'yyyy",
+                                 "This is the format argument to QDateTime::toString(...) and needs to follow the rules for that function {literal text must be single quoted} as well as being suitable for the translation locale");
+
+    // The page colours are those of the first session - or of the theme:
+    TSessionLogRecord record;
+    bool isFirstSession = true;
+    quint32 sessionForeground = 0xc0c0c0;
+    quint32 sessionBackground = 0x000000;
+    while (reader.readRecord(record)) {
+        switch (record.type) {
+        case TSessionLogRecord::SessionStart:
+            sessionForeground = record.foreground;
+            sessionBackground = record.background;
+            if (options.isHtml) {
+                if (isFirstSession) {
+                    QStringList fontsList;
+                    if (!options.fontFamily.isEmpty()) {
+                        fontsList << options.fontFamily;
+                    }
+                    fontsList << QStringLiteral("Courier New") << QStringLiteral("Monospace") << QStringLiteral("Courier");
+                    fontsList.removeDuplicates();
+                    const quint32 pageForeground = options.isThemed ? options.foreground : sessionForeground;
+                    const quint32 pageBackground = options.isThemed ? options.background : sessionBackground;
+                    out << "<!DOCTYPE HTML PUBLIC '-//W3C//DTD HTML 4.01//EN' 'http://www.w3.org/TR/html4/strict.dtd'>\n";
+                    out << "<html>\n";
+                    out << " <head>\n";
+                    out << "  <meta http-equiv='content-type' content='text/html; charset=utf-8'>";
+                    out << "  <meta name='generator' content='" << tr("Mudlet MUD Client version: %1%2").arg(APP_VERSION, APP_BUILD) << "'>\n";
+                    out << "  <title>" << tr("Mudlet, log from %1 profile").arg(record.text.toHtmlEscaped()) << "</title>\n";
+                    out << "  <style type='text/css'>\n";
+                    out << "   <!-- body { font-family: '" << fontsList.join("', '") << "'; font-size: 100%; line-height: 1.125em; white-space: nowrap; color:"
+                        << rgb(pageForeground >> 16, pageForeground >> 8, pageForeground) << "; background-color:"
+                        << rgb(pageBackground >> 16, pageBackground >> 8, pageBackground) << ";}\n";
+                    out << "        span { white-space: pre; } -->\n";
+                    out << "  </style>\n";
+                    out << "  </head>\n";
+                    out << "  <body><div>\n";
+                } else {
+                    out << "  </div><hr><div>\n";
+                }
+                out << QStringLiteral("<p>%1</p>\n").arg(QDateTime::fromMSecsSinceEpoch(record.time).toString(startFormat));
+            } else {
+                if (!isFirstSession) {
+                    out << QStringLiteral("⎯⎯⎯⎯⎯⎯⎯⎯⎯⎯").repeated(8).append(QChar::LineFeed);
+                }
+                out << QDateTime::fromMSecsSinceEpoch(record.time).toString(startFormat) << ".\n";
+            }
+            isFirstSession = false;
+            break;
+
+        case TSessionLogRecord::Line:
+            if (options.isHtml) {
+                if (options.isThemed) {
+                    applyTheme(record, sessionForeground, sessionBackground, options);
+                }
+                out << lineToHtml(record, options.isTimeStamped);
+            } else {
+                out << (options.isTimeStamped ? timeStamp(record.time) : QString()) << record.text << '\n';
+            }
+            break;
+
+        case TSessionLogRecord::SessionEnd: {
+            const QString endDateTimeLine = tr("Log session ending at %1.").arg(QDateTime::fromMSecsSinceEpoch(record.time).toString(endFormat));
+            if (options.isHtml) {
+                out << QStringLiteral("<p>%1</p>\n").arg(endDateTimeLine);
+            } else {
+                out << endDateTimeLine << '\n';
+            }
+            break;
+        }
+        }
+    }
+
+    if (options.isHtml && !isFirstSession) {
+        out << "  </div></body>\n";
+        out << "</html>\n";
+    }
+    out.flush();
+    if (outputFile.error() != QFileDevice::NoError) {
+        errorMessage = tr("cannot write \"%1\": %2").arg(outputFileName, outputFile.errorString());
+        return false;
+    }
+    if (!reader.errorString().isEmpty()) {
+        // Everything that could be read has been written out, but the damaged
+        // parts are lost:
+        errorMessage = tr("\"%1\" is damaged: %2").arg(logFileName, reader.errorString());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,174 @@
+#ifndef MUDLET_TSESSIONLOG_H
+#define MUDLET_TSESSIONLOG_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QBuffer>
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "post_guard.h"
+
+/*
+ * Binary session log format (version 1, file extension ".mlog"), all numbers
+ * are little-endian:
+ *
+ *   header:  "MUDLETLG" quint32 version quint32 reserved(0)
+ *   frames:  quint32 length quint8 encoding <length bytes>
+ *            ... where the encoding is 1 for records that have been through
+ *            qCompress(...), which is all that Mudlet writes, or 0 for
+ *            records as they are, which can still be read ...
+ *   records: quint8 type, followed by (for each type):
+ *            SessionStart: qint64 time QByteArray profileName(UTF-8)
+ *                          quint32 foregroundRgb quint32 backgroundRgb
+ *            Line:         qint64 time quint8 isPrompt QByteArray text(UTF-8)
+ *                          quint32 runCount, then for each run:
+ *                          quint32 length quint8 fgR fgG fgB bgR bgG bgB
+ *                          quint16 flags
+ *            SessionEnd:   qint64 time
+ *
+ * A record is never split between frames. A frame that was only partly
+ * written - when Mudlet or the computer crashed - is followed by those of the
+ * next session when logging to the same file is started again, so a reader
+ * skips any damage and carries on from the next frame that it can read. Times are milli-seconds since the
+ * epoch, except that for a line 0 means none and -1 that it carries on from
+ * the line before (see TBuffer::csm...TimeStamp). A run is a number of UTF-16
+ * code units of the text that share a style. The colours of a session start are
+ * the profile's default ones, so that a renderer can swap them for others.
+ *
+ * Only the style runs are kept for each line rather than a style for every
+ * character and nothing is turned into HTML whilst logging, which is what
+ * makes this much smaller and cheaper to write than an HTML log; the
+ * TSessionLogRenderer makes HTML or plain text from it afterwards.
+ */
+
+struct TSessionLogRun
+{
+    int length;
+    quint8 fgR;
+    quint8 fgG;
+    quint8 fgB;
+    quint8 bgR;
+    quint8 bgG;
+    quint8 bgB;
+    quint16 flags;
+};
+
+struct TSessionLogRecord
+{
+    enum Type {
+        SessionStart = 1,
+        Line = 2,
+        SessionEnd = 3
+    };
+
+    TSessionLogRecord() : type(Line), time(0), isPrompt(false), foreground(0), background(0) {}
+
+    Type type;
+    qint64 time;
+    bool isPrompt;
+    // The line for a Line, the profile name for a SessionStart:
+    QString text;
+    QVector<TSessionLogRun> runs;
+    // 0xRRGGBB, only for a SessionStart:
+    quint32 foreground;
+    quint32 background;
+};
+
+class TSessionLog
+{
+public:
+    // The TSessionLogRun::flags values, which are the same as the TCHAR_...
+    // ones that they are copied from:
+    static const quint16 csmItalics = 1;
+    static const quint16 csmBold = 2;
+    static const quint16 csmUnderline = 4;
+    static const quint16 csmInverse = 8;
+    static const quint16 csmStrikeOut = 32;
+
+    static QByteArray fileHeader();
+    static void appendSessionStart(QByteArray& records, qint64 time, const QString& profileName, quint32 foreground, quint32 background);
+    static void appendLine(QByteArray& records, qint64 time, bool isPrompt, const QString& text, const QVector<TSessionLogRun>& runs);
+    static void appendSessionEnd(QByteArray& records, qint64 time);
+    // Compresses some whole records and wraps them up to be written after the
+    // header:
+    static QByteArray frame(const QByteArray& records);
+};
+
+
+class TSessionLogReader
+{
+public:
+    TSessionLogReader();
+
+    bool open(const QString& fileName, QString& errorMessage);
+    // Returns false at the end of the file. Any damaged parts of it are
+    // skipped, in which case errorString() says what was wrong with the last
+    // one:
+    bool readRecord(TSessionLogRecord& record);
+    QString errorString() const { return mErrorString; }
+
+private:
+    Q_DISABLE_COPY(TSessionLogReader)
+
+    bool readFrame();
+    bool loadFrame();
+    bool findFrame(qint64 from);
+    bool parseRecord(TSessionLogRecord& record);
+
+
+    QFile mFile;
+    QDataStream mFileStream;
+    // The records of the frame being read:
+    QByteArray mFrame;
+    QBuffer mFrameBuffer;
+    QDataStream mFrameStream;
+    QString mErrorString;
+};
+
+
+struct TSessionLogRenderOptions
+{
+    TSessionLogRenderOptions() : isHtml(true), isTimeStamped(false), isThemed(false), foreground(0), background(0) {}
+
+    bool isHtml;
+    bool isTimeStamped;
+    // When set the foreground and background colours that each session was
+    // recorded with are replaced by these:
+    bool isThemed;
+    quint32 foreground;
+    quint32 background;
+    QString fontFamily;
+};
+
+class TSessionLogRenderer
+{
+    Q_DECLARE_TR_FUNCTIONS(TSessionLogRenderer)
+
+public:
+    static bool render(const QString& logFileName, const QString& outputFileName, const TSessionLogRenderOptions& options, QString& errorMessage);
+};
+
+#endif // MUDLET_TSESSIONLOG_H
@@ -0,0 +1,95 @@
+#ifndef MUDLET_TSPSCQUEUE_H
+#define MUDLET_TSPSCQUEUE_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// A bounded, lock-free FIFO for handing items from exactly ONE producer thread
+// to exactly ONE consumer thread. tryPush() must only ever be called from the
+// producer and tryPop() only from the consumer - anything else is a data race.
+// The capacity is rounded up to a power of two so that the indexes can be
+// wrapped with a mask rather than a division.
+template <typename T>
+class TSpscQueue
+{
+public:
+    explicit TSpscQueue(size_t capacity)
+    : mSlots(roundUpToPowerOfTwo(capacity))
+    , mMask(mSlots.size() - 1)
+    , mHead(0)
+    , mTail(0)
+    {
+    }
+
+    TSpscQueue(const TSpscQueue&) = delete;
+    TSpscQueue& operator=(const TSpscQueue&) = delete;
+
+    // Producer side, returns false (and leaves item untouched) if full:
+    bool tryPush(T&& item)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == mSlots.size()) {
+            return false;
+        }
+        mSlots[tail & mMask] = std::move(item);
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if there was nothing to take:
+    bool tryPop(T& item)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(mSlots[head & mMask]);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot - the other side may change it at any moment:
+    bool isEmpty() const { return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire); }
+    size_t capacity() const { return mSlots.size(); }
+
+private:
+    static size_t roundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::vector<T> mSlots;
+    const size_t mMask;
+    // Kept on separate cache lines so that the two threads do not keep
+    // invalidating each other's copy of the index they do not write to:
+    alignas(64) std::atomic<size_t> mHead;
+    alignas(64) std::atomic<size_t> mTail;
+};
+
+#endif // MUDLET_TSPSCQUEUE_H
@@ -0,0 +1,79 @@
+#ifndef MUDLET_TSTRINGVIEW_H
+#define MUDLET_TSTRINGVIEW_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// A read-only, non-owning window onto some bytes - a cut down version of the
+// C++17 std::string_view for this C++11 code base. It offers just the parts of
+// the std::string interface that the incoming data processing code uses so
+// that it can work on data in place rather than on a copy of it; the owner of
+// the bytes MUST keep them unchanged for as long as the view is in use.
+class TStringView
+{
+public:
+    static const size_t npos = std::string::npos;
+
+    TStringView() : mpData(nullptr), mSize(0) {}
+    TStringView(const char* data, const size_t size) : mpData(data), mSize(size) {}
+    TStringView(const std::string& string) : mpData(string.data()), mSize(string.size()) {}
+
+    const char* data() const { return mpData; }
+    size_t size() const { return mSize; }
+    size_t length() const { return mSize; }
+    bool empty() const { return !mSize; }
+
+    const char& operator[](const size_t pos) const { return mpData[pos]; }
+
+    const char& at(const size_t pos) const
+    {
+        if (pos >= mSize) {
+            throw std::out_of_range("TStringView::at(...) position out of range");
+        }
+        return mpData[pos];
+    }
+
+    std::string substr(const size_t pos, const size_t count = npos) const
+    {
+        if (pos > mSize) {
+            throw std::out_of_range("TStringView::substr(...) position out of range");
+        }
+        return std::string(mpData + pos, std::min(count, mSize - pos));
+    }
+
+    // True if the bytes starting at pos are the same as the given literal,
+    // without having to build a temporary std::string to compare against:
+    template <size_t N>
+    bool matchesAt(const size_t pos, const char (&literal)[N]) const
+    {
+        return (pos + N - 1 <= mSize) && std::equal(literal, literal + N - 1, mpData + pos);
+    }
+
+private:
+    const char* mpData;
+    size_t mSize;
+};
+
+#endif // MUDLET_TSTRINGVIEW_H
@@ -0,0 +1,264 @@
+/***************************************************************************
+ *   Copyright (C) 2002-2005 by Tomas Mecir - kmuddy@kmuddy.com            *
+ *   Copyright (C) 2008-2013 by Heiko Koehn - KoehnHeiko@googlemail.com    *
+ *   Copyright (C) 2017 by Michael Hupp - darksix@northfire.org            *
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TTelnetDecoder.h"
+
+
+#include "TByteScanner.h"
+#include "ctelnet.h"
+
+#include "pre_guard.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include "post_guard.h"
+
+// The inflate output buffer starts at this size and is doubled, up to the
+// maximum, whenever a single inflate fills it:
+static const size_t csmInitialInflateBufferSize = 16384;
+static const size_t csmMaxInflateBufferSize = 1048576;
+
+TTelnetDecoder::TTelnetDecoder(const Output& output)
+: mOutput(output)
+, mInflateBuffer(csmInitialInflateBufferSize)
+, mZstream()
+, mNeedDecompression(false)
+, iac(false)
+, iac2(false)
+, insb(false)
+, mInflateTime(-1)
+, mIsCompressionNegotiated(false)
+, mIsRecording(false)
+{
+}
+
+TTelnetDecoder::~TTelnetDecoder()
+{
+    if (mNeedDecompression) {
+        inflateEnd(&mZstream);
+    }
+}
+
+void TTelnetDecoder::reset()
+{
+    if (mNeedDecompression) {
+        inflateEnd(&mZstream);
+        mNeedDecompression = false;
+    }
+    iac = iac2 = insb = false;
+    command.clear();
+}
+
+void TTelnetDecoder::push(TTelnetChunk::Type type)
+{
+    if (type == TTelnetChunk::Text) {
+        mOutput(type, mText);
+        mText.clear();
+    } else if (type == TTelnetChunk::Command) {
+        mOutput(type, command);
+        command.clear();
+    } else {
+        std::string nothing;
+        mOutput(type, nothing);
+    }
+}
+
+void TTelnetDecoder::flushText()
+{
+    if (!mText.empty()) {
+        push(TTelnetChunk::Text);
+    }
+}
+
+void TTelnetDecoder::initStreamDecompressor()
+{
+    mZstream.zalloc = Z_NULL;
+    mZstream.zfree = Z_NULL;
+    mZstream.opaque = Z_NULL;
+    mZstream.avail_in = 0;
+    mZstream.next_in = Z_NULL;
+
+    inflateInit(&mZstream);
+    mNeedDecompression = true;
+}
+
+void TTelnetDecoder::endStreamDecompressor()
+{
+    inflateEnd(&mZstream);
+    mNeedDecompression = false;
+    // The option state is not ours so let whoever owns it know:
+    push(TTelnetChunk::CompressionEnded);
+}
+
+// Where the data is compressed it is inflated a piece at a time into
+// mInflateBuffer and each piece is then parsed in place from there:
+void TTelnetDecoder::receive(const char* data, size_t length)
+{
+    while (length) {
+        if (!mNeedDecompression) {
+            // parse(...) stops early, just after the sequence that marks the
+            // start of an MCCP stream, if it finds one:
+            size_t used = parse(data, length);
+            if (mIsRecording.load()) {
+                std::string raw(data, used);
+                mOutput(TTelnetChunk::Raw, raw);
+            }
+            data += used;
+            length -= used;
+            continue;
+        }
+
+        mZstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        mZstream.avail_in = static_cast<uInt>(length);
+        int zval;
+        do {
+            mZstream.next_out = reinterpret_cast<Bytef*>(mInflateBuffer.data());
+            mZstream.avail_out = static_cast<uInt>(mInflateBuffer.size());
+            QElapsedTimer inflateTimer;
+            inflateTimer.start();
+            zval = inflate(&mZstream, Z_SYNC_FLUSH);
+            mInflateTime = qMax(mInflateTime, Q_INT64_C(0)) + inflateTimer.nsecsElapsed();
+            size_t produced = mInflateBuffer.size() - mZstream.avail_out;
+            if (produced) {
+                if (mIsRecording.load()) {
+                    std::string raw(mInflateBuffer.data(), produced);
+                    mOutput(TTelnetChunk::Raw, raw);
+                }
+                parse(mInflateBuffer.data(), produced);
+            }
+            if (!mZstream.avail_out && mInflateBuffer.size() < csmMaxInflateBufferSize) {
+                // A big burst - fewer, larger, pieces will be more efficient:
+                mInflateBuffer.resize(mInflateBuffer.size() * 2);
+            }
+        } while (zval == Z_OK && (mZstream.avail_in || !mZstream.avail_out));
+
+        size_t consumed = length - mZstream.avail_in;
+        data += consumed;
+        length -= consumed;
+
+        if (zval == Z_STREAM_END) {
+            qDebug() << "recv Z_STREAM_END, ending compression";
+            endStreamDecompressor();
+            qDebug() << "Listening for new compression sequences";
+            // Anything left over is uncompressed and goes round again...
+        } else if (zval != Z_OK && zval != Z_BUF_ERROR) {
+            qWarning() << "TTelnetDecoder::receive(...) ERROR: decompression failed, zlib reports:" << zval << "- discarding remaining data in this packet!";
+            endStreamDecompressor();
+            return;
+        }
+    }
+}
+
+// Returns the number of bytes processed, which will be less than length only
+// if the start of an MCCP compressed stream was found:
+size_t TTelnetDecoder::parse(const char* data, const size_t length)
+{
+    size_t i = 0;
+    while (i < length) {
+        if (!(iac || iac2 || insb)) {
+            // Copy whole runs of ordinary text in one go:
+            size_t runEnd = i + TByteScanner::findTelnetSpecial(data + i, length - i);
+            if (runEnd > i) {
+                mText.append(data + i, runEnd - i);
+                i = runEnd;
+                continue;
+            }
+
+            char ch = data[i++];
+            if (ch == TN_IAC) {
+                iac = true;
+                command += ch;
+            } else if (ch == TN_BELL) {
+                push(TTelnetChunk::Bell);
+                mText += ch;
+            }
+            // Otherwise it is a <CR> or <NUL> which we drop
+            continue;
+        }
+
+        char ch = data[i++];
+        if (iac && (ch == TN_IAC) && (!insb)) {
+            //2. seq. of two IACs
+            iac = false;
+            mText += ch;
+            command.clear();
+        } else if (iac && (!insb) && ((ch == TN_WILL) || (ch == TN_WONT) || (ch == TN_DO) || (ch == TN_DONT))) {
+            //3. IAC DO/DONT/WILL/WONT
+            iac = false;
+            iac2 = true;
+            command += ch;
+        } else if (iac2) {
+            //4. IAC DO/DONT/WILL/WONT <command code>
+            iac2 = false;
+            command += ch;
+            flushText();
+            push(TTelnetChunk::Command);
+        } else if (iac && (!insb) && (ch == TN_SB)) {
+            //5. IAC SB
+            iac = false;
+            insb = true;
+            command += ch;
+        } else if (iac && (!insb) && (ch == TN_SE)) {
+            //6. IAC SE without IAC SB - error - ignored
+            command.clear();
+            iac = false;
+        } else if (insb) {
+            //7. inside IAC SB
+            command += ch;
+            // IAC SB COMPRESS WILL SE for MCCP v1 (unterminated invalid telnet sequence)
+            // IAC SB COMPRESS2 IAC SE for MCCP v2
+            // from just after these the data will be compressed by zlib:
+            if (!mNeedDecompression && mIsCompressionNegotiated.load() && command.size() == 5
+                && ((command[2] == OPT_COMPRESS && command[3] == TN_WILL && ch == TN_SE) || (command[2] == OPT_COMPRESS2 && command[3] == TN_IAC && ch == TN_SE))) {
+                qDebug() << "MCCP version" << (command[2] == OPT_COMPRESS ? 1 : 2) << "starting sequence";
+                flushText();
+                command.clear();
+                iac = false;
+                insb = false;
+                initStreamDecompressor();
+                return i;
+            }
+
+            if (iac && (ch == TN_SE)) //IAC SE - end of subcommand
+            {
+                flushText();
+                push(TTelnetChunk::Command);
+                iac = false;
+                insb = false;
+            }
+            if (iac) {
+                iac = false;
+            } else if (ch == TN_IAC) {
+                iac = true;
+            }
+        } else
+        //8. IAC fol. by something else than IAC, SB, SE, DO, DONT, WILL, WONT
+        {
+            iac = false;
+            command += ch;
+            // this could be a GA/EOR - the main thread handles that
+            flushText();
+            push(TTelnetChunk::Command);
+        }
+    }
+    return length;
+}
@@ -0,0 +1,129 @@
+#ifndef MUDLET_TTELNETDECODER_H
+#define MUDLET_TTELNETDECODER_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QtGlobal>
+#include "post_guard.h"
+
+#include <zlib.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// One unit of work handed from the network thread to the main thread, they
+// MUST be processed in the order they were produced:
+struct TTelnetChunk
+{
+    enum Type {
+        // Clean text (telnet commands and <CR>/<NUL> removed):
+        Text,
+        // A complete telnet command, "IAC ..." up to and including any
+        // "IAC SE" that terminates a sub-negotiation:
+        Command,
+        // A <BEL> was seen in the text (the byte itself stays in the Text):
+        Bell,
+        // The MCCP stream was closed by the server:
+        CompressionEnded,
+        // A copy of the (decompressed) bytes as read, for replay recording:
+        Raw
+    };
+
+    TTelnetChunk() : type(Text), receivedTime(0) {}
+    TTelnetChunk(Type t, std::string d = std::string()) : type(t), data(std::move(d)), receivedTime(0) {}
+
+    Type type;
+    std::string data;
+    // When the read that produced this was done, in milli-seconds since the
+    // epoch, zero if not known (e.g. for a replay):
+    qint64 receivedTime;
+};
+
+
+
+// The telnet protocol decoder: it is fed the bytes from the MUD server, in
+// whatever sized pieces they arrive, and inflates any MCCP stream and splits
+// the telnet commands out from the text. It knows nothing about sockets or
+// threads, so the live connection (in the network thread) and replay playback
+// (in the main thread) can both use it and get exactly the same results.
+class TTelnetDecoder
+{
+public:
+    // Is handed each chunk as it is produced and should take the contents of
+    // the data (e.g. by swapping it out), leaving it empty:
+    typedef std::function<void(TTelnetChunk::Type, std::string&)> Output;
+
+    explicit TTelnetDecoder(const Output& output);
+    ~TTelnetDecoder();
+
+    void receive(const char* data, size_t length);
+    // Passes on any text collected so far - call at the end of each lot of
+    // data so that it does not sit waiting for the next one:
+    void flushText();
+    // Forget any partial telnet command and any compressed stream:
+    void reset();
+
+    // These two are safe to call from any thread:
+    void setCompressionNegotiated(const bool state) { mIsCompressionNegotiated.store(state); }
+    void setRecording(const bool state) { mIsRecording.store(state); }
+
+    // The time (in nano-seconds) spent inflating MCCP data since the last
+    // call, or -1 if there was none:
+    qint64 takeInflateTime()
+    {
+        const qint64 time = mInflateTime;
+        mInflateTime = -1;
+        return time;
+    }
+
+private:
+    TTelnetDecoder(const TTelnetDecoder&) = delete;
+    TTelnetDecoder& operator=(const TTelnetDecoder&) = delete;
+
+    void initStreamDecompressor();
+    void endStreamDecompressor();
+    size_t parse(const char* data, const size_t length);
+    void push(TTelnetChunk::Type type);
+
+
+    Output mOutput;
+
+    // Grown as needed but never shrunk or freed until we are destroyed, so a
+    // steady stream of data does not need any allocations:
+    std::vector<char> mInflateBuffer;
+    // The text (since the last telnet command) that is being built up:
+    std::string mText;
+
+    z_stream mZstream;
+    bool mNeedDecompression;
+    std::string command;
+    bool iac, iac2, insb;
+    qint64 mInflateTime;
+
+    std::atomic<bool> mIsCompressionNegotiated;
+    std::atomic<bool> mIsRecording;
+};
+
+#endif // MUDLET_TTELNETDECODER_H
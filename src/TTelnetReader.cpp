@@ -0,0 +1,211 @@
+/***************************************************************************
+ *   Copyright (C) 2002-2005 by Tomas Mecir - kmuddy@kmuddy.com            *
+ *   Copyright (C) 2008-2013 by Heiko Koehn - KoehnHeiko@googlemail.com    *
+ *   Copyright (C) 2017 by Michael Hupp - darksix@northfire.org            *
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TTelnetReader.h"
+
+
+#include "pre_guard.h"
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QTcpSocket>
+#include <QThread>
+#include "post_guard.h"
+
+// Enough for many seconds of heavy spam - if the main thread falls further
+// behind than this we stop reading and let TCP flow control throttle the
+// server:
+static const size_t csmQueueCapacity = 4096;
+
+TTelnetReader::TTelnetReader()
+: QObject(nullptr)
+, mpSocket(nullptr)
+, mQueue(csmQueueCapacity)
+, mSpareBuffers(csmQueueCapacity)
+, mDecoder([this](TTelnetChunk::Type type, std::string& data) { push(type, data); })
+, mIsAwaitingResponse(false)
+, mReceivedTime(0)
+, mIsConnected(false)
+, mIsNotifyPending(false)
+, mIsStopping(false)
+{
+}
+
+// Called (in the network thread) once it has started, the socket must be
+// created here so that it has an affinity with THAT thread:
+void TTelnetReader::slot_init()
+{
+    mpSocket = new QTcpSocket(this);
+    connect(mpSocket, &QTcpSocket::connected, this, &TTelnetReader::slot_connected);
+    connect(mpSocket, &QTcpSocket::disconnected, this, &TTelnetReader::slot_disconnected);
+    connect(mpSocket, &QTcpSocket::readyRead, this, &TTelnetReader::slot_readyRead);
+    connect(mpSocket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), this, &TTelnetReader::slot_error);
+}
+
+void TTelnetReader::slot_connectToHost(const QString& address, const int port)
+{
+    if (mpSocket->state() != QAbstractSocket::UnconnectedState) {
+        mpSocket->abort();
+    }
+    mpSocket->connectToHost(address, static_cast<quint16>(port));
+}
+
+void TTelnetReader::slot_abort()
+{
+    if (mpSocket->state() != QAbstractSocket::UnconnectedState) {
+        mpSocket->abort();
+    }
+}
+
+void TTelnetReader::slot_disconnectFromHost()
+{
+    mpSocket->disconnectFromHost();
+}
+
+void TTelnetReader::slot_write(const QByteArray& data)
+{
+    if (!mpSocket->isWritable()) {
+        return;
+    }
+    // QTcpSocket buffers whatever it cannot send straight away:
+    mpSocket->write(data);
+    if (!mIsAwaitingResponse) {
+        mIsAwaitingResponse = true;
+        mResponseTimer.start();
+    }
+}
+
+void TTelnetReader::slot_connected()
+{
+    mDecoder.reset();
+    mIsConnected.store(true);
+    emit signal_connected();
+}
+
+void TTelnetReader::slot_disconnected()
+{
+    mIsConnected.store(false);
+    // Anything still sitting in the socket's buffer is still wanted:
+    slot_readyRead();
+    mDecoder.reset();
+    emit signal_disconnected(mpSocket->errorString());
+}
+
+void TTelnetReader::slot_error(const QAbstractSocket::SocketError error)
+{
+    // The server hanging up is reported as the reason for the disconnection:
+    if (error != QAbstractSocket::RemoteHostClosedError) {
+        // Taken now, from the socket, as it will have changed by the time
+        // the main thread gets this:
+        emit signal_error(mpSocket->errorString());
+    }
+}
+
+bool TTelnetReader::takeChunk(TTelnetChunk& chunk)
+{
+    return mQueue.tryPop(chunk);
+}
+
+void TTelnetReader::recycle(std::string& spent)
+{
+    if (spent.capacity()) {
+        // If there are already plenty spare this one just gets freed later:
+        std::string buffer;
+        buffer.swap(spent);
+        mSpareBuffers.tryPush(std::move(buffer));
+    }
+}
+
+void TTelnetReader::notify()
+{
+    // Only one notification is needed no matter how much data is queued
+    // before the main thread gets around to processing it:
+    if (!mIsNotifyPending.exchange(true)) {
+        emit signal_dataAvailable();
+    }
+}
+
+void TTelnetReader::push(TTelnetChunk::Type type, std::string& data)
+{
+    TTelnetChunk chunk(type);
+    chunk.data.swap(data);
+    chunk.receivedTime = mReceivedTime;
+    if (type == TTelnetChunk::Text) {
+        // Pick up an already allocated buffer for the next lot if there is one:
+        mSpareBuffers.tryPop(data);
+    }
+    while (!mQueue.tryPush(std::move(chunk))) {
+        // The main thread has fallen a long way behind - make sure that it
+        // knows there is work waiting and give it a chance to catch up:
+        if (mIsStopping.load()) {
+            return;
+        }
+        notify();
+        QThread::usleep(200);
+    }
+}
+
+void TTelnetReader::slot_readyRead()
+{
+    qint64 available;
+    while ((available = mpSocket->bytesAvailable()) > 0) {
+        if (mReadBuffer.size() < static_cast<size_t>(available)) {
+            mReadBuffer.resize(static_cast<size_t>(available));
+        }
+        qint64 amount = mpSocket->read(mReadBuffer.data(), available);
+        if (amount <= 0) {
+            break;
+        }
+
+        const qint64 responseTime = mIsAwaitingResponse ? mResponseTimer.nsecsElapsed() / 1000 : -1;
+        mIsAwaitingResponse = false;
+        mReceivedTime = QDateTime::currentMSecsSinceEpoch();
+
+        mDecoder.receive(mReadBuffer.data(), static_cast<size_t>(amount));
+        mDecoder.flushText();
+        notify();
+
+        const qint64 inflateTime = mDecoder.takeInflateTime();
+        QMutexLocker locker(&mStatisticsLock);
+        if (responseTime >= 0) {
+            mStatistics.record(TConnectionStatistics::CommandLatency, responseTime);
+        }
+        mStatistics.record(TConnectionStatistics::BytesPerRead, amount);
+        if (inflateTime >= 0) {
+            mStatistics.record(TConnectionStatistics::InflateTime, inflateTime / 1000);
+        }
+    }
+}
+
+void TTelnetReader::copyStatistics(TConnectionStatistics& statistics) const
+{
+    QMutexLocker locker(&mStatisticsLock);
+    for (auto metric : {TConnectionStatistics::CommandLatency, TConnectionStatistics::BytesPerRead, TConnectionStatistics::InflateTime}) {
+        statistics.histogram(metric) = mStatistics.histogram(metric);
+    }
+}
+
+void TTelnetReader::resetStatistics()
+{
+    QMutexLocker locker(&mStatisticsLock);
+    mStatistics.reset();
+}
@@ -0,0 +1,122 @@
+#ifndef MUDLET_TTELNETREADER_H
+#define MUDLET_TTELNETREADER_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TConnectionStatistics.h"
+#include "TSpscQueue.h"
+#include "TTelnetDecoder.h"
+
+#include "pre_guard.h"
+#include <QAbstractSocket>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include "post_guard.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+class QTcpSocket;
+
+
+// Owns the socket for a cTelnet instance and lives in a per-connection
+// network thread: it reads from the socket and feeds the data through a
+// TTelnetDecoder; the results are passed to the main thread through a
+// lock-free queue so that only triggers, Lua and rendering are left for the
+// GUI thread to do.
+// Everything in the "public slots" section must only be reached via queued
+// signals (or QMetaObject::invokeMethod(...)) from other threads!
+class TTelnetReader : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_DISABLE_COPY(TTelnetReader)
+    TTelnetReader();
+
+    // These are safe to call from the main thread:
+    bool takeChunk(TTelnetChunk& chunk);
+    // Hand back the storage of a chunk's data once it has been used so that
+    // the network thread can fill it again rather than allocating more:
+    void recycle(std::string& spent);
+    void clearDataAvailable() { mIsNotifyPending.store(false); }
+    bool isConnected() const { return mIsConnected.load(); }
+    void setCompressionNegotiated(const bool state) { mDecoder.setCompressionNegotiated(state); }
+    void setRecording(const bool state) { mDecoder.setRecording(state); }
+    void stop() { mIsStopping.store(true); }
+    // Copies the measurements taken in the network thread into statistics:
+    void copyStatistics(TConnectionStatistics& statistics) const;
+    void resetStatistics();
+
+public slots:
+    void slot_init();
+    void slot_connectToHost(const QString& address, const int port);
+    void slot_abort();
+    void slot_disconnectFromHost();
+    void slot_write(const QByteArray& data);
+
+signals:
+    void signal_connected();
+    void signal_disconnected(const QString& reason);
+    // For an error that is not reported by signal_disconnected(...):
+    void signal_error(const QString& message);
+    void signal_dataAvailable();
+
+private slots:
+    void slot_connected();
+    void slot_disconnected();
+    void slot_error(QAbstractSocket::SocketError error);
+    void slot_readyRead();
+
+private:
+    // Takes the contents of data, leaving it empty or with some spare storage:
+    void push(TTelnetChunk::Type type, std::string& data);
+    void notify();
+
+
+    QTcpSocket* mpSocket;
+    TSpscQueue<TTelnetChunk> mQueue;
+    // Storage returned by the main thread for reuse:
+    TSpscQueue<std::string> mSpareBuffers;
+    // Grown as needed but never shrunk:
+    std::vector<char> mReadBuffer;
+    TTelnetDecoder mDecoder;
+
+    // Only the CommandLatency, BytesPerRead and InflateTime ones are used:
+    TConnectionStatistics mStatistics;
+    mutable QMutex mStatisticsLock;
+    // Started when something is written whilst not already waiting for a
+    // response, and read when the next data arrives:
+    QElapsedTimer mResponseTimer;
+    bool mIsAwaitingResponse;
+    // Wall-clock time of the current read, given to each chunk it produces:
+    qint64 mReceivedTime;
+
+    std::atomic<bool> mIsConnected;
+    std::atomic<bool> mIsNotifyPending;
+    std::atomic<bool> mIsStopping;
+};
+
+#endif // MUDLET_TTELNETREADER_H
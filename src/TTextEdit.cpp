@@ -44,6 +44,7 @@
 #include <QTextBoundaryFinder>
 #include <QTextCursor>
 #include <QToolTip>
+#include <QVarLengthArray>
 #include "post_guard.h"
 
 
@@ -69,6 +70,7 @@ TTextEdit::TTextEdit(TConsole* pC, QWidget* pW, TBuffer* pB, Host* pH, bool isDe
 , mpHost(pH)
 , mpScrollBar(nullptr)
 , mIsAmbigousWidthGlyphsToBeWide(pH->getUseWideAmbiguousEAsianGlyphs())
+, mSearchHighlightLine(-1)
 {
     mLastClickTimer.start();
     if (!mIsDebugConsole) {
@@ -183,6 +185,9 @@ void TTextEdit::slot_scrollBarMoved(int line)
 {
     if (mpConsole->mpScrollBar) {
         disconnect(mpConsole->mpScrollBar, SIGNAL(valueChanged(int)), this, SLOT(slot_scrollBarMoved(int)));
+        if (line < mScreenHeight) {
+            line += restoreArchivedLines();
+        }
         mpConsole->mpScrollBar->setRange(0, mpBuffer->getLastLineNumber());
         mpConsole->mpScrollBar->setSingleStep(1);
         mpConsole->mpScrollBar->setPageStep(mScreenHeight);
@@ -304,6 +309,9 @@ void TTextEdit::updateScreenView()
     } else {
         mScreenWidth = currentScreenWidth;
     }
+    if (!mIsLowerPane) {
+        mpBuffer->setVisibleLineCount(mScreenHeight);
+    }
 }
 
 void TTextEdit::showNewLines()
@@ -380,6 +388,10 @@ void TTextEdit::scrollUp(int lines)
         return;
     }
 
+    if (mpBuffer->mCursorY - lines < mScreenHeight) {
+        restoreArchivedLines();
+    }
+
     if (bufferScrollUp(lines)) {
         mIsTailMode = false;
         mScrollVector = 0;
@@ -387,6 +399,24 @@ void TTextEdit::scrollUp(int lines)
     }
 }
 
+// Brings back the most recently archived batch of lines, if the buffer has
+// any, when the (upper pane) view is about to reach the top of those still in
+// memory - and moves everything else that refers to a line down to match:
+int TTextEdit::restoreArchivedLines()
+{
+    const int count = mpBuffer->restoreArchivedLines();
+    if (count > 0) {
+        mPA.ry() += count;
+        mPB.ry() += count;
+        mpConsole->mUserCursor.ry() += count;
+        mpConsole->P_begin.ry() += count;
+        mpConsole->P_end.ry() += count;
+        mpConsole->mLowerPane->mCursorY += count;
+        mForceUpdate = true;
+    }
+    return count;
+}
+
 void TTextEdit::scrollDown(int lines)
 {
     if (mIsLowerPane) {
@@ -457,16 +487,16 @@ void TTextEdit::drawFrame(QPainter& p, const QRect& rect)
             break;
         }
         int timeOffset = 0;
+        QString timeStamp;
         if (mShowTimeStamps) {
-            if (mpBuffer->timeBuffer.size() > i + lineOffset) {
-                timeOffset = mpBuffer->timeBuffer[i + lineOffset].size() - 1;
-            }
+            timeStamp = mpBuffer->timeStamp(i + lineOffset);
+            timeOffset = timeStamp.size() - 1;
         }
         int lineLength = mpBuffer->buffer[i + lineOffset].size() + timeOffset;
         for (int i2 = x1; i2 < lineLength;) {
             QString text;
             if (i2 < timeOffset) {
-                text = mpBuffer->timeBuffer[i + lineOffset];
+                text = timeStamp;
                 bool isBold = false;
                 bool isUnderline = false;
                 bool isItalics = false;
@@ -538,12 +568,17 @@ void TTextEdit::updateLastLine()
 
 inline uint TTextEdit::getGraphemeBaseCharacter(const QString& str)
 {
-    if (str.isEmpty()) {
+    return getGraphemeBaseCharacter(str.constData(), str.size());
+}
+
+inline uint TTextEdit::getGraphemeBaseCharacter(const QChar* str, const int size)
+{
+    if (size <= 0) {
         return 0;
     }
-    QChar first = str.at(0);
-    if (first.isSurrogate() && str.size() >= 2) {
-        QChar second = str.at(1);
+    QChar first = str[0];
+    if (first.isSurrogate() && size >= 2) {
+        QChar second = str[1];
         if (first.isHighSurrogate() && second.isLowSurrogate()) {
             return QChar::surrogateToUcs4(first, second);
         } else if (first.isLowSurrogate() && second.isHighSurrogate()) {
@@ -571,22 +606,101 @@ void TTextEdit::drawLine(QPainter& painter, int lineNumber, int lineOfScreen)
         timeStampStyle.fgR = 200;
         timeStampStyle.fgG = 150;
         timeStampStyle.fgB = 0;
-        QString timestamp = mpBuffer->timeBuffer[lineNumber];
+        QString timestamp = mpBuffer->timeStamp(lineNumber);
         for (QChar c : timestamp) {
             cursor.setX(cursor.x() + drawGrapheme(painter, cursor, c, 0, timeStampStyle));
         }
     }
 
+    // The graphemes are measured first so that the background can then be
+    // filled a run at a time - a run being a stretch of graphemes that share
+    // a background colour, of which most lines only have a few - before the
+    // text is drawn over it, rather than one cell at a time:
+    QVarLengthArray<int, 256> graphemeStarts;
+    QVarLengthArray<int, 256> graphemeWidths;
     int columnWithOutTimestamp = 0;
     for (int indexOfChar = 0; indexOfChar < lineText.size();) {
         int nextBoundary = boundaryFinder.toNextBoundary();
-
-        TChar &charStyle = mpBuffer->buffer[lineNumber][indexOfChar];
-        int graphemeWidth = drawGrapheme(painter, cursor, lineText.mid(indexOfChar, nextBoundary - indexOfChar), columnWithOutTimestamp, charStyle);
-        cursor.setX(cursor.x() + graphemeWidth);
+        if (nextBoundary <= indexOfChar) {
+            nextBoundary = lineText.size();
+        }
+        int width = graphemeWidth(getGraphemeBaseCharacter(lineText.constData() + indexOfChar, nextBoundary - indexOfChar), columnWithOutTimestamp);
+        graphemeStarts.append(indexOfChar);
+        graphemeWidths.append(width);
         indexOfChar = nextBoundary;
-        columnWithOutTimestamp += graphemeWidth;
+        columnWithOutTimestamp += width;
+    }
+    const int graphemeCount = graphemeWidths.size();
+    graphemeStarts.append(lineText.size());
+
+    std::deque<TChar>& lineStyle = mpBuffer->buffer[lineNumber];
+    const bool hasSearchHighlights = !mSearchHighlights.isEmpty() && lineNumber + mpBuffer->trimmedLineCount() == mSearchHighlightLine;
+    auto styleOf = [&](const int grapheme) {
+        TChar style = lineStyle[graphemeStarts[grapheme]];
+        if (hasSearchHighlights) {
+            for (const auto& match : mSearchHighlights) {
+                if (graphemeStarts[grapheme] >= match.first && graphemeStarts[grapheme] < match.first + match.second) {
+                    style.fgR = 0;
+                    style.fgG = 0;
+                    style.fgB = 0;
+                    style.bgR = 255;
+                    style.bgG = 255;
+                    style.bgB = 0;
+                    style.flags &= ~TCHAR_INVERSE;
+                    break;
+                }
+            }
+        }
+        return style;
+    };
+    auto backgroundOf = [](const TChar& style) {
+        return (style.flags & TCHAR_INVERSE) ? QColor(style.fgR, style.fgG, style.fgB) : QColor(style.bgR, style.bgG, style.bgB);
+    };
+    const int lineStart = cursor.x();
+    int runStart = lineStart;
+    int runEnd = lineStart;
+    QColor runColor;
+    for (int i = 0; i < graphemeCount; ++i) {
+        const QColor bgColor = backgroundOf(styleOf(i));
+        if (i && bgColor != runColor) {
+            drawBackground(painter, QRect(mFontWidth * runStart, mFontHeight * cursor.y(), mFontWidth * (runEnd - runStart), mFontHeight), runColor);
+            runStart = runEnd;
+        }
+        runColor = bgColor;
+        runEnd += graphemeWidths[i];
+    }
+    if (runEnd > runStart) {
+        drawBackground(painter, QRect(mFontWidth * runStart, mFontHeight * cursor.y(), mFontWidth * (runEnd - runStart), mFontHeight), runColor);
+    }
+
+    for (int i = 0; i < graphemeCount; ++i) {
+        TChar charStyle = styleOf(i);
+        const int start = graphemeStarts[i];
+        const int length = graphemeStarts[i + 1] - start;
+        // A plain space has nothing to draw over its background:
+        if (!(length == 1 && lineText.at(start) == cSPACE && !(charStyle.flags & (TCHAR_UNDERLINE | TCHAR_STRIKEOUT)))) {
+            drawGraphemeText(painter, cursor, lineText.mid(start, length), charStyle);
+        }
+        cursor.setX(cursor.x() + graphemeWidths[i]);
+    }
+}
+
+void TTextEdit::setSearchHighlight(const int line, const QVector<QPair<int, int>>& matches)
+{
+    mSearchHighlightLine = line;
+    mSearchHighlights = matches;
+    forceUpdate();
+}
+
+int TTextEdit::graphemeWidth(const uint unicode, const int column) const
+{
+    if (unicode == '\t') {
+        return column / 8 * 8 + 8;
+    }
+    if (mIsAmbigousWidthGlyphsToBeWide) {
+        return mk_wcwidth_cjk(unicode) == 2 ? 2 : 1;
     }
+    return mk_wcwidth(unicode) == 2 ? 2 : 1;
 }
 
 /**
@@ -600,18 +714,26 @@ void TTextEdit::drawLine(QPainter& painter, int lineNumber, int lineOfScreen)
  */
 int TTextEdit::drawGrapheme(QPainter &painter, const QPoint &cursor, const QString &grapheme, int column, TChar &charStyle)
 {
-    uint unicode = getGraphemeBaseCharacter(grapheme);
-    int charWidth;
-    if (unicode == '\t') {
-        charWidth = column / 8 * 8 + 8;
+    int charWidth = graphemeWidth(getGraphemeBaseCharacter(grapheme), column);
+
+    QColor bgColor;
+    if (charStyle.flags & TCHAR_INVERSE) {
+        bgColor = QColor(charStyle.fgR, charStyle.fgG, charStyle.fgB);
     } else {
-        if (mIsAmbigousWidthGlyphsToBeWide) {
-            charWidth = mk_wcwidth_cjk(unicode) == 2 ? 2 : 1;
-        } else {
-            charWidth = mk_wcwidth(unicode) == 2 ? 2 : 1;
-        }
+        bgColor = QColor(charStyle.bgR, charStyle.bgG, charStyle.bgB);
     }
+    auto textRect = QRect(mFontWidth * cursor.x(), mFontHeight * cursor.y(),
+                          mFontWidth * charWidth, mFontHeight);
+    drawBackground(painter, textRect, bgColor);
 
+    drawGraphemeText(painter, cursor, grapheme, charStyle);
+    return charWidth;
+}
+
+// Draws just the text of a grapheme, the background is expected to have been
+// drawn already:
+void TTextEdit::drawGraphemeText(QPainter& painter, const QPoint& cursor, const QString& grapheme, TChar& charStyle)
+{
     bool isBold = charStyle.flags & TCHAR_BOLD;
     bool isUnderline = charStyle.flags & TCHAR_UNDERLINE;
     bool isItalics = charStyle.flags & TCHAR_ITALICS;
@@ -628,25 +750,17 @@ int TTextEdit::drawGrapheme(QPainter &painter, const QPoint &cursor, const QStri
         painter.setFont(font);
     }
 
-    QColor bgColor, fgColor;
+    QColor fgColor;
     if (charStyle.flags & TCHAR_INVERSE) {
-        bgColor = QColor(charStyle.fgR, charStyle.fgG, charStyle.fgB);
         fgColor = QColor(charStyle.bgR, charStyle.bgG, charStyle.bgB);
     } else {
         fgColor = QColor(charStyle.fgR, charStyle.fgG, charStyle.fgB);
-        bgColor = QColor(charStyle.bgR, charStyle.bgG, charStyle.bgB);
     }
-
-    auto textRect = QRect(mFontWidth * cursor.x(), mFontHeight * cursor.y(),
-                          mFontWidth * charWidth, mFontHeight);
-    drawBackground(painter, textRect, bgColor);
-
     if (painter.pen().color() != fgColor) {
         painter.setPen(fgColor);
     }
 
-    painter.drawText(textRect.x(), textRect.bottom() - mFontDescent, grapheme);
-    return charWidth;
+    painter.drawText(mFontWidth * cursor.x(), mFontHeight * (cursor.y() + 1) - 1 - mFontDescent, grapheme);
 }
 
 void TTextEdit::drawForeground(QPainter& painter, const QRect& r)
@@ -776,6 +890,9 @@ void TTextEdit::paintEvent(QPaintEvent* e)
     QRect borderRect2 = QRect(rect.width() - mScreenWidth, 0, rect.width(), rect.height());
     drawBackground(painter, borderRect2, mBgColor);
     drawForeground(painter, rect);
+    if (mIsLowerPane) {
+        mpConsole->painted();
+    }
 }
 
 
@@ -26,8 +26,10 @@
 
 #include "pre_guard.h"
 #include <QMap>
+#include <QPair>
 #include <QPointer>
 #include <QTime>
+#include <QVector>
 #include <QWidget>
 #include "post_guard.h"
 
@@ -56,8 +58,11 @@ public:
     void drawBackground(QPainter&, const QRect&, const QColor&);
     void updateLastLine();
     uint getGraphemeBaseCharacter(const QString& str);
+    uint getGraphemeBaseCharacter(const QChar* str, int size);
     void drawLine(QPainter &painter, int lineNumber, int rowOfScreen);
     int drawGrapheme(QPainter &painter, const QPoint &cursor, const QString &c, int column, TChar &style);
+    int graphemeWidth(uint unicode, int column) const;
+    void drawGraphemeText(QPainter& painter, const QPoint& cursor, const QString& grapheme, TChar& style);
     void drawCharacters(QPainter& painter, const QRect& rect, QString& text, bool isBold, bool isUnderline, bool isItalics, bool isStrikeOut, QColor& fgColor, QColor& bgColor);
     void showNewLines();
     void forceUpdate();
@@ -87,6 +92,11 @@ public:
     void searchSelectionOnline();
     int getColumnCount();
     int getRowCount();
+    // The line is a session one (see TBuffer::trimmedLineCount()) and each
+    // match is a start and length in it; they are drawn over the text rather
+    // than changing its formatting:
+    void setSearchHighlight(int line, const QVector<QPair<int, int>>& matches);
+    int restoreArchivedLines();
 
     QColor mBgColor;
     int mCursorY;
@@ -155,6 +165,8 @@ private:
     int mScreenWidth;
     QTime mLastClickTimer;
     bool mIsAmbigousWidthGlyphsToBeWide;
+    int mSearchHighlightLine;
+    QVector<QPair<int, int>> mSearchHighlights;
 };
 
 #endif // MUDLET_TTEXTEDIT_H
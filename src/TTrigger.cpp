@@ -25,6 +25,7 @@
 
 
 #include "Host.h"
+#include "TBenchmark.h"
 #include "TConsole.h"
 #include "TDebug.h"
 #include "TMatchState.h"
@@ -43,6 +44,11 @@ using namespace std;
 
 const QString nothing = "";
 
+quint64 TTrigger::smRegexVersionCounter = 0;
+
+// Fewer patterns than this are not worth scanning for together:
+static const int scmMinChildPatternScanSize = 4;
+
 TTrigger::TTrigger( TTrigger * parent, Host * pHost )
 : Tree<TTrigger>( parent )
 , mTriggerContainsPerlRegex( false )
@@ -57,6 +63,9 @@ TTrigger::TTrigger( TTrigger * parent, Host * pHost )
 , mpHost( pHost )
 , exportItem(true)
 , mModuleMasterFolder(false)
+, mChildPatternScanGeneration(0)
+, mIsChildPatternScanUsable(false)
+, mRegexVersion(++smRegexVersionCounter)
 , mNeedsToBeCompiled(true)
 , mTriggerType(REGEX_SUBSTRING)
 
@@ -93,6 +102,9 @@ TTrigger::TTrigger(const QString& name, QStringList regexList, QList<int> regexP
 , exportItem(true)
 , mModuleMasterFolder(false)
 , mRegexCodePropertyList(regexProperyList)
+, mChildPatternScanGeneration(0)
+, mIsChildPatternScanUsable(false)
+, mRegexVersion(++smRegexVersionCounter)
 , mNeedsToBeCompiled(true)
 , mTriggerType(REGEX_SUBSTRING)
 , mIsLineTrigger(false)
@@ -117,6 +129,7 @@ TTrigger::~TTrigger()
     if (!mpHost) {
         return;
     }
+    releasePrefilterIds();
     mpHost->getTriggerUnit()->unregisterTrigger(this);
 }
 
@@ -130,11 +143,6 @@ void TTrigger::setName(const QString& name)
     mpHost->getTriggerUnit()->mLookupTable.insertMulti(name, this);
 }
 
-static void pcre_deleter(pcre* pointer)
-{
-    pcre_free(pointer);
-}
-
 //FIXME: sperren, wenn code nicht compiliert werden kann *ODER* regex falsch
 bool TTrigger::setRegexCodeList(QStringList regexList, QList<int> propertyList)
 {
@@ -145,6 +153,9 @@ bool TTrigger::setRegexCodeList(QStringList regexList, QList<int> propertyList)
     mLuaConditionMap.clear();
     mColorPatternList.clear();
     mTriggerContainsPerlRegex = false;
+    releasePrefilterIds();
+    mChildPatternScanIds.clear();
+    mRegexVersion = ++smRegexVersionCounter;
 
     if (propertyList.size() != regexList.size()) {
         //FIXME: ronny hat das irgendwie geschafft
@@ -168,22 +179,20 @@ bool TTrigger::setRegexCodeList(QStringList regexList, QList<int> propertyList)
         mRegexCodePropertyList.append(propertyList.at(i));
 
         if (propertyList.at(i) == REGEX_PERL) {
-            const char* error;
-            const QByteArray& regexp = regexList.at(i).toUtf8();
-
-            int erroffset;
+            const QString& regexp = regexList.at(i);
+            QString error;
 
             // PCRE_UTF8 needed to run compile in UTF-8 mode
             // PCRE_UCP needed for \d, \w etc. to use Unicode properties:
-            QSharedPointer<pcre> re(pcre_compile(regexp.constData(), PCRE_UTF8 | PCRE_UCP, &error, &erroffset, nullptr), pcre_deleter);
+            QSharedPointer<TRegex> re = TRegex::compile(regexp, PCRE_UTF8 | PCRE_UCP, error);
 
             if (!re) {
                 if (mudlet::debugMode) {
                     TDebug(QColor(Qt::white), QColor(Qt::red)) << "REGEX ERROR: failed to compile, reason:\n" << error << "\n" >> 0;
-                    TDebug(QColor(Qt::red), QColor(Qt::gray)) << R"(in: ")" << regexp.constData() << "\"\n" >> 0;
+                    TDebug(QColor(Qt::red), QColor(Qt::gray)) << R"(in: ")" << regexp << "\"\n" >> 0;
                 }
                 setError(QStringLiteral("<b><font color='blue'>%1</font></b>")
-                                 .arg(tr(R"(Error: in item %1, perl regex: "%2", it failed to compile, reason: "%3".)").arg(QString::number(i), regexp.constData(), error)));
+                                 .arg(tr(R"(Error: in item %1, perl regex: "%2", it failed to compile, reason: "%3".)").arg(QString::number(i), regexp, error)));
                 state = false;
             } else {
                 if (mudlet::debugMode) {
@@ -238,6 +247,25 @@ bool TTrigger::setRegexCodeList(QStringList regexList, QList<int> propertyList)
             mColorPatternList.push_back(nullptr);
         }
     }
+
+    TTriggerPrefilter& prefilter = mpHost->getTriggerUnit()->mPrefilter;
+    for (int i = 0; i < mRegexCodeList.size(); ++i) {
+        switch (mRegexCodePropertyList.at(i)) {
+        case REGEX_SUBSTRING:
+        case REGEX_BEGIN_OF_LINE_SUBSTRING:
+        case REGEX_EXACT_MATCH:
+            mPrefilterIds.append(prefilter.addPattern(mRegexCodeList.at(i)));
+            break;
+        case REGEX_PERL:
+            // addPattern(...) gives -1 for the regexes that nothing could be
+            // found in, they are listed by TriggerUnit::assembleReport():
+            mPrefilterIds.append(prefilter.addPattern(TTriggerPrefilter::requiredLiteral(mRegexCodeList.at(i))));
+            break;
+        default:
+            mPrefilterIds.append(-1);
+        }
+    }
+
     if (!state) {
         mOK_init = false;
     } else {
@@ -246,11 +274,117 @@ bool TTrigger::setRegexCodeList(QStringList regexList, QList<int> propertyList)
     return state;
 }
 
+// The Perl regex patterns that have to be run on every line as no text that
+// they need could be found in them:
+QStringList TTrigger::unfilteredPatterns() const
+{
+    QStringList patterns;
+    for (int i = 0; i < mRegexCodeList.size(); ++i) {
+        if (mRegexCodePropertyList.at(i) == REGEX_PERL && (i >= mPrefilterIds.size() || mPrefilterIds.at(i) < 0)) {
+            patterns << mRegexCodeList.at(i);
+        }
+    }
+    return patterns;
+}
+
+void TTrigger::releasePrefilterIds()
+{
+    TTriggerPrefilter& prefilter = mpHost->getTriggerUnit()->mPrefilter;
+    for (const int id : mPrefilterIds) {
+        prefilter.removePattern(id);
+    }
+    mPrefilterIds.clear();
+}
+
+// Whether the trigger unit has already found that a literal pattern (or the
+// text that a regex needs) is not in the line, in which case it cannot match
+// and need not be looked for again:
+bool TTrigger::isRuledOut(const QString& toMatch, const int patternNumber) const
+{
+    if (patternNumber < mPrefilterIds.size() && mPrefilterIds.at(patternNumber) > -1) {
+        const TTriggerPrefilter& prefilter = mpHost->getTriggerUnit()->mPrefilter;
+        if (prefilter.isScanned(toMatch) && !prefilter.isFound(mPrefilterIds.at(patternNumber))) {
+            return true;
+        }
+    }
+    return mpParent && patternNumber < mChildPatternScanIds.size() && mpParent->isChildPatternRuledOut(toMatch, mChildPatternScanIds.at(patternNumber));
+}
+
+// Makes sure that the scan of the children's Perl regexes, if one is wanted,
+// is the one for the children and patterns that there are now:
+void TTrigger::prepareChildPatternScan()
+{
+    if (!mpHost->mIsTriggerGroupScanEnabled) {
+        if (!mChildPatternScanMembers.isEmpty()) {
+            mpChildPatternScan.reset();
+            mChildPatternScanMembers.clear();
+            for (auto trigger : *mpMyChildrenList) {
+                trigger->mChildPatternScanIds.clear();
+            }
+        }
+        return;
+    }
+
+    bool isCurrent = mChildPatternScanMembers.size() == static_cast<int>(mpMyChildrenList->size());
+    if (isCurrent) {
+        int i = 0;
+        for (auto trigger : *mpMyChildrenList) {
+            const QPair<TTrigger*, quint64>& member = mChildPatternScanMembers.at(i++);
+            if (member.first != trigger || member.second != trigger->mRegexVersion) {
+                isCurrent = false;
+                break;
+            }
+        }
+    }
+    if (isCurrent) {
+        return;
+    }
+
+    mpChildPatternScan.reset(new TRegexSet);
+    mChildPatternScanMembers.clear();
+    mChildPatternScanGeneration = 0;
+    for (auto trigger : *mpMyChildrenList) {
+        mChildPatternScanMembers.append(qMakePair(trigger, trigger->mRegexVersion));
+        trigger->mChildPatternScanIds.clear();
+        for (int i = 0; i < trigger->mRegexCodeList.size(); ++i) {
+            // The ones that cannot be scanned for (-1) are just run as usual:
+            trigger->mChildPatternScanIds.append(trigger->mRegexCodePropertyList.at(i) == REGEX_PERL ? mpChildPatternScan->addPattern(trigger->mRegexCodeList.at(i)) : -1);
+        }
+    }
+    if (mpChildPatternScan->patternCount() < scmMinChildPatternScanSize) {
+        mpChildPatternScan.reset();
+        for (auto trigger : *mpMyChildrenList) {
+            trigger->mChildPatternScanIds.clear();
+        }
+    }
+}
+
+// Whether the scan of the children's Perl regexes has found that the one with
+// the id cannot match the line, the line is only scanned for them (once) if
+// one of them is asked about:
+bool TTrigger::isChildPatternRuledOut(const QString& toMatch, const int id)
+{
+    if (!mpChildPatternScan || id < 0) {
+        return false;
+    }
+    // As with TTriggerPrefilter the text passed down a filter chain is not
+    // the line, only the line is scanned:
+    const TTriggerPrefilter& prefilter = mpHost->getTriggerUnit()->mPrefilter;
+    if (!prefilter.isScanned(toMatch)) {
+        return false;
+    }
+    if (mChildPatternScanGeneration != prefilter.scanGeneration()) {
+        mChildPatternScanGeneration = prefilter.scanGeneration();
+        mIsChildPatternScanUsable = mpChildPatternScan->scan(toMatch);
+    }
+    return mIsChildPatternScanUsable && !mpChildPatternScan->mayMatch(id);
+}
+
 bool TTrigger::match_perl(char* subject, const QString& toMatch, int regexNumber, int posOffset)
 {
     assert(mRegexMap.contains(regexNumber));
 
-    QSharedPointer<pcre> re = mRegexMap[regexNumber];
+    QSharedPointer<TRegex> re = mRegexMap[regexNumber];
 
     if (!re) {
         if (mudlet::debugMode) {
@@ -273,7 +407,7 @@ bool TTrigger::match_perl(char* subject, const QString& toMatch, int regexNumber
     std::list<int> posList;
     int ovector[300]; // 100 capture groups max (can be increase nbGroups=1/3 ovector
 
-    rc = pcre_exec(re.data(), nullptr, subject, subject_length, 0, 0, ovector, 100);
+    rc = re->exec(subject, subject_length, 0, 0, ovector, 100, &mpHost->getTriggerUnit()->mJitStack);
 
     if (rc < 0) {
         return false;
@@ -303,15 +437,15 @@ bool TTrigger::match_perl(char* subject, const QString& toMatch, int regexNumber
             TDebug(QColor(Qt::darkMagenta), QColor(Qt::black)) << "<" << match.c_str() << ">\n" >> 0;
         }
     }
-    pcre_fullinfo(re.data(), nullptr, PCRE_INFO_NAMECOUNT, &namecount);
+    re->fullInfo(PCRE_INFO_NAMECOUNT, &namecount);
 
     if (namecount <= 0) {
         ;// Do something?
     } else {
         unsigned char* tabptr;
-        pcre_fullinfo(re.data(), nullptr, PCRE_INFO_NAMETABLE, &name_table);
+        re->fullInfo(PCRE_INFO_NAMETABLE, &name_table);
 
-        pcre_fullinfo(re.data(), nullptr, PCRE_INFO_NAMEENTRYSIZE, &name_entry_size);
+        re->fullInfo(PCRE_INFO_NAMEENTRYSIZE, &name_entry_size);
 
         tabptr = name_table;
         for (i = 0; i < namecount; i++) {
@@ -333,7 +467,7 @@ bool TTrigger::match_perl(char* subject, const QString& toMatch, int regexNumber
             options = PCRE_NOTEMPTY | PCRE_ANCHORED;
         }
 
-        rc = pcre_exec(re.data(), nullptr, subject, subject_length, start_offset, options, ovector, 30);
+        rc = re->exec(subject, subject_length, start_offset, options, ovector, 30, &mpHost->getTriggerUnit()->mJitStack);
 
         if (rc == PCRE_ERROR_NOMATCH) {
             if (options == 0) {
@@ -820,7 +954,9 @@ bool TTrigger::match(char* subject, const QString& toMatch, int line, int posOff
     bool ret = false;
     if (isActive()) {
         if (mIsLineTrigger) {
+            ++mProfile.evaluations;
             if (--mStartOfLineDelta < 0) {
+                ++mProfile.matches;
                 execute();
                 if (--mLineDelta <= 0) {
                     deactivate();
@@ -835,6 +971,13 @@ bool TTrigger::match(char* subject, const QString& toMatch, int line, int posOff
             return false;
         }
 
+        ++mProfile.evaluations;
+        TriggerUnit* pTriggerUnit = mpHost->getTriggerUnit();
+        // Only started once a pattern is actually tried, so that the many
+        // triggers that the prefilters rule out cost next to nothing more:
+        bool isProfileTiming = false;
+        TriggerUnit::ProfileMark profileMark = {0, 0};
+
         bool conditionMet = false;
 
         int highestCondition = 0;
@@ -854,38 +997,46 @@ bool TTrigger::match(char* subject, const QString& toMatch, int line, int posOff
                 break;
             }
             ret = false;
-            switch (mRegexCodePropertyList.value(patternNumber)) {
-            case REGEX_SUBSTRING:
-                ret = match_substring(toMatch, mRegexCodeList[patternNumber], patternNumber, posOffset);
-                break;
+            // The ruled out patterns are no different from ones that did not
+            // match as far as the policy below is concerned:
+            if (!isRuledOut(toMatch, patternNumber)) {
+                if (!isProfileTiming) {
+                    isProfileTiming = true;
+                    profileMark = pTriggerUnit->startProfileTiming();
+                }
+                switch (mRegexCodePropertyList.value(patternNumber)) {
+                case REGEX_SUBSTRING:
+                    ret = match_substring(toMatch, mRegexCodeList[patternNumber], patternNumber, posOffset);
+                    break;
 
-            case REGEX_PERL:
-                ret = match_perl(subject, toMatch, patternNumber, posOffset);
-                break;
+                case REGEX_PERL:
+                    ret = match_perl(subject, toMatch, patternNumber, posOffset);
+                    break;
 
-            case REGEX_BEGIN_OF_LINE_SUBSTRING:
-                ret = match_begin_of_line_substring(toMatch, mRegexCodeList[patternNumber], patternNumber, posOffset);
-                break;
+                case REGEX_BEGIN_OF_LINE_SUBSTRING:
+                    ret = match_begin_of_line_substring(toMatch, mRegexCodeList[patternNumber], patternNumber, posOffset);
+                    break;
 
-            case REGEX_EXACT_MATCH:
-                ret = match_exact_match(toMatch, mRegexCodeList[patternNumber], patternNumber, posOffset);
-                break;
+                case REGEX_EXACT_MATCH:
+                    ret = match_exact_match(toMatch, mRegexCodeList[patternNumber], patternNumber, posOffset);
+                    break;
 
-            case REGEX_LUA_CODE:
-                ret = match_lua_code(patternNumber);
-                break;
+                case REGEX_LUA_CODE:
+                    ret = match_lua_code(patternNumber);
+                    break;
 
-            case REGEX_LINE_SPACER:
-                ret = match_line_spacer(patternNumber);
-                break;
+                case REGEX_LINE_SPACER:
+                    ret = match_line_spacer(patternNumber);
+                    break;
 
-            case REGEX_COLOR_PATTERN:
-                ret = match_color_pattern(line, patternNumber);
-                break;
+                case REGEX_COLOR_PATTERN:
+                    ret = match_color_pattern(line, patternNumber);
+                    break;
 
-            case REGEX_PROMPT:
-                ret = match_prompt(patternNumber);
-                break;
+                case REGEX_PROMPT:
+                    ret = match_prompt(patternNumber);
+                    break;
+                }
             }
             // policy: one match is enough to fire on OR-trigger, but in the case of
             //         an AND-trigger all conditions have to be met in order to fire the trigger
@@ -901,6 +1052,9 @@ bool TTrigger::match(char* subject, const QString& toMatch, int line, int posOff
                 }
             }
         }
+        if (isProfileTiming) {
+            mProfile.addMatchTime(pTriggerUnit->stopProfileTiming(profileMark));
+        }
 
         // in the case of multiline triggers: check our state
         if (mIsMultiline) {
@@ -960,6 +1114,10 @@ bool TTrigger::match(char* subject, const QString& toMatch, int line, int posOff
         }
 
 
+        if (conditionMet) {
+            ++mProfile.matches;
+        }
+
         // definition trigger chain: a folder is part of a trigger chain if it has a regex defined
         // a trigger chain only lets data pass if the condition matches or in case of multiline all
         // all conditions are fullfilled
@@ -968,6 +1126,7 @@ bool TTrigger::match(char* subject, const QString& toMatch, int line, int posOff
         // if at least one regex is defined a folder is considered a trigger chain otherwise a structural element
         if (!mFilterTrigger) {
             if (conditionMet || (mRegexCodeList.size() < 1)) {
+                prepareChildPatternScan();
                 for (auto trigger : *mpMyChildrenList) {
                     ret = trigger->match(subject, toMatch, line);
                     if (ret) {
@@ -982,6 +1141,7 @@ bool TTrigger::match(char* subject, const QString& toMatch, int line, int posOff
             if ((mKeepFiring == mStayOpen) || (mpMyChildrenList->size() == 0)) {
                 execute();
             }
+            prepareChildPatternScan();
             for (auto trigger : *mpMyChildrenList) {
                 ret = trigger->match(subject, toMatch, line);
                 if (ret) {
@@ -1314,6 +1474,15 @@ bool TTrigger::compileScript()
 }
 
 void TTrigger::execute()
+{
+    TBenchmarkScope scope(TBenchmark::Lua);
+    TriggerUnit* pTriggerUnit = mpHost->getTriggerUnit();
+    const TriggerUnit::ProfileMark profileMark = pTriggerUnit->startProfileTiming();
+    executeActions();
+    mProfile.addScriptTime(pTriggerUnit->stopProfileTiming(profileMark));
+}
+
+void TTrigger::executeActions()
 {
     if (mSoundTrigger) { /* eventually something should be added to the gui to change sound volumes. 100=full volume */
         mudlet::self()->playSound(mSoundFile, 100);
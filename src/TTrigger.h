@@ -23,18 +23,21 @@
  ***************************************************************************/
 
 
+#include "TRegex.h"
+#include "TRegexSet.h"
 #include "Tree.h"
 
 #include "pre_guard.h"
 #include <QApplication>
 #include <QColor>
 #include <QMap>
+#include <QPair>
 #include <QPointer>
+#include <QScopedPointer>
 #include <QSharedPointer>
+#include <QVector>
 #include "post_guard.h"
 
-#include <pcre.h>
-
 #include <map>
 #include <string>
 
@@ -66,6 +69,39 @@ struct TColorTable
     int bgB;
 };
 
+// What a trigger has cost since it was created or the profiles were last
+// reset (see TriggerUnit::resetProfiles()). The times are in nano-seconds and
+// exclusive - the time taken by the scripts and the other triggers that are
+// run from within a trigger's matching is not counted against it as well:
+struct TTriggerProfile
+{
+    TTriggerProfile()
+    : evaluations(0), matches(0), matchTime(0), maxMatchTime(0), scriptRuns(0), scriptTime(0), maxScriptTime(0)
+    {}
+
+    void addMatchTime(const qint64 time)
+    {
+        matchTime += time;
+        maxMatchTime = qMax(maxMatchTime, time);
+    }
+    void addScriptTime(const qint64 time)
+    {
+        ++scriptRuns;
+        scriptTime += time;
+        maxScriptTime = qMax(maxScriptTime, time);
+    }
+    qint64 totalTime() const { return matchTime + scriptTime; }
+
+    // The lines that it was active for and those that it fired on:
+    quint64 evaluations;
+    quint64 matches;
+    qint64 matchTime;
+    qint64 maxMatchTime;
+    quint64 scriptRuns;
+    qint64 scriptTime;
+    qint64 maxScriptTime;
+};
+
 class TTrigger : public Tree<TTrigger>
 {
     Q_DECLARE_TR_FUNCTIONS(TTrigger) // Needed so we can use tr() even though TTrigger is NOT derived from QObject
@@ -118,6 +154,7 @@ public:
     bool match_line_spacer(int regexNumber);
     bool match_color_pattern(int, int);
     bool match_prompt(int patternNumber);
+    QStringList unfilteredPatterns() const;
     void setConditionLineDelta(int delta) { mConditionLineDelta = delta; }
     int getConditionLineDelta() { return mConditionLineDelta; }
     bool registerTrigger();
@@ -148,15 +185,39 @@ public:
     // specifies whenever the payload is Lua code as a string
     // or a function
     bool mRegisteredAnonymousLuaFunction;
+    TTriggerProfile mProfile;
 
 private:
     TTrigger() {}
+    void executeActions();
     void updateMultistates(int regexNumber, std::list<std::string>& captureList, std::list<int>& posList);
     void filter(std::string&, int&);
+    void releasePrefilterIds();
+    bool isRuledOut(const QString& toMatch, int patternNumber) const;
+    void prepareChildPatternScan();
+    bool isChildPatternRuledOut(const QString& toMatch, int id);
 
 
     QList<int> mRegexCodePropertyList;
-    QMap<int, QSharedPointer<pcre>> mRegexMap;
+    QMap<int, QSharedPointer<TRegex>> mRegexMap;
+    // The TTriggerPrefilter id of each literal pattern (and Perl regex one
+    // that needs some literal text), -1 for the others:
+    QVector<int> mPrefilterIds;
+
+    // When the profile asks for it, a folder (or chain) has all the Perl
+    // regexes of its children looked for at once before they are run - it
+    // is rebuilt whenever the children or their patterns change, so it keeps
+    // the version of the patterns of each one that it was built from:
+    QScopedPointer<TRegexSet> mpChildPatternScan;
+    QVector<QPair<TTrigger*, quint64>> mChildPatternScanMembers;
+    // The TTriggerPrefilter scan that the line was last scanned for and
+    // whether it could be:
+    quint32 mChildPatternScanGeneration;
+    bool mIsChildPatternScanUsable;
+    // The id in the parent's scan of each pattern, -1 if it is not in it:
+    QVector<int> mChildPatternScanIds;
+    quint64 mRegexVersion;
+    static quint64 smRegexVersionCounter;
 
     // Lua code as a string to run
     QString mScript;
@@ -0,0 +1,367 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TTriggerPrefilter.h"
+
+
+#include "pre_guard.h"
+#include <QRegularExpression>
+#include "post_guard.h"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+const int TTriggerPrefilter::csmMaxPendingPatterns;
+
+TTriggerPrefilter::TTriggerPrefilter()
+: mRemovedSinceRebuild(0)
+, mGeneration(1)
+{
+    rebuild();
+}
+
+int TTriggerPrefilter::addPattern(const QString& pattern)
+{
+    if (pattern.isEmpty()) {
+        // Matches everything so there is nothing to filter:
+        return -1;
+    }
+
+    int id;
+    if (!mFreeIds.empty()) {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+        // If the automaton still has the pattern that had this id it will just
+        // report this one as found a little more often than it should be:
+        mPatterns[static_cast<size_t>(id)] = pattern;
+    } else {
+        id = static_cast<int>(mPatterns.size());
+        mPatterns.push_back(pattern);
+        mFoundGeneration.push_back(0);
+    }
+    mPendingIds.push_back(id);
+    return id;
+}
+
+void TTriggerPrefilter::removePattern(const int id)
+{
+    if (id < 0 || id >= static_cast<int>(mPatterns.size()) || mPatterns.at(static_cast<size_t>(id)).isNull()) {
+        return;
+    }
+    mPatterns[static_cast<size_t>(id)] = QString();
+    mFreeIds.push_back(id);
+    ++mRemovedSinceRebuild;
+}
+
+void TTriggerPrefilter::clearScan()
+{
+    mScannedText = QString();
+}
+
+void TTriggerPrefilter::scan(const QString& text)
+{
+    const int livePatterns = static_cast<int>(mPatterns.size() - mFreeIds.size());
+    if (static_cast<int>(mPendingIds.size()) > csmMaxPendingPatterns || mRemovedSinceRebuild > std::max(csmMaxPendingPatterns, livePatterns / 2)) {
+        rebuild();
+    }
+
+    if (++mGeneration == 0) {
+        // So that nothing from 2^32 scans ago looks as if it was found now:
+        std::fill(mFoundGeneration.begin(), mFoundGeneration.end(), 0);
+        std::fill(mNodeGeneration.begin(), mNodeGeneration.end(), 0);
+        mGeneration = 1;
+    }
+    mScannedText = text;
+
+    int node = 0;
+    for (const QChar c : text) {
+        node = nextNode(node, c.unicode());
+        // Marking each node as it is reported means that the (common) patterns
+        // that end in many places in the line are only reported once:
+        for (int output = mOutputs.at(static_cast<size_t>(node)).empty() ? mOutputLink.at(static_cast<size_t>(node)) : node;
+             output > 0 && mNodeGeneration.at(static_cast<size_t>(output)) != mGeneration;
+             output = mOutputLink.at(static_cast<size_t>(output))) {
+            mNodeGeneration[static_cast<size_t>(output)] = mGeneration;
+            for (const int id : mOutputs.at(static_cast<size_t>(output))) {
+                mFoundGeneration[static_cast<size_t>(id)] = mGeneration;
+            }
+        }
+    }
+
+    for (const int id : mPendingIds) {
+        const QString& pattern = mPatterns.at(static_cast<size_t>(id));
+        if (!pattern.isNull() && text.contains(pattern)) {
+            mFoundGeneration[static_cast<size_t>(id)] = mGeneration;
+        }
+    }
+}
+
+int TTriggerPrefilter::nextNode(int node, const ushort c) const
+{
+    forever {
+        auto it = mEdges.constFind(edgeKey(node, c));
+        if (it != mEdges.cend()) {
+            return it.value();
+        }
+        if (!node) {
+            return 0;
+        }
+        node = mFailure.at(static_cast<size_t>(node));
+    }
+}
+
+void TTriggerPrefilter::rebuild()
+{
+    mEdges.clear();
+    mFailure.assign(1, 0);
+    mOutputLink.assign(1, 0);
+    mOutputs.assign(1, std::vector<int>());
+    // The edges out of each node, only needed whilst building:
+    std::vector<std::vector<std::pair<ushort, int>>> children(1);
+
+    for (size_t id = 0; id < mPatterns.size(); ++id) {
+        const QString& pattern = mPatterns.at(id);
+        if (pattern.isNull()) {
+            continue;
+        }
+        int node = 0;
+        for (const QChar c : pattern) {
+            auto it = mEdges.constFind(edgeKey(node, c.unicode()));
+            if (it != mEdges.cend()) {
+                node = it.value();
+                continue;
+            }
+            const int child = static_cast<int>(mFailure.size());
+            mEdges.insert(edgeKey(node, c.unicode()), child);
+            children[static_cast<size_t>(node)].emplace_back(c.unicode(), child);
+            mFailure.push_back(0);
+            mOutputLink.push_back(0);
+            mOutputs.emplace_back();
+            children.emplace_back();
+            node = child;
+        }
+        mOutputs[static_cast<size_t>(node)].push_back(static_cast<int>(id));
+    }
+
+    // Work out the failure links breadth first, so that those of the shorter
+    // suffixes that they depend on are always done first:
+    std::queue<int> queue;
+    for (const auto& edge : children.front()) {
+        queue.push(edge.second);
+    }
+    while (!queue.empty()) {
+        const int node = queue.front();
+        queue.pop();
+        for (const auto& edge : children.at(static_cast<size_t>(node))) {
+            const int child = edge.second;
+            const int failure = nextNode(mFailure.at(static_cast<size_t>(node)), edge.first);
+            mFailure[static_cast<size_t>(child)] = failure;
+            mOutputLink[static_cast<size_t>(child)] = mOutputs.at(static_cast<size_t>(failure)).empty() ? mOutputLink.at(static_cast<size_t>(failure)) : failure;
+            queue.push(child);
+        }
+    }
+
+    mNodeGeneration.assign(mFailure.size(), 0);
+    mPendingIds.clear();
+    mRemovedSinceRebuild = 0;
+}
+
+// Returns the position of the last character of the argument (if any) that
+// follows the escape letter at position i, e.g. of the "}" of "\x{263a}":
+static int skipEscapeArgument(const QString& regex, int i)
+{
+    const QChar letter = regex.at(i);
+    const int total = regex.size();
+    auto skipTo = [&](const QChar closing) {
+        const int end = regex.indexOf(closing, i + 2);
+        return end > -1 ? end : total - 1;
+    };
+    auto skipWhile = [&](int limit, bool (*isWanted)(QChar)) {
+        while (limit-- && i + 1 < total && isWanted(regex.at(i + 1))) {
+            ++i;
+        }
+        return i;
+    };
+    auto isDigit = [](const QChar c) { return c >= QLatin1Char('0') && c <= QLatin1Char('9'); };
+    auto isHexDigit = [](const QChar c) { return (c >= QLatin1Char('0') && c <= QLatin1Char('9')) || (c >= QLatin1Char('a') && c <= QLatin1Char('f')) || (c >= QLatin1Char('A') && c <= QLatin1Char('F')); };
+    const QChar next = i + 1 < total ? regex.at(i + 1) : QChar();
+
+    switch (letter.unicode()) {
+    case 'c':
+        // A control character, "\cA" for instance:
+        return qMin(i + 1, total - 1);
+    case 'x':
+        return next == QLatin1Char('{') ? skipTo(QLatin1Char('}')) : skipWhile(2, isHexDigit);
+    case 'o':
+        return next == QLatin1Char('{') ? skipTo(QLatin1Char('}')) : i;
+    case 'p':
+    case 'P':
+        return next == QLatin1Char('{') ? skipTo(QLatin1Char('}')) : qMin(i + 1, total - 1);
+    case 'g':
+    case 'k':
+        if (next == QLatin1Char('{')) {
+            return skipTo(QLatin1Char('}'));
+        }
+        if (next == QLatin1Char('<')) {
+            return skipTo(QLatin1Char('>'));
+        }
+        if (next == QLatin1Char('\'')) {
+            return skipTo(QLatin1Char('\''));
+        }
+        if (next == QLatin1Char('-')) {
+            ++i;
+        }
+        return skipWhile(-1, isDigit);
+    default:
+        if (isDigit(letter)) {
+            // A back reference or an octal code:
+            return skipWhile(-1, isDigit);
+        }
+        return i;
+    }
+}
+
+// Only the parts of the regex outside of any group are looked at, and none of
+// it if there is a top level alternative (or an option setting or a verb that
+// could change what the text means), so what is found is always needed but it
+// may miss some text that is:
+QString TTriggerPrefilter::requiredLiteral(const QString& regex)
+{
+    static const QRegularExpression optionSetting(QStringLiteral(R"(\(\?[a-zA-Z-]+[:)])"));
+    static const QRegularExpression quantifier(QStringLiteral(R"(\{\d+(,\d*)?\})"));
+    if (regex.contains(QLatin1String("(*")) || regex.contains(optionSetting)) {
+        return QString();
+    }
+
+    QString best;
+    QString run;
+    auto endRun = [&]() {
+        if (run.size() > best.size()) {
+            best = run;
+        }
+        run.clear();
+    };
+
+    int depth = 0;
+    for (int i = 0, total = regex.size(); i < total; ++i) {
+        const QChar c = regex.at(i);
+        if (c == QLatin1Char('\\')) {
+            if (++i >= total) {
+                return QString();
+            }
+            const QChar escaped = regex.at(i);
+            if (escaped.isLetterOrNumber()) {
+                // A character type, an assertion, a back reference or a code
+                // for a character - none of which can be part of the run:
+                i = skipEscapeArgument(regex, i);
+                if (!depth) {
+                    endRun();
+                }
+            } else if (!depth) {
+                run.append(escaped);
+            }
+            continue;
+        }
+
+        if (c == QLatin1Char('[')) {
+            // Skip the class, a ']' straight after the '[' or "[^" is a literal:
+            if (!depth) {
+                endRun();
+            }
+            int j = i + 1;
+            if (j < total && regex.at(j) == QLatin1Char('^')) {
+                ++j;
+            }
+            if (j < total && regex.at(j) == QLatin1Char(']')) {
+                ++j;
+            }
+            for (; j < total && regex.at(j) != QLatin1Char(']'); ++j) {
+                if (regex.at(j) == QLatin1Char('\\')) {
+                    ++j;
+                } else if (regex.at(j) == QLatin1Char('[') && j + 1 < total && regex.at(j + 1) == QLatin1Char(':')) {
+                    const int end = regex.indexOf(QLatin1String(":]"), j + 2);
+                    if (end > -1) {
+                        j = end + 1;
+                    }
+                }
+            }
+            if (j >= total) {
+                return QString();
+            }
+            i = j;
+            continue;
+        }
+
+        if (depth) {
+            if (c == QLatin1Char('(')) {
+                ++depth;
+            } else if (c == QLatin1Char(')')) {
+                --depth;
+            }
+            continue;
+        }
+
+        switch (c.unicode()) {
+        case '|':
+            return QString();
+        case '(':
+            ++depth;
+            endRun();
+            break;
+        case ')':
+            // Not balanced so the regex will not compile anyway:
+            return QString();
+        case '{': {
+            const QRegularExpressionMatch match = quantifier.match(regex, i, QRegularExpression::NormalMatch, QRegularExpression::AnchoredMatchOption);
+            if (!match.hasMatch()) {
+                // Not a quantifier, so it is just a '{':
+                run.append(c);
+                break;
+            }
+            i = match.capturedEnd() - 1;
+        }
+        // Fall-through
+        case '*':
+        case '?':
+            // The character before may be left out (or repeated, which the
+            // run cannot hold either) - all of it, when it is a surrogate pair:
+            if (!run.isEmpty()) {
+                const int size = run.size();
+                run.chop((size > 1 && run.at(size - 1).isLowSurrogate() && run.at(size - 2).isHighSurrogate()) ? 2 : 1);
+            }
+            endRun();
+            break;
+        case '+':
+            // The character before is needed at least once:
+            endRun();
+            break;
+        case '.':
+        case '^':
+        case '$':
+            endRun();
+            break;
+        default:
+            run.append(c);
+        }
+    }
+    endRun();
+    return best;
+}
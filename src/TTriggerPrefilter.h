@@ -0,0 +1,105 @@
+#ifndef MUDLET_TTRIGGERPREFILTER_H
+#define MUDLET_TTRIGGERPREFILTER_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QHash>
+#include <QString>
+#include "post_guard.h"
+
+#include <vector>
+
+// Finds which of the literal (substring, begin of line substring and exact
+// match) trigger patterns - and of the pieces of text that Perl regex ones
+// cannot match without, see requiredLiteral(...) - occur anywhere in a line
+// with a single pass over it, using an Aho-Corasick automaton of all of them,
+// so that TTrigger::match(...) only has to look properly at the patterns that
+// have been found - for a profile with thousands of such patterns that is far
+// cheaper than searching the line for each of them (or running each regex on
+// it) in turn.
+//
+// Being found is necessary but not sufficient for a match (a begin of line
+// substring must also be at the start, for instance) so the normal matching is
+// still done for the patterns that are found; those that are not found cannot
+// match and are skipped.
+//
+// Patterns that are added after the automaton was last built are searched for
+// one at a time until there are csmMaxPendingPatterns of them, only then is it
+// rebuilt, so temporary triggers being made and killed all the time do not
+// cause a rebuild for each one. Removed patterns stay in the automaton, where
+// they do no harm, until the next rebuild.
+class TTriggerPrefilter
+{
+public:
+    TTriggerPrefilter();
+
+    // Returns the id that the pattern is known by:
+    int addPattern(const QString& pattern);
+    void removePattern(int id);
+
+    // Finds the patterns in the text, they can then be looked up with
+    // isFound(...) until the next scan(...) or clearScan():
+    void scan(const QString& text);
+    void clearScan();
+    // Whether the text is the very one that was scanned - and not, say, a
+    // capture being passed on down a filter chain:
+    bool isScanned(const QString& text) const { return !mScannedText.isNull() && text.constData() == mScannedText.constData(); }
+    bool isFound(int id) const { return mFoundGeneration.at(static_cast<size_t>(id)) == mGeneration; }
+    // Changes with every scan(...), so that other results that are worked
+    // out from the same text can tell when they are out of date:
+    quint32 scanGeneration() const { return mGeneration; }
+
+    // The longest piece of text that anything the (PCRE) regex matches has
+    // to contain, or an empty string if one cannot be worked out:
+    static QString requiredLiteral(const QString& regex);
+
+    static const int csmMaxPendingPatterns = 64;
+
+private:
+    Q_DISABLE_COPY(TTriggerPrefilter)
+
+    void rebuild();
+    int nextNode(int node, ushort c) const;
+    static quint64 edgeKey(const int node, const ushort c) { return (static_cast<quint64>(node) << 16) | c; }
+
+
+    // Indexed by id, a null pattern is one that has been removed:
+    std::vector<QString> mPatterns;
+    std::vector<int> mFreeIds;
+    std::vector<int> mPendingIds;
+    int mRemovedSinceRebuild;
+
+    // The automaton, node 0 is the root:
+    QHash<quint64, int> mEdges;
+    std::vector<int> mFailure;
+    // The nearest node along the failure links that ends a pattern:
+    std::vector<int> mOutputLink;
+    // The ids of the patterns that end at each node:
+    std::vector<std::vector<int>> mOutputs;
+
+    QString mScannedText;
+    quint32 mGeneration;
+    std::vector<quint32> mFoundGeneration;
+    std::vector<quint32> mNodeGeneration;
+};
+
+#endif // MUDLET_TTRIGGERPREFILTER_H
@@ -27,6 +27,7 @@
 #include "TLuaInterpreter.h"
 #include "TTrigger.h"
 
+#include <algorithm>
 #include <iostream>
 #include <ostream>
 
@@ -47,6 +48,8 @@ void TriggerUnit::initStats()
     statsMaxLineProcessingTime = 0;
     statsMinLineProcessingTime = 0;
     statsRegexTriggers = 0;
+    statsLinesProcessed = 0;
+    statsTotalLineProcessingTime = 0;
 }
 
 void TriggerUnit::_uninstall(TTrigger* pChild, QString packageName)
@@ -255,11 +258,22 @@ void TriggerUnit::processDataStream(const QString& data, int line)
 #else
         char* subject = strndup(data.toUtf8().constData(), strlen(data.toUtf8().constData()));
 #endif
+        const qint64 lineStart = mProfileClock.nsecsElapsed();
+        // One pass over the line finds every literal pattern in it, so that
+        // the triggers do not each have to look for theirs:
+        mPrefilter.scan(data);
         for (auto trigger : mTriggerRootNodeList) {
             trigger->match(subject, data, line);
         }
+        mPrefilter.clearScan();
         free(subject);
 
+        const int lineTime = static_cast<int>((mProfileClock.nsecsElapsed() - lineStart) / 1000);
+        statsMaxLineProcessingTime = qMax(statsMaxLineProcessingTime, lineTime);
+        statsMinLineProcessingTime = statsLinesProcessed ? qMin(statsMinLineProcessingTime, lineTime) : lineTime;
+        statsTotalLineProcessingTime += lineTime;
+        statsAverageLineProcessingTime = static_cast<int>(statsTotalLineProcessingTime / static_cast<qint64>(++statsLinesProcessed));
+
         for (auto& trigger : mCleanupList) {
             delete trigger;
         }
@@ -366,6 +380,14 @@ void TriggerUnit::_assembleReport(TTrigger* pChild)
         }
         statsPatterns += trigger->mRegexCodeList.size();
         statsTriggerTotal++;
+        addUnfilteredPatterns(trigger);
+    }
+}
+
+void TriggerUnit::addUnfilteredPatterns(TTrigger* pT)
+{
+    for (const auto& pattern : pT->unfilteredPatterns()) {
+        statsUnfilteredPatterns << QStringLiteral("    %1: %2\n").arg(pT->getName(), pattern);
     }
 }
 
@@ -375,6 +397,7 @@ QString TriggerUnit::assembleReport()
     statsTriggerTotal = 0;
     statsTempTriggers = 0;
     statsPatterns = 0;
+    statsUnfilteredPatterns.clear();
     for (auto rootTrigger : mTriggerRootNodeList) {
         if (rootTrigger->isActive()) {
             statsActiveTriggers++;
@@ -384,6 +407,7 @@ QString TriggerUnit::assembleReport()
         }
         statsPatterns += rootTrigger->mRegexCodeList.size();
         statsTriggerTotal++;
+        addUnfilteredPatterns(rootTrigger);
         list<TTrigger*>* childrenList = rootTrigger->mpMyChildrenList;
         for (auto childTrigger : *childrenList) {
             _assembleReport(childTrigger);
@@ -395,16 +419,94 @@ QString TriggerUnit::assembleReport()
             }
             statsPatterns += childTrigger->mRegexCodeList.size();
             statsTriggerTotal++;
+            addUnfilteredPatterns(childTrigger);
         }
     }
     QStringList msg;
     msg << "triggers current total: " << QString::number(statsTriggerTotal) << "\n"
         << "trigger patterns total: " << QString::number(statsPatterns) << "\n"
         << "tempTriggers current total: " << QString::number(statsTempTriggers) << "\n"
-        << "active triggers: " << QString::number(statsActiveTriggers) << "\n";
+        << "active triggers: " << QString::number(statsActiveTriggers) << "\n"
+        << "lines processed: " << QString::number(statsLinesProcessed) << "\n";
+    if (statsLinesProcessed) {
+        msg << "line processing time (micro-seconds) average: " << QString::number(statsAverageLineProcessingTime)
+            << " min: " << QString::number(statsMinLineProcessingTime)
+            << " max: " << QString::number(statsMaxLineProcessingTime) << "\n";
+    }
+    if (!statsUnfilteredPatterns.isEmpty()) {
+        // These cannot be skipped by the prefilter - usually because the only
+        // literal text in them is inside a group or there is a top level "|":
+        msg << "regex patterns run on every line: " << QString::number(statsUnfilteredPatterns.size()) << "\n"
+            << statsUnfilteredPatterns;
+    }
     return msg.join("");
 }
 
+// Every trigger that has been active for a line since the profiles were last
+// reset, the most costly first:
+QList<TTrigger*> TriggerUnit::profiledTriggers()
+{
+    QList<TTrigger*> triggers;
+    for (auto trigger : mTriggerMap) {
+        if (trigger->mProfile.evaluations) {
+            triggers.append(trigger);
+        }
+    }
+    std::sort(triggers.begin(), triggers.end(), [](const TTrigger* pA, const TTrigger* pB) { return pA->mProfile.totalTime() > pB->mProfile.totalTime(); });
+    return triggers;
+}
+
+void TriggerUnit::resetProfiles()
+{
+    for (auto trigger : mTriggerMap) {
+        trigger->mProfile = TTriggerProfile();
+    }
+    statsLinesProcessed = 0;
+    statsTotalLineProcessingTime = 0;
+    statsAverageLineProcessingTime = 0;
+    statsMaxLineProcessingTime = 0;
+    statsMinLineProcessingTime = 0;
+}
+
+// A table of the profiles of the (up to) count most costly triggers, with the
+// times in milli-seconds:
+QString TriggerUnit::assembleProfileReport(const int count)
+{
+    const QList<TTrigger*> triggers = profiledTriggers();
+    if (triggers.isEmpty()) {
+        return QStringLiteral("no trigger has been active for a line yet\n");
+    }
+
+    auto milliSeconds = [](const qint64 time) { return QString::number(time / 1000000.0, 'f', 3); };
+    QStringList msg;
+    msg << QStringLiteral("%1 %2 %3 %4 %5 %6 %7  %8\n")
+                   .arg(QStringLiteral("total ms"), 10)
+                   .arg(QStringLiteral("evaluated"), 10)
+                   .arg(QStringLiteral("matched"), 8)
+                   .arg(QStringLiteral("match ms"), 10)
+                   .arg(QStringLiteral("max"), 8)
+                   .arg(QStringLiteral("script ms"), 10)
+                   .arg(QStringLiteral("max"), 8)
+                   .arg(QStringLiteral("trigger"));
+    for (int i = 0, total = qMin(count, triggers.size()); i < total; ++i) {
+        TTrigger* pT = triggers.at(i);
+        const TTriggerProfile& profile = pT->mProfile;
+        msg << QStringLiteral("%1 %2 %3 %4 %5 %6 %7  %8\n")
+                       .arg(milliSeconds(profile.totalTime()), 10)
+                       .arg(QString::number(profile.evaluations), 10)
+                       .arg(QString::number(profile.matches), 8)
+                       .arg(milliSeconds(profile.matchTime), 10)
+                       .arg(milliSeconds(profile.maxMatchTime), 8)
+                       .arg(milliSeconds(profile.scriptTime), 10)
+                       .arg(milliSeconds(profile.maxScriptTime), 8)
+                       .arg(QStringLiteral("%1 (%2)").arg(pT->getName(), QString::number(pT->getID())));
+    }
+    if (triggers.size() > count) {
+        msg << QStringLiteral("... and %1 more\n").arg(triggers.size() - count);
+    }
+    return msg.join(QString());
+}
+
 void TriggerUnit::doCleanup()
 {
     for (auto trigger : mCleanupList) {
@@ -22,11 +22,16 @@
  ***************************************************************************/
 
 
+#include "TRegex.h"
+#include "TTriggerPrefilter.h"
+
 #include "pre_guard.h"
+#include <QElapsedTimer>
 #include <QMultiMap>
 #include <QMutex>
 #include <QPointer>
 #include <QString>
+#include <QStringList>
 #include "post_guard.h"
 
 #include <list>
@@ -41,7 +46,20 @@ class TriggerUnit
     friend class XMLimport;
 
 public:
-    TriggerUnit(Host* pHost) : mpHost(pHost), mMaxID(0), statsPatterns(), mModuleMember() { initStats(); }
+    TriggerUnit(Host* pHost) : mpHost(pHost), mMaxID(0), statsPatterns(), mModuleMember(), mProfileChargedTime(0)
+    {
+        initStats();
+        mProfileClock.start();
+    }
+
+    // Where a timing of part of a trigger's profile started, the time that
+    // had been charged to any trigger by then is kept so that what is
+    // charged whilst it runs (for nested triggers and scripts) can be left out:
+    struct ProfileMark
+    {
+        qint64 start;
+        qint64 charged;
+    };
 
     std::list<TTrigger*> getTriggerRootNodeList()
     {
@@ -65,9 +83,24 @@ public:
     void stopAllTriggers();
     void reenableAllTriggers();
     QString assembleReport();
+    QString assembleProfileReport(int count);
+    QList<TTrigger*> profiledTriggers();
+    void resetProfiles();
+    ProfileMark startProfileTiming() const { return {mProfileClock.nsecsElapsed(), mProfileChargedTime}; }
+    // Returns the time since the mark, less that charged since, and charges it:
+    qint64 stopProfileTiming(const ProfileMark& mark)
+    {
+        const qint64 time = mProfileClock.nsecsElapsed() - mark.start - (mProfileChargedTime - mark.charged);
+        mProfileChargedTime += time;
+        return time;
+    }
     std::list<TTrigger*> mCleanupList;
     int getNewID();
     QMultiMap<QString, TTrigger*> mLookupTable;
+    // Shared by all the triggers, see TTrigger::isRuledOut(...):
+    TTriggerPrefilter mPrefilter;
+    // For the JIT compiled code of all of the triggers' regexes:
+    TRegexJitStack mJitStack;
     QMutex mTriggerUnitLock;
     void markCleanup(TTrigger* pT);
     void doCleanup();
@@ -87,12 +120,19 @@ public:
     int statsMaxLineProcessingTime;
     int statsMinLineProcessingTime;
     int statsRegexTriggers;
+    // For statsAverageLineProcessingTime, which (like the other two) is in
+    // micro-seconds:
+    quint64 statsLinesProcessed;
+    qint64 statsTotalLineProcessingTime;
+    // "name: pattern" for each regex pattern that the prefilter cannot skip:
+    QStringList statsUnfilteredPatterns;
     QList<TTrigger*> uninstallList;
 
 private:
     TriggerUnit() {}
     void initStats();
     void _assembleReport(TTrigger*);
+    void addUnfilteredPatterns(TTrigger*);
     TTrigger* getTriggerPrivate(int id);
     void addTriggerRootNode(TTrigger* pT, int parentPosition = -1, int childPosition = -1, bool moveTrigger = false);
     void addTrigger(TTrigger* pT);
@@ -104,6 +144,8 @@ private:
     std::list<TTrigger*> mTriggerRootNodeList;
     int mMaxID;
     bool mModuleMember;
+    QElapsedTimer mProfileClock;
+    qint64 mProfileChargedTime;
 };
 
 #endif // MUDLET_TRIGGERUNIT_H
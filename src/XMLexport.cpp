@@ -326,12 +326,14 @@ bool XMLexport::writeHost(Host* pHost)
     writeAttribute("mUSE_UNIX_EOL", pHost->mUSE_UNIX_EOL ? "yes" : "no");
     writeAttribute("mNoAntiAlias", pHost->mNoAntiAlias ? "yes" : "no");
     writeAttribute("mEchoLuaErrors", pHost->mEchoLuaErrors ? "yes" : "no");
+    writeAttribute("mTriggerGroupScan", pHost->mIsTriggerGroupScanEnabled ? "yes" : "no");
     writeAttribute("AmbigousWidthGlyphsToBeWide", pHost->mIsAmbigousWidthGlyphsSettingAutomatic ? "auto" : pHost->mIsAmbigousWidthGlyphsToBeWide ? "yes" : "no");
     // FIXME: Change to a string or integer property when possible to support more
     // than false (perhaps 0 or "PlainText") or true (perhaps 1 or "HTML") in the
     // future - phpBB code might be useful if it can be done.
     writeAttribute("mRawStreamDump", pHost->mIsNextLogFileInHtmlFormat ? "yes" : "no");
     writeAttribute("mIsLoggingTimestamps", pHost->mIsLoggingTimestamps ? "yes" : "no");
+    writeAttribute("mLogInBinaryFormat", pHost->mIsNextLogFileInBinaryFormat ? "yes" : "no");
     writeAttribute("mLogDir", pHost->mLogDir);
     writeAttribute("mLogFileName", pHost->mLogFileName);
     writeAttribute("mLogFileNameFormat", pHost->mLogFileNameFormat);
@@ -779,6 +779,7 @@ void XMLimport::readHostPackage(Host* pHost)
     pHost->mUSE_UNIX_EOL = (attributes().value("mUSE_UNIX_EOL") == "yes");
     pHost->mNoAntiAlias = (attributes().value("mNoAntiAlias") == "yes");
     pHost->mEchoLuaErrors = (attributes().value("mEchoLuaErrors") == "yes");
+    pHost->mIsTriggerGroupScanEnabled = (attributes().value("mTriggerGroupScan") == "yes");
     if (attributes().hasAttribute("AmbigousWidthGlyphsToBeWide")) {
         const QStringRef ambiguousWidthSetting(attributes().value("AmbigousWidthGlyphsToBeWide"));
         if (ambiguousWidthSetting == QStringLiteral("yes")) {
@@ -797,6 +798,7 @@ void XMLimport::readHostPackage(Host* pHost)
     }
     pHost->mIsNextLogFileInHtmlFormat = (attributes().value("mRawStreamDump") == "yes");
     pHost->mIsLoggingTimestamps = (attributes().value("mIsLoggingTimestamps") == "yes");
+    pHost->mIsNextLogFileInBinaryFormat = (attributes().value("mLogInBinaryFormat") == "yes");
     pHost->mLogDir = attributes().value("mLogDir").toString();
     pHost->mLogFileName = attributes().value("mLogFileName").toString();
     pHost->mLogFileNameFormat = attributes().value("mLogFileNameFormat").toString();
@@ -30,11 +30,13 @@
 
 
 #include "Host.h"
+#include "TBenchmark.h"
 #include "TBuffer.h"
 #include "TConsole.h"
 #include "TDebug.h"
 #include "TEvent.h"
 #include "TMap.h"
+#include "TTelnetReader.h"
 #include "dlgComposer.h"
 #include "dlgMapper.h"
 #include "glwidget.h"
@@ -43,6 +45,7 @@
 #include "pre_guard.h"
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QNetworkAccessManager>
 #include <QProgressDialog>
 #include <QStringBuilder>
@@ -51,6 +54,7 @@
 #include "post_guard.h"
 
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <sstream>
 
@@ -62,10 +66,10 @@
 
 using namespace std;
 
-char loadBuffer[100001];
-int loadedBytes;
-QDataStream replayStream;
-QFile replayFile;
+// When playing a replay as fast as possible hand control back to the event
+// loop at least this often (in milli-seconds) so that the display can be
+// redrawn and the replay controls still work:
+static const qint64 csmReplayBatchTime = 50;
 
 
 cTelnet::cTelnet(Host* pH)
@@ -75,6 +79,11 @@ cTelnet::cTelnet(Host* pH)
 , mFORCE_GA_OFF(false)
 , mpComposer(nullptr)
 , mpHost(pH)
+, mpReader(new TTelnetReader())
+, mReplayDecoder([this](TTelnetChunk::Type type, std::string& data) { mReplayChunks.emplace_back(type); mReplayChunks.back().data.swap(data); })
+, mReplayChunk(0)
+, mReplayPosition(0)
+, mpReplayTimer(new QTimer(this))
 , mEncoding()
 , mpPostingTimer(new QTimer(this))
 , mUSE_IRE_DRIVER_BUGFIX(false)
@@ -92,13 +101,10 @@ cTelnet::cTelnet(Host* pH)
 , networkLatencyMin()
 , networkLatencyMax()
 , mWaitingForResponse()
-, mZstream()
 , recvdGA()
-, lastTimeOffset()
 , mIsReplayRunFromLua(false)
 {
     mIsTimerPosting = false;
-    mNeedDecompression = false;
 
     // initialize encoding to a sensible default - needs to be a different value
     // than that in the initialisation list so that it is processed as a change
@@ -109,9 +115,6 @@ cTelnet::cTelnet(Host* pH)
         termType.append(QString(APP_BUILD));
     }
 
-    iac = iac2 = insb = false;
-
-    command = "";
     curX = 80;
     curY = 25;
 
@@ -131,10 +134,21 @@ cTelnet::cTelnet(Host* pH)
         mFriendlyEncodings << TBuffer::getFriendlyEncodingNames();
     }
 
-    // initialize the socket
-    connect(&socket, SIGNAL(connected()), this, SLOT(handle_socket_signal_connected()));
-    connect(&socket, SIGNAL(disconnected()), this, SLOT(handle_socket_signal_disconnected()));
-    connect(&socket, SIGNAL(readyRead()), this, SLOT(handle_socket_signal_readyRead()));
+    // initialize the socket - it is created, and then lives, in the network
+    // thread so everything to and from it has to go via queued signals:
+    mpReader->moveToThread(&mNetworkThread);
+    connect(&mNetworkThread, &QThread::started, mpReader, &TTelnetReader::slot_init);
+    connect(&mNetworkThread, &QThread::finished, mpReader, &QObject::deleteLater);
+    connect(this, &cTelnet::signal_connectToHost, mpReader, &TTelnetReader::slot_connectToHost);
+    connect(this, &cTelnet::signal_abort, mpReader, &TTelnetReader::slot_abort);
+    connect(this, &cTelnet::signal_disconnectFromHost, mpReader, &TTelnetReader::slot_disconnectFromHost);
+    connect(this, &cTelnet::signal_write, mpReader, &TTelnetReader::slot_write);
+    connect(mpReader, &TTelnetReader::signal_connected, this, &cTelnet::handle_socket_signal_connected);
+    connect(mpReader, &TTelnetReader::signal_disconnected, this, &cTelnet::handle_socket_signal_disconnected);
+    connect(mpReader, &TTelnetReader::signal_error, this, &cTelnet::handle_socket_signal_error);
+    connect(mpReader, &TTelnetReader::signal_dataAvailable, this, &cTelnet::slot_processIncomingData);
+    mNetworkThread.setObjectName(QStringLiteral("network"));
+    mNetworkThread.start();
 
     // initialize telnet session
     reset();
@@ -142,6 +156,9 @@ cTelnet::cTelnet(Host* pH)
     mpPostingTimer->setInterval(300); //FIXME
     connect(mpPostingTimer, SIGNAL(timeout()), this, SLOT(slot_timerPosting()));
 
+    mpReplayTimer->setSingleShot(true);
+    connect(mpReplayTimer, &QTimer::timeout, this, &cTelnet::slot_processReplayChunk);
+
     mTimerLogin = new QTimer(this);
     mTimerLogin->setSingleShot(true);
     connect(mTimerLogin, SIGNAL(timeout()), this, SLOT(slot_send_login()));
@@ -164,8 +181,6 @@ void cTelnet::reset()
         heAnnouncedState[i] = false;
         triedToEnable[i] = false;
     }
-    iac = iac2 = insb = false;
-    command = "";
     mMudData = "";
 }
 
@@ -177,7 +192,8 @@ cTelnet::~cTelnet()
         // NOT the "last profile standing" the replay system gets reset for
         // another profile to use:
         loadingReplay = false;
-        replayFile.close();
+        mpReplayTimer->stop();
+        mReplayReader.close();
         qDebug() << "cTelnet::~cTelnet() INFO - A replay was in progress on this profile but has been aborted.";
         mudlet::self()->replayOver();
     }
@@ -188,7 +204,11 @@ cTelnet::~cTelnet()
             qWarning("%s\n------------", qPrintable(message));
         }
     }
-    socket.deleteLater();
+
+    // The reader is deleted in its own thread once the event loop there stops:
+    mpReader->stop();
+    mNetworkThread.quit();
+    mNetworkThread.wait();
 }
 
 
@@ -275,11 +295,8 @@ void cTelnet::connectIt(const QString& address, int port)
         mFORCE_GA_OFF = mpHost->mFORCE_GA_OFF;
     }
 
-    if (socket.state() != QAbstractSocket::UnconnectedState) {
-        socket.abort();
-        connectIt(address, port);
-        return;
-    }
+    // Drop any existing connection before looking up the (new) address:
+    emit signal_abort();
 
     hostName = address;
     hostPort = port;
@@ -291,12 +308,12 @@ void cTelnet::connectIt(const QString& address, int port)
 
 void cTelnet::disconnect()
 {
-    socket.disconnectFromHost();
+    emit signal_disconnectFromHost();
 }
 
-void cTelnet::handle_socket_signal_error()
+void cTelnet::handle_socket_signal_error(const QString& message)
 {
-    QString err = "[ ERROR ] - TCP/IP socket ERROR:" % socket.errorString();
+    QString err = "[ ERROR ] - TCP/IP socket ERROR:" % message;
     postMessage(err);
 }
 
@@ -330,8 +347,11 @@ void cTelnet::handle_socket_signal_connected()
     mpHost->raiseEvent(event);
 }
 
-void cTelnet::handle_socket_signal_disconnected()
+void cTelnet::handle_socket_signal_disconnected(const QString& reason)
 {
+    // Anything that arrived just before the connection dropped has to be shown
+    // before the disconnection is reported:
+    slot_processIncomingData();
     postData();
 
     TEvent event;
@@ -342,15 +362,18 @@ void cTelnet::handle_socket_signal_disconnected()
     QString msg;
     QTime timeDiff(0, 0, 0, 0);
     msg = QString("[ INFO ]  - Connection time: %1\n    ").arg(timeDiff.addMSecs(mConnectionTime.elapsed()).toString("hh:mm:ss.zzz"));
-    mNeedDecompression = false;
     reset();
-    QString err = "[ ALERT ] - Socket got disconnected.\nReason: " % socket.errorString();
+    QString err = "[ ALERT ] - Socket got disconnected.\nReason: " % reason;
     QString spacer = "    ";
     if (!mpHost->mIsGoingDown) {
         postMessage(spacer);
         postMessage(err);
         postMessage(msg);
     }
+    // So that the log file has everything up to the disconnection in it:
+    if (mpHost->mpConsole) {
+        mpHost->mpConsole->flushLog();
+    }
 }
 
 void cTelnet::handle_socket_signal_hostFound(QHostInfo hostInfo)
@@ -361,9 +384,9 @@ void cTelnet::handle_socket_signal_hostFound(QHostInfo hostInfo)
         postMessage(msg);
         msg = "[ INFO ]  - Trying to connect to " + mHostAddress.toString() + ":" + QString::number(hostPort) + " ...\n";
         postMessage(msg);
-        socket.connectToHost(mHostAddress, hostPort);
+        emit signal_connectToHost(mHostAddress.toString(), hostPort);
     } else {
-        socket.connectToHost(hostInfo.hostName(), hostPort);
+        emit signal_connectToHost(hostInfo.hostName(), hostPort);
         QString msg = "[ ERROR ] - Host name lookup Failure!\nConnection cannot be established.\nThe server name is not correct, not working properly,\nor your nameservers are not working properly.";
         postMessage(msg);
         return;
@@ -416,21 +439,11 @@ bool cTelnet::sendData(QString& data)
 
 bool cTelnet::socketOutRaw(string& data)
 {
-    if (!socket.isWritable()) {
+    if (!mpReader->isConnected()) {
         return false;
     }
-    int dataLength = data.length();
-    int remlen = dataLength;
-
-    do {
-        int written = socket.write(data.data(), remlen);
-
-        if (written == -1) {
-            return false;
-        }
-        remlen -= written;
-        dataLength += written;
-    } while (remlen > 0);
+    // The socket will buffer whatever it cannot send at once:
+    emit signal_write(QByteArray(data.data(), static_cast<int>(data.size())));
 
     if (mGA_Driver) {
         mCommands++;
@@ -721,8 +734,14 @@ void cTelnet::processTelnetCommand(const string& command)
                         //protocol says: reject MCCP v1 if you have previously accepted MCCP v2...
                         sendTelnetOption(TN_DONT, option);
                         hisOptionState[idxOption] = false;
+                        // Only still on if the other version is:
+                        mpReader->setCompressionNegotiated(mMCCP_version_1 || mMCCP_version_2);
                         qDebug() << "Rejecting MCCP v1, because v2 has already been negotiated or FORCE COMPRESSION OFF is set to ON.";
                     } else {
+                        // The network thread must know before the server
+                        // gets our reply and starts the compressed stream,
+                        // which could be as soon as the reply is queued:
+                        mpReader->setCompressionNegotiated(true);
                         sendTelnetOption(TN_DO, option);
                         hisOptionState[idxOption] = true;
                         //inform MCCP object about the change
@@ -794,6 +813,7 @@ void cTelnet::processTelnetCommand(const string& command)
                     mMCCP_version_2 = false;
                     qDebug() << "MCCP v2 disabled !";
                 }
+                mpReader->setCompressionNegotiated(mMCCP_version_1 || mMCCP_version_2);
             }
             heAnnouncedState[idxOption] = true;
         }
@@ -1215,11 +1235,56 @@ void cTelnet::setGMCPVariables(const QString& msg)
         return;
     }
     arg.remove('\n');
-    // remove \r's from the data, as yajl doesn't like it
+    // remove \r's from the data, as the JSON decoder doesn't like them
     arg.remove(QChar('\r'));
+    if (mpHost->mGMCP_coalesce_table_keys.contains(var)) {
+        coalesceGMCPVariables(var, arg);
+        return;
+    }
     mpHost->mLuaInterpreter.setGMCPTable(var, arg);
 }
 
+// Servers often send the same message several times in one burst (e.g. a
+// Char.Vitals for each of a number of prompts) - for the keys the user has
+// asked for only the last one is put into the gmcp table, and the events for
+// it are only raised once, when the burst has been dealt with:
+void cTelnet::coalesceGMCPVariables(const QString& var, const QString& arg)
+{
+    const bool isMerged = mpHost->mGMCP_merge_table_keys.contains(var);
+    if (isMerged) {
+        // Each one may carry different fields, so they all have to be merged:
+        QString key = var;
+        mpHost->mLuaInterpreter.setGMCPTable(key, arg, false);
+    }
+
+    for (auto& pending : mCoalescedGMCP) {
+        if (pending.key == var) {
+            pending.payload = isMerged ? QString() : arg;
+            pending.isMerged = isMerged;
+            return;
+        }
+    }
+    TCoalescedGMCP pending;
+    pending.key = var;
+    pending.payload = isMerged ? QString() : arg;
+    pending.isMerged = isMerged;
+    mCoalescedGMCP.append(pending);
+}
+
+void cTelnet::flushCoalescedGMCPVariables()
+{
+    // Taken first in case an event handler causes more data to be handled:
+    QVector<TCoalescedGMCP> coalesced;
+    coalesced.swap(mCoalescedGMCP);
+    for (auto& pending : coalesced) {
+        if (pending.isMerged) {
+            mpHost->mLuaInterpreter.raiseProtocolEvents(QStringLiteral("gmcp"), pending.key);
+        } else {
+            mpHost->mLuaInterpreter.setGMCPTable(pending.key, pending.payload);
+        }
+    }
+}
+
 void cTelnet::setChannel102Variables(const QString& msg)
 {
     // messages consist of 2 bytes only
@@ -1478,7 +1543,12 @@ void cTelnet::gotRest(string& mud_data)
         }
 
     } else if (mGA_Driver) {
-        mMudData += mud_data;
+        if (mMudData.empty()) {
+            // Take the data rather than copying it:
+            mMudData.swap(mud_data);
+        } else {
+            mMudData += mud_data;
+        }
         postData();
         mMudData = "";
     } else {
@@ -1512,69 +1582,21 @@ void cTelnet::postData()
     }
 }
 
-void cTelnet::initStreamDecompressor()
-{
-    mZstream.zalloc = Z_NULL;
-    mZstream.zfree = Z_NULL;
-    mZstream.opaque = Z_NULL;
-    mZstream.avail_in = 0;
-    mZstream.next_in = Z_NULL;
-
-    inflateInit(&mZstream);
-}
-
-int cTelnet::decompressBuffer(char*& in_buffer, int& length, char* out_buffer)
+void cTelnet::recordReplay()
 {
-    mZstream.avail_in = length;
-    mZstream.next_in = (Bytef*)in_buffer;
-
-    mZstream.avail_out = 100000;
-    mZstream.next_out = (Bytef*)out_buffer;
-
-    int zval = inflate(&mZstream, Z_SYNC_FLUSH);
-    int outSize = 100000 - mZstream.avail_out;
-
-    length = mZstream.avail_in;
-    in_buffer = (char*)mZstream.next_in;
-
-    if (zval == Z_STREAM_END) {
-        inflateEnd(&mZstream);
-        qDebug() << "recv Z_STREAM_END, ending compression";
-        this->mNeedDecompression = false;
-
-        hisOptionState[static_cast<int>(OPT_COMPRESS)] = false;
-        hisOptionState[static_cast<int>(OPT_COMPRESS2)] = false;
-
-        // zval should always be NULL on inflateEnd.  No need for an else block. MCCP Rev. 3 -MH //
-        initStreamDecompressor();
-        qDebug() << "Listening for new compression sequences";
-        return -1;
-    }
-    /* TODO: Remove this commented code once it is deemed safe. -MH
-	   else
-	   {
-	    if( zval <= 0 )
-	    {
-	        initStreamDecompressor();
-	        qDebug() << "Listening for new compression sequences";
-	        return -1;
-	    }
-	   }
-	 */
-    return outSize;
+    timeOffset.start();
+    mpReader->setRecording(true);
 }
 
-
-void cTelnet::recordReplay()
+void cTelnet::stopReplayRecording()
 {
-    lastTimeOffset = 0;
-    timeOffset.start();
+    mpReader->setRecording(false);
 }
 
 bool cTelnet::loadReplay(const QString& name, QString* pErrMsg)
 {
-    replayFile.setFileName(name);
-    if (replayFile.open(QIODevice::ReadOnly)) {
+    QString errMsg;
+    if (mReplayReader.open(name, errMsg)) {
         if (!pErrMsg) {
             // Only post an information menu if initiated from GUI controls
             postMessage(tr("[ INFO ]  - Loading replay file:\n"
@@ -1584,14 +1606,16 @@ bool cTelnet::loadReplay(const QString& name, QString* pErrMsg)
         } else {
             mIsReplayRunFromLua = false;
         }
-        replayStream.setDevice(&replayFile);
+        mReplayDecoder.reset();
+        mReplayChunk = 0;
+        mReplayPosition = 0;
         loadingReplay = true;
         if (mudlet::self()->replayStart()) {
-            // TODO: consider moving to a QTimeLine based system...?
             // This initiates the replay chunk reading/processing cycle:
             loadReplayChunk();
         } else {
             loadingReplay = false;
+            mReplayReader.close();
             if (pErrMsg) {
                 *pErrMsg = QStringLiteral("cannot perform replay, another one seems to already be in progress; try again when it has finished.");
             } else {
@@ -1603,12 +1627,12 @@ bool cTelnet::loadReplay(const QString& name, QString* pErrMsg)
     } else {
         if (pErrMsg) {
             // Call from lua case:
-            *pErrMsg = QStringLiteral("cannot read file \"%1\", error message was: \"%2\".")
-                    .arg(name, replayFile.errorString());
+            *pErrMsg = QStringLiteral("cannot read file \"%1\", reason: %2")
+                    .arg(name, errMsg);
         } else {
             postMessage(tr("[ ERROR ] - Cannot read file \"%1\",\n"
-                           "error message was: \"%2\".")
-                        .arg(name, replayFile.errorString()));
+                           "reason: %2")
+                        .arg(name, errMsg));
         }
         return false;
     }
@@ -1616,23 +1640,21 @@ bool cTelnet::loadReplay(const QString& name, QString* pErrMsg)
     return true;
 }
 
+// Schedules the next chunk - at the recorded interval (scaled by the replay
+// speed) after the last one, or straight away when playing as fast as
+// possible - or wraps up the replay if there are no more:
 void cTelnet::loadReplayChunk()
 {
-    if (!replayStream.atEnd()) {
-        int offset;
-        int amount;
-        replayStream >> offset;
-        replayStream >> amount;
-
-        loadedBytes = replayStream.readRawData(loadBuffer, amount);
-        // Previous use of loadedBytes + 1 caused a spurious character at end of
-        // string display by a qDebug of the loadBuffer contents
-        loadBuffer[loadedBytes] = '\0';
-        mudlet::self()->mReplayTime = mudlet::self()->mReplayTime.addMSecs(offset);
-        QTimer::singleShot(offset / mudlet::self()->mReplaySpeed, this, SLOT(slot_processReplayChunk()));
+    if (mReplayChunk < mReplayReader.chunkCount()) {
+        const int speed = mudlet::self()->mReplaySpeed;
+        qint64 delay = 0;
+        if (speed > 0) {
+            delay = qMax(Q_INT64_C(0), mReplayReader.timeOf(mReplayChunk) - mReplayPosition) / speed;
+        }
+        mpReplayTimer->start(static_cast<int>(qMin(delay, static_cast<qint64>(std::numeric_limits<int>::max()))));
     } else {
         loadingReplay = false;
-        replayFile.close();
+        mReplayReader.close();
         if (!mIsReplayRunFromLua) {
             postMessage(tr("[  OK  ]  - The replay has ended."));
         }
@@ -1640,104 +1662,87 @@ void cTelnet::loadReplayChunk()
     }
 }
 
+// Moves the replay to the first chunk recorded at or after the given number
+// of milli-seconds from the start - in either direction. The display is not
+// cleared so going backwards will repeat what has already been shown:
+bool cTelnet::seekReplay(const qint64 time)
+{
+    if (!loadingReplay) {
+        return false;
+    }
+
+    mpReplayTimer->stop();
+    mReplayChunk = mReplayReader.findChunk(time);
+    mReplayPosition = qMax(Q_INT64_C(0), time);
+    // Whatever was part way through being decoded is no longer wanted:
+    mReplayDecoder.reset();
+    mReplayChunks.clear();
+    mudlet::self()->mReplayTime = QTime(0, 0, 0, 1).addMSecs(static_cast<int>(mReplayPosition));
+    loadReplayChunk();
+    return true;
+}
+
 
+// The recorded data is fed through the same decoder (and chunk handling) as
+// live data so that a replay behaves exactly as the original session did; it
+// was recorded after any MCCP inflation so the decoder here never has
+// compression negotiated and so never tries to inflate it again. Each
+// recorded chunk is handled as a separate lot of incoming data, as it was
+// when it was received, but when playing as fast as possible as many are
+// handled at a time as will fit in csmReplayBatchTime:
 void cTelnet::slot_processReplayChunk()
 {
-    int datalen = loadedBytes;
-    string cleandata = "";
-    recvdGA = false;
-    for (int i = 0; i < datalen; i++) {
-        char ch = loadBuffer[i];
-        if (iac || iac2 || insb || (ch == TN_IAC)) {
-            if (!(iac || iac2 || insb) && (ch == TN_IAC)) {
-                iac = true;
-                command += ch;
-            } else if (iac && (ch == TN_IAC) && (!insb)) {
-                //2. seq. of two IACs
-                iac = false;
-                cleandata += ch;
-                command = "";
-            } else if (iac && (!insb) && ((ch == TN_WILL) || (ch == TN_WONT) || (ch == TN_DO) || (ch == TN_DONT))) {
-                //3. IAC DO/DONT/WILL/WONT
-                iac = false;
-                iac2 = true;
-                command += ch;
-            } else if (iac2) {
-                //4. IAC DO/DONT/WILL/WONT <command code>
-                iac2 = false;
-                command += ch;
-                processTelnetCommand(command);
-                command = "";
-            } else if (iac && (!insb) && (ch == TN_SB)) {
-                //5. IAC SB
-                iac = false;
-                insb = true;
-                command += ch;
-            } else if (iac && (!insb) && (ch == TN_SE)) {
-                //6. IAC SE without IAC SB - error - ignored
-                command = "";
-                iac = false;
-            } else if (insb) {
-                //7. inside IAC SB
-                command += ch;
-                if (iac && (ch == TN_SE)) //IAC SE - end of subcommand
-                {
-                    processTelnetCommand(command);
-                    command = "";
-                    iac = false;
-                    insb = false;
-                }
-                if (iac) {
-                    iac = false;
-                } else if (ch == TN_IAC) {
-                    iac = true;
-                }
-            } else
-            //8. IAC fol. by something else than IAC, SB, SE, DO, DONT, WILL, WONT
-            {
-                iac = false;
-                command += ch;
-                processTelnetCommand(command);
-                //this could have set receivedGA to true; we'll handle that later
-                command = "";
-            }
-        } else {
-            if (ch != '\r') {
-                cleandata += ch;
-            }
-        }
+    if (!loadingReplay) {
+        return;
+    }
 
-        if (recvdGA) {
-            mGA_Driver = true;
-            if (mCommands > 0) {
-                mCommands--;
-                if (networkLatencyTime.elapsed() > 2000) {
-                    mCommands = 0;
-                }
-            }
+    QElapsedTimer batchTime;
+    batchTime.start();
+    const bool isMaximumSpeed = mudlet::self()->mReplaySpeed <= 0;
+    const int chunkCount = mReplayReader.chunkCount();
+    do {
+        const TStringView data = mReplayReader.chunk(mReplayChunk);
+        mReplayPosition = mReplayReader.timeOf(mReplayChunk);
+        ++mReplayChunk;
 
-            if (mUSE_IRE_DRIVER_BUGFIX || mLF_ON_GA) {
-                cleandata.push_back('\n'); //part of the broken IRE-driver bugfix to make up for broken \n-prepending in unsolicited lines, part #2 see line 628
-            }
-            recvdGA = false;
-            gotPrompt(cleandata);
-            cleandata = "";
+        TBenchmark::addBytes(data.size());
+        {
+            TBenchmarkScope scope(TBenchmark::Telnet);
+            mReplayDecoder.receive(data.data(), data.size());
+            mReplayDecoder.flushText();
         }
-    } //for
 
-    if (cleandata.size() > 0) {
-        gotRest(cleandata);
-    }
+        string cleandata;
+        beginIncomingData();
+        for (auto& chunk : mReplayChunks) {
+            processChunk(chunk, cleandata);
+        }
+        mReplayChunks.clear();
+        endIncomingData(cleandata);
+        // Scripts run by the above may have ended or moved the replay:
+        if (!loadingReplay || mpReplayTimer->isActive()) {
+            return;
+        }
+    } while (isMaximumSpeed && mReplayChunk < chunkCount && batchTime.elapsed() < csmReplayBatchTime);
 
-    mpHost->mpConsole->finalize();
-    if (loadingReplay) {
-        loadReplayChunk();
-    }
+    mudlet::self()->mReplayTime = QTime(0, 0, 0, 1).addMSecs(static_cast<int>(mReplayPosition));
+    loadReplayChunk();
 }
 
-void cTelnet::handle_socket_signal_readyRead()
+// Runs in the main thread whenever the network thread has queued up some more
+// data for us: the text and telnet commands have already been separated (and
+// any MCCP stream inflated) so all that is left is to act on the commands in
+// the order that they arrived and to hand the text on to the console:
+void cTelnet::slot_processIncomingData()
 {
-    mpHost->mInsertedMissingLF = false;
+    // Must be done before emptying the queue so that anything added after we
+    // have finished will get a fresh notification:
+    mpReader->clearDataAvailable();
+
+    TTelnetChunk chunk;
+    if (!mpReader->takeChunk(chunk)) {
+        return;
+    }
 
     if (mWaitingForResponse) {
         double time = networkLatencyTime.elapsed();
@@ -1745,177 +1750,103 @@ void cTelnet::handle_socket_signal_readyRead()
         mWaitingForResponse = false;
     }
 
-    char in_bufferx[100010];
-    char* in_buffer = in_bufferx;
-    char out_buffer[100010];
+    string cleandata;
+    beginIncomingData();
+    do {
+        processChunk(chunk, cleandata);
+        mpReader->recycle(chunk.data);
+    } while (mpReader->takeChunk(chunk));
+    endIncomingData(cleandata);
+    mpReader->recycle(cleandata);
+}
 
-    int amount = socket.read(in_buffer, 100000);
-    in_buffer[amount + 1] = '\0';
-    if (amount == -1) {
-        return;
+TConnectionStatistics cTelnet::statistics() const
+{
+    TConnectionStatistics result = mStatistics;
+    mpReader->copyStatistics(result);
+    return result;
+}
+
+void cTelnet::resetStatistics()
+{
+    mStatistics.reset();
+    mpReader->resetStatistics();
+}
+
+void cTelnet::beginIncomingData()
+{
+    mpHost->mInsertedMissingLF = false;
+}
+
+void cTelnet::endIncomingData(std::string& cleandata)
+{
+    if (!mCoalescedGMCP.isEmpty()) {
+        flushCoalescedGMCPVariables();
     }
-    if (amount == 0) {
-        return;
+    if (cleandata.size() > 0) {
+        gotRest(cleandata);
     }
+    TBenchmarkScope scope(TBenchmark::Display);
+    mpHost->mpConsole->finalize();
+}
 
-    string cleandata = "";
-    int datalen;
-    do {
-        datalen = amount;
-        char* buffer = in_buffer;
-        if (mNeedDecompression) {
-            datalen = decompressBuffer(in_buffer, amount, out_buffer);
-            buffer = out_buffer;
+// Used for both live and replayed data, cleandata accumulates the text until a
+// prompt (GA/EOR) or the end of the current batch of data:
+void cTelnet::processChunk(TTelnetChunk& chunk, std::string& cleandata)
+{
+    switch (chunk.type) {
+    case TTelnetChunk::Text:
+        if (cleandata.empty()) {
+            // The lines get the time that the first of their text was read:
+            mpHost->mpConsole->buffer.setReceivedTime(chunk.receivedTime);
+            cleandata.swap(chunk.data);
+        } else {
+            cleandata.append(chunk.data);
         }
-        buffer[datalen] = '\0';
+        break;
+
+    case TTelnetChunk::Bell:
+        // flash taskbar for 3 seconds on the telnet bell
+        QApplication::alert(mudlet::self(), 3000);
+        break;
+
+    case TTelnetChunk::CompressionEnded:
+        hisOptionState[static_cast<int>(OPT_COMPRESS)] = false;
+        hisOptionState[static_cast<int>(OPT_COMPRESS2)] = false;
+        break;
+
+    case TTelnetChunk::Raw:
         if (mpHost->mpConsole->mRecordReplay) {
-            mpHost->mpConsole->mReplayStream << timeOffset.elapsed() - lastTimeOffset;
-            mpHost->mpConsole->mReplayStream << datalen;
-            mpHost->mpConsole->mReplayStream.writeRawData(&buffer[0], datalen);
+            mpHost->mpConsole->mReplayWriter.writeChunk(timeOffset.elapsed(), chunk.data.data(), static_cast<int>(chunk.data.size()));
         }
+        break;
 
+    case TTelnetChunk::Command:
         recvdGA = false;
-        for (int i = 0; i < datalen; i++) {
-            char ch = buffer[i];
-
-            if (iac || iac2 || insb || (ch == TN_IAC)) {
-                if (!(iac || iac2 || insb) && (ch == TN_IAC)) {
-                    iac = true;
-                    command += ch;
-                } else if (iac && (ch == TN_IAC) && (!insb)) {
-                    //2. seq. of two IACs
-                    iac = false;
-                    cleandata += ch;
-                    command = "";
-                } else if (iac && (!insb) && ((ch == TN_WILL) || (ch == TN_WONT) || (ch == TN_DO) || (ch == TN_DONT))) {
-                    //3. IAC DO/DONT/WILL/WONT
-                    iac = false;
-                    iac2 = true;
-                    command += ch;
-                } else if (iac2) {
-                    //4. IAC DO/DONT/WILL/WONT <command code>
-                    iac2 = false;
-                    command += ch;
-                    processTelnetCommand(command);
-                    command = "";
-                } else if (iac && (!insb) && (ch == TN_SB)) {
-                    //5. IAC SB
-                    iac = false;
-                    insb = true;
-                    command += ch;
-                } else if (iac && (!insb) && (ch == TN_SE)) {
-                    //6. IAC SE without IAC SB - error - ignored
-                    command = "";
-                    iac = false;
-                } else if (insb) {
-                    if (!mNeedDecompression) {
-                        // IAC SB COMPRESS WILL SE for MCCP v1 (unterminated invalid telnet sequence)
-                        // IAC SB COMPRESS2 IAC SE for MCCP v2
-                        if ((mMCCP_version_1 || mMCCP_version_2) && (!mNeedDecompression)) {
-                            char _ch = buffer[i];
-                            if ((_ch == OPT_COMPRESS) || (_ch == OPT_COMPRESS2)) {
-                                bool _compress = false;
-                                if ((i > 1) && (i + 2 < datalen)) {
-                                    qDebug() << "checking mccp start seq...";
-                                    if ((buffer[i - 2] == TN_IAC) && (buffer[i - 1] == TN_SB) && (buffer[i + 1] == TN_WILL) && (buffer[i + 2] == TN_SE)) {
-                                        qDebug() << "MCCP version 1 starting sequence";
-                                        _compress = true;
-                                    }
-                                    if ((buffer[i - 2] == TN_IAC) && (buffer[i - 1] == TN_SB) && (buffer[i + 1] == TN_IAC) && (buffer[i + 2] == TN_SE)) {
-                                        qDebug() << "MCCP version 2 starting sequence";
-                                        _compress = true;
-                                    }
-                                    qDebug() << (int)buffer[i - 2] << "," << (int)buffer[i - 1] << "," << (int)buffer[i] << "," << (int)buffer[i + 1] << "," << (int)buffer[i + 2];
-                                }
-                                if (_compress) {
-                                    mNeedDecompression = true;
-                                    // from this position in stream onwards, data will be compressed by zlib
-                                    gotRest(cleandata);
-                                    cleandata = "";
-                                    initStreamDecompressor();
-                                    buffer += i + 3; //bugfix: BenH
-                                    int restLength = datalen - i - 3;
-                                    if (restLength > 0) {
-                                        datalen = decompressBuffer(buffer, restLength, out_buffer);
-                                        buffer = out_buffer;
-                                        i = -1; // start processing buffer from the beginning.
-                                    } else {
-                                        datalen = 0;
-                                        i = -1; // end the loop, this will make i and datalen the same.
-                                    }
-                                    //bugfix: BenH
-                                    iac = false;
-                                    insb = false;
-                                    command = "";
-                                    ////////////////
-                                    goto MAIN_LOOP_END;
-                                }
-                            }
-                        }
-                    }
-                    //7. inside IAC SB
-
-                    command += ch;
-                    if (iac && (ch == TN_SE)) //IAC SE - end of subcommand
-                    {
-                        processTelnetCommand(command);
-                        command = "";
-                        iac = false;
-                        insb = false;
-                    }
-                    if (iac) {
-                        iac = false;
-                    } else if (ch == TN_IAC) {
-                        iac = true;
+        processTelnetCommand(chunk.data);
+        if (recvdGA) {
+            recvdGA = false;
+            if (!mFORCE_GA_OFF) //FIXME: wird noch nicht richtig initialisiert
+            {
+                mGA_Driver = true;
+                if (mCommands > 0) {
+                    mCommands--;
+                    if (networkLatencyTime.elapsed() > 2000) {
+                        mCommands = 0;
                     }
-                } else
-                //8. IAC fol. by something else than IAC, SB, SE, DO, DONT, WILL, WONT
-                {
-                    iac = false;
-                    command += ch;
-                    processTelnetCommand(command);
-                    //this could have set receivedGA to true; we'll handle that later
-                    command = "";
                 }
+                cleandata.push_back('\xff');
+                gotPrompt(cleandata);
+                cleandata = "";
             } else {
-                if (ch == TN_BELL) {
-                    // flash taskbar for 3 seconds on the telnet bell
-                    QApplication::alert(mudlet::self(), 3000);
-                }
-                if (ch != '\r' && ch != 0) {
-                    cleandata += ch;
-                }
-            }
-        MAIN_LOOP_END:;
-            if (recvdGA) {
-                if (!mFORCE_GA_OFF) //FIXME: wird noch nicht richtig initialisiert
+                if (mLF_ON_GA) //TODO: reenable option in preferences
                 {
-                    mGA_Driver = true;
-                    if (mCommands > 0) {
-                        mCommands--;
-                        if (networkLatencyTime.elapsed() > 2000) {
-                            mCommands = 0;
-                        }
-                    }
-                    cleandata.push_back('\xff');
-                    recvdGA = false;
-                    gotPrompt(cleandata);
-                    cleandata = "";
-                } else {
-                    if (mLF_ON_GA) //TODO: reenable option in preferences
-                    {
-                        cleandata.push_back('\n');
-                    }
+                    cleandata.push_back('\n');
                 }
             }
-        } //for
-    } while (datalen == 100000);
-
-    if (cleandata.size() > 0) {
-        gotRest(cleandata);
+        }
+        break;
     }
-    mpHost->mpConsole->finalize();
-    lastTimeOffset = timeOffset.elapsed();
 }
 
 void cTelnet::raiseProtocolEvent(const QString& name, const QString& protocol)
@@ -26,20 +26,24 @@
  ***************************************************************************/
 
 
+#include "TConnectionStatistics.h"
+#include "TReplayFile.h"
+#include "TTelnetDecoder.h"
+
 #include "pre_guard.h"
 #include <QHostAddress>
 #include <QHostInfo>
 #include <QPointer>
 #include <QStringList>
-#include <QTcpSocket>
+#include <QThread>
 #include <QTime>
+#include <QVector>
 #include "post_guard.h"
 
-#include <zlib.h>
-
 #include <iostream>
 #include <queue>
 #include <string>
+#include <vector>
 
 class QNetworkAccessManager;
 class QNetworkReply;
@@ -50,6 +54,7 @@ class QTextEncoder;
 class QTimer;
 
 class Host;
+class TTelnetReader;
 class dlgComposer;
 
 
@@ -109,9 +114,16 @@ public:
     void set_USE_IRE_DRIVER_BUGFIX(bool b) { mUSE_IRE_DRIVER_BUGFIX = b; }
     void set_LF_ON_GA(bool b) { mLF_ON_GA = b; }
     void recordReplay();
+    void stopReplayRecording();
+    // A snapshot of all the measurements for this connection:
+    TConnectionStatistics statistics() const;
+    void recordStatistic(const TConnectionStatistics::Metric metric, const qint64 value) { mStatistics.record(metric, value); }
+    void resetStatistics();
     bool loadReplay(const QString&, QString* pErrMsg = nullptr);
     void loadReplayChunk();
     bool isReplaying() { return loadingReplay; }
+    bool seekReplay(const qint64 time);
+    qint64 replayDuration() const { return mReplayReader.duration(); }
     void setChannel102Variables(const QString&);
     bool socketOutRaw(std::string& data);
     const QString & getEncoding() const { return mEncoding; }
@@ -140,19 +152,26 @@ public slots:
     void slot_processReplayChunk();
     void handle_socket_signal_hostFound(QHostInfo);
     void handle_socket_signal_connected();
-    void handle_socket_signal_disconnected();
-    void handle_socket_signal_readyRead();
-    void handle_socket_signal_error();
+    void handle_socket_signal_disconnected(const QString& reason);
+    void handle_socket_signal_error(const QString& message);
+    void slot_processIncomingData();
     void slot_timerPosting();
     void slot_send_login();
     void slot_send_pass();
 
+signals:
+    // These are all handled by mpReader in the network thread:
+    void signal_connectToHost(const QString& address, const int port);
+    void signal_abort();
+    void signal_disconnectFromHost();
+    void signal_write(const QByteArray& data);
 
 private:
     cTelnet() {}
-    void initStreamDecompressor();
-    int decompressBuffer(char*& in_buffer, int& length, char* out_buffer);
     void reset();
+    void beginIncomingData();
+    void processChunk(TTelnetChunk& chunk, std::string& cleandata);
+    void endIncomingData(std::string& cleandata);
 
     void processTelnetCommand(const std::string& command);
     void sendTelnetOption(char type, char option);
@@ -160,9 +179,38 @@ private:
     void gotPrompt(std::string&);
     void postData();
     void raiseProtocolEvent(const QString& name, const QString& protocol);
+    void coalesceGMCPVariables(const QString& var, const QString& arg);
+    void flushCoalescedGMCPVariables();
+
+    // A GMCP message for one of the Host::mGMCP_coalesce_table_keys, held back
+    // until the end of the current batch of incoming data:
+    struct TCoalescedGMCP
+    {
+        QString key;
+        // Only the last one for the key counts:
+        QString payload;
+        // Merge keys have been merged into the gmcp table as they arrived and
+        // only their events have been held back:
+        bool isMerged;
+    };
 
     QPointer<Host> mpHost;
-    QTcpSocket socket;
+    // The socket, MCCP inflation and the splitting of telnet commands from the
+    // text are all handled by this, in this thread:
+    TTelnetReader* mpReader;
+    QThread mNetworkThread;
+    // Replays are decoded in this thread, the chunks are collected here:
+    TTelnetDecoder mReplayDecoder;
+    std::vector<TTelnetChunk> mReplayChunks;
+    // In the order that each key first arrived in the current batch:
+    QVector<TCoalescedGMCP> mCoalescedGMCP;
+    // The measurements taken in this thread, see statistics():
+    TConnectionStatistics mStatistics;
+    TReplayReader mReplayReader;
+    // The next chunk to play and the (recorded) time that has been reached:
+    int mReplayChunk;
+    qint64 mReplayPosition;
+    QTimer* mpReplayTimer;
     QHostAddress mHostAddress;
 //    QTextCodec* incomingDataCodec;
     QTextCodec* outgoingDataCodec;
@@ -175,11 +223,6 @@ private:
     bool mWaitingForResponse;
     std::queue<int> mCommandQueue;
 
-    z_stream mZstream;
-
-    bool mNeedDecompression;
-    std::string command;
-    bool iac, iac2, insb;
     bool myOptionState[256], hisOptionState[256];
     bool announcedState[256];
     bool heAnnouncedState[256];
@@ -204,7 +247,6 @@ private:
     QTimer* mTimerPass;
     QTime timeOffset;
     QTime mConnectionTime;
-    int lastTimeOffset;
     bool enableATCP;
     bool enableGMCP;
     bool enableChannel102;
@@ -0,0 +1,101 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "dlgConnectionStatistics.h"
+
+
+#include "Host.h"
+#include "TConnectionStatistics.h"
+
+#include "pre_guard.h"
+#include <QTimer>
+#include "post_guard.h"
+
+dlgConnectionStatistics::dlgConnectionStatistics(Host* pHost, QWidget* parent)
+: QDialog(parent)
+, mpHost(pHost)
+, mpUpdateTimer(new QTimer(this))
+{
+    setupUi(this);
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(tr("%1 - connection statistics").arg(pHost->getName()));
+
+    tableWidget_statistics->setRowCount(TConnectionStatistics::MetricCount);
+    for (int row = 0; row < TConnectionStatistics::MetricCount; ++row) {
+        for (int column = 0; column < tableWidget_statistics->columnCount(); ++column) {
+            auto pItem = new QTableWidgetItem();
+            if (column) {
+                pItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            }
+            tableWidget_statistics->setItem(row, column, pItem);
+        }
+    }
+    tableWidget_statistics->item(TConnectionStatistics::CommandLatency, 0)->setText(tr("Command to response"));
+    tableWidget_statistics->item(TConnectionStatistics::BytesPerRead, 0)->setText(tr("Bytes per read"));
+    tableWidget_statistics->item(TConnectionStatistics::InflateTime, 0)->setText(tr("Decompression (MCCP)"));
+    tableWidget_statistics->item(TConnectionStatistics::ParseTime, 0)->setText(tr("Parsing and triggers"));
+    tableWidget_statistics->item(TConnectionStatistics::TriggerTime, 0)->setText(tr("Triggers per line"));
+    tableWidget_statistics->item(TConnectionStatistics::PaintTime, 0)->setText(tr("Time to paint"));
+
+    connect(pushButton_close, &QPushButton::clicked, this, &QDialog::close);
+    connect(pushButton_reset, &QPushButton::clicked, this, &dlgConnectionStatistics::slot_reset);
+    connect(mpUpdateTimer, &QTimer::timeout, this, &dlgConnectionStatistics::slot_update);
+    mpUpdateTimer->start(1000);
+    slot_update();
+}
+
+void dlgConnectionStatistics::slot_update()
+{
+    if (!mpHost) {
+        close();
+        return;
+    }
+
+    TConnectionStatistics statistics = mpHost->mTelnet.statistics();
+    for (int row = 0; row < TConnectionStatistics::MetricCount; ++row) {
+        const auto metric = static_cast<TConnectionStatistics::Metric>(row);
+        TLatencyHistogram& histogram = statistics.histogram(metric);
+        const quint64 count = histogram.count();
+        tableWidget_statistics->item(row, 1)->setText(QString::number(count));
+
+        const qint64 values[] = {histogram.percentile(50.0), histogram.percentile(99.0), histogram.maximum()};
+        for (int column = 2; column < 5; ++column) {
+            const qint64 value = values[column - 2];
+            QString text;
+            if (!count) {
+                text = QStringLiteral("-");
+            } else if (TConnectionStatistics::isTime(metric)) {
+                //: A time in milli-seconds
+                text = tr("%1 ms").arg(value / 1000.0, 0, 'f', 3);
+            } else {
+                text = QString::number(value);
+            }
+            tableWidget_statistics->item(row, column)->setText(text);
+        }
+    }
+}
+
+void dlgConnectionStatistics::slot_reset()
+{
+    if (mpHost) {
+        mpHost->mTelnet.resetStatistics();
+    }
+    slot_update();
+}
@@ -0,0 +1,52 @@
+#ifndef MUDLET_DLGCONNECTIONSTATISTICS_H
+#define MUDLET_DLGCONNECTIONSTATISTICS_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+#include "pre_guard.h"
+#include "ui_connection_statistics.h"
+#include <QPointer>
+#include "post_guard.h"
+
+class Host;
+class QTimer;
+
+
+// Shows the TConnectionStatistics for a profile, updated every second:
+class dlgConnectionStatistics : public QDialog, public Ui::connection_statistics
+{
+    Q_OBJECT
+
+public:
+    Q_DISABLE_COPY(dlgConnectionStatistics)
+    explicit dlgConnectionStatistics(Host* pHost, QWidget* parent = nullptr);
+
+private slots:
+    void slot_update();
+    void slot_reset();
+
+private:
+    QPointer<Host> mpHost;
+    QTimer* mpUpdateTimer;
+};
+
+#endif // MUDLET_DLGCONNECTIONSTATISTICS_H
@@ -210,6 +210,7 @@ void dlgProfilePreferences::disableHostDetails()
     // disable the others:
     checkBox_USE_IRE_DRIVER_BUGFIX->setEnabled(false);
     checkBox_echoLuaErrors->setEnabled(false);
+    checkBox_scanTriggerGroups->setEnabled(false);
     checkBox_useWideAmbiguousEastAsianGlyphs->setEnabled(false);
 
     // on tab_codeEditor:
@@ -280,6 +281,7 @@ void dlgProfilePreferences::enableHostDetails()
 
     checkBox_USE_IRE_DRIVER_BUGFIX->setEnabled(true);
     checkBox_echoLuaErrors->setEnabled(true);
+    checkBox_scanTriggerGroups->setEnabled(true);
     checkBox_useWideAmbiguousEastAsianGlyphs->setEnabled(true);
 
     // on tab_codeEditor:
@@ -339,6 +341,7 @@ void dlgProfilePreferences::initWithHost(Host* pHost)
     dictList->setSelectionMode(QAbstractItemView::SingleSelection);
     enableSpellCheck->setChecked(pHost->mEnableSpellCheck);
     checkBox_echoLuaErrors->setChecked(pHost->mEchoLuaErrors);
+    checkBox_scanTriggerGroups->setChecked(pHost->mIsTriggerGroupScanEnabled);
     checkBox_useWideAmbiguousEastAsianGlyphs->setCheckState(pHost->getUseWideAmbiguousEAsianGlyphsControlState());
 
     QString path;
@@ -445,9 +448,12 @@ void dlgProfilePreferences::initWithHost(Host* pHost)
     // Set the properties in groupBox_logOptions
     mIsLoggingTimestamps->setChecked(pHost->mIsLoggingTimestamps);
     mIsToLogInHtml->setChecked(pHost->mIsNextLogFileInHtmlFormat);
+    checkBox_logInBinary->setChecked(pHost->mIsNextLogFileInBinaryFormat);
+    // The binary format records the formatting itself:
+    mIsToLogInHtml->setEnabled(!pHost->mIsNextLogFileInBinaryFormat);
 
     bool isLogFileNameEntryShown = pHost->mLogFileNameFormat.isEmpty();
-    QString logExtension = pHost->mIsNextLogFileInHtmlFormat ? ".html" : ".txt";
+    QString logExtension = pHost->mIsNextLogFileInBinaryFormat ? ".mlog" : pHost->mIsNextLogFileInHtmlFormat ? ".html" : ".txt";
     label_logFileNameExtension->setVisible(isLogFileNameEntryShown);
     lineEdit_logFileName->setVisible(isLogFileNameEntryShown);
     label_logFileName->setVisible(isLogFileNameEntryShown);
@@ -676,6 +682,7 @@ void dlgProfilePreferences::initWithHost(Host* pHost)
     connect(pushButton_resetLogDir, SIGNAL(clicked()), this, SLOT(slot_resetLogDir()));
     connect(comboBox_logFileNameFormat, SIGNAL(currentIndexChanged(int)), this, SLOT(slot_logFileNameFormatChange(int)));
     connect(mIsToLogInHtml, SIGNAL(clicked(bool)), this, SLOT(slot_changeLogFileAsHtml(bool)));
+    connect(checkBox_logInBinary, SIGNAL(clicked(bool)), this, SLOT(slot_changeLogFileAsBinary(bool)));
 }
 
 void dlgProfilePreferences::disconnectHostRelatedControls()
@@ -752,6 +759,7 @@ void dlgProfilePreferences::disconnectHostRelatedControls()
     disconnect(pushButton_resetLogDir, SIGNAL(clicked()));
     disconnect(comboBox_logFileNameFormat, SIGNAL(currentIndexChanged(int)));
     disconnect(mIsToLogInHtml, SIGNAL(clicked(bool)));
+    disconnect(checkBox_logInBinary, SIGNAL(clicked(bool)));
 }
 
 void dlgProfilePreferences::clearHostDetails()
@@ -776,6 +784,7 @@ void dlgProfilePreferences::clearHostDetails()
     dictList->clear();
     enableSpellCheck->setChecked(false);
     checkBox_echoLuaErrors->setChecked(false);
+    checkBox_scanTriggerGroups->setChecked(false);
 
     groupBox_downloadMapOptions->setVisible(false);
 
@@ -807,6 +816,8 @@ void dlgProfilePreferences::clearHostDetails()
     leftBorderWidth->clear();
     rightBorderWidth->clear();
     mIsToLogInHtml->setChecked(false);
+    mIsToLogInHtml->setEnabled(true);
+    checkBox_logInBinary->setChecked(false);
     mIsLoggingTimestamps->setChecked(false);
     commandLineMinimumHeight->clear();
     mNoAntiAlias->setChecked(false);
@@ -1907,6 +1918,7 @@ void dlgProfilePreferences::slot_save_and_exit()
         pHost->commandLineMinimumHeight = commandLineMinimumHeight->value();
         pHost->mFORCE_MXP_NEGOTIATION_OFF = mFORCE_MXP_NEGOTIATION_OFF->isChecked();
         pHost->mIsNextLogFileInHtmlFormat = mIsToLogInHtml->isChecked();
+        pHost->mIsNextLogFileInBinaryFormat = checkBox_logInBinary->isChecked();
         pHost->mIsLoggingTimestamps = mIsLoggingTimestamps->isChecked();
         pHost->mLogDir = mLogDirPath;
         pHost->mLogFileName = lineEdit_logFileName->text();
@@ -2010,6 +2022,7 @@ void dlgProfilePreferences::slot_save_and_exit()
         }
 
         pHost->mEchoLuaErrors = checkBox_echoLuaErrors->isChecked();
+        pHost->mIsTriggerGroupScanEnabled = checkBox_scanTriggerGroups->isChecked();
         pHost->setUseWideAmbiguousEAsianGlyphs(checkBox_useWideAmbiguousEastAsianGlyphs->checkState());
         pHost->mEditorTheme = code_editor_theme_selection_combobox->currentText();
         pHost->mEditorThemeFile = code_editor_theme_selection_combobox->currentData().toString();
@@ -2810,17 +2823,24 @@ void dlgProfilePreferences::slot_changeShowToolBar(const int newIndex)
 
 void dlgProfilePreferences::slot_changeLogFileAsHtml(const bool isHtml)
 {
-    if (isHtml) {
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-dd#HH-mm-ss")), tr("yyyy-MM-dd#HH-mm-ss (e.g., 1970-01-01#00-00-00.html)"));
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-ddTHH-mm-ss")), tr("yyyy-MM-ddTHH-mm-ss (e.g., 1970-01-01T00-00-00.html)"));
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-dd")), tr("yyyy-MM-dd (concatenate daily logs in, e.g. 1970-01-01.html)"));
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM")), tr("yyyy-MM (concatenate month logs in, e.g. 1970-01.html)"));
-        label_logFileNameExtension->setText(QStringLiteral(".html"));
+    setLogFileExtension(isHtml ? QStringLiteral(".html") : QStringLiteral(".txt"));
+}
+
+void dlgProfilePreferences::slot_changeLogFileAsBinary(const bool isBinary)
+{
+    mIsToLogInHtml->setEnabled(!isBinary);
+    if (isBinary) {
+        setLogFileExtension(QStringLiteral(".mlog"));
     } else {
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-dd#HH-mm-ss")), tr("yyyy-MM-dd#HH-mm-ss (e.g., 1970-01-01#00-00-00.txt)"));
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-ddTHH-mm-ss")), tr("yyyy-MM-ddTHH-mm-ss (e.g., 1970-01-01T00-00-00.txt)"));
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-dd")), tr("yyyy-MM-dd (concatenate daily logs in, e.g. 1970-01-01.txt)"));
-        comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM")), tr("yyyy-MM (concatenate month logs in, e.g. 1970-01.txt)"));
-        label_logFileNameExtension->setText(QStringLiteral(".txt"));
+        setLogFileExtension(mIsToLogInHtml->isChecked() ? QStringLiteral(".html") : QStringLiteral(".txt"));
     }
 }
+
+void dlgProfilePreferences::setLogFileExtension(const QString& extension)
+{
+    comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-dd#HH-mm-ss")), tr("yyyy-MM-dd#HH-mm-ss (e.g., 1970-01-01#00-00-00%1)").arg(extension));
+    comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-ddTHH-mm-ss")), tr("yyyy-MM-ddTHH-mm-ss (e.g., 1970-01-01T00-00-00%1)").arg(extension));
+    comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM-dd")), tr("yyyy-MM-dd (concatenate daily logs in, e.g. 1970-01-01%1)").arg(extension));
+    comboBox_logFileNameFormat->setItemText(comboBox_logFileNameFormat->findData(QStringLiteral("yyyy-MM")), tr("yyyy-MM (concatenate month logs in, e.g. 1970-01%1)").arg(extension));
+    label_logFileNameExtension->setText(extension);
+}
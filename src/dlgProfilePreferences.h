@@ -116,6 +116,7 @@ public slots:
     void slot_resetLogDir();
     void slot_logFileNameFormatChange(const int index);
     void slot_changeLogFileAsHtml(const bool isHtml);
+    void slot_changeLogFileAsBinary(const bool isBinary);
 
     // Save.
     void slot_save_and_exit();
@@ -139,6 +140,7 @@ private slots:
     void slot_changeShowToolBar(const int);
 
 private:
+    void setLogFileExtension(const QString& extension);
     void setColors();
     void setColors2();
     void setColor(QPushButton* b, QColor& c);
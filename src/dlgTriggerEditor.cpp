@@ -45,6 +45,7 @@
 #include "dlgKeysMainArea.h"
 #include "dlgScriptsMainArea.h"
 #include "dlgTriggerPatternEdit.h"
+#include "dlgTriggerProfile.h"
 #include "dlgTriggersMainArea.h"
 #include "mudlet.h"
 
@@ -415,6 +416,10 @@ dlgTriggerEditor::dlgTriggerEditor(Host* pH)
     viewStatsAction->setStatusTip(tr("Generates a statics summary display on the main profile console."));
     connect(viewStatsAction, SIGNAL(triggered()), this, SLOT(slot_viewStatsAction()));
 
+    QAction* viewTriggerProfileAction = new QAction(QIcon(QStringLiteral(":/icons/view-statistics.png")), tr("Profile"), this);
+    viewTriggerProfileAction->setStatusTip(tr("Shows how often each trigger has been tried and has matched, and the time spent matching it and running its script."));
+    connect(viewTriggerProfileAction, SIGNAL(triggered()), this, SLOT(slot_viewTriggerProfileAction()));
+
     QAction* viewErrorsAction = new QAction(QIcon(QStringLiteral(":/icons/errors.png")), tr("errors"), this);
     viewErrorsAction->setStatusTip(tr("Shows/Hides the errors console in the bottom right of this editor."));
     connect(viewErrorsAction, SIGNAL(triggered()), this, SLOT(slot_viewErrorsAction()));
@@ -461,6 +466,7 @@ dlgTriggerEditor::dlgTriggerEditor(Host* pH)
     toolBar2->addAction(viewActionAction);
     toolBar2->addAction(viewErrorsAction);
     toolBar2->addAction(viewStatsAction);
+    toolBar2->addAction(viewTriggerProfileAction);
     toolBar2->addAction(showDebugAreaAction);
 
     toolBar2->setMovable(true);
@@ -640,6 +646,13 @@ void dlgTriggerEditor::slot_toggleHiddenVariables(bool state)
     }
 }
 
+void dlgTriggerEditor::slot_viewTriggerProfileAction()
+{
+    auto pDialog = new dlgTriggerProfile(mpHost, this);
+    connect(pDialog, &dlgTriggerProfile::signal_triggerSelected, this, [=](const int id) { selectTriggerByID(id); });
+    pDialog->show();
+}
+
 void dlgTriggerEditor::slot_viewStatsAction()
 {
     mpHost->mpConsole->showStatistics();
@@ -210,6 +210,7 @@ public slots:
     void slot_export();
     void slot_import();
     void slot_viewStatsAction();
+    void slot_viewTriggerProfileAction();
     void slot_debug_mode();
     void slot_show_timers();
     void slot_show_triggers();
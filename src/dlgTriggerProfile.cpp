@@ -0,0 +1,99 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "dlgTriggerProfile.h"
+
+
+#include "Host.h"
+#include "TTrigger.h"
+#include "TriggerUnit.h"
+
+dlgTriggerProfile::dlgTriggerProfile(Host* pHost, QWidget* parent)
+: QDialog(parent)
+, mpHost(pHost)
+{
+    setupUi(this);
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(tr("%1 - trigger profile").arg(pHost->getName()));
+
+    connect(pushButton_close, &QPushButton::clicked, this, &QDialog::close);
+    connect(pushButton_refresh, &QPushButton::clicked, this, &dlgTriggerProfile::slot_update);
+    connect(pushButton_reset, &QPushButton::clicked, this, &dlgTriggerProfile::slot_reset);
+    connect(tableWidget_profile, &QTableWidget::itemDoubleClicked, this, &dlgTriggerProfile::slot_itemDoubleClicked);
+    slot_update();
+    tableWidget_profile->sortByColumn(1, Qt::DescendingOrder);
+}
+
+void dlgTriggerProfile::slot_update()
+{
+    if (!mpHost) {
+        close();
+        return;
+    }
+
+    // Filling the table whilst it is sorted would move the rows about under
+    // the items being set:
+    tableWidget_profile->setSortingEnabled(false);
+    const QList<TTrigger*> triggers = mpHost->getTriggerUnit()->profiledTriggers();
+    tableWidget_profile->setRowCount(triggers.size());
+    for (int row = 0; row < triggers.size(); ++row) {
+        TTrigger* pT = triggers.at(row);
+        const TTriggerProfile& profile = pT->mProfile;
+        // The numbers are held as such rather than as text so that they sort
+        // as numbers, the times are in milli-seconds:
+        auto milliSeconds = [](const qint64 time) { return QVariant(qRound64(time / 1000.0) / 1000.0); };
+        const QVariant values[] = {QVariant(),
+                                   milliSeconds(profile.totalTime()),
+                                   QVariant(profile.evaluations),
+                                   QVariant(profile.matches),
+                                   milliSeconds(profile.matchTime),
+                                   milliSeconds(profile.maxMatchTime),
+                                   QVariant(profile.scriptRuns),
+                                   milliSeconds(profile.scriptTime),
+                                   milliSeconds(profile.maxScriptTime)};
+
+        auto pNameItem = new QTableWidgetItem(pT->getName());
+        pNameItem->setData(Qt::UserRole, pT->getID());
+        tableWidget_profile->setItem(row, 0, pNameItem);
+        for (int column = 1; column < tableWidget_profile->columnCount(); ++column) {
+            auto pItem = new QTableWidgetItem();
+            pItem->setData(Qt::DisplayRole, values[column]);
+            pItem->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            tableWidget_profile->setItem(row, column, pItem);
+        }
+    }
+    tableWidget_profile->setSortingEnabled(true);
+}
+
+void dlgTriggerProfile::slot_reset()
+{
+    if (mpHost) {
+        mpHost->getTriggerUnit()->resetProfiles();
+    }
+    slot_update();
+}
+
+void dlgTriggerProfile::slot_itemDoubleClicked(QTableWidgetItem* pItem)
+{
+    QTableWidgetItem* pNameItem = tableWidget_profile->item(pItem->row(), 0);
+    if (pNameItem) {
+        emit signal_triggerSelected(pNameItem->data(Qt::UserRole).toInt());
+    }
+}
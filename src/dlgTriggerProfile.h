@@ -0,0 +1,56 @@
+#ifndef MUDLET_DLGTRIGGERPROFILE_H
+#define MUDLET_DLGTRIGGERPROFILE_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+
+#include "pre_guard.h"
+#include "ui_trigger_profile.h"
+#include <QPointer>
+#include "post_guard.h"
+
+class Host;
+
+
+// Shows the TTriggerProfile of each trigger of a profile that has been active
+// for a line, as a table that can be sorted by any of its columns:
+class dlgTriggerProfile : public QDialog, public Ui::trigger_profile
+{
+    Q_OBJECT
+
+public:
+    Q_DISABLE_COPY(dlgTriggerProfile)
+    explicit dlgTriggerProfile(Host* pHost, QWidget* parent = nullptr);
+
+signals:
+    // When a row is double-clicked, so that the trigger can be shown:
+    void signal_triggerSelected(int id);
+
+private slots:
+    void slot_update();
+    void slot_reset();
+    void slot_itemDoubleClicked(QTableWidgetItem* pItem);
+
+private:
+    QPointer<Host> mpHost;
+};
+
+#endif // MUDLET_DLGTRIGGERPROFILE_H
@@ -23,6 +23,8 @@
 
 #include "FontManager.h"
 #include "HostManager.h"
+#include "TBenchmark.h"
+#include "TRegex.h"
 #include "mudlet.h"
 
 #include "pre_guard.h"
@@ -35,6 +37,7 @@
 #include <QSplashScreen>
 #include <QStringBuilder>
 #include <QTextLayout>
+#include <QTimer>
 #include "post_guard.h"
 
 /*
@@ -107,6 +110,17 @@ QCoreApplication* createApplication(int& argc, char* argv[], unsigned int& actio
         }
 
         if (isOption) {
+            if (qstrcmp(argv[i], "--benchmark") == 0) {
+                // Implies --quiet as nothing is to be shown:
+                action |= 4 | 8;
+                continue;
+            }
+
+            if (qstrcmp(argv[i], "--no-regex-jit") == 0) {
+                // Dealt with once the application exists:
+                continue;
+            }
+
             if (tolower(argument) == 'v') {
                 action = 2; // Make this the only action to do and do it directly
                 break;
@@ -147,6 +161,12 @@ QCoreApplication* createApplication(int& argc, char* argv[], unsigned int& actio
         // Qt's OpenGL layer on Windows (QOpenGLFunctions)
         QApplication::setAttribute(Qt::AA_UseDesktopOpenGL);
 #endif
+        if ((action & 8) && qgetenv("QT_QPA_PLATFORM").isEmpty()) {
+            // A benchmark does not need (or want) to put anything on the
+            // screen, but the consoles are still widgets that need a platform
+            // to be created on:
+            qputenv("QT_QPA_PLATFORM", QByteArrayLiteral("offscreen"));
+        }
         return new QApplication(argc, argv); // Normal course of events - (GUI), so: game on!
     }
 }
@@ -313,7 +333,12 @@ int main(int argc, char* argv[])
         texts << QCoreApplication::translate("main", "Usage: %1 [OPTION...]\n"
                                                      "       -h, --help      displays this message.\n"
                                                      "       -v, --version   displays version information.\n"
-                                                     "       -q, --quiet     no splash screen on startup.\n\n"
+                                                     "       -q, --quiet     no splash screen on startup.\n"
+                                                     "       --benchmark PROFILE REPLAY  load the PROFILE without connecting\n"
+                                                     "                       it, play the REPLAY file through it as fast as\n"
+                                                     "                       possible, report the time taken and quit.\n"
+                                                     "       --no-regex-jit  compile trigger and alias regexes without any study or\n"
+                                                     "                       JIT data, to compare a --benchmark against.\n\n"
                                                      "There are other inherited options that arise from the Qt Libraries which are\n"
                                                      "less likely to be useful for normal use of this application:\n")
                  .arg(QLatin1String(APP_TARGET));
@@ -364,12 +389,29 @@ int main(int argc, char* argv[])
         return 0;
     }
 
+    QString benchmarkProfileName;
+    QString benchmarkReplayFileName;
+    if (startupAction & 8) {
+        const QStringList arguments = QCoreApplication::arguments();
+        const int index = arguments.indexOf(QStringLiteral("--benchmark"));
+        if (index < 0 || index + 2 >= arguments.size()) {
+            std::cerr << QCoreApplication::translate("main", "Usage: %1 --benchmark PROFILE REPLAY\n").arg(QLatin1String(APP_TARGET)).toStdString();
+            return 1;
+        }
+        benchmarkProfileName = arguments.at(index + 1);
+        benchmarkReplayFileName = arguments.at(index + 2);
+    }
+
+    if (QCoreApplication::arguments().contains(QStringLiteral("--no-regex-jit"))) {
+        TRegex::setJitEnabled(false);
+    }
+
     /*******************************************************************
      * If we get to HERE then we are going to run a GUI application... *
      *******************************************************************/
 
 #if defined(Q_OS_WIN32) && defined(INCLUDE_UPDATER)
-    auto abortLaunch = runUpdate();
+    auto abortLaunch = !(startupAction & 8) && runUpdate();
     if (abortLaunch) {
         return 0;
     }
@@ -600,17 +642,24 @@ int main(int argc, char* argv[])
         splash.finish(mudlet::self());
     }
 
-    mudlet::self()->show();
+    if (startupAction & 8) {
+        // The main window is left hidden and the benchmark is started once the
+        // event loop is running; it quits the application when it is done:
+        auto pBenchmark = new TBenchmark(benchmarkProfileName, benchmarkReplayFileName, mudlet::self());
+        QTimer::singleShot(0, pBenchmark, &TBenchmark::slot_start);
+    } else {
+        mudlet::self()->show();
 
-    mudlet::self()->startAutoLogin();
+        mudlet::self()->startAutoLogin();
 
 #if defined(INCLUDE_UPDATER)
-    mudlet::self()->checkUpdatesOnStart();
+        mudlet::self()->checkUpdatesOnStart();
 #if !defined(Q_OS_MACOS)
-    // Sparkle doesn't allow us to manually show the changelog, so leave it be for dblsqd only
-    mudlet::self()->showChangelogIfUpdated();
+        // Sparkle doesn't allow us to manually show the changelog, so leave it be for dblsqd only
+        mudlet::self()->showChangelogIfUpdated();
 #endif // Q_OS_LINUX
 #endif // INCLUDE_UPDATER
+    }
 
     app->restoreOverrideCursor();
 
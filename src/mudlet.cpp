@@ -29,6 +29,7 @@
 #include "Host.h"
 #include "HostManager.h"
 #include "LuaInterface.h"
+#include "TBenchmark.h"
 #include "TCommandLine.h"
 #include "TConsole.h"
 #include "TDebug.h"
@@ -43,6 +44,7 @@
 #include "XMLimport.h"
 #include "dlgAboutDialog.h"
 #include "dlgConnectionProfiles.h"
+#include "dlgConnectionStatistics.h"
 #include "dlgIRC.h"
 #include "dlgMapper.h"
 #include "dlgNotepad.h"
@@ -124,6 +126,10 @@ QPointer<QMainWindow> mudlet::mpDebugArea = nullptr;
 bool mudlet::debugMode = false;
 const bool mudlet::scmIsDevelopmentVersion = !QByteArray(APP_BUILD).isEmpty();
 
+// Doubling the replay speed beyond this switches to playing it as fast as
+// possible:
+static const int csmMaxReplaySpeedMultiple = 64;
+
 QPointer<mudlet> mudlet::_self = nullptr;
 
 void mudlet::start()
@@ -423,6 +429,7 @@ mudlet::mudlet()
     connect(dactionReconnect, SIGNAL(triggered()), this, SLOT(slot_reconnect()));
     connect(dactionDisconnect, SIGNAL(triggered()), this, SLOT(slot_disconnect()));
     connect(dactionNotepad, SIGNAL(triggered()), this, SLOT(slot_notes()));
+    connect(dactionConnectionStatistics, &QAction::triggered, this, &mudlet::slot_connection_statistics);
     connect(dactionReplay, SIGNAL(triggered()), this, SLOT(slot_replay()));
 
     connect(mactionHelp, SIGNAL(triggered()), this, SLOT(show_help_dialog()));
@@ -1757,6 +1764,23 @@ bool mudlet::setConsoleBufferSize(Host* pHost, const QString& name, int x1, int
     }
 }
 
+bool mudlet::setConsoleBufferArchived(Host* pHost, const QString& name, const bool state)
+{
+    if (name == "main") {
+        pHost->mpConsole->buffer.setArchived(state);
+        return true;
+    }
+
+    QMap<QString, TConsole*>& dockWindowConsoleMap = mHostConsoleMap[pHost];
+
+    if (dockWindowConsoleMap.contains(name)) {
+        (dockWindowConsoleMap[name]->buffer).setArchived(state);
+        return true;
+    } else {
+        return false;
+    }
+}
+
 bool mudlet::setScrollBarVisible(Host* pHost, const QString& name, bool isVisible)
 {
     QMap<QString, TConsole*>& dockWindowConsoleMap = mHostConsoleMap[pHost];
@@ -2703,6 +2727,19 @@ void mudlet::slot_notes()
     pNotes->show();
 }
 
+void mudlet::slot_connection_statistics()
+{
+    Host* pHost = getActiveHost();
+    if (!pHost) {
+        return;
+    }
+    if (!pHost->mpConnectionStatistics) {
+        pHost->mpConnectionStatistics = new dlgConnectionStatistics(pHost, this);
+    }
+    pHost->mpConnectionStatistics->raise();
+    pHost->mpConnectionStatistics->show();
+}
+
 void mudlet::slot_irc()
 {
     Host* pHost = getActiveHost();
@@ -2941,6 +2978,11 @@ void mudlet::slot_connection_dlg_finished(const QString& profile, int historyVer
     //      and one host has a slower response time as the other one, but
     //      the worst that can happen is that they have to login manually.
 
+    // A benchmark only wants the profile, the data comes from a replay:
+    if (TBenchmark::active()) {
+        return;
+    }
+
     tempHostQueue.enqueue(pHost);
     tempHostQueue.enqueue(pHost);
     pHost->connectToServer();
@@ -3048,7 +3090,7 @@ bool mudlet::replayStart()
     mpActionReplaySpeedUp = new QAction(QIcon(QStringLiteral(":/icons/export.png")), tr("Faster"), this);
     mpActionReplaySpeedUp->setObjectName(QStringLiteral("replay_speed_up_action"));
     mpActionReplaySpeedUp->setToolTip(QStringLiteral("<html><head/><body>%1</body></html>")
-                                      .arg(tr("<p>Replay each step with a shorter time interval between steps.</p>")));
+                                      .arg(tr("<p>Replay each step with a shorter time interval between steps, beyond X%1 the replay is played as fast as possible.</p>").arg(csmMaxReplaySpeedMultiple)));
     mpToolBarReplay->addAction(mpActionReplaySpeedUp);
     mpToolBarReplay->widgetForAction(mpActionReplaySpeedUp)->setObjectName(mpActionReplaySpeedUp->objectName());
 
@@ -3065,7 +3107,7 @@ bool mudlet::replayStart()
     connect(mpActionReplaySpeedUp, SIGNAL(triggered()), this, SLOT(slot_replaySpeedUp()));
     connect(mpActionReplaySpeedDown, SIGNAL(triggered()), this, SLOT(slot_replaySpeedDown()));
 
-    mpLabelReplaySpeedDisplay->setText(QStringLiteral("<font size=25><b>%1</b></font>").arg(tr("Speed: X%1").arg(mReplaySpeed)));
+    setReplaySpeed(mReplaySpeed);
 
     mpTimerReplay = new QTimer(this);
     mpTimerReplay->setInterval(1000);
@@ -3128,27 +3170,39 @@ void mudlet::replayOver()
     dactionReplay->setEnabled(true);
     mpActionReplay->setToolTip(QStringLiteral("<html><head/><body>%1</body></html>").arg(tr("<p>Load a Mudlet replay.</p>")));
     dactionReplay->setToolTip(mpActionReplay->toolTip());
+
+    if (TBenchmark::active()) {
+        TBenchmark::active()->finish();
+    }
 }
 
-void mudlet::slot_replaySpeedUp()
+// A speed of zero (or less) plays the replay as fast as it can be processed,
+// anything else is a multiple of the recorded rate:
+void mudlet::setReplaySpeed(const int speed)
 {
+    mReplaySpeed = qMax(0, speed);
     if (mpLabelReplaySpeedDisplay) {
-        mReplaySpeed = mReplaySpeed * 2;
-        mpLabelReplaySpeedDisplay->setText(QStringLiteral("<font size=25><b>%1</b></font>").arg(tr("Speed: X%1").arg(mReplaySpeed)));
-
+        if (mReplaySpeed) {
+            mpLabelReplaySpeedDisplay->setText(QStringLiteral("<font size=25><b>%1</b></font>").arg(tr("Speed: X%1").arg(mReplaySpeed)));
+        } else {
+            mpLabelReplaySpeedDisplay->setText(QStringLiteral("<font size=25><b>%1</b></font>").arg(tr("Speed: Maximum")));
+        }
         mpLabelReplaySpeedDisplay->show();
     }
 }
 
+void mudlet::slot_replaySpeedUp()
+{
+    if (mpLabelReplaySpeedDisplay) {
+        // Past the largest multiple go to as fast as possible:
+        setReplaySpeed((mReplaySpeed <= 0 || mReplaySpeed >= csmMaxReplaySpeedMultiple) ? 0 : mReplaySpeed * 2);
+    }
+}
+
 void mudlet::slot_replaySpeedDown()
 {
     if (mpLabelReplaySpeedDisplay) {
-        mReplaySpeed = mReplaySpeed / 2;
-        if (mReplaySpeed < 1) {
-            mReplaySpeed = 1;
-        }
-        mpLabelReplaySpeedDisplay->setText(QStringLiteral("<font size=25><b>%1</b></font>").arg(tr("Speed: X%1").arg(mReplaySpeed)));
-        mpLabelReplaySpeedDisplay->show();
+        setReplaySpeed((mReplaySpeed <= 0) ? csmMaxReplaySpeedMultiple : qMax(1, mReplaySpeed / 2));
     }
 }
 
@@ -3624,7 +3678,7 @@ bool mudlet::loadReplay(Host* pHost, const QString& replayFileName, QString* pEr
     if (!mpMainToolBar || mpToolBarReplay) {
         // This was in (bool) ctelnet::loadReplay(const QString&, QString*)
         // but is needed here to prevent getting into there otherwise a lua call
-        // to start a replay would mess up (QFile) ctelnet::replayFile for a
+        // to start a replay would mess up (TReplayReader) cTelnet::mReplayReader for a
         // replay already in progess in the SAME profile.  Technically there
         // could be a very small chance of a race condition if a lua call of
         // loadRawFile happens at the same time as a file was selected for a
@@ -185,7 +185,9 @@ public:
     controlsVisibility menuBarVisibility() const { return mMenuBarVisibility; }
     controlsVisibility toolBarVisibility() const { return mToolbarVisibility; }
     bool replayStart();
+    void setReplaySpeed(const int speed);
     bool setConsoleBufferSize(Host* pHost, const QString& name, int x1, int y1);
+    bool setConsoleBufferArchived(Host* pHost, const QString& name, bool state);
     bool setScrollBarVisible(Host* pHost, const QString& name, bool isVisible);
     void replayOver();
     void showEvent(QShowEvent* event) override;
@@ -343,6 +345,7 @@ public slots:
     void slot_replay();
     void slot_disconnect();
     void slot_notes();
+    void slot_connection_statistics();
     void slot_reconnect();
     void slot_close_profile_requested(int);
     void startAutoLogin();
@@ -287,6 +287,7 @@ unix:!macx {
         -lopengl32 \
         -lglut \
         -lglu32 \
+        -lpsapi \              # for TBenchmark.cpp
         -L"$${MINGW_BASE_DIR}\\bin"
     INCLUDEPATH += "C:\\mingw32\\include" \
                    "C:\\Libraries\\boost_1_60_0" \
@@ -460,6 +461,7 @@ SOURCES += \
     dlgColorTrigger.cpp \
     dlgComposer.cpp \
     dlgConnectionProfiles.cpp \
+    dlgConnectionStatistics.cpp \
     dlgIRC.cpp \
     dlgKeysMainArea.cpp \
     dlgMapper.cpp \
@@ -473,6 +475,7 @@ SOURCES += \
     dlgTimersMainArea.cpp \
     dlgTriggerEditor.cpp \
     dlgTriggerPatternEdit.cpp \
+    dlgTriggerProfile.cpp \
     dlgTriggersMainArea.cpp \
     dlgVarsMainArea.cpp \
     EAction.cpp \
@@ -491,8 +494,11 @@ SOURCES += \
     TAction.cpp \
     TAlias.cpp \
     TArea.cpp \
+    TBenchmark.cpp \
     TBuffer.cpp \
+    TBufferSearch.cpp \
     TCommandLine.cpp \
+    TConnectionStatistics.cpp \
     TConsole.cpp \
     TDebug.cpp \
     TDockWidget.cpp \
@@ -500,22 +506,32 @@ SOURCES += \
     TFlipButton.cpp \
     TForkedProcess.cpp \
     TimerUnit.cpp \
+    TJsonToLua.cpp \
     TKey.cpp \
     TLabel.cpp \
+    TLogWriter.cpp \
     TLuaInterpreter.cpp \
     TMap.cpp \
+    TRegex.cpp \
+    TRegexSet.cpp \
+    TReplayFile.cpp \
     TriggerUnit.cpp \
     TRoom.cpp \
     TRoomDB.cpp \
     TScript.cpp \
+    TScrollbackArchive.cpp \
+    TSessionLog.cpp \
     TSplitter.cpp \
     TSplitterHandle.cpp \
     TTabBar.cpp \
+    TTelnetDecoder.cpp \
+    TTelnetReader.cpp \
     TTextEdit.cpp \
     TTimer.cpp \
     TToolBar.cpp \
     TTreeWidget.cpp \
     TTrigger.cpp \
+    TTriggerPrefilter.cpp \
     TVar.cpp \
     VarUnit.cpp \
     XMLexport.cpp \
@@ -533,6 +549,7 @@ HEADERS += \
     dlgColorTrigger.h \
     dlgComposer.h \
     dlgConnectionProfiles.h \
+    dlgConnectionStatistics.h \
     dlgIRC.h \
     dlgKeysMainArea.h \
     dlgMapper.h \
@@ -546,6 +563,7 @@ HEADERS += \
     dlgTimersMainArea.h \
     dlgTriggerEditor.h \
     dlgTriggerPatternEdit.h \
+    dlgTriggerProfile.h \
     dlgTriggersMainArea.h \
     dlgVarsMainArea.h \
     EAction.h \
@@ -565,8 +583,12 @@ HEADERS += \
     TAlias.h \
     TArea.h \
     TAstar.h \
+    TBenchmark.h \
     TBuffer.h \
+    TBufferSearch.h \
+    TByteScanner.h \
     TCommandLine.h \
+    TConnectionStatistics.h \
     TConsole.h \
     TDebug.h \
     TDockWidget.h \
@@ -576,24 +598,36 @@ HEADERS += \
     TFlipButton.h \
     TForkedProcess.h \
     TimerUnit.h \
+    TJsonToLua.h \
     TKey.h \
     TLabel.h \
+    TLogWriter.h \
     TLuaInterpreter.h \
     TMap.h \
     TMatchState.h \
     Tree.h \
+    TRegex.h \
+    TRegexSet.h \
+    TReplayFile.h \
     TriggerUnit.h \
     TRoom.h \
     TRoomDB.h \
     TScript.h \
+    TScrollbackArchive.h \
+    TSessionLog.h \
     TSplitter.h \
     TSplitterHandle.h \
+    TSpscQueue.h \
+    TStringView.h \
     TTabBar.h \
+    TTelnetDecoder.h \
+    TTelnetReader.h \
     TTextEdit.h \
     TTimer.h \
     TToolBar.h \
     TTreeWidget.h \
     TTrigger.h \
+    TTriggerPrefilter.h \
     TVar.h \
     VarUnit.h \
     XMLexport.h \
@@ -609,6 +643,7 @@ FORMS += \
     ui/color_trigger.ui \
     ui/composer.ui \
     ui/connection_profiles.ui \
+    ui/connection_statistics.ui \
     ui/dlgPackageExporter.ui \
     ui/glyph_usage.ui \
     ui/irc.ui \
@@ -625,6 +660,7 @@ FORMS += \
     ui/triggers_main_area.ui \
     ui/trigger_editor.ui \
     ui/trigger_pattern_edit.ui \
+    ui/trigger_profile.ui \
     ui/vars_main_area.ui
 
 RESOURCES = mudlet.qrc
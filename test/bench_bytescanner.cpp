@@ -0,0 +1,122 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Compares the TByteScanner runs that the telnet and ANSI parsers now take
+// plain text in with the byte at a time loops that they used before, over a
+// megabyte of typical (mostly plain text, some colour codes) MUD output.
+
+#include "TByteScanner.h"
+
+#include <QtTest/QtTest>
+
+#include <string>
+
+class bench_bytescanner : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Splits the data into the runs of ordinary bytes and the bytes that
+    // stop them - much as the parsers do - and returns the text of the runs:
+    template <typename Scanner>
+    static std::string takeRuns(const QByteArray& data, Scanner scanner)
+    {
+        std::string text;
+        const char* pData = data.constData();
+        const size_t length = static_cast<size_t>(data.size());
+        size_t i = 0;
+        while (i < length) {
+            const size_t runLength = scanner(pData + i, length - i);
+            text.append(pData + i, runLength);
+            // The byte that needs individual attention:
+            i += runLength + 1;
+        }
+        return text;
+    }
+
+    static size_t findTelnetSpecialByteAtATime(const char* data, const size_t length)
+    {
+        size_t i = 0;
+        while (i < length && !TByteScanner::isTelnetSpecial(data[i])) {
+            ++i;
+        }
+        return i;
+    }
+
+    static size_t findEndOfPlainTextByteAtATime(const char* data, const size_t length)
+    {
+        size_t i = 0;
+        while (i < length && TByteScanner::isPlainText(data[i])) {
+            ++i;
+        }
+        return i;
+    }
+
+    QByteArray mData;
+
+private slots:
+    void initTestCase()
+    {
+        const QByteArray lines[] = {QByteArrayLiteral("You are standing in a small clearing, the path leads north and south.\r\n"),
+                                    QByteArrayLiteral("\x1b[1;32mA goblin warrior\x1b[0m attacks you with a rusty sword, hitting you hard.\r\n"),
+                                    QByteArrayLiteral("H:1234/1500 M:876/900 E:4500/4500 W:3200/3200 [eb db] \xff\xf9"),
+                                    QByteArrayLiteral("[Newbie] Someone says, \"Does anybody know where the smithy in town is?\"\r\n")};
+        while (mData.size() < 1024 * 1024) {
+            for (const auto& line : lines) {
+                mData.append(line);
+            }
+        }
+    }
+
+    void telnetRuns_data()
+    {
+        QTest::addColumn<bool>("isByteAtATime");
+        QTest::newRow("byte at a time") << true;
+        QTest::newRow("TByteScanner") << false;
+    }
+
+    void telnetRuns()
+    {
+        QFETCH(bool, isByteAtATime);
+        QCOMPARE(takeRuns(mData, TByteScanner::findTelnetSpecial), takeRuns(mData, findTelnetSpecialByteAtATime));
+        QBENCHMARK {
+            takeRuns(mData, isByteAtATime ? findTelnetSpecialByteAtATime : TByteScanner::findTelnetSpecial);
+        }
+    }
+
+    void plainTextRuns_data()
+    {
+        QTest::addColumn<bool>("isByteAtATime");
+        QTest::newRow("byte at a time") << true;
+        QTest::newRow("TByteScanner") << false;
+    }
+
+    void plainTextRuns()
+    {
+        QFETCH(bool, isByteAtATime);
+        QCOMPARE(takeRuns(mData, TByteScanner::findEndOfPlainText), takeRuns(mData, findEndOfPlainTextByteAtATime));
+        QBENCHMARK {
+            takeRuns(mData, isByteAtATime ? findEndOfPlainTextByteAtATime : TByteScanner::findEndOfPlainText);
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(bench_bytescanner)
+#include "bench_bytescanner.moc"
@@ -0,0 +1,131 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Compares decoding GMCP payloads with TJsonToLua, as the main Lua
+// interpreter now does, with calling the Lua json_to_value (yajl.to_value)
+// function for each one, as it used to, over some typical messages from
+// small (Char.Vitals) to large (a long inventory list).
+
+#include "TJsonToLua.h"
+
+#include <QtTest/QtTest>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lualib.h>
+
+int luaopen_yajl(lua_State*);
+}
+
+class bench_jsontolua : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void addMessages()
+    {
+        QTest::addColumn<QByteArray>("json");
+
+        QTest::newRow("Char.Vitals") << QByteArrayLiteral("{\"hp\": \"1234\", \"maxhp\": \"1500\", \"mp\": \"876\", \"maxmp\": \"900\", \"ep\": 4500, \"maxep\": 4500, "
+                                                          "\"wp\": 3200, \"maxwp\": 3200, \"nl\": 42, \"string\": \"H:1234/1500 M:876/900\"}");
+        QTest::newRow("Room.Info") << QByteArrayLiteral("{\"num\": 12345, \"name\": \"A small clearing\", \"area\": \"Forest of Shadows\", \"environment\": \"Forest\", "
+                                                        "\"coords\": \"45,3,-2,0\", \"map\": \"www.example.com/map 12 34\", \"details\": [\"outdoors\", \"wilderness\"], "
+                                                        "\"exits\": {\"n\": 12346, \"s\": 12344, \"e\": 12400, \"w\": 12290, \"up\": 13001}, \"owner\": null}");
+        QTest::newRow("Comm.Channel.Text") << QByteArrayLiteral("{\"channel\": \"newbie\", \"talker\": \"Someone\", "
+                                                                "\"text\": \"\\u001b[1;32m(Newbie): Someone says, \\\"Does anybody know where the smithy is?\\\"\\u001b[0;37m\"}");
+
+        QByteArray items("{\"location\": \"inv\", \"items\": [");
+        for (int i = 0; i < 100; ++i) {
+            if (i) {
+                items.append(", ");
+            }
+            items.append("{\"id\": \"").append(QByteArray::number(100000 + i)).append("\", \"name\": \"a rusty iron sword number ").append(QByteArray::number(i));
+            items.append("\", \"attrib\": \"wWl\", \"weight\": ").append(QByteArray::number(i * 0.25)).append(", \"wielded\": ").append((i % 7) ? "false" : "true").append("}");
+        }
+        items.append("]}");
+        QTest::newRow("Char.Items.List") << items;
+    }
+
+    lua_State* L;
+
+private slots:
+    void initTestCase()
+    {
+        L = luaL_newstate();
+        luaL_openlibs(L);
+        luaopen_yajl(L);
+        lua_setglobal(L, "yajl");
+        QVERIFY(!luaL_dostring(L,
+                               "json_to_value = yajl.to_value\n"
+                               "function same(a, b)\n"
+                               "  if type(a) ~= 'table' or type(b) ~= 'table' then return a == b end\n"
+                               "  for k, v in pairs(a) do if not same(v, b[k]) then return false end end\n"
+                               "  for k in pairs(b) do if a[k] == nil then return false end end\n"
+                               "  return true\n"
+                               "end"));
+    }
+
+    void cleanupTestCase() { lua_close(L); }
+
+    void jsonToValue_data() { addMessages(); }
+
+    void jsonToValue()
+    {
+        QFETCH(QByteArray, json);
+
+        QBENCHMARK {
+            lua_getglobal(L, "json_to_value");
+            lua_pushlstring(L, json.constData(), json.size());
+            if (lua_pcall(L, 1, 1, 0)) {
+                QFAIL(lua_tostring(L, -1));
+            }
+            lua_pop(L, 1);
+        }
+    }
+
+    void native_data() { addMessages(); }
+
+    void native()
+    {
+        QFETCH(QByteArray, json);
+
+        // Must give the same as the Lua function did:
+        QString errorMessage;
+        lua_getglobal(L, "same");
+        QVERIFY2(TJsonToLua(L).push(json.constData(), static_cast<size_t>(json.size()), errorMessage), qPrintable(errorMessage));
+        lua_getglobal(L, "json_to_value");
+        lua_pushlstring(L, json.constData(), json.size());
+        QVERIFY(!lua_pcall(L, 1, 1, 0));
+        QVERIFY(!lua_pcall(L, 2, 1, 0));
+        QVERIFY(lua_toboolean(L, -1));
+        lua_pop(L, 1);
+
+        QBENCHMARK {
+            TJsonToLua decoder(L);
+            if (!decoder.push(json.constData(), static_cast<size_t>(json.size()), errorMessage)) {
+                QFAIL(qPrintable(errorMessage));
+            }
+            lua_pop(L, 1);
+        }
+    }
+};
+
+QTEST_APPLESS_MAIN(bench_jsontolua)
+#include "bench_jsontolua.moc"
@@ -0,0 +1,214 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Compares the memory that a full scrollback (10,000 lines of 100
+// characters, TBuffer's default limit) of TChars takes, and the time to fill
+// it, with the packed TChar and with the int member layout that it had before.
+// Also compares applying a format to a selection a character at a time, as
+// TBuffer::applyFormat(...) used to, with TBuffer::applyFormat(...) itself,
+// which does it a line span at a time, on a buffer full of lines.
+
+#include "TBuffer.h"
+
+#include <QtTest/QtTest>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+// TChar as it was, with a whole int (or unsigned) for every member:
+struct TUnpackedChar
+{
+    TUnpackedChar() : fgR(255), fgG(255), fgB(255), bgR(0), bgG(0), bgB(0), flags(0), link(0) {}
+
+    int fgR;
+    int fgG;
+    int fgB;
+    int bgR;
+    int bgG;
+    int bgB;
+    unsigned flags;
+    int link;
+};
+
+// The number of bytes that the lines of the scrollback currently have
+// allocated, including the unused space in the blocks of each std::deque:
+static qint64 smAllocated = 0;
+
+template <typename T>
+struct TCountingAllocator
+{
+    typedef T value_type;
+
+    TCountingAllocator() {}
+    template <typename U>
+    TCountingAllocator(const TCountingAllocator<U>&) {}
+
+    T* allocate(const size_t n)
+    {
+        smAllocated += static_cast<qint64>(n * sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, const size_t n)
+    {
+        smAllocated -= static_cast<qint64>(n * sizeof(T));
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const TCountingAllocator<T>&, const TCountingAllocator<U>&)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const TCountingAllocator<T>&, const TCountingAllocator<U>&)
+{
+    return false;
+}
+
+class bench_tchar : public QObject
+{
+    Q_OBJECT
+
+private:
+    static const int csmLines = 10000;
+    static const int csmLineLength = 100;
+
+    // Built a character at a time, as TBuffer::translateToPlainText(...) does:
+    template <typename Char>
+    static void fill(std::deque<std::deque<Char, TCountingAllocator<Char>>>& scrollback)
+    {
+        Char format;
+        for (int y = 0; y < csmLines; ++y) {
+            scrollback.emplace_back();
+            auto& line = scrollback.back();
+            for (int x = 0; x < csmLineLength; ++x) {
+                format.fgR = static_cast<quint8>(x);
+                line.push_back(format);
+            }
+        }
+    }
+
+    template <typename Char>
+    static qint64 scrollbackSize()
+    {
+        std::deque<std::deque<Char, TCountingAllocator<Char>>> scrollback;
+        smAllocated = 0;
+        fill(scrollback);
+        return smAllocated;
+    }
+
+    // TBuffer::applyFormat(...) as it was, less its range checks:
+    static void applyPerCharacter(std::deque<std::deque<TChar>>& buffer, const int x1, const int y1, const int x2, const int y2, const TChar& format)
+    {
+        for (int y = y1; y <= y2; y++) {
+            int x = 0;
+            if (y == y1) {
+                x = x1;
+            }
+            while (x < static_cast<int>(buffer[y].size())) {
+                if (y >= y2) {
+                    if (x >= x2) {
+                        return;
+                    }
+                }
+
+                buffer[y][x] = format;
+                x++;
+            }
+        }
+    }
+
+private slots:
+    void scrollbackMemory_data()
+    {
+        QTest::addColumn<bool>("isPacked");
+
+        QTest::newRow("unpacked (before)") << false;
+        QTest::newRow("TChar") << true;
+    }
+
+    void scrollbackMemory()
+    {
+        QFETCH(bool, isPacked);
+
+        const qint64 bytes = isPacked ? scrollbackSize<TChar>() : scrollbackSize<TUnpackedChar>();
+        qDebug("%d bytes per character of a line", static_cast<int>(bytes / (csmLines * csmLineLength)));
+        QTest::setBenchmarkResult(bytes, QTest::BytesAllocated);
+    }
+
+    void scrollbackFill_data() { scrollbackMemory_data(); }
+
+    void scrollbackFill()
+    {
+        QFETCH(bool, isPacked);
+
+        QBENCHMARK {
+            if (isPacked) {
+                scrollbackSize<TChar>();
+            } else {
+                scrollbackSize<TUnpackedChar>();
+            }
+        }
+    }
+
+    void applyFormat_data()
+    {
+        QTest::addColumn<bool>("isBySpans");
+        QTest::addColumn<int>("lineCount");
+
+        QTest::newRow("1 line, per character (before)") << false << 1;
+        QTest::newRow("1 line, TBuffer") << true << 1;
+        QTest::newRow("1000 lines, per character (before)") << false << 1000;
+        QTest::newRow("1000 lines, TBuffer") << true << 1000;
+    }
+
+    // From part way along the first line to part way along the last one, of
+    // the selection at the end of a full scrollback:
+    void applyFormat()
+    {
+        QFETCH(bool, isBySpans);
+        QFETCH(int, lineCount);
+
+        std::deque<std::deque<TChar>> buffer(static_cast<size_t>(csmLines), std::deque<TChar>(csmLineLength));
+        const int y1 = csmLines - lineCount;
+        const int y2 = csmLines - 1;
+        TChar format;
+        format.fgR = 0;
+        format.flags = TCHAR_BOLD;
+        QBENCHMARK {
+            if (isBySpans) {
+                TBuffer::applyFormat(buffer, QPoint(10, y1), QPoint(90, y2), format);
+            } else {
+                applyPerCharacter(buffer, 10, y1, 90, y2, format);
+            }
+        }
+        QCOMPARE(buffer.at(static_cast<size_t>(y1 - 1)).at(50).flags, static_cast<quint16>(0));
+        QCOMPARE(buffer.at(static_cast<size_t>(y1)).at(9).flags, static_cast<quint16>(0));
+        QCOMPARE(buffer.at(static_cast<size_t>(y1)).at(10).flags, static_cast<quint16>(TCHAR_BOLD));
+        QCOMPARE(buffer.back().at(89).flags, static_cast<quint16>(TCHAR_BOLD));
+        QCOMPARE(buffer.back().at(90).flags, static_cast<quint16>(0));
+    }
+};
+
+QTEST_APPLESS_MAIN(bench_tchar)
+#include "bench_tchar.moc"
@@ -0,0 +1,271 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Checks that the trigram index of TBufferSearchIndex gives the same answers
+// as looking at every line would, as lines arrive, are trimmed and are
+// changed in place, and that a search carries on into the lines that have
+// been archived.
+
+#include "TBuffer.h"
+#include "TBufferSearch.h"
+#include "TScrollbackArchive.h"
+
+#include <QtTest/QtTest>
+
+class tst_buffersearch : public QObject
+{
+    Q_OBJECT
+
+private:
+    // The last line is always looked at directly, so keep the ones that are
+    // wanted in the index away from it:
+    static QStringList someLines()
+    {
+        return QStringList() << QStringLiteral("You see a rusty sword here.") << QStringLiteral("A goblin attacks you!") << QStringLiteral("You hit the goblin.")
+                             << QStringLiteral("The goblin dies.") << QStringLiteral("H:100 M:100 >");
+    }
+
+    static TBufferSearchRequest request(const QStringList& lines, const QString& query, const int firstLine = 0)
+    {
+        TBufferSearchRequest request;
+        request.lines = lines;
+        request.firstLine = firstLine;
+        request.query = query;
+        request.fromLine = firstLine + lines.size();
+        return request;
+    }
+
+    // As TBuffer::shrinkBuffer() does, with plain characters:
+    static bool store(TScrollbackArchive& archive, const QStringList& lines)
+    {
+        std::deque<std::deque<TChar>> chars;
+        std::deque<qint64> times;
+        QList<bool> prompts;
+        for (const QString& line : lines) {
+            chars.emplace_back(static_cast<size_t>(line.size()));
+            times.push_back(0);
+            prompts.append(false);
+        }
+        return archive.store(chars, lines, times, prompts, 0, lines.size());
+    }
+
+    // Two blocks, as two trims of the buffer would leave, with the lines of
+    // someLines() still in memory after them:
+    static QSharedPointer<TScrollbackArchive> someArchivedLines()
+    {
+        QSharedPointer<TScrollbackArchive> archive(new TScrollbackArchive);
+        store(*archive, QStringList() << QStringLiteral("You enter the cave.") << QStringLiteral("A bat flies past."));
+        store(*archive, QStringList() << QStringLiteral("You find a lantern.") << QStringLiteral("It is dark."));
+        return archive;
+    }
+
+private slots:
+    void findsUpwardsAndDownwards()
+    {
+        TBufferSearchIndex index;
+        TBufferSearchRequest up = request(someLines(), QStringLiteral("goblin"));
+        TBufferSearchResult result = index.search(up);
+        QCOMPARE(result.line, 3);
+        QCOMPARE(result.matches.size(), 1);
+        QCOMPARE(result.matches.first(), qMakePair(4, 6));
+
+        up.fromLine = result.line;
+        QCOMPARE(index.search(up).line, 2);
+
+        TBufferSearchRequest down = request(someLines(), QStringLiteral("goblin"));
+        down.isUpwards = false;
+        down.fromLine = -1;
+        QCOMPARE(index.search(down).line, 1);
+        QCOMPARE(index.search(request(someLines(), QStringLiteral("dragon"))).line, -1);
+    }
+
+    void followsTrimmedAndAddedLines()
+    {
+        TBufferSearchIndex index;
+        QCOMPARE(index.search(request(someLines(), QStringLiteral("sword"))).line, 0);
+
+        // The first two lines have gone and two more have arrived:
+        QStringList lines = someLines().mid(2);
+        lines.insert(lines.size() - 1, QStringLiteral("You pick up a shiny sword."));
+        lines.insert(lines.size() - 1, QStringLiteral("H:100 M:100 >"));
+        QCOMPARE(index.search(request(lines, QStringLiteral("sword"), 2)).line, 4);
+        QCOMPARE(index.search(request(lines, QStringLiteral("rusty"), 2)).line, -1);
+    }
+
+    void findsTextChangedInPlace()
+    {
+        TBufferSearchIndex index;
+        QStringList lines = someLines();
+        QCOMPARE(index.search(request(lines, QStringLiteral("orc"))).line, -1);
+
+        // As a trigger doing replace("goblin", "orc") would:
+        lines[1] = QStringLiteral("A orc attacks you!");
+        lines[3] = QStringLiteral("The orc dies.");
+        TBufferSearchRequest edited = request(lines, QStringLiteral("orc"));
+        edited.editedLines << 1 << 3;
+        TBufferSearchResult result = index.search(edited);
+        QCOMPARE(result.line, 3);
+        QCOMPARE(result.matches.first(), qMakePair(4, 3));
+        edited.editedLines.clear();
+        edited.fromLine = result.line;
+        QCOMPARE(index.search(edited).line, 1);
+
+        // Only the lines it was told about are looked at again:
+        QCOMPARE(index.search(request(lines, QStringLiteral("goblin"))).line, 2);
+    }
+
+    // The changes must not be forgotten when they come with a search that
+    // does not use the index:
+    void keepsChangesFromUnindexedSearches()
+    {
+        TBufferSearchIndex index;
+        QStringList lines = someLines();
+        QCOMPARE(index.search(request(lines, QStringLiteral("goblin"))).line, 3);
+
+        lines[0] = QStringLiteral("You see a rusty dagger here.");
+        TBufferSearchRequest regex = request(lines, QStringLiteral("rusty\\s+\\w+"));
+        regex.isRegularExpression = true;
+        regex.editedLines << 0;
+        QCOMPARE(index.search(regex).line, 0);
+        QCOMPARE(index.search(request(lines, QStringLiteral("dagger"))).line, 0);
+    }
+
+    void rebuildsAfterRenumbering()
+    {
+        TBufferSearchIndex index;
+        QStringList lines = someLines();
+        QCOMPARE(index.search(request(lines, QStringLiteral("sword"))).line, 0);
+
+        lines.insert(1, QStringLiteral("Your sword glows."));
+        TBufferSearchRequest renumbered = request(lines, QStringLiteral("sword"));
+        renumbered.renumberCount = 1;
+        QCOMPARE(index.search(renumbered).line, 1);
+    }
+
+    void findsLinesInTheArchive()
+    {
+        TBufferSearchIndex index;
+        QSharedPointer<TScrollbackArchive> archive = someArchivedLines();
+        QCOMPARE(archive->lineCount(), 4);
+        TBufferSearchRequest up = request(someLines(), QStringLiteral("lantern"), 4);
+        up.archive = archive;
+        up.archivedLineCount = archive->lineCount();
+        TBufferSearchResult result = index.search(up);
+        QCOMPARE(result.line, 2);
+        QCOMPARE(result.matches.first(), qMakePair(11, 7));
+
+        // In the older block, and then on up from a line in the archive:
+        up.query = QStringLiteral("You");
+        up.fromLine = 4;
+        QCOMPARE(index.search(up).line, 2);
+        up.fromLine = 2;
+        QCOMPARE(index.search(up).line, 0);
+        up.fromLine = 0;
+        QCOMPARE(index.search(up).line, -1);
+
+        up.query = QStringLiteral("^It is \\w+");
+        up.isRegularExpression = true;
+        up.fromLine = 9;
+        QCOMPARE(index.search(up).line, 3);
+
+        // Down from the archive into the lines in memory:
+        TBufferSearchRequest down = request(someLines(), QStringLiteral("goblin"), 4);
+        down.archive = archive;
+        down.archivedLineCount = archive->lineCount();
+        down.isUpwards = false;
+        down.fromLine = 1;
+        QCOMPARE(index.search(down).line, 5);
+        down.query = QStringLiteral("dark");
+        QCOMPARE(index.search(down).line, 3);
+    }
+
+    // Only the archived lines that were there when the copy was made are
+    // read, as the numbers of any others are not known to the request:
+    void onlyReadsTheArchivedLinesItWasToldAbout()
+    {
+        TBufferSearchIndex index;
+        QSharedPointer<TScrollbackArchive> archive = someArchivedLines();
+        // The copy was made before the second block was stored, so those two
+        // lines are still at the start of it:
+        TBufferSearchRequest up = request(QStringList() << QStringLiteral("You find a lantern.") << QStringLiteral("It is dark.") << someLines(), QStringLiteral("bat"), 2);
+        up.archive = archive;
+        up.archivedLineCount = 2;
+        QCOMPARE(index.search(up).line, 1);
+        up.query = QStringLiteral("cave");
+        QCOMPARE(index.search(up).line, 0);
+
+        // The second block was taken back into the buffer after the copy:
+        up = request(someLines(), QStringLiteral("lantern"), 4);
+        up.archive = archive;
+        up.archivedLineCount = 4;
+        std::deque<std::deque<TChar>> chars;
+        QStringList text;
+        std::deque<qint64> times;
+        QList<bool> prompts;
+        QCOMPARE(archive->takeLastBlock(chars, text, times, prompts), 2);
+        QCOMPARE(index.search(up).line, -1);
+        up.query = QStringLiteral("bat");
+        QCOMPARE(index.search(up).line, 1);
+
+        // Archiving was turned off:
+        up.archive.reset();
+        QCOMPARE(index.search(up).line, -1);
+    }
+
+    // As TConsole::slot_searchBufferFinished() does, blocks are taken back
+    // from the archive until the line found is in memory, where it must then
+    // be at its session number less the lines still trimmed:
+    void bringsBackArchivedHits()
+    {
+        TBufferSearchIndex index;
+        QSharedPointer<TScrollbackArchive> archive = someArchivedLines();
+        std::deque<std::deque<TChar>> chars(5);
+        QStringList lines = someLines();
+        std::deque<qint64> times(5);
+        QList<bool> prompts;
+        prompts << false << false << false << false << false;
+        int trimmedLines = 4;
+
+        TBufferSearchRequest up = request(lines, QStringLiteral("bat"), trimmedLines);
+        up.archive = archive;
+        up.archivedLineCount = archive->lineCount();
+        const TBufferSearchResult result = index.search(up);
+        QCOMPARE(result.line, 1);
+        while (result.line < trimmedLines) {
+            const int count = archive->takeLastBlock(chars, lines, times, prompts);
+            QVERIFY(count > 0);
+            trimmedLines -= count;
+        }
+        QCOMPARE(trimmedLines, 0);
+        QCOMPARE(archive->lineCount(), 0);
+        QCOMPARE(lines.size(), 9);
+        QCOMPARE(static_cast<int>(chars.size()), 9);
+        QCOMPARE(lines.at(result.line - trimmedLines).mid(result.matches.first().first, result.matches.first().second), QStringLiteral("bat"));
+
+        // The same line is found again now that it is in memory:
+        TBufferSearchRequest again = request(lines, QStringLiteral("bat"), trimmedLines);
+        again.archive = archive;
+        again.archivedLineCount = archive->lineCount();
+        QCOMPARE(index.search(again).line, result.line);
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_buffersearch)
+#include "tst_buffersearch.moc"
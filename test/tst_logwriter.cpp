@@ -0,0 +1,225 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Checks what ends up in a log file as TBuffer::log(...) would hand lines to
+// the TLogWriter through a TLogHeldLines, in particular across the flush done
+// when the connection is lost (TConsole::flushLog()) and a reconnection: no
+// line may be written twice or out of order. Also checks that a binary
+// session log that has been damaged - such as by a frame being only partly
+// written before a crash - can still be read past it.
+
+#include "TLogWriter.h"
+#include "TSessionLog.h"
+
+#include <QtTest/QtTest>
+
+#include "pre_guard.h"
+#include <QTemporaryDir>
+#include "post_guard.h"
+
+class tst_logwriter : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QByteArray contents(const QString& fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return QByteArray();
+        }
+        return file.readAll();
+    }
+
+    static QByteArray linesFrame(const QStringList& lines)
+    {
+        QByteArray records;
+        for (const auto& line : lines) {
+            TSessionLog::appendLine(records, 0, false, line, QVector<TSessionLogRun>());
+        }
+        return TSessionLog::frame(records);
+    }
+
+    QString writeSessionLog(const QByteArray& frames)
+    {
+        const QString fileName = mDir.filePath(QStringLiteral("%1.mlog").arg(QTest::currentTestFunction()));
+        QFile file(fileName);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write(TSessionLog::fileHeader() + frames);
+        }
+        return fileName;
+    }
+
+    static QStringList readSessionLog(const QString& fileName, QString& errorString)
+    {
+        QStringList lines;
+        TSessionLogReader reader;
+        if (!reader.open(fileName, errorString)) {
+            return lines;
+        }
+        TSessionLogRecord record;
+        while (reader.readRecord(record)) {
+            lines << record.text;
+        }
+        errorString = reader.errorString();
+        return lines;
+    }
+
+    QTemporaryDir mDir;
+    QString mFileName;
+    TLogWriter mWriter;
+
+private slots:
+    void init()
+    {
+        QVERIFY(mDir.isValid());
+        mFileName = mDir.filePath(QStringLiteral("%1.txt").arg(QTest::currentTestFunction()));
+        QVERIFY2(mWriter.open(mFileName), qPrintable(mWriter.errorString()));
+    }
+
+    void cleanup() { mWriter.close(); }
+
+    void writesHeldLinesOnceSomethingElseIs()
+    {
+        TLogHeldLines held;
+        held.hold(mWriter, 0, 0, QStringLiteral("Welcome!\n"), QByteArray());
+        mWriter.flush();
+        QCOMPARE(contents(mFileName), QByteArray());
+
+        held.hold(mWriter, 1, 1, QStringLiteral("H:100 >\n"), QByteArray());
+        // The same line again with a command after the prompt:
+        held.hold(mWriter, 1, 1, QStringLiteral("H:100 > look\n"), QByteArray());
+        held.hold(mWriter, 2, 3, QStringLiteral("A small clearing.\nThere are two exits.\n"), QByteArray());
+        held.release(mWriter);
+        mWriter.close();
+        QCOMPARE(contents(mFileName), QByteArrayLiteral("Welcome!\nH:100 > look\nA small clearing.\nThere are two exits.\n"));
+    }
+
+    void disconnectAndReconnect()
+    {
+        TLogHeldLines held;
+        held.hold(mWriter, 0, 0, QStringLiteral("Welcome!\n"), QByteArray());
+        held.hold(mWriter, 1, 1, QStringLiteral("H:100 >\n"), QByteArray());
+
+        // The connection is lost, everything so far must be in the file:
+        held.release(mWriter);
+        mWriter.flush();
+        QCOMPARE(contents(mFileName), QByteArrayLiteral("Welcome!\nH:100 >\n"));
+        // ... but only once, however many times that is done:
+        held.release(mWriter);
+        mWriter.flush();
+        QCOMPARE(contents(mFileName), QByteArrayLiteral("Welcome!\nH:100 >\n"));
+
+        // The last line is logged again, unchanged, once the text after the
+        // reconnection moves it on:
+        held.hold(mWriter, 1, 1, QStringLiteral("H:100 >\n"), QByteArray());
+        held.hold(mWriter, 2, 2, QStringLiteral("Welcome back!\n"), QByteArray());
+        held.hold(mWriter, 3, 3, QStringLiteral("H:100 >\n"), QByteArray());
+        held.release(mWriter);
+        mWriter.close();
+        QCOMPARE(contents(mFileName), QByteArrayLiteral("Welcome!\nH:100 >\nWelcome back!\nH:100 >\n"));
+    }
+
+    // A line written early that then has more added to it is written again,
+    // in its place, as that is what was on the screen each time:
+    void changedAfterDisconnection()
+    {
+        TLogHeldLines held;
+        held.hold(mWriter, 0, 0, QStringLiteral("H:100 >\n"), QByteArray());
+        held.release(mWriter);
+        held.hold(mWriter, 0, 0, QStringLiteral("H:100 > connect\n"), QByteArray());
+        held.hold(mWriter, 1, 1, QStringLiteral("Welcome back!\n"), QByteArray());
+        held.release(mWriter);
+        mWriter.close();
+        QCOMPARE(contents(mFileName), QByteArrayLiteral("H:100 >\nH:100 > connect\nWelcome back!\n"));
+    }
+
+    // The other lines logged straight after a disconnection (the messages
+    // about it) come after the line held back from before it:
+    void keepsOrderAcrossDisconnection()
+    {
+        TLogHeldLines held;
+        held.hold(mWriter, 0, 0, QStringLiteral("You are hungry.\n"), QByteArray());
+        held.hold(mWriter, 1, 1, QStringLiteral("[ ALERT ] - Socket got disconnected.\n"), QByteArray());
+        held.release(mWriter);
+        held.hold(mWriter, 2, 2, QStringLiteral("[ INFO ]  - Looking up the IP address\n"), QByteArray());
+        held.release(mWriter);
+        mWriter.close();
+        QCOMPARE(contents(mFileName), QByteArrayLiteral("You are hungry.\n[ ALERT ] - Socket got disconnected.\n[ INFO ]  - Looking up the IP address\n"));
+    }
+
+    void readsSessionLog()
+    {
+        const QString fileName = writeSessionLog(linesFrame({QStringLiteral("one"), QStringLiteral("two")}) + linesFrame({QStringLiteral("three")}));
+        QString errorString;
+        QCOMPARE(readSessionLog(fileName, errorString), QStringList({QStringLiteral("one"), QStringLiteral("two"), QStringLiteral("three")}));
+        QVERIFY(errorString.isEmpty());
+    }
+
+    // Logging to the same file again after a crash adds the new frames after
+    // one that was only partly written:
+    void readsPastPartlyWrittenFrame_data()
+    {
+        QTest::addColumn<int>("writtenSize");
+
+        QTest::newRow("part of the header") << 3;
+        QTest::newRow("the header") << 5;
+        QTest::newRow("part of the records") << 20;
+    }
+
+    void readsPastPartlyWrittenFrame()
+    {
+        QFETCH(int, writtenSize);
+
+        const QByteArray lost = linesFrame({QStringLiteral("lost"), QStringLiteral("also lost")});
+        QVERIFY(writtenSize < lost.size());
+        const QString fileName = writeSessionLog(linesFrame({QStringLiteral("one")}) + lost.left(writtenSize) + linesFrame({QStringLiteral("two"), QStringLiteral("three")}));
+        QString errorString;
+        QCOMPARE(readSessionLog(fileName, errorString), QStringList({QStringLiteral("one"), QStringLiteral("two"), QStringLiteral("three")}));
+        QVERIFY(!errorString.isEmpty());
+    }
+
+    void partlyWrittenFrameAtEnd()
+    {
+        const QByteArray lost = linesFrame({QStringLiteral("lost")});
+        const QString fileName = writeSessionLog(linesFrame({QStringLiteral("one")}) + lost.left(lost.size() - 1));
+        QString errorString;
+        QCOMPARE(readSessionLog(fileName, errorString), QStringList({QStringLiteral("one")}));
+        QVERIFY(!errorString.isEmpty());
+    }
+
+    // The rest of a frame after a damaged record is skipped, but not the
+    // frames after it:
+    void readsPastDamagedRecord()
+    {
+        QByteArray records;
+        TSessionLog::appendLine(records, 0, false, QStringLiteral("one"), QVector<TSessionLogRun>());
+        // Not a record type:
+        records.append(char(0x7f));
+        TSessionLog::appendLine(records, 0, false, QStringLiteral("lost"), QVector<TSessionLogRun>());
+        const QString fileName = writeSessionLog(TSessionLog::frame(records) + linesFrame({QStringLiteral("two")}));
+        QString errorString;
+        QCOMPARE(readSessionLog(fileName, errorString), QStringList({QStringLiteral("one"), QStringLiteral("two")}));
+        QVERIFY(!errorString.isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(tst_logwriter)
+#include "tst_logwriter.moc"
@@ -0,0 +1,171 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Checks TRegexSet against PCRE itself (compiled with the same options as for
+// a trigger): a regex that PCRE finds a match for in a line must always be
+// reported by the set as one that may match it. Both some regexes picked out
+// for the corners of the syntax and a few thousand made up at random from
+// pieces of it are tried, over a set of lines made up in the same way.
+
+#include "TRegexSet.h"
+
+#include <QtTest/QtTest>
+
+#include <pcre.h>
+
+#include <random>
+#include <vector>
+
+class tst_regexset : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct TPcreRegex
+    {
+        QString regex;
+        pcre* pCode;
+        int id;
+    };
+
+    static pcre* compilePcre(const QString& regex)
+    {
+        const char* error = nullptr;
+        int errorOffset = 0;
+        return pcre_compile(regex.toUtf8().constData(), PCRE_UTF8 | PCRE_UCP, &error, &errorOffset, nullptr);
+    }
+
+    static bool pcreMatches(const pcre* pCode, const QString& line)
+    {
+        const QByteArray subject = line.toUtf8();
+        int ovector[30];
+        return pcre_exec(pCode, nullptr, subject.constData(), subject.size(), 0, 0, ovector, 30) >= 0;
+    }
+
+    // Adds to the set those of the regexes that both it and PCRE can take,
+    // then checks every line against all of them:
+    static void compare(const QStringList& regexes, const QStringList& lines)
+    {
+        TRegexSet set;
+        std::vector<TPcreRegex> compiled;
+        for (const auto& regex : regexes) {
+            pcre* pCode = compilePcre(regex);
+            if (!pCode) {
+                continue;
+            }
+            const int id = set.addPattern(regex);
+            if (id < 0) {
+                pcre_free(pCode);
+                continue;
+            }
+            compiled.push_back({regex, pCode, id});
+        }
+
+        QString failure;
+        for (const auto& line : lines) {
+            if (!set.scan(line)) {
+                failure = QStringLiteral("\"%1\" could not be scanned").arg(line);
+                break;
+            }
+            for (const auto& pcreRegex : compiled) {
+                if (pcreMatches(pcreRegex.pCode, line) && !set.mayMatch(pcreRegex.id)) {
+                    failure = QStringLiteral("\"%1\" matches \"%2\" but the set rules it out").arg(pcreRegex.regex, line);
+                    break;
+                }
+            }
+            if (!failure.isEmpty()) {
+                break;
+            }
+        }
+        for (const auto& pcreRegex : compiled) {
+            pcre_free(pcreRegex.pCode);
+        }
+        QVERIFY2(failure.isEmpty(), qPrintable(failure));
+    }
+
+private slots:
+    void neverRulesOutMatch_data()
+    {
+        QTest::addColumn<QString>("regex");
+        QTest::addColumn<QString>("line");
+
+        // A quantifier after a quote is for its last character only:
+        QTest::newRow("quote repeated") << QStringLiteral("^x\\Qab\\E{2}y") << QStringLiteral("xabby");
+        QTest::newRow("quote optional") << QStringLiteral("^x\\Qab\\E?y$") << QStringLiteral("xay");
+        QTest::newRow("quote at least once") << QStringLiteral("^\\Q.*\\E+$") << QStringLiteral(".**");
+        QTest::newRow("quote to the end") << QStringLiteral("a\\Q+b") << QStringLiteral("a+b");
+        // ... and after something that PCRE ignores, for what came before:
+        QTest::newRow("lone \\E") << QStringLiteral("^a\\E+$") << QStringLiteral("aaa");
+        QTest::newRow("empty quote") << QStringLiteral("^a\\Q\\E{2}$") << QStringLiteral("aa");
+        QTest::newRow("comment") << QStringLiteral("^a(?#note)+$") << QStringLiteral("aa");
+        QTest::newRow("group repeated") << QStringLiteral("^(ab){2}$") << QStringLiteral("abab");
+        QTest::newRow("escaped backslash") << QStringLiteral("^\\\\Q+$") << QStringLiteral("\\QQ");
+        QTest::newRow("caseless") << QStringLiteral("(?i)hello \\w+") << QStringLiteral("HELLO there");
+    }
+
+    void neverRulesOutMatch()
+    {
+        QFETCH(QString, regex);
+        QFETCH(QString, line);
+
+        compare({regex}, {line});
+    }
+
+    void randomRegexes()
+    {
+        static const QStringList atoms{QStringLiteral("a"), QStringLiteral("b"), QStringLiteral("x"), QStringLiteral("A"), QStringLiteral("."), QStringLiteral("\\d"),
+                                       QStringLiteral("\\w"), QStringLiteral("\\s"), QStringLiteral("[ab]"), QStringLiteral("[^a]"), QStringLiteral("[a-x]"),
+                                       QStringLiteral("\\Qab\\E"), QStringLiteral("\\Qa.\\E"), QStringLiteral("\\Q\\E"), QStringLiteral("\\E"), QStringLiteral("(?#c)"),
+                                       QStringLiteral("(a|b)"), QStringLiteral("(?:ab)"), QStringLiteral("(x|)"), QStringLiteral("^"), QStringLiteral("$"),
+                                       QStringLiteral("\\b"), QStringLiteral("(?=a)"), QStringLiteral("(?i)"), QStringLiteral("\\."), QStringLiteral("{")};
+        static const QStringList quantifiers{QString(), QString(), QString(), QStringLiteral("?"), QStringLiteral("*"), QStringLiteral("+"), QStringLiteral("{2}"),
+                                             QStringLiteral("{1,2}"), QStringLiteral("{0,}"), QStringLiteral("*?"), QStringLiteral("++")};
+        static const QString lineCharacters = QStringLiteral("abxA1 .{");
+
+        // The same every time, so that a failure can be repeated:
+        std::minstd_rand random(20181017);
+        auto pick = [&](const int count) { return static_cast<int>(random() % static_cast<unsigned>(count)); };
+
+        QStringList regexes;
+        for (int i = 0; i < 2000; ++i) {
+            QString regex;
+            for (int length = 1 + pick(4); length > 0; --length) {
+                regex.append(atoms.at(pick(atoms.size()))).append(quantifiers.at(pick(quantifiers.size())));
+            }
+            if (!pick(8)) {
+                regex.append(QLatin1Char('|')).append(atoms.at(pick(atoms.size())));
+            }
+            regexes << regex;
+        }
+        QStringList lines{QString()};
+        for (int i = 0; i < 300; ++i) {
+            QString line;
+            for (int length = 1 + pick(7); length > 0; --length) {
+                line.append(lineCharacters.at(pick(lineCharacters.size())));
+            }
+            lines << line;
+        }
+
+        compare(regexes, lines);
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_regexset)
+#include "tst_regexset.moc"
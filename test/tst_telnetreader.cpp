@@ -0,0 +1,300 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Connects the network thread half of cTelnet (the TTelnetReader, set up in
+// its own thread just as cTelnet::cTelnet(...) does) to a TTestServer on
+// localhost and checks what comes out of it for the negotiation, with and
+// without MCCP v2 and with the output both in one piece and dribbled out a
+// few bytes at a time so that the telnet commands and the compressed stream
+// are split across reads. cTelnet itself needs a whole Host (and the mudlet
+// singleton) so it cannot be built on its own; this client stands in for
+// its option handling.
+
+#include "TTelnetReader.h"
+#include "TTestServer.h"
+#include "ctelnet.h"
+
+#include <QtTest/QtTest>
+
+#include "pre_guard.h"
+#include <QThread>
+#include "post_guard.h"
+
+// How long to wait for anything to arrive:
+static const int scmTimeout = 10000;
+
+class TTestClient : public QObject
+{
+public:
+    explicit TTestClient(const bool isCompressionAccepted)
+    : mIsConnected(false)
+    , mIsDisconnected(false)
+    , mIsCompressionEnded(false)
+    , mpReader(new TTelnetReader())
+    , mIsCompressionAccepted(isCompressionAccepted)
+    {
+        mpReader->moveToThread(&mNetworkThread);
+        connect(&mNetworkThread, &QThread::started, mpReader, &TTelnetReader::slot_init);
+        connect(&mNetworkThread, &QThread::finished, mpReader, &QObject::deleteLater);
+        connect(mpReader, &TTelnetReader::signal_connected, this, [=]() { mIsConnected = true; });
+        connect(mpReader, &TTelnetReader::signal_disconnected, this, [=]() {
+            processIncomingData();
+            mIsDisconnected = true;
+        });
+        connect(mpReader, &TTelnetReader::signal_dataAvailable, this, [=]() { processIncomingData(); });
+        mNetworkThread.start();
+    }
+
+    ~TTestClient()
+    {
+        mpReader->stop();
+        mNetworkThread.quit();
+        mNetworkThread.wait();
+    }
+
+    void connectToHost(const quint16 port)
+    {
+        QMetaObject::invokeMethod(mpReader, "slot_connectToHost", Qt::QueuedConnection, Q_ARG(QString, QStringLiteral("127.0.0.1")), Q_ARG(int, port));
+    }
+
+    void sendLine(const QByteArray& line) { write(line + QByteArrayLiteral("\r\n")); }
+
+    bool hasCommand(const QByteArray& command) const { return mCommands.contains(command); }
+
+    TConnectionStatistics statistics() const
+    {
+        TConnectionStatistics statistics;
+        mpReader->copyStatistics(statistics);
+        return statistics;
+    }
+
+    QByteArray mText;
+    QList<QByteArray> mCommands;
+    bool mIsConnected;
+    bool mIsDisconnected;
+    bool mIsCompressionEnded;
+
+private:
+    void write(const QByteArray& data) { QMetaObject::invokeMethod(mpReader, "slot_write", Qt::QueuedConnection, Q_ARG(QByteArray, data)); }
+
+    // As cTelnet::slot_processIncomingData() does:
+    void processIncomingData()
+    {
+        mpReader->clearDataAvailable();
+        TTelnetChunk chunk;
+        while (mpReader->takeChunk(chunk)) {
+            switch (chunk.type) {
+            case TTelnetChunk::Text:
+                mText.append(chunk.data.data(), static_cast<int>(chunk.data.size()));
+                break;
+            case TTelnetChunk::Command:
+                handleCommand(QByteArray(chunk.data.data(), static_cast<int>(chunk.data.size())));
+                break;
+            case TTelnetChunk::CompressionEnded:
+                mIsCompressionEnded = true;
+                break;
+            case TTelnetChunk::Bell:
+                // Fall-through
+            case TTelnetChunk::Raw:
+                break;
+            }
+            mpReader->recycle(chunk.data);
+        }
+    }
+
+    // Accepts everything the test server offers, bar MCCP if told not to:
+    void handleCommand(const QByteArray& command)
+    {
+        mCommands.append(command);
+        if (command.size() != 3 || command.at(1) != TN_WILL) {
+            return;
+        }
+
+        const char option = command.at(2);
+        QByteArray reply;
+        reply.append(TN_IAC);
+        if (option == OPT_COMPRESS2 && !mIsCompressionAccepted) {
+            reply.append(TN_DONT);
+        } else {
+            if (option == OPT_COMPRESS2) {
+                // The network thread must know before the server gets our
+                // reply and starts the compressed stream:
+                mpReader->setCompressionNegotiated(true);
+            }
+            reply.append(TN_DO);
+        }
+        reply.append(option);
+        write(reply);
+    }
+
+
+    QThread mNetworkThread;
+    TTelnetReader* mpReader;
+    bool mIsCompressionAccepted;
+};
+
+
+class tst_telnetreader : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QByteArray command(const char type, const char option)
+    {
+        QByteArray data;
+        data.append(TN_IAC).append(type).append(option);
+        return data;
+    }
+
+    // The server's output that ends with the given text is all in once it
+    // has turned up:
+    static bool waitForText(TTestClient& client, const QByteArray& ending)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (!client.mText.endsWith(ending)) {
+            if (timer.elapsed() > scmTimeout) {
+                return false;
+            }
+            QTest::qWait(10);
+        }
+        return true;
+    }
+
+    static TTestServerSettings serverSettings()
+    {
+        TTestServerSettings settings;
+        // Any free port:
+        settings.port = 0;
+        settings.probeInterval = 0;
+        return settings;
+    }
+
+private slots:
+    void negotiation()
+    {
+        TTestServerSettings settings = serverSettings();
+        settings.isCompressionOffered = false;
+        TTestServer server(settings);
+        server.addStep(TTestStep(TTestStep::Text, QByteArrayLiteral("Welcome!")));
+        server.addStep(TTestStep(TTestStep::Gmcp, QByteArrayLiteral("Char.Vitals {\"hp\": 100}")));
+        server.addStep(TTestStep(TTestStep::Prompt, QByteArrayLiteral(">")));
+        QString errorMessage;
+        QVERIFY2(server.listen(errorMessage), qPrintable(errorMessage));
+
+        TTestClient client(true);
+        client.connectToHost(server.serverPort());
+        QTRY_VERIFY_WITH_TIMEOUT(client.mIsConnected, scmTimeout);
+        QVERIFY(waitForText(client, QByteArrayLiteral("Welcome!\n>")));
+
+        QVERIFY(client.hasCommand(command(TN_WILL, OPT_EOR)));
+        QVERIFY(client.hasCommand(command(TN_WILL, OPT_GMCP)));
+        QVERIFY(client.hasCommand(command(TN_WILL, OPT_MXP)));
+        QVERIFY(!client.hasCommand(command(TN_WILL, OPT_COMPRESS2)));
+        // Only sent because we said DO to the above:
+        QByteArray gmcp;
+        gmcp.append(TN_IAC).append(TN_SB).append(OPT_GMCP).append("Char.Vitals {\"hp\": 100}").append(TN_IAC).append(TN_SE);
+        QVERIFY(client.hasCommand(gmcp));
+        QByteArray mxp;
+        mxp.append(TN_IAC).append(TN_SB).append(OPT_MXP).append(TN_IAC).append(TN_SE);
+        QVERIFY(client.hasCommand(mxp));
+        QTRY_VERIFY_WITH_TIMEOUT(client.mCommands.last() == QByteArray().append(TN_IAC).append(TN_EOR), scmTimeout);
+
+        // Something sent to the server gets an answer, which is timed:
+        client.sendLine(QByteArrayLiteral("look"));
+        QVERIFY(waitForText(client, QByteArrayLiteral("You sent: look\n>")));
+        QVERIFY(client.statistics().histogram(TConnectionStatistics::CommandLatency).count() > 0);
+    }
+
+    void transfer_data()
+    {
+        QTest::addColumn<bool>("isCompressed");
+        QTest::addColumn<int>("burstSize");
+
+        QTest::newRow("plain, whole") << false << 0;
+        QTest::newRow("plain, split") << false << 3;
+        QTest::newRow("MCCP, whole") << true << 0;
+        QTest::newRow("MCCP, split") << true << 3;
+    }
+
+    void transfer()
+    {
+        QFETCH(bool, isCompressed);
+        QFETCH(int, burstSize);
+
+        TTestServerSettings settings = serverSettings();
+        settings.isCompressionOffered = isCompressed;
+        if (burstSize > 0) {
+            // A burst every milli-second:
+            settings.burstSize = burstSize;
+            settings.bytesPerSecond = burstSize * 1000;
+        }
+        TTestServer server(settings);
+        QByteArray expected;
+        for (int i = 1; i <= 50; ++i) {
+            // A doubled IAC comes through as a single 0xff in the text:
+            const QByteArray line = QByteArrayLiteral("\x1b[1;3") + QByteArray::number(i % 8) + QByteArrayLiteral("mLine ") + QByteArray::number(i)
+                                    + QByteArrayLiteral("\x1b[0m of the output, with an \xff in it.");
+            server.addStep(TTestStep(TTestStep::Text, line));
+            expected.append(line).append('\n');
+            if (i % 10 == 0) {
+                server.addStep(TTestStep(TTestStep::Prompt, QByteArrayLiteral("H:100 M:100 >")));
+                expected.append("H:100 M:100 >");
+            }
+        }
+        QString errorMessage;
+        QVERIFY2(server.listen(errorMessage), qPrintable(errorMessage));
+
+        TTestClient client(true);
+        client.connectToHost(server.serverPort());
+        QVERIFY(waitForText(client, expected.right(40)));
+        QCOMPARE(client.mText, expected);
+        QCOMPARE(client.mCommands.count(command(TN_WILL, OPT_COMPRESS2)), isCompressed ? 1 : 0);
+        QVERIFY(!client.mIsCompressionEnded);
+
+        TConnectionStatistics statistics = client.statistics();
+        // Only recorded when there was something to inflate:
+        QCOMPARE(statistics.histogram(TConnectionStatistics::InflateTime).count() > 0, isCompressed);
+        if (burstSize > 0) {
+            QVERIFY(statistics.histogram(TConnectionStatistics::BytesPerRead).count() > 10);
+        }
+    }
+
+    void disconnection()
+    {
+        TTestServer server(serverSettings());
+        server.addStep(TTestStep(TTestStep::Prompt, QByteArrayLiteral(">")));
+        QString errorMessage;
+        QVERIFY2(server.listen(errorMessage), qPrintable(errorMessage));
+
+        TTestClient client(true);
+        client.connectToHost(server.serverPort());
+        QVERIFY(waitForText(client, QByteArrayLiteral(">")));
+
+        // The server says goodbye and hangs up straight away; what it said
+        // must still be passed on:
+        client.sendLine(QByteArrayLiteral("quit"));
+        QTRY_VERIFY_WITH_TIMEOUT(client.mIsDisconnected, scmTimeout);
+        QVERIFY(client.mText.endsWith("Bye!\n"));
+    }
+};
+
+QTEST_GUILESS_MAIN(tst_telnetreader)
+#include "tst_telnetreader.moc"
@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Checks the text that TTriggerPrefilter::requiredLiteral(...) takes from a
+// regex: it must be in every line that the regex matches - checked here
+// against one such line each time - and must not cut a character outside of
+// the Basic Multilingual Plane (a surrogate pair) in two.
+
+#include "TTriggerPrefilter.h"
+
+#include <QtTest/QtTest>
+
+#include "pre_guard.h"
+#include <QRegularExpression>
+#include "post_guard.h"
+
+class tst_triggerprefilter : public QObject
+{
+    Q_OBJECT
+
+private:
+    // U+1F409 DRAGON, two UTF-16 code units:
+    static QString dragon() { return QString::fromUtf8("\xf0\x9f\x90\x89"); }
+
+private slots:
+    void requiredLiteral_data()
+    {
+        QTest::addColumn<QString>("regex");
+        QTest::addColumn<QString>("line");
+        QTest::addColumn<QString>("literal");
+
+        QTest::newRow("plain") << QStringLiteral("You are hungry") << QStringLiteral("You are hungry.") << QStringLiteral("You are hungry");
+        QTest::newRow("group") << QStringLiteral("^You see (.*) here\\.$") << QStringLiteral("You see a sword here.") << QStringLiteral("You see ");
+        QTest::newRow("character type") << QStringLiteral("^Gold: \\d+ coins") << QStringLiteral("Gold: 25 coins") << QStringLiteral("Gold: ");
+        QTest::newRow("escaped") << QStringLiteral("\\(\\d+\\) \\[ok\\]") << QStringLiteral("(3) [ok]") << QStringLiteral(") [ok]");
+        QTest::newRow("optional") << QStringLiteral("colou?r") << QStringLiteral("color") << QStringLiteral("colo");
+        QTest::newRow("alternative") << QStringLiteral("north|south") << QStringLiteral("south") << QString();
+        QTest::newRow("option setting") << QStringLiteral("(?i)dragon") << QStringLiteral("DRAGON") << QString();
+        QTest::newRow("optional surrogate pair") << QStringLiteral("the dragon %1?").arg(dragon()) << QStringLiteral("the dragon roars") << QStringLiteral("the dragon ");
+        QTest::newRow("repeated surrogate pair") << QStringLiteral("a%1{2}b").arg(dragon()) << QStringLiteral("a%1%1b").arg(dragon()) << QStringLiteral("a");
+        QTest::newRow("surrogate pair at least once") << QStringLiteral("%1+ breathes").arg(dragon()) << QStringLiteral("%1%1 breathes").arg(dragon()) << QStringLiteral(" breathes");
+        QTest::newRow("whole surrogate pairs") << QStringLiteral("%1%1 here").arg(dragon()) << QStringLiteral("%1%1 here").arg(dragon()) << QStringLiteral("%1%1 here").arg(dragon());
+    }
+
+    void requiredLiteral()
+    {
+        QFETCH(QString, regex);
+        QFETCH(QString, line);
+        QFETCH(QString, literal);
+
+        QVERIFY(QRegularExpression(regex).match(line).hasMatch());
+        const QString found = TTriggerPrefilter::requiredLiteral(regex);
+        QCOMPARE(found, literal);
+        QVERIFY(line.contains(found));
+        if (!found.isEmpty()) {
+            QVERIFY(!found.at(0).isLowSurrogate());
+            QVERIFY(!found.at(found.size() - 1).isHighSurrogate());
+        }
+    }
+
+    // A line that only has the optional character is still found:
+    void scanWithoutOptionalSurrogatePair()
+    {
+        TTriggerPrefilter prefilter;
+        const int id = prefilter.addPattern(TTriggerPrefilter::requiredLiteral(QStringLiteral("the dragon %1?").arg(dragon())));
+        prefilter.scan(QStringLiteral("the dragon roars"));
+        QVERIFY(prefilter.isFound(id));
+    }
+};
+
+QTEST_APPLESS_MAIN(tst_triggerprefilter)
+#include "tst_triggerprefilter.moc"
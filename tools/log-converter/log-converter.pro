@@ -0,0 +1,43 @@
+############################################################################
+#    Copyright (C) 2018 by Mudlet developers                               #
+#                                                                          #
+#    This program is free software; you can redistribute it and/or modify  #
+#    it under the terms of the GNU General Public License as published by  #
+#    the Free Software Foundation; either version 2 of the License, or     #
+#    (at your option) any later version.                                   #
+#                                                                          #
+#    This program is distributed in the hope that it will be useful,       #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+#    GNU General Public License for more details.                          #
+#                                                                          #
+#    You should have received a copy of the GNU General Public License     #
+#    along with this program; if not, write to the                         #
+#    Free Software Foundation, Inc.,                                       #
+#    59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             #
+############################################################################
+
+# Turns Mudlet's binary (".mlog") session logs into HTML or plain text away
+# from the main application; it shares the log reader with it:
+TEMPLATE = app
+TARGET = mudlet-log-converter
+CONFIG += console c++11
+CONFIG -= app_bundle
+QT = core
+
+VERSION = 3.9.0
+BUILD = $$(MUDLET_VERSION_BUILD)
+isEmpty( BUILD ) {
+   BUILD = "-dev"
+}
+DEFINES += APP_VERSION=\\\"$${VERSION}\\\"
+DEFINES += APP_BUILD=\\\"$${BUILD}\\\"
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/TSessionLog.cpp
+
+HEADERS += \
+    ../../src/TSessionLog.h
@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// Renders a binary (".mlog") session log, as written by Mudlet when it is set
+// to log in that format, as an HTML or plain text file - optionally with other
+// colors in place of the profile's default ones that it was recorded with.
+
+#include "TSessionLog.h"
+
+#include "pre_guard.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include "post_guard.h"
+
+// Takes "#rrggbb" (or "rrggbb") and gives 0xRRGGBB, or -1 if it is not valid:
+static qint64 parseColor(QString text)
+{
+    if (text.startsWith(QLatin1Char('#'))) {
+        text.remove(0, 1);
+    }
+    bool isOk = false;
+    const uint value = text.toUInt(&isOk, 16);
+    if (!isOk || text.size() != 6) {
+        return -1;
+    }
+    return value;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("mudlet-log-converter"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+            "Converts a Mudlet binary session log (\".mlog\") to HTML or plain text.\n\n"
+            "The format is HTML unless the output file name ends in \".txt\" or --format is given."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("log"), QStringLiteral("The binary session log to read."));
+    parser.addPositionalArgument(QStringLiteral("output"), QStringLiteral("The HTML or text file to write."));
+    QCommandLineOption formatOption(QStringList() << QStringLiteral("f") << QStringLiteral("format"), QStringLiteral("\"html\" or \"text\"."), QStringLiteral("format"));
+    QCommandLineOption timestampsOption(QStringList() << QStringLiteral("t") << QStringLiteral("timestamps"), QStringLiteral("Start each line with the time it was received."));
+    QCommandLineOption foregroundOption(QStringLiteral("foreground"), QStringLiteral("Color (#rrggbb) to use in place of the recorded default foreground one."), QStringLiteral("color"));
+    QCommandLineOption backgroundOption(QStringLiteral("background"), QStringLiteral("Color (#rrggbb) to use in place of the recorded default background one."), QStringLiteral("color"));
+    QCommandLineOption fontOption(QStringLiteral("font"), QStringLiteral("Font family to ask for first in HTML output."), QStringLiteral("family"));
+    parser.addOptions({formatOption, timestampsOption, foregroundOption, backgroundOption, fontOption});
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 2) {
+        parser.showHelp(1);
+    }
+
+    TSessionLogRenderOptions options;
+    options.isHtml = !arguments.at(1).endsWith(QLatin1String(".txt"), Qt::CaseInsensitive);
+    if (parser.isSet(formatOption)) {
+        const QString format = parser.value(formatOption);
+        if (format != QLatin1String("html") && format != QLatin1String("text")) {
+            qCritical("format \"%s\" is not \"html\" or \"text\"", qPrintable(format));
+            return 1;
+        }
+        options.isHtml = (format == QLatin1String("html"));
+    }
+    options.isTimeStamped = parser.isSet(timestampsOption);
+    options.fontFamily = parser.value(fontOption);
+    if (parser.isSet(foregroundOption) || parser.isSet(backgroundOption)) {
+        // The colors are replaced together, so the default of the one not
+        // given is Mudlet's own default for it:
+        const qint64 foreground = parseColor(parser.isSet(foregroundOption) ? parser.value(foregroundOption) : QStringLiteral("#c0c0c0"));
+        const qint64 background = parseColor(parser.isSet(backgroundOption) ? parser.value(backgroundOption) : QStringLiteral("#000000"));
+        if (foreground < 0 || background < 0) {
+            qCritical("colors must be given as #rrggbb");
+            return 1;
+        }
+        options.isThemed = true;
+        options.foreground = static_cast<quint32>(foreground);
+        options.background = static_cast<quint32>(background);
+    }
+
+    QString errorMessage;
+    if (!TSessionLogRenderer::render(arguments.at(0), arguments.at(1), options, errorMessage)) {
+        qCritical("%s", qPrintable(errorMessage));
+        return 1;
+    }
+    return 0;
+}
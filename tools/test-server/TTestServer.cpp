@@ -0,0 +1,603 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "TTestServer.h"
+
+
+#include "TReplayFile.h"
+
+#include "pre_guard.h"
+#include <QFile>
+#include <QHostAddress>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include "post_guard.h"
+
+#include <algorithm>
+
+// The same values as used by the client in ctelnet.h:
+static const char csmIAC = static_cast<char>(255);
+static const char csmDONT = static_cast<char>(254);
+static const char csmDO = static_cast<char>(253);
+static const char csmWONT = static_cast<char>(252);
+static const char csmWILL = static_cast<char>(251);
+static const char csmSB = static_cast<char>(250);
+static const char csmGA = static_cast<char>(249);
+static const char csmSE = static_cast<char>(240);
+static const char csmEOR = static_cast<char>(239);
+
+static const char csmOptTimingMark = 6;
+static const char csmOptEOR = 25;
+static const char csmOptCompress2 = 86;
+static const char csmOptMXP = 91;
+static const char csmOptGMCP = static_cast<char>(201);
+
+// Do not read further ahead in the script than this whilst the rate limiter
+// is holding output back:
+static const int csmPendingHighWater = 65536;
+
+QString TLatencyStats::summary() const
+{
+    if (mSamples.isEmpty()) {
+        return QStringLiteral("no samples");
+    }
+
+    QVector<qint64> sorted(mSamples);
+    std::sort(sorted.begin(), sorted.end());
+    qint64 total = 0;
+    for (auto sample : sorted) {
+        total += sample;
+    }
+    auto percentile = [&sorted](const int percent) { return sorted.at(std::min(sorted.size() - 1, sorted.size() * percent / 100)) / 1000.0; };
+
+    return QStringLiteral("%1 samples, min %2 ms, mean %3 ms, p50 %4 ms, p90 %5 ms, p99 %6 ms, max %7 ms")
+            .arg(sorted.size())
+            .arg(sorted.first() / 1000.0, 0, 'f', 3)
+            .arg(total / 1000.0 / sorted.size(), 0, 'f', 3)
+            .arg(percentile(50), 0, 'f', 3)
+            .arg(percentile(90), 0, 'f', 3)
+            .arg(percentile(99), 0, 'f', 3)
+            .arg(sorted.last() / 1000.0, 0, 'f', 3);
+}
+
+
+TTestConnection::TTestConnection(QTcpSocket* pSocket, const TTestServerSettings& settings, const QVector<TTestStep>& steps, QObject* parent)
+: QObject(parent)
+, mpSocket(pSocket)
+, mPeerName(QStringLiteral("%1 port %2").arg(pSocket->peerAddress().toString()).arg(pSocket->peerPort()))
+, mSettings(settings)
+, mSteps(steps)
+, mNextStep(0)
+, mpStepTimer(new QTimer(this))
+, mpBurstTimer(new QTimer(this))
+, mpPingTimer(new QTimer(this))
+, mpProbeTimer(new QTimer(this))
+, mIsEorNegotiated(false)
+, mIsGmcpNegotiated(false)
+, mIsCompressing(false)
+, mNextPing(1)
+, mProbeTime(-1)
+, mBytesQueued(0)
+, mBytesSent(0)
+, mCommandsReceived(0)
+{
+    mpSocket->setParent(this);
+    mpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    mClock.start();
+
+    connect(mpSocket, &QTcpSocket::readyRead, this, &TTestConnection::slot_readyRead);
+    connect(mpSocket, &QTcpSocket::disconnected, this, &TTestConnection::slot_disconnected);
+
+    mpStepTimer->setSingleShot(true);
+    connect(mpStepTimer, &QTimer::timeout, this, &TTestConnection::slot_nextStep);
+
+    // Each burst is spaced out so as to give the requested average rate:
+    if (mSettings.bytesPerSecond > 0) {
+        mpBurstTimer->setInterval(std::max(1, static_cast<int>(1000LL * mSettings.burstSize / mSettings.bytesPerSecond)));
+    } else {
+        mpBurstTimer->setInterval(0);
+    }
+    connect(mpBurstTimer, &QTimer::timeout, this, &TTestConnection::slot_sendBurst);
+
+    connect(mpPingTimer, &QTimer::timeout, this, &TTestConnection::slot_sendPing);
+    if (mSettings.pingInterval > 0) {
+        mpPingTimer->start(mSettings.pingInterval);
+    }
+    connect(mpProbeTimer, &QTimer::timeout, this, &TTestConnection::slot_sendProbe);
+    if (mSettings.probeInterval > 0) {
+        mpProbeTimer->start(mSettings.probeInterval);
+    }
+
+    // Offer everything the client is likely to want to test:
+    sendTelnetOption(csmWILL, csmOptEOR);
+    sendTelnetOption(csmWILL, csmOptGMCP);
+    sendTelnetOption(csmWILL, csmOptMXP);
+    if (mSettings.isCompressionOffered) {
+        sendTelnetOption(csmWILL, csmOptCompress2);
+    }
+
+    // Give the negotiation a moment to complete before the output starts:
+    mpStepTimer->start(250);
+}
+
+TTestConnection::~TTestConnection()
+{
+    if (mIsCompressing) {
+        deflateEnd(&mDeflateStream);
+    }
+}
+
+void TTestConnection::slot_nextStep()
+{
+    while (mPending.size() < csmPendingHighWater) {
+        if (mNextStep >= mSteps.size()) {
+            if (!mSettings.isLooping || mSteps.isEmpty()) {
+                return;
+            }
+            mNextStep = 0;
+        }
+
+        const TTestStep& step = mSteps.at(mNextStep++);
+        switch (step.type) {
+        case TTestStep::Text:
+            queueText(step.data);
+            break;
+        case TTestStep::Prompt:
+            queueText(step.data, true);
+            break;
+        case TTestStep::Gmcp:
+            if (mIsGmcpNegotiated) {
+                QByteArray message;
+                message.append(csmIAC).append(csmSB).append(csmOptGMCP);
+                message.append(step.data);
+                message.append(csmIAC).append(csmSE);
+                queue(message);
+            }
+            break;
+        case TTestStep::Raw:
+            queue(step.data);
+            break;
+        case TTestStep::Pause:
+            if (step.delay > 0) {
+                mpStepTimer->start(step.delay);
+                return;
+            }
+            break;
+        }
+    }
+    // Come back when the rate limiter has caught up a bit:
+    mpStepTimer->start(std::max(10, mpBurstTimer->interval()));
+}
+
+void TTestConnection::queue(const QByteArray& data)
+{
+    mPending.append(data);
+    mBytesQueued += static_cast<quint64>(data.size());
+    if (!mpBurstTimer->isActive()) {
+        if (mSettings.bytesPerSecond > 0) {
+            // Start with a burst straight away rather than after an interval:
+            slot_sendBurst();
+        }
+        mpBurstTimer->start();
+    }
+}
+
+void TTestConnection::queueText(const QByteArray& text, const bool isPrompt)
+{
+    QByteArray data(text);
+    // Any IAC in the text must be doubled:
+    data.replace(QByteArray(1, csmIAC), QByteArray(2, csmIAC));
+    if (isPrompt) {
+        data.append(csmIAC).append(mIsEorNegotiated ? csmEOR : csmGA);
+    } else {
+        data.append("\r\n");
+    }
+    queue(data);
+}
+
+void TTestConnection::slot_sendBurst()
+{
+    if (mPending.isEmpty()) {
+        mpBurstTimer->stop();
+        return;
+    }
+
+    const int size = (mSettings.bytesPerSecond > 0) ? std::min(mPending.size(), mSettings.burstSize) : mPending.size();
+    writeToSocket(mPending.left(size));
+    mPending.remove(0, size);
+}
+
+void TTestConnection::writeToSocket(const QByteArray& data)
+{
+    if (!mIsCompressing) {
+        mBytesSent += static_cast<quint64>(data.size());
+        mpSocket->write(data);
+        return;
+    }
+
+    QByteArray output(static_cast<int>(deflateBound(&mDeflateStream, static_cast<uLong>(data.size()))) + 64, '\0');
+    mDeflateStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    mDeflateStream.avail_in = static_cast<uInt>(data.size());
+    mDeflateStream.next_out = reinterpret_cast<Bytef*>(output.data());
+    mDeflateStream.avail_out = static_cast<uInt>(output.size());
+    // A sync flush after each burst so the client can inflate it all at once:
+    deflate(&mDeflateStream, Z_SYNC_FLUSH);
+    output.truncate(output.size() - static_cast<int>(mDeflateStream.avail_out));
+    mBytesSent += static_cast<quint64>(output.size());
+    mpSocket->write(output);
+}
+
+void TTestConnection::sendTelnetOption(const char command, const char option)
+{
+    QByteArray data;
+    data.append(csmIAC).append(command).append(option);
+    // Negotiation jumps the queue:
+    writeToSocket(data);
+}
+
+void TTestConnection::slot_sendPing()
+{
+    mPingTimes.insert(mNextPing, mClock.nsecsElapsed());
+    queueText(QByteArrayLiteral("ping ") + QByteArray::number(mNextPing++));
+}
+
+void TTestConnection::slot_sendProbe()
+{
+    // Only one at a time, a reply is not guaranteed if the client is busy:
+    if (mProbeTime >= 0 && mClock.nsecsElapsed() - mProbeTime < 10000000000LL) {
+        return;
+    }
+    mProbeTime = mClock.nsecsElapsed();
+    sendTelnetOption(csmDO, csmOptTimingMark);
+}
+
+void TTestConnection::slot_readyRead()
+{
+    const QByteArray data = mpSocket->readAll();
+    for (const char ch : data) {
+        if (!mCommand.isEmpty()) {
+            mCommand.append(ch);
+            const int size = mCommand.size();
+            if (size == 2) {
+                if (ch == csmIAC) {
+                    // An escaped data byte:
+                    mCommand.clear();
+                    mLine.append(ch);
+                } else if (ch != csmSB && ch != csmDO && ch != csmDONT && ch != csmWILL && ch != csmWONT) {
+                    handleTelnetCommand(mCommand);
+                    mCommand.clear();
+                }
+            } else if (mCommand.at(1) != csmSB) {
+                handleTelnetCommand(mCommand);
+                mCommand.clear();
+            } else if (ch == csmSE && mCommand.at(size - 2) == csmIAC) {
+                handleTelnetCommand(mCommand);
+                mCommand.clear();
+            }
+        } else if (ch == csmIAC) {
+            mCommand.append(ch);
+        } else if (ch == '\n') {
+            if (mLine.endsWith('\r')) {
+                mLine.chop(1);
+            }
+            handleLine(mLine);
+            mLine.clear();
+        } else {
+            mLine.append(ch);
+        }
+    }
+}
+
+void TTestConnection::handleTelnetCommand(const QByteArray& command)
+{
+    if (command.size() < 3) {
+        return;
+    }
+
+    const char type = command.at(1);
+    const char option = command.at(2);
+    if (type == csmDO) {
+        if (option == csmOptEOR) {
+            mIsEorNegotiated = true;
+        } else if (option == csmOptGMCP) {
+            mIsGmcpNegotiated = true;
+        } else if (option == csmOptMXP) {
+            QByteArray data;
+            data.append(csmIAC).append(csmSB).append(csmOptMXP).append(csmIAC).append(csmSE);
+            writeToSocket(data);
+        } else if (option == csmOptCompress2 && mSettings.isCompressionOffered && !mIsCompressing) {
+            QByteArray data;
+            data.append(csmIAC).append(csmSB).append(csmOptCompress2).append(csmIAC).append(csmSE);
+            writeToSocket(data);
+            // Everything after the above is compressed:
+            mDeflateStream.zalloc = Z_NULL;
+            mDeflateStream.zfree = Z_NULL;
+            mDeflateStream.opaque = Z_NULL;
+            mIsCompressing = (deflateInit(&mDeflateStream, Z_DEFAULT_COMPRESSION) == Z_OK);
+        }
+    } else if (type == csmWILL || type == csmWONT) {
+        if (option == csmOptTimingMark && mProbeTime >= 0) {
+            mProbeLatency.add((mClock.nsecsElapsed() - mProbeTime) / 1000);
+            mProbeTime = -1;
+        }
+    }
+    // Anything else (NAWS, TTYPE, GMCP from the client...) is ignored.
+}
+
+void TTestConnection::handleLine(const QByteArray& line)
+{
+    ++mCommandsReceived;
+    if (line.startsWith("pong ")) {
+        const int id = line.mid(5).trimmed().toInt();
+        if (mPingTimes.contains(id)) {
+            mCommandLatency.add((mClock.nsecsElapsed() - mPingTimes.take(id)) / 1000);
+        }
+        return;
+    }
+
+    if (line == "quit") {
+        queueText(QByteArrayLiteral("Bye!"));
+        slot_sendBurst();
+        mpSocket->disconnectFromHost();
+        return;
+    }
+
+    if (line == "stats") {
+        for (const auto& reportLine : report().toUtf8().split('\n')) {
+            queueText(reportLine);
+        }
+        queueText(QByteArrayLiteral(">"), true);
+        return;
+    }
+
+    // Anything else gets a reply at once so that the client's own latency
+    // measurement (from sending a command to the next prompt) has something
+    // to time:
+    queueText(QByteArrayLiteral("You sent: ") + line);
+    queueText(QByteArrayLiteral(">"), true);
+}
+
+QString TTestConnection::report() const
+{
+    const double seconds = std::max(mClock.elapsed(), Q_INT64_C(1)) / 1000.0;
+    QStringList texts;
+    texts << QStringLiteral("Connection from %1 after %2 seconds:").arg(mPeerName).arg(seconds, 0, 'f', 1);
+    texts << QStringLiteral("  sent %1 bytes (%2 bytes on the wire%3), %4 bytes/sec")
+             .arg(mBytesQueued)
+             .arg(mBytesSent)
+             .arg(mIsCompressing ? QStringLiteral(", MCCP v2") : QString())
+             .arg(mBytesQueued / seconds, 0, 'f', 0);
+    texts << QStringLiteral("  received %1 lines").arg(mCommandsReceived);
+    texts << QStringLiteral("  command round trips (ping/pong): %1").arg(mCommandLatency.summary());
+    texts << QStringLiteral("  protocol round trips (TIMING-MARK): %1").arg(mProbeLatency.summary());
+    return texts.join(QLatin1Char('\n'));
+}
+
+void TTestConnection::slot_disconnected()
+{
+    mpStepTimer->stop();
+    mpBurstTimer->stop();
+    mpPingTimer->stop();
+    mpProbeTimer->stop();
+    emit signal_finished(report());
+    deleteLater();
+}
+
+
+TTestServer::TTestServer(const TTestServerSettings& settings, QObject* parent)
+: QObject(parent)
+, mSettings(settings)
+, mpServer(new QTcpServer(this))
+{
+    connect(mpServer, &QTcpServer::newConnection, this, &TTestServer::slot_newConnection);
+}
+
+// A script is a text file, each line of which is sent as it is apart from
+// those starting with '@' which are directives:
+//   @prompt <text>       send the text followed by a GA/EOR
+//   @gmcp <Package> <json>  send a GMCP message
+//   @pause <ms>          wait before carrying on
+//   @@...                a line of text that starts with a single '@'
+// Within text "\e" is an ESC (for ANSI codes) and "\\" a single backslash.
+bool TTestServer::loadScript(const QString& fileName, QString& errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = QStringLiteral("cannot open script file \"%1\": %2").arg(fileName, file.errorString());
+        return false;
+    }
+
+    auto unescape = [](QByteArray text) { return text.replace("\\e", "\x1b").replace("\\\\", "\\"); };
+
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+        ++lineNumber;
+        while (line.endsWith('\n') || line.endsWith('\r')) {
+            line.chop(1);
+        }
+
+        if (line.startsWith("@@")) {
+            mSteps.append(TTestStep(TTestStep::Text, unescape(line.mid(1))));
+        } else if (line.startsWith("@prompt")) {
+            mSteps.append(TTestStep(TTestStep::Prompt, unescape(line.mid(8))));
+        } else if (line.startsWith("@gmcp ")) {
+            mSteps.append(TTestStep(TTestStep::Gmcp, line.mid(6)));
+        } else if (line.startsWith("@pause ")) {
+            bool isOk = false;
+            const int delay = line.mid(7).trimmed().toInt(&isOk);
+            if (!isOk || delay < 0) {
+                errorMessage = QStringLiteral("%1:%2: bad pause time").arg(fileName).arg(lineNumber);
+                return false;
+            }
+            mSteps.append(TTestStep(TTestStep::Pause, QByteArray(), delay));
+        } else if (line.startsWith('@')) {
+            errorMessage = QStringLiteral("%1:%2: unknown directive").arg(fileName).arg(lineNumber);
+            return false;
+        } else {
+            mSteps.append(TTestStep(TTestStep::Text, unescape(line)));
+        }
+    }
+    return true;
+}
+
+// The replay data is what the original server sent, so it goes out as it is;
+// the original negotiation in it may well get some replies that are ignored:
+bool TTestServer::loadReplay(const QString& fileName, const bool isRecordedTimingUsed, QString& errorMessage)
+{
+    TReplayReader reader;
+    QString readerError;
+    if (!reader.open(fileName, readerError)) {
+        errorMessage = QStringLiteral("cannot load replay file \"%1\": %2").arg(fileName, readerError);
+        return false;
+    }
+
+    qint64 lastTime = 0;
+    for (int i = 0, total = reader.chunkCount(); i < total; ++i) {
+        if (isRecordedTimingUsed && reader.timeOf(i) > lastTime) {
+            mSteps.append(TTestStep(TTestStep::Pause, QByteArray(), static_cast<int>(reader.timeOf(i) - lastTime)));
+            lastTime = reader.timeOf(i);
+        }
+        const TStringView chunk = reader.chunk(i);
+        mSteps.append(TTestStep(TTestStep::Raw, QByteArray(chunk.data(), static_cast<int>(chunk.size()))));
+    }
+    return true;
+}
+
+// Adds screens of colour-dense output, like the ANSI art maps that some games
+// draw, for measuring how fast the client parses SGR sequences: every cell of
+// each 80x24 screen has its own colours, set with the 16 color codes in the
+// first third of the rows, the 256 color ones in the next and the 24-bit ones
+// in the last:
+void TTestServer::addAnsiArt(const int screens)
+{
+    static const char terrain[] = ".,~^#T\"'%";
+    quint32 seed = 1;
+    auto random = [&seed](const int range) {
+        seed = seed * 1103515245 + 12345;
+        return static_cast<int>((seed >> 16) % static_cast<quint32>(range));
+    };
+
+    for (int screen = 0; screen < screens; ++screen) {
+        for (int row = 0; row < 24; ++row) {
+            QByteArray line;
+            for (int column = 0; column < 80; ++column) {
+                if (row < 8) {
+                    line.append(QStringLiteral("\x1b[%1;%2;%3m").arg(random(2)).arg(30 + random(8)).arg(40 + random(8)).toLatin1());
+                } else if (row < 16) {
+                    line.append(QStringLiteral("\x1b[38;5;%1;48;5;%2m").arg(random(256)).arg(random(256)).toLatin1());
+                } else {
+                    line.append(QStringLiteral("\x1b[38;2;%1;%2;%3;48;2;%4;%5;%6m")
+                                        .arg(random(256))
+                                        .arg(random(256))
+                                        .arg(random(256))
+                                        .arg(random(256))
+                                        .arg(random(256))
+                                        .arg(random(256))
+                                        .toLatin1());
+                }
+                line.append(terrain[random(static_cast<int>(sizeof(terrain)) - 1)]);
+            }
+            line.append("\x1b[0m");
+            mSteps.append(TTestStep(TTestStep::Text, line));
+        }
+        mSteps.append(TTestStep(TTestStep::Prompt, QByteArrayLiteral("<map ") + QByteArray::number(screen + 1) + QByteArrayLiteral(">")));
+    }
+}
+
+// Saves what a client would be sent as a Mudlet replay file instead, e.g. for
+// "mudlet --benchmark PROFILE REPLAY"; as there is no negotiation GMCP is left
+// out, prompts end with a GA and the pauses become gaps in the timing:
+bool TTestServer::writeReplay(const QString& fileName, QString& errorMessage) const
+{
+    TReplayWriter writer;
+    if (!writer.open(fileName)) {
+        errorMessage = QStringLiteral("cannot write replay file \"%1\": %2").arg(fileName, writer.errorString());
+        return false;
+    }
+
+    qint64 time = 0;
+    QByteArray pending;
+    auto flush = [&]() {
+        if (!pending.isEmpty()) {
+            writer.writeChunk(time, pending.constData(), pending.size());
+            pending.clear();
+        }
+    };
+
+    for (const auto& step : mSteps) {
+        switch (step.type) {
+        case TTestStep::Text:
+        case TTestStep::Prompt: {
+            QByteArray data(step.data);
+            data.replace(QByteArray(1, csmIAC), QByteArray(2, csmIAC));
+            if (step.type == TTestStep::Prompt) {
+                data.append(csmIAC).append(csmGA);
+            } else {
+                data.append("\r\n");
+            }
+            pending.append(data);
+            break;
+        }
+        case TTestStep::Raw:
+            pending.append(step.data);
+            break;
+        case TTestStep::Gmcp:
+            break;
+        case TTestStep::Pause:
+            flush();
+            time += step.delay;
+            break;
+        }
+        // Chunks of about the size that a read from the network gives:
+        if (pending.size() >= mSettings.burstSize) {
+            flush();
+        }
+    }
+    flush();
+    writer.close();
+    return true;
+}
+
+bool TTestServer::listen(QString& errorMessage)
+{
+    if (!mpServer->listen(QHostAddress::LocalHost, mSettings.port)) {
+        errorMessage = QStringLiteral("cannot listen on port %1: %2").arg(mSettings.port).arg(mpServer->errorString());
+        return false;
+    }
+    qInfo("Listening on localhost port %d", mpServer->serverPort());
+    return true;
+}
+
+quint16 TTestServer::serverPort() const
+{
+    return mpServer->serverPort();
+}
+
+void TTestServer::slot_newConnection()
+{
+    while (QTcpSocket* pSocket = mpServer->nextPendingConnection()) {
+        qInfo("Connection from %s port %d", qPrintable(pSocket->peerAddress().toString()), pSocket->peerPort());
+        auto pConnection = new TTestConnection(pSocket, mSettings, mSteps, this);
+        connect(pConnection, &TTestConnection::signal_finished, this, [](const QString& report) { qInfo("%s", qPrintable(report)); });
+    }
+}
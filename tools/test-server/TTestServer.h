@@ -0,0 +1,192 @@
+#ifndef MUDLET_TTESTSERVER_H
+#define MUDLET_TTESTSERVER_H
+
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+#include "pre_guard.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include "post_guard.h"
+
+#include <zlib.h>
+
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+
+// One thing for the server to do, in order, for each connection:
+struct TTestStep
+{
+    enum Type {
+        // A line of text (a CR LF is added):
+        Text,
+        // Text followed by a GA (or an EOR if that has been negotiated):
+        Prompt,
+        // A "Package.Name json" message, only sent if GMCP was negotiated:
+        Gmcp,
+        // Wait for the given number of milli-seconds:
+        Pause,
+        // Bytes sent exactly as they are (e.g. from a replay file):
+        Raw
+    };
+
+    TTestStep(const Type t = Text, const QByteArray& d = QByteArray(), const int ms = 0) : type(t), data(d), delay(ms) {}
+
+    Type type;
+    QByteArray data;
+    int delay;
+};
+
+struct TTestServerSettings
+{
+    TTestServerSettings()
+    : port(4000)
+    , bytesPerSecond(0)
+    , burstSize(4096)
+    , pingInterval(0)
+    , probeInterval(1000)
+    , isLooping(false)
+    , isCompressionOffered(true)
+    {}
+
+    quint16 port;
+    // Zero for no limit, otherwise the output is sent in bursts of burstSize
+    // bytes spaced out to give this average rate:
+    int bytesPerSecond;
+    int burstSize;
+    // How often (in milli-seconds) to send a "ping <n>" line that a trigger
+    // in the client is expected to answer with "pong <n>", zero for never:
+    int pingInterval;
+    // How often to send an IAC DO TIMING-MARK, zero for never:
+    int probeInterval;
+    bool isLooping;
+    bool isCompressionOffered;
+};
+
+// Collects round trip times (in micro-seconds) and summarises them:
+class TLatencyStats
+{
+public:
+    void add(const qint64 microSeconds) { mSamples.append(microSeconds); }
+    bool isEmpty() const { return mSamples.isEmpty(); }
+    QString summary() const;
+
+private:
+    QVector<qint64> mSamples;
+};
+
+
+class TTestConnection : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_DISABLE_COPY(TTestConnection)
+    TTestConnection(QTcpSocket* pSocket, const TTestServerSettings& settings, const QVector<TTestStep>& steps, QObject* parent = nullptr);
+    ~TTestConnection();
+
+signals:
+    void signal_finished(const QString& report);
+
+private slots:
+    void slot_readyRead();
+    void slot_disconnected();
+    void slot_nextStep();
+    void slot_sendBurst();
+    void slot_sendPing();
+    void slot_sendProbe();
+
+private:
+    void queue(const QByteArray& data);
+    void queueText(const QByteArray& text, const bool isPrompt = false);
+    void writeToSocket(const QByteArray& data);
+    void sendTelnetOption(const char command, const char option);
+    void handleTelnetCommand(const QByteArray& command);
+    void handleLine(const QByteArray& line);
+    QString report() const;
+
+
+    QTcpSocket* mpSocket;
+    // Kept as it is not available after the disconnection:
+    QString mPeerName;
+    TTestServerSettings mSettings;
+    const QVector<TTestStep>& mSteps;
+    int mNextStep;
+    // Output waiting for the rate limiter:
+    QByteArray mPending;
+    QTimer* mpStepTimer;
+    QTimer* mpBurstTimer;
+    QTimer* mpPingTimer;
+    QTimer* mpProbeTimer;
+
+    // Telnet state:
+    QByteArray mCommand;
+    QByteArray mLine;
+    bool mIsEorNegotiated;
+    bool mIsGmcpNegotiated;
+    bool mIsCompressing;
+    z_stream mDeflateStream;
+
+    QElapsedTimer mClock;
+    QMap<int, qint64> mPingTimes;
+    int mNextPing;
+    qint64 mProbeTime;
+    TLatencyStats mCommandLatency;
+    TLatencyStats mProbeLatency;
+    quint64 mBytesQueued;
+    quint64 mBytesSent;
+    quint64 mCommandsReceived;
+};
+
+
+class TTestServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    Q_DISABLE_COPY(TTestServer)
+    explicit TTestServer(const TTestServerSettings& settings, QObject* parent = nullptr);
+
+    bool loadScript(const QString& fileName, QString& errorMessage);
+    bool loadReplay(const QString& fileName, const bool isRecordedTimingUsed, QString& errorMessage);
+    void addAnsiArt(const int screens);
+    void addStep(const TTestStep& step) { mSteps.append(step); }
+    bool writeReplay(const QString& fileName, QString& errorMessage) const;
+    // A port of zero in the settings picks any free one, which this returns
+    // once listening:
+    bool listen(QString& errorMessage);
+    quint16 serverPort() const;
+
+private slots:
+    void slot_newConnection();
+
+private:
+    TTestServerSettings mSettings;
+    QTcpServer* mpServer;
+    QVector<TTestStep> mSteps;
+};
+
+#endif // MUDLET_TTESTSERVER_H
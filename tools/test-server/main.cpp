@@ -0,0 +1,96 @@
+/***************************************************************************
+ *   Copyright (C) 2018 by Mudlet developers                               *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+
+// A stand-in for a MUD server, for measuring Mudlet's performance without
+// involving a real game: it listens on localhost, negotiates EOR, GMCP, MXP
+// and MCCP v2 with each client that connects and then sends it the contents
+// of a script or a Mudlet replay file at a controlled rate. It reports the
+// round trip times it sees when each client disconnects.
+
+#include "TTestServer.h"
+
+#include "pre_guard.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include "post_guard.h"
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("mudlet-test-server"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral(
+            "A local MUD server stand-in for load and latency testing of Mudlet.\n\n"
+            "Each client gets the output of the script or replay file. Any line the client sends is\n"
+            "echoed back followed by a prompt. The exceptions are \"pong <n>\" (the answer\n"
+            "to a \"ping <n>\", which a trigger should send), \"stats\" and \"quit\"."));
+    parser.addHelpOption();
+    QCommandLineOption portOption(QStringList() << QStringLiteral("p") << QStringLiteral("port"), QStringLiteral("Port to listen on (default 4000)."), QStringLiteral("port"), QStringLiteral("4000"));
+    QCommandLineOption scriptOption(QStringList() << QStringLiteral("s") << QStringLiteral("script"), QStringLiteral("Script of output to send, see TTestServer::loadScript(...)."), QStringLiteral("file"));
+    QCommandLineOption replayOption(QStringList() << QStringLiteral("r") << QStringLiteral("replay"), QStringLiteral("Mudlet replay file to send."), QStringLiteral("file"));
+    QCommandLineOption timingOption(QStringLiteral("replay-timing"), QStringLiteral("Keep the recorded gaps between the parts of a replay."));
+    QCommandLineOption rateOption(QStringLiteral("rate"), QStringLiteral("Average output rate in bytes/sec, 0 for as fast as possible (default)."), QStringLiteral("bytes"), QStringLiteral("0"));
+    QCommandLineOption burstOption(QStringLiteral("burst"), QStringLiteral("Bytes sent in each burst when the rate is limited (default 4096)."), QStringLiteral("bytes"), QStringLiteral("4096"));
+    QCommandLineOption loopOption(QStringLiteral("loop"), QStringLiteral("Start the script or replay again when it ends."));
+    QCommandLineOption pingOption(QStringLiteral("ping"), QStringLiteral("Send a \"ping <n>\" line this often, 0 for never (default)."), QStringLiteral("ms"), QStringLiteral("0"));
+    QCommandLineOption probeOption(QStringLiteral("probe"), QStringLiteral("Send a telnet TIMING-MARK this often, 0 for never (default 1000)."), QStringLiteral("ms"), QStringLiteral("1000"));
+    QCommandLineOption noCompressionOption(QStringLiteral("no-mccp"), QStringLiteral("Do not offer MCCP v2 compression."));
+    QCommandLineOption ansiArtOption(QStringLiteral("ansi-art"), QStringLiteral("Add this many 80x24 screens of output with different colors in every cell."), QStringLiteral("screens"));
+    QCommandLineOption writeReplayOption(QStringLiteral("write-replay"), QStringLiteral("Write the output to a Mudlet replay file (e.g. for \"mudlet --benchmark\") and quit rather than listening."), QStringLiteral("file"));
+    parser.addOptions({portOption, scriptOption, replayOption, timingOption, rateOption, burstOption, loopOption, pingOption, probeOption, noCompressionOption, ansiArtOption, writeReplayOption});
+    parser.process(app);
+
+    TTestServerSettings settings;
+    settings.port = static_cast<quint16>(parser.value(portOption).toUInt());
+    settings.bytesPerSecond = qMax(0, parser.value(rateOption).toInt());
+    settings.burstSize = qMax(1, parser.value(burstOption).toInt());
+    settings.pingInterval = qMax(0, parser.value(pingOption).toInt());
+    settings.probeInterval = qMax(0, parser.value(probeOption).toInt());
+    settings.isLooping = parser.isSet(loopOption);
+    settings.isCompressionOffered = !parser.isSet(noCompressionOption);
+
+    TTestServer server(settings);
+    QString errorMessage;
+    if (parser.isSet(scriptOption) && !server.loadScript(parser.value(scriptOption), errorMessage)) {
+        qCritical("%s", qPrintable(errorMessage));
+        return 1;
+    }
+    if (parser.isSet(replayOption) && !server.loadReplay(parser.value(replayOption), parser.isSet(timingOption), errorMessage)) {
+        qCritical("%s", qPrintable(errorMessage));
+        return 1;
+    }
+    if (parser.isSet(ansiArtOption)) {
+        server.addAnsiArt(qMax(0, parser.value(ansiArtOption).toInt()));
+    }
+    if (parser.isSet(writeReplayOption)) {
+        if (!server.writeReplay(parser.value(writeReplayOption), errorMessage)) {
+            qCritical("%s", qPrintable(errorMessage));
+            return 1;
+        }
+        return 0;
+    }
+    if (!server.listen(errorMessage)) {
+        qCritical("%s", qPrintable(errorMessage));
+        return 1;
+    }
+
+    return app.exec();
+}
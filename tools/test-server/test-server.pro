@@ -0,0 +1,46 @@
+############################################################################
+#    Copyright (C) 2018 by Mudlet developers                               #
+#                                                                          #
+#    This program is free software; you can redistribute it and/or modify  #
+#    it under the terms of the GNU General Public License as published by  #
+#    the Free Software Foundation; either version 2 of the License, or     #
+#    (at your option) any later version.                                   #
+#                                                                          #
+#    This program is distributed in the hope that it will be useful,       #
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+#    GNU General Public License for more details.                          #
+#                                                                          #
+#    You should have received a copy of the GNU General Public License     #
+#    along with this program; if not, write to the                         #
+#    Free Software Foundation, Inc.,                                       #
+#    59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             #
+############################################################################
+
+# A local stand-in for a MUD server, for load and latency testing; it shares
+# the replay file reader with the main application:
+TEMPLATE = app
+TARGET = mudlet-test-server
+CONFIG += console c++11
+CONFIG -= app_bundle
+QT = core network
+
+INCLUDEPATH += ../../src
+
+unix {
+    LIBS += -lz
+} else:win32 {
+    LIBS += -L"C:\\mingw32\\lib" \
+        -lz
+    INCLUDEPATH += "C:\\mingw32\\include"
+}
+
+SOURCES += \
+    main.cpp \
+    TTestServer.cpp \
+    ../../src/TReplayFile.cpp
+
+HEADERS += \
+    TTestServer.h \
+    ../../src/TReplayFile.h \
+    ../../src/TStringView.h